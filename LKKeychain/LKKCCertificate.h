@@ -39,6 +39,11 @@
 
 /** Represents a digital certificate. */
 @interface LKKCCertificate : LKKCKeychainItem
+{
+@private
+    // The DER data of the certificate, its decoded fields and derived values, filled on first use.
+    struct LKKCCertificateFields *volatile _fields;
+}
 
 + (LKKCCertificate *)certificateWithDERData:(NSData *)data;
 + (LKKCCertificate *)certificateWithSecCertificate:(SecCertificateRef)scertificate;
@@ -97,7 +102,7 @@
  certificates that contain a particular public key. Its value may be derived from the public
  key itself (using a possibly truncated SHA-1 digest), or it may contain a unique value.
  
- The value is nil if this certificate is not on a keychain.
+ If the certificate is not on a keychain, the value is read from the certificate's extension.
  
  This property corresponds to the `kSecAttrSubjectKeyID` attribute.
  */
@@ -120,10 +125,65 @@
  */
 @property (nonatomic, readonly) UInt32 certificateEncoding;
 
+/** --------------------------------------------------------------------------------
+ @name Decoded Fields
+ -------------------------------------------------------------------------------- */
+
+/** The subject DN of this certificate in DER format, exactly as it is encoded in the certificate.
+ 
+ Unlike <subject>, this value isn't normalized. The fields in this section are decoded from <data> 
+ on first use without the help of the Security framework, and the returned data objects share its bytes.
+ */
+@property (nonatomic, readonly) NSData *rawSubject;
+
+/** The issuer DN of this certificate in DER format, exactly as it is encoded in the certificate.
+ @see rawSubject
+ */
+@property (nonatomic, readonly) NSData *rawIssuer;
+
+/** The DER encoding of the SubjectPublicKeyInfo structure of this certificate, which includes the key algorithm.
+ */
+@property (nonatomic, readonly) NSData *subjectPublicKeyInfo;
+
+/** The beginning of the validity period of this certificate.
+ */
+@property (nonatomic, readonly) NSDate *notValidBefore;
+
+/** The end of the validity period of this certificate.
+ */
+@property (nonatomic, readonly) NSDate *notValidAfter;
+
+/** The DNS names in the subject alternative name extension of this certificate, as NSStrings.
+ 
+ The array is empty if the certificate doesn't have the extension.
+ */
+@property (nonatomic, readonly) NSArray *DNSNames;
+
+/** The IP addresses in the subject alternative name extension of this certificate, 
+ as NSData objects holding 4-byte IPv4 or 16-byte IPv6 addresses in network byte order.
+ 
+ The array is empty if the certificate doesn't have the extension.
+ */
+@property (nonatomic, readonly) NSArray *IPAddresses;
+
+/** The object identifiers of the extensions in this certificate, as NSStrings in dotted decimal form.
+ */
+@property (nonatomic, readonly) NSArray *extensionOIDs;
+
+/** Return the value of an extension.
+ @param oid The object identifier of the extension in dotted decimal form, e.g., `@"2.5.29.19"`.
+ @param critical On output, whether the extension is marked critical (optional).
+ @return The DER-encoded value of the extension, or nil if the certificate doesn't have it.
+ */
+- (NSData *)valueForExtensionWithOID:(NSString *)oid critical:(BOOL *)critical;
+
 /** --------------------------------------------------------------------------------
  @name Miscellaneous Properties
  -------------------------------------------------------------------------------- */
 
+// Certificates are immutable, so the properties in this section (and <publicKeyHash>) 
+// are computed on first use, then kept for the lifetime of the object.
+
 /** The Common Name of the certificate subject.
  */
 @property (nonatomic, readonly) NSString *commonName;
@@ -140,6 +200,14 @@
  */
 @property (nonatomic, readonly) NSData *data;
 
+/** The SHA-1 digest of <data>.
+ */
+@property (nonatomic, readonly) NSData *SHA1Fingerprint;
+
+/** The SHA-256 digest of <data>.
+ */
+@property (nonatomic, readonly) NSData *SHA256Fingerprint;
+
 /** The certificate data in dictionary format, as returned by `SecCertificateCopyValues`.
  */
 - (NSDictionary *)contents;
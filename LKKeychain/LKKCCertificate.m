@@ -39,6 +39,36 @@
 #import "LKKCKeychainItem+Subclasses.h"
 #import "LKKCKey.h"
 #import "LKKCUtil.h"
+#import "LKKCDER.h"
+#import <libkern/OSAtomic.h>
+
+// Derived values that are computed once and kept for the lifetime of the certificate.
+enum {
+    LKKCCertificateValueCommonName,
+    LKKCCertificateValueSubjectSummary,
+    LKKCCertificateValueEmailAddresses,
+    LKKCCertificateValueContents,
+    LKKCCertificateValuePublicKeyHash,
+    LKKCCertificateValueSHA1Fingerprint,
+    LKKCCertificateValueSHA256Fingerprint,
+    LKKCCertificateValueCount
+};
+
+struct LKKCCertificateFields {
+    NSData *data; // The slices in der point into its bytes.
+    BOOL decoded; // NO if data is malformed; der is invalid then.
+    LKKCDERCertificate der;
+    id volatile values[LKKCCertificateValueCount];
+};
+
+@interface LKKCCertificate()
+- (struct LKKCCertificateFields *)_loadFields;
+- (id)_cachedValue:(int)index;
+- (id)_cacheValue:(id)value at:(int)index;
+- (const LKKCDERCertificate *)_der;
+- (NSData *)_dataForSlice:(LKKCDERSlice)slice;
+- (NSArray *)_subjectAlternativeNamesWithTag:(uint8_t)tag;
+@end
 
 @implementation LKKCCertificate
 
@@ -73,6 +103,18 @@
     return [certificate autorelease];
 }
 
+- (void)dealloc
+{
+    if (_fields != NULL) {
+        for (int i = 0; i < LKKCCertificateValueCount; i++) {
+            [_fields->values[i] release];
+        }
+        [_fields->data release];
+        free(_fields);
+    }
+    [super dealloc];
+}
+
 
 #pragma mark - Attributes
 
@@ -109,22 +151,11 @@
             // SecCertificateCopyNormalizedSubjectContent does not include the topmost SEQUENCE tag.
             // This seems to be a bug in 10.7, since kSecAttrSubject does include it, as does
             // SecCertificateCopyNormalizedIssuerContent.
-            // Work around this issue by gluing the tag back using duct tape.
-            if (length > 65535) {
-                // I don't feel like writing a full DER encoder.
-                LKKCReportError(errSecInternalError, NULL, @"Normalized subject DN is too long");
-                return nil;
-            }
-            size_t tagLength = (length < 128 ? 2 : 4);
-            NSMutableData *newSubject = [NSMutableData dataWithCapacity:tagLength + length];
-            if (length < 128) {
-                UInt8 b[2] = { '\x30', (UInt8)length };
-                [newSubject appendBytes:&b length:2];
-            }
-            else {
-                UInt8 b[4] = { '\x30', 2, (UInt8)(length >> 8), (UInt8)length };
-                [newSubject appendBytes:&b length:4];
-            }
+            // Work around this issue by gluing the tag back.
+            uint8_t header[2 + sizeof(size_t)] = { LKKCDERTagSequence };
+            size_t headerLength = 1 + LKKCDEREncodeLength(length, header + 1);
+            NSMutableData *newSubject = [NSMutableData dataWithCapacity:headerLength + length];
+            [newSubject appendBytes:header length:headerLength];
             [newSubject appendData:subject];
             subject = newSubject;
         }
@@ -162,6 +193,9 @@
     NSData *result = [self valueForAttribute:kSecAttrSerialNumber];
     if (result)
         return result;
+    const LKKCDERCertificate *der = [self _der];
+    if (der != NULL)
+        return [self _dataForSlice:der->serialNumber];
     if (SecCertificateCopySerialNumber != NULL) { // 10.7
         CFErrorRef cferror = NULL;
         result = (NSData *)SecCertificateCopySerialNumber(scertificate, &cferror);
@@ -180,7 +214,20 @@
     SecCertificateRef scertificate = self.SecCertificate;
     if (scertificate == NULL)
         return nil;
-    return [self valueForAttribute:kSecAttrSubjectKeyID];
+    NSData *result = [self valueForAttribute:kSecAttrSubjectKeyID];
+    if (result != nil)
+        return result;
+    
+    const LKKCDERCertificate *der = [self _der];
+    LKKCDERExtension extension;
+    LKKCDERItem keyID;
+    if (der == NULL || LKKCDERFindExtension(der, LKKCDEROIDSubjectKeyIdentifier, sizeof(LKKCDEROIDSubjectKeyIdentifier), &extension) != 0)
+        return nil;
+    if (LKKCDERDecodeItem(extension.value, &keyID) != 0 || keyID.tag != LKKCDERTagOctetString) {
+        LKKCReportError(errSecDecode, NULL, @"Malformed subject key identifier");
+        return nil;
+    }
+    return [self _dataForSlice:keyID.content];
 }
 
 - (NSData *)publicKeyHash
@@ -188,9 +235,20 @@
     SecCertificateRef scertificate = self.SecCertificate;
     if (scertificate == NULL)
         return nil;
-    NSData *result = [self valueForAttribute:kSecAttrPublicKeyHash];
+    NSData *result = [self _cachedValue:LKKCCertificateValuePublicKeyHash];
     if (result != nil)
         return result;
+    result = [self valueForAttribute:kSecAttrPublicKeyHash];
+    if (result != nil)
+        return [self _cacheValue:result at:LKKCCertificateValuePublicKeyHash];
+    
+    // The hash covers the contents of the subjectPublicKey BIT STRING.
+    UInt8 md[CC_SHA1_DIGEST_LENGTH];
+    const LKKCDERCertificate *der = [self _der];
+    if (der != NULL) {
+        CC_SHA1(der->subjectPublicKey.bytes, (CC_LONG)der->subjectPublicKey.length, md);
+        return [self _cacheValue:[NSData dataWithBytes:md length:CC_SHA1_DIGEST_LENGTH] at:LKKCCertificateValuePublicKeyHash];
+    }
     
     // Calculate hash manually.
     LKKCKey *publicKey = self.publicKey;
@@ -200,9 +258,8 @@
     if (publicKeyData == nil)
         return nil;
     
-    UInt8 md[CC_SHA1_DIGEST_LENGTH];
     CC_SHA1([publicKeyData bytes], [publicKeyData length], md);
-    return [NSData dataWithBytes:md length:CC_SHA1_DIGEST_LENGTH];
+    return [self _cacheValue:[NSData dataWithBytes:md length:CC_SHA1_DIGEST_LENGTH] at:LKKCCertificateValuePublicKeyHash];
 }
 
 - (UInt32)certificateType
@@ -256,6 +313,200 @@
     return (SecCertificateRef)_sitem;
 }
 
+#pragma mark - Decoded Fields
+
+// Copy and decode the certificate on first use. Returns NULL if the certificate is deleted.
+- (struct LKKCCertificateFields *)_loadFields
+{
+    SecCertificateRef scertificate = self.SecCertificate;
+    if (scertificate == NULL)
+        return NULL;
+    struct LKKCCertificateFields *fields = _fields;
+    if (fields != NULL)
+        return fields;
+    
+    NSData *data = (NSData *)SecCertificateCopyData(scertificate);
+    if (data == nil)
+        return NULL;
+    fields = calloc(1, sizeof(*fields));
+    fields->data = data;
+    fields->decoded = (LKKCDERDecodeCertificate([data bytes], [data length], &fields->der) == 0);
+    if (!OSAtomicCompareAndSwapPtrBarrier(NULL, fields, (void * volatile *)&_fields)) {
+        // Another thread got there first.
+        [data release];
+        free(fields);
+        return _fields;
+    }
+    if (!fields->decoded) {
+        LKKCReportError(errSecDecode, NULL, @"Can't decode certificate");
+    }
+    return fields;
+}
+
+// Returns NULL if the certificate is deleted or malformed.
+- (const LKKCDERCertificate *)_der
+{
+    struct LKKCCertificateFields *fields = [self _loadFields];
+    if (fields == NULL || !fields->decoded)
+        return NULL;
+    return &fields->der;
+}
+
+- (id)_cachedValue:(int)index
+{
+    struct LKKCCertificateFields *fields = [self _loadFields];
+    if (fields == NULL)
+        return nil;
+    return [[fields->values[index] retain] autorelease];
+}
+
+// Remember value unless another thread has already done so. Returns the value that is kept.
+- (id)_cacheValue:(id)value at:(int)index
+{
+    struct LKKCCertificateFields *fields = [self _loadFields];
+    if (fields == NULL || value == nil)
+        return value;
+    [value retain];
+    if (!OSAtomicCompareAndSwapPtrBarrier(nil, value, (void * volatile *)&fields->values[index])) {
+        [value release];
+        value = fields->values[index];
+    }
+    return [[value retain] autorelease];
+}
+
+- (NSData *)_dataForSlice:(LKKCDERSlice)slice
+{
+    if (slice.bytes == NULL)
+        return nil;
+    return LKKCDataSlice([self _loadFields]->data, slice.bytes, slice.length);
+}
+
+- (NSData *)rawSubject
+{
+    const LKKCDERCertificate *der = [self _der];
+    return (der != NULL ? [self _dataForSlice:der->subject] : nil);
+}
+
+- (NSData *)rawIssuer
+{
+    const LKKCDERCertificate *der = [self _der];
+    return (der != NULL ? [self _dataForSlice:der->issuer] : nil);
+}
+
+- (NSData *)subjectPublicKeyInfo
+{
+    const LKKCDERCertificate *der = [self _der];
+    return (der != NULL ? [self _dataForSlice:der->subjectPublicKeyInfo] : nil);
+}
+
+- (NSDate *)notValidBefore
+{
+    const LKKCDERCertificate *der = [self _der];
+    int64_t seconds;
+    if (der == NULL || LKKCDERDecodeTime(der->notBeforeTag, der->notBefore, &seconds) != 0)
+        return nil;
+    return [NSDate dateWithTimeIntervalSince1970:(NSTimeInterval)seconds];
+}
+
+- (NSDate *)notValidAfter
+{
+    const LKKCDERCertificate *der = [self _der];
+    int64_t seconds;
+    if (der == NULL || LKKCDERDecodeTime(der->notAfterTag, der->notAfter, &seconds) != 0)
+        return nil;
+    return [NSDate dateWithTimeIntervalSince1970:(NSTimeInterval)seconds];
+}
+
+// Return the subject alternative names of the given kind as slices.
+- (NSArray *)_subjectAlternativeNamesWithTag:(uint8_t)tag
+{
+    const LKKCDERCertificate *der = [self _der];
+    if (der == NULL)
+        return nil;
+    NSMutableArray *names = [NSMutableArray array];
+    LKKCDERExtension extension;
+    if (LKKCDERFindExtension(der, LKKCDEROIDSubjectAlternativeName, sizeof(LKKCDEROIDSubjectAlternativeName), &extension) != 0)
+        return names;
+    
+    LKKCDERReader reader;
+    LKKCDERItem item;
+    int result = LKKCDERReaderInitGeneralNames(&reader, &extension);
+    while (result == 0 && (result = LKKCDERReaderNext(&reader, &item)) == 0) {
+        if (item.tag == tag)
+            [names addObject:[self _dataForSlice:item.content]];
+    }
+    if (result < 0) {
+        LKKCReportError(errSecDecode, NULL, @"Malformed subject alternative names");
+        return nil;
+    }
+    return names;
+}
+
+- (NSArray *)DNSNames
+{
+    NSArray *names = [self _subjectAlternativeNamesWithTag:LKKCDERGeneralNameDNS];
+    if (names == nil)
+        return nil;
+    NSMutableArray *result = [NSMutableArray arrayWithCapacity:[names count]];
+    for (NSData *name in names) {
+        NSString *string = [[NSString alloc] initWithData:name encoding:NSASCIIStringEncoding];
+        if (string != nil)
+            [result addObject:string];
+        [string release];
+    }
+    return result;
+}
+
+- (NSArray *)IPAddresses
+{
+    NSArray *addresses = [self _subjectAlternativeNamesWithTag:LKKCDERGeneralNameIPAddress];
+    if (addresses == nil)
+        return nil;
+    NSMutableArray *result = [NSMutableArray arrayWithCapacity:[addresses count]];
+    for (NSData *address in addresses) {
+        if ([address length] == 4 || [address length] == 16)
+            [result addObject:address];
+    }
+    return result;
+}
+
+- (NSArray *)extensionOIDs
+{
+    const LKKCDERCertificate *der = [self _der];
+    if (der == NULL)
+        return nil;
+    NSMutableArray *result = [NSMutableArray array];
+    LKKCDERReader reader;
+    LKKCDERExtension extension;
+    char oid[128];
+    LKKCDERReaderInit(&reader, der->extensions);
+    while (LKKCDERReaderNextExtension(&reader, &extension) == 0) {
+        if (LKKCDERFormatOID(extension.oid, oid, sizeof(oid)) == 0)
+            [result addObject:[NSString stringWithUTF8String:oid]];
+    }
+    return result;
+}
+
+- (NSData *)valueForExtensionWithOID:(NSString *)oid critical:(BOOL *)critical
+{
+    const LKKCDERCertificate *der = [self _der];
+    if (der == NULL)
+        return nil;
+    const char *wanted = [oid UTF8String];
+    LKKCDERReader reader;
+    LKKCDERExtension extension;
+    char buffer[128];
+    LKKCDERReaderInit(&reader, der->extensions);
+    while (LKKCDERReaderNextExtension(&reader, &extension) == 0) {
+        if (LKKCDERFormatOID(extension.oid, buffer, sizeof(buffer)) == 0 && strcmp(buffer, wanted) == 0) {
+            if (critical != NULL)
+                *critical = (extension.critical != 0);
+            return [self _dataForSlice:extension.value];
+        }
+    }
+    return nil;
+}
+
 #pragma mark - Extra information
 
 - (NSString *)commonName
@@ -263,13 +514,16 @@
     SecCertificateRef scertificate = self.SecCertificate;
     if (scertificate == NULL)
         return nil;
+    NSString *result = [self _cachedValue:LKKCCertificateValueCommonName];
+    if (result != nil)
+        return result;
     CFStringRef cn = NULL;
     OSStatus status = SecCertificateCopyCommonName(scertificate, &cn);
     if (status) {
         LKKCReportError(status, NULL, @"Can't get common name from certificate");
         return nil;
     }
-    return [(NSString *)cn autorelease];
+    return [self _cacheValue:[(NSString *)cn autorelease] at:LKKCCertificateValueCommonName];
 }
 
 - (NSString *)subjectSummary
@@ -277,8 +531,11 @@
     SecCertificateRef scertificate = self.SecCertificate;
     if (scertificate == NULL)
         return nil;
+    NSString *result = [self _cachedValue:LKKCCertificateValueSubjectSummary];
+    if (result != nil)
+        return result;
     CFStringRef summary = SecCertificateCopySubjectSummary(scertificate);
-    return [(NSString *)summary autorelease];
+    return [self _cacheValue:[(NSString *)summary autorelease] at:LKKCCertificateValueSubjectSummary];
 }
 
 - (NSArray *)emailAddresses
@@ -286,13 +543,16 @@
     SecCertificateRef scertificate = self.SecCertificate;
     if (scertificate == NULL)
         return nil;
+    NSArray *result = [self _cachedValue:LKKCCertificateValueEmailAddresses];
+    if (result != nil)
+        return result;
     CFArrayRef addresses = NULL;
     OSStatus status = SecCertificateCopyEmailAddresses(scertificate, &addresses);
     if (status) {
         LKKCReportError(status, NULL, @"Can't get email addresses from certificate");
         return nil;
     }
-    return [(NSArray *)addresses autorelease];
+    return [self _cacheValue:[(NSArray *)addresses autorelease] at:LKKCCertificateValueEmailAddresses];
 }
 
 - (LKKCKey *)publicKey
@@ -317,20 +577,60 @@
     SecCertificateRef scertificate = self.SecCertificate;
     if (scertificate == NULL)
         return nil;
-    NSData *data = (NSData *)SecCertificateCopyData(scertificate);
-    return [data autorelease];
+    struct LKKCCertificateFields *fields = [self _loadFields];
+    if (fields == NULL)
+        return nil;
+    return [[fields->data retain] autorelease];
+}
+
+- (NSData *)SHA1Fingerprint
+{
+    SecCertificateRef scertificate = self.SecCertificate;
+    if (scertificate == NULL)
+        return nil;
+    NSData *result = [self _cachedValue:LKKCCertificateValueSHA1Fingerprint];
+    if (result != nil)
+        return result;
+    NSData *data = self.data;
+    if (data == nil)
+        return nil;
+    UInt8 md[CC_SHA1_DIGEST_LENGTH];
+    CC_SHA1([data bytes], (CC_LONG)[data length], md);
+    return [self _cacheValue:[NSData dataWithBytes:md length:CC_SHA1_DIGEST_LENGTH] at:LKKCCertificateValueSHA1Fingerprint];
+}
+
+- (NSData *)SHA256Fingerprint
+{
+    SecCertificateRef scertificate = self.SecCertificate;
+    if (scertificate == NULL)
+        return nil;
+    NSData *result = [self _cachedValue:LKKCCertificateValueSHA256Fingerprint];
+    if (result != nil)
+        return result;
+    NSData *data = self.data;
+    if (data == nil)
+        return nil;
+    UInt8 md[CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256([data bytes], (CC_LONG)[data length], md);
+    return [self _cacheValue:[NSData dataWithBytes:md length:CC_SHA256_DIGEST_LENGTH] at:LKKCCertificateValueSHA256Fingerprint];
 }
 
 - (NSDictionary *)contents
 {
+    SecCertificateRef scertificate = self.SecCertificate;
+    if (scertificate == NULL)
+        return nil;
+    NSDictionary *result = [self _cachedValue:LKKCCertificateValueContents];
+    if (result != nil)
+        return result;
     CFErrorRef error = NULL;
-    NSDictionary *contents = (NSDictionary *)SecCertificateCopyValues(self.SecCertificate, NULL, &error);
+    NSDictionary *contents = (NSDictionary *)SecCertificateCopyValues(scertificate, NULL, &error);
     if (contents == nil) {
         LKKCReportErrorObj((NSError *)error, NULL, @"Can't get certificate contents");
         CFRelease(error);
         return nil;
     }
-    return [contents autorelease];
+    return [self _cacheValue:[contents autorelease] at:LKKCCertificateValueContents];
 }
 
 @end
@@ -35,14 +35,29 @@
 
 #import <Foundation/Foundation.h>
 #import <Security/Security.h>
+#import <LKKeychain/LKKCKey.h>
 
-@class LKKCKey;
+
+/** The size of the buffers used by the stream and file descriptor methods of LKKCCryptoContext. */
+extern const size_t LKKCCryptoContextStreamBufferSize;
+
+/** An encryption or decryption operation with a specific key.
+ 
+ A context can process a complete message at once with encryptData:error: or decryptData:error:, 
+ or it can process a message incrementally with updateWithData:error: and finishWithError:. 
+ Incremental processing is only supported for symmetric keys.
+ */
 @interface LKKCCryptoContext : NSObject
 {
 @private
-    LKKCKey *_key;
+    SecKeyRef _skey;
     NSData *_iv;
     CSSM_CC_HANDLE _cchandle;
+    BOOL _encrypt;
+    BOOL _symmetric;
+    BOOL _streaming;
+    BOOL _padded;
+    UInt32 _blockSize;
 }
 
 + (LKKCCryptoContext *)cryptoContextForKey:(LKKCKey *)key
@@ -50,7 +65,144 @@
                                 initVector:(NSData *)iv
                                      error:(NSError **)error;
 
+/** The key used by this context. */
+@property (nonatomic, readonly) SecKeyRef SecKey;
+
+/** The current initialization vector, or nil for asymmetric keys. */
+@property (nonatomic, readonly) NSData *initVector;
+
+/** Prepare the context for a new message encrypted with a different initialization vector.
+ 
+ Re-keying an existing context is much cheaper than creating a new one. 
+ Any unfinished incremental operation is abandoned.
+ 
+ @param iv The new initialization vector. Required for symmetric keys; ignored for asymmetric keys.
+ @param error On output, the error that occurred in case the context could not be updated (optional).
+ @return YES if the context is ready to process a new message.
+ */
+- (BOOL)resetWithInitVector:(NSData *)iv error:(NSError **)error;
+
 - (NSData *)encryptData:(NSData *)plaintext error:(NSError **)error;
 - (NSData *)decryptData:(NSData *)ciphertext error:(NSError **)error;
 
+/** --------------------------------------------------------------------------------
+ @name Caller-Provided Output
+ -------------------------------------------------------------------------------- */
+
+/** Return the number of bytes this context needs in its output buffer to process `length` bytes of input.
+ 
+ For encryption, this is the exact length of the ciphertext, including padding.
+ For decryption, this is an upper bound; the actual plaintext may be shorter by the length of the padding.
+ */
+- (size_t)outputLengthForInputLength:(size_t)length;
+
+/** Whether the input and output buffers may be the same. 
+ This is true for stream ciphers, whose output is always the same length as their input. */
+@property (nonatomic, readonly) BOOL supportsInPlaceOperation;
+
+/** Encrypt `length` bytes at `bytes` into a caller-provided buffer.
+ 
+ @param bytes The plaintext.
+ @param length The length of the plaintext.
+ @param output The buffer that receives the ciphertext. It may be the same as `bytes` if <supportsInPlaceOperation> is YES; otherwise the buffers must not overlap.
+ @param capacity The size of `output`; see outputLengthForInputLength:.
+ @param outputLength On output, the length of the ciphertext (optional).
+ @param error On output, the error that occurred in case the data could not be encrypted (optional).
+ @return YES if the data was encrypted.
+ */
+- (BOOL)encryptBytes:(const void *)bytes 
+              length:(size_t)length 
+              output:(void *)output 
+            capacity:(size_t)capacity 
+        outputLength:(size_t *)outputLength 
+               error:(NSError **)error;
+
+/** Decrypt `length` bytes at `bytes` into a caller-provided buffer.
+ @see encryptBytes:length:output:capacity:outputLength:error:
+ */
+- (BOOL)decryptBytes:(const void *)bytes 
+              length:(size_t)length 
+              output:(void *)output 
+            capacity:(size_t)capacity 
+        outputLength:(size_t *)outputLength 
+               error:(NSError **)error;
+
+/** Encrypt `plaintext` and append the ciphertext to `output`. 
+ On error, `output` is left unchanged. `plaintext` must not share storage with `output`. */
+- (BOOL)encryptData:(NSData *)plaintext appendingToData:(NSMutableData *)output error:(NSError **)error;
+
+/** Decrypt `ciphertext` and append the plaintext to `output`. 
+ On error, `output` is left unchanged. `ciphertext` must not share storage with `output`. */
+- (BOOL)decryptData:(NSData *)ciphertext appendingToData:(NSMutableData *)output error:(NSError **)error;
+
+/** --------------------------------------------------------------------------------
+ @name Batch Encryption and Decryption
+ -------------------------------------------------------------------------------- */
+
+/** Encrypt many messages into a single buffer, switching initialization vectors between messages.
+ @see [LKKCKey encryptBatch:count:output:capacity:offsets:error:]
+ */
+- (BOOL)encryptBatch:(const LKKCCryptoBatchItem *)items 
+               count:(NSUInteger)count 
+              output:(void *)output 
+            capacity:(size_t)capacity 
+             offsets:(size_t *)offsets 
+               error:(NSError **)error;
+
+/** Decrypt many messages into a single buffer, switching initialization vectors between messages.
+ @see [LKKCKey decryptBatch:count:output:capacity:offsets:error:]
+ */
+- (BOOL)decryptBatch:(const LKKCCryptoBatchItem *)items 
+               count:(NSUInteger)count 
+              output:(void *)output 
+            capacity:(size_t)capacity 
+             offsets:(size_t *)offsets 
+               error:(NSError **)error;
+
+/** --------------------------------------------------------------------------------
+ @name Incremental Encryption and Decryption
+ -------------------------------------------------------------------------------- */
+
+/** Process the next chunk of the message. 
+ 
+ The returned data may be shorter or longer than the input, because block ciphers 
+ hold back partial blocks until more input arrives or until the message is finished.
+ 
+ @param data The next chunk of plaintext (when encrypting) or ciphertext (when decrypting).
+ @param error On output, the error that occurred in case the data could not be processed (optional).
+ @return The output produced for this chunk, which may be empty, or nil on error.
+ */
+- (NSData *)updateWithData:(NSData *)data error:(NSError **)error;
+
+/** Finish the message and return the remaining output, including any padding. 
+ After this call, the context can be used to process a new message with the same initialization vector.
+ @param error On output, the error that occurred in case the message could not be finished (optional).
+ @return The remaining output, which may be empty, or nil on error.
+ */
+- (NSData *)finishWithError:(NSError **)error;
+
+/** Process all data from `input` and write the result to `output`.
+ 
+ Memory use is constant: data is read and written in LKKCCryptoContextStreamBufferSize chunks, 
+ and output is written on a background queue while the next chunk is being processed.
+ The streams are opened if necessary, but they are not closed.
+ 
+ @param input The stream to read from.
+ @param output The stream to write to.
+ @param error On output, the error that occurred in case processing failed (optional).
+ @return YES if all input was processed and written successfully.
+ */
+- (BOOL)processInputStream:(NSInputStream *)input outputStream:(NSOutputStream *)output error:(NSError **)error;
+
+/** Process all data read from the file descriptor `input` and write the result to the file descriptor `output`.
+ 
+ This works the same way as processInputStream:outputStream:error:. The file descriptors are not closed.
+ 
+ @param input The file descriptor to read from.
+ @param output The file descriptor to write to.
+ @param error On output, the error that occurred in case processing failed (optional).
+ @return YES if all input was processed and written successfully.
+ */
+- (BOOL)processFileDescriptor:(int)input outputFileDescriptor:(int)output error:(NSError **)error;
+
 @end
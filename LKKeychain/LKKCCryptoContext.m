@@ -34,11 +34,30 @@
 // 
 
 #import "LKKCCryptoContext.h"
+#import "LKKCCryptoContext+Private.h"
 #import "LKKCKey.h"
 #import "LKKCUtil.h"
 
+const size_t LKKCCryptoContextStreamBufferSize = 64 * 1024;
+
+// Reads up to length bytes into buffer. Returns the number of bytes read, 0 at the end of input, or -1 on error.
+typedef ssize_t (^LKKCCryptoContextReader)(void *buffer, size_t length, NSError **error);
+// Writes all length bytes from buffer. Returns NO on error.
+typedef BOOL (^LKKCCryptoContextWriter)(const void *buffer, size_t length, NSError **error);
+
 @interface LKKCCryptoContext()
-- (id)initWithKey:(LKKCKey *)key initVector:(NSData *)iv ccHandle:(CSSM_CC_HANDLE)cchandle;
+- (id)initWithKey:(LKKCKey *)key initVector:(NSData *)iv ccHandle:(CSSM_CC_HANDLE)cchandle operation:(CSSM_ACL_AUTHORIZATION_TAG)operation padding:(CSSM_PADDING)padding;
+- (size_t)_outputCapacityForInputLength:(size_t)length;
+- (BOOL)_setInitVectorBytes:(const void *)bytes length:(size_t)length error:(NSError **)error;
+- (BOOL)_encrypt:(BOOL)encrypt bytes:(const void *)bytes length:(size_t)length output:(void *)output capacity:(size_t)capacity produced:(size_t *)produced error:(NSError **)error;
+- (BOOL)_process:(BOOL)encrypt bytes:(const void *)bytes length:(size_t)length output:(void *)output capacity:(size_t)capacity outputLength:(size_t *)outputLength error:(NSError **)error;
+- (BOOL)_process:(BOOL)encrypt data:(NSData *)input appendingToData:(NSMutableData *)output error:(NSError **)error;
+- (BOOL)_processBatch:(const LKKCCryptoBatchItem *)items count:(NSUInteger)count encrypt:(BOOL)encrypt output:(void *)output capacity:(size_t)capacity offsets:(size_t *)offsets error:(NSError **)error;
+- (BOOL)_beginStreamingWithError:(NSError **)error;
+- (BOOL)_updateWithBytes:(const void *)bytes length:(size_t)length output:(void *)output capacity:(size_t)capacity produced:(size_t *)produced error:(NSError **)error;
+- (BOOL)_finishWithOutput:(void *)output capacity:(size_t)capacity produced:(size_t *)produced error:(NSError **)error;
+- (void)_abortStreaming;
+- (BOOL)_processWithReader:(LKKCCryptoContextReader)reader writer:(LKKCCryptoContextWriter)writer error:(NSError **)error;
 @end
 
 @implementation LKKCCryptoContext
@@ -47,6 +66,21 @@
                                  operation:(CSSM_ACL_AUTHORIZATION_TAG)operation 
                                 initVector:(NSData *)iv
                                      error:(NSError **)error
+{
+    return [self _cryptoContextForKey:key 
+                            operation:operation 
+                                 mode:LKKCCryptoContextDefaultMode 
+                              padding:LKKCCryptoContextDefaultPadding 
+                           initVector:iv 
+                                error:error];
+}
+
++ (LKKCCryptoContext *)_cryptoContextForKey:(LKKCKey *)key 
+                                  operation:(CSSM_ACL_AUTHORIZATION_TAG)operation 
+                                       mode:(CSSM_ENCRYPT_MODE)mode
+                                    padding:(CSSM_PADDING)padding
+                                 initVector:(NSData *)iv
+                                      error:(NSError **)error
 {
     SecKeyRef skey = key.SecKey;
     if (skey == nil) {
@@ -80,7 +114,7 @@
         algid = CSSM_ALGID_3DES_3KEY_EDE;
     
     CSSM_ENCRYPT_MODE algmode = CSSM_ALGMODE_NONE;
-    CSSM_PADDING padding = CSSM_PADDING_NONE;
+    CSSM_PADDING algpadding = CSSM_PADDING_NONE;
     switch(algid) {
             /* 8-byte block ciphers */
         case CSSM_ALGID_DES:
@@ -88,35 +122,40 @@
         case CSSM_ALGID_RC5:
         case CSSM_ALGID_RC2:
             algmode = CSSM_ALGMODE_CBCPadIV8;
-            padding = CSSM_PADDING_PKCS5;
+            algpadding = CSSM_PADDING_PKCS5;
             break;
             
             /* 16-byte block ciphers */
         case CSSM_ALGID_AES:
             algmode = CSSM_ALGMODE_CBCPadIV8;
-            padding = CSSM_PADDING_PKCS7;
+            algpadding = CSSM_PADDING_PKCS7;
             break;
             
             /* stream ciphers */
         case CSSM_ALGID_ASC:
         case CSSM_ALGID_RC4:
             algmode = CSSM_ALGMODE_NONE;
-            padding = CSSM_PADDING_NONE;
+            algpadding = CSSM_PADDING_NONE;
             break;
             
         case CSSM_ALGID_RSA:
-            padding = CSSM_PADDING_PKCS1;
+            algpadding = CSSM_PADDING_PKCS1;
             break;
         default:
             LKKCReportError(errSecInvalidAlgorithm, error, @"Unsupported key type");
             return nil;
     }
     
+    if (mode != LKKCCryptoContextDefaultMode)
+        algmode = mode;
+    if (padding != LKKCCryptoContextDefaultPadding)
+        algpadding = padding;
+    
     CSSM_CC_HANDLE cchandle = 0;
     switch (key.keyClass) {
         case LKKCKeyClassPublic:
         case LKKCKeyClassPrivate: {
-            status = CSSM_CSP_CreateAsymmetricContext(csphandle, algid, scredentials, cssmkey, padding, &cchandle);
+            status = CSSM_CSP_CreateAsymmetricContext(csphandle, algid, scredentials, cssmkey, algpadding, &cchandle);
             if (status) {
                 LKKCReportError(status, error, @"Can't create symmetric context");
                 return nil;
@@ -124,12 +163,12 @@
             break;            
         }
         case LKKCKeyClassSymmetric: {
-            if (iv == nil) {
+            if (iv == nil && algmode != CSSM_ALGMODE_ECB) {
                 LKKCReportError(errSecParam, error, @"Missing initialization vector");
                 return nil;
             }
             CSSM_DATA cssm_iv = { .Length = [iv length], .Data = (void *)[iv bytes] };
-            status = CSSM_CSP_CreateSymmetricContext(csphandle, algid, algmode, scredentials, cssmkey, &cssm_iv, padding, NULL, &cchandle);
+            status = CSSM_CSP_CreateSymmetricContext(csphandle, algid, algmode, scredentials, cssmkey, (iv != nil ? &cssm_iv : NULL), algpadding, NULL, &cchandle);
             if (status) {
                 LKKCReportError(status, error, @"Can't create symmetric context");
                 return nil;
@@ -143,82 +182,479 @@
         }
     }
     
-    return [[[LKKCCryptoContext alloc] initWithKey:key initVector:iv ccHandle:cchandle] autorelease];    
+    return [[[LKKCCryptoContext alloc] initWithKey:key initVector:iv ccHandle:cchandle operation:operation padding:algpadding] autorelease];
 }
 
-- (id)initWithKey:(LKKCKey *)key initVector:(NSData *)iv ccHandle:(CSSM_CC_HANDLE)cchandle
+- (id)initWithKey:(LKKCKey *)key initVector:(NSData *)iv ccHandle:(CSSM_CC_HANDLE)cchandle operation:(CSSM_ACL_AUTHORIZATION_TAG)operation padding:(CSSM_PADDING)padding
 {
     self = [super init];
     if (self == nil)
         return nil;
-    _key = [key retain];
+    // Retain the SecKey rather than the LKKCKey, because keys keep a pool of their contexts.
+    _skey = (SecKeyRef)CFRetain(key.SecKey);
     _iv = [iv retain];
     _cchandle = cchandle;
+    _encrypt = (operation == CSSM_ACL_AUTHORIZATION_ENCRYPT);
+    _symmetric = (key.keyClass == LKKCKeyClassSymmetric);
+    _streaming = NO;
+    _padded = (padding != CSSM_PADDING_NONE);
+    _blockSize = (_symmetric ? key.blockSize : 0);
     return self;
 }
 
 - (void)dealloc
 {
+    [self _abortStreaming];
     CSSM_DeleteContext(_cchandle);
-    [_key release];
+    CFRelease(_skey);
+    [_iv release];
     [super dealloc];
 }
 
+@synthesize SecKey = _skey;
+@synthesize initVector = _iv;
+
+- (BOOL)resetWithInitVector:(NSData *)iv error:(NSError **)error
+{
+    [self _abortStreaming];
+    if (!_symmetric)
+        return YES;
+    if (iv == nil) {
+        LKKCReportError(errSecParam, error, @"Missing initialization vector");
+        return NO;
+    }
+    if (iv == _iv || [iv isEqualToData:_iv])
+        return YES;
+    if (![self _setInitVectorBytes:[iv bytes] length:[iv length] error:error])
+        return NO;
+    [_iv release];
+    _iv = [iv copy];
+    return YES;
+}
+
+- (BOOL)_setInitVectorBytes:(const void *)bytes length:(size_t)length error:(NSError **)error
+{
+    CSSM_DATA cssm_iv = { .Length = length, .Data = (void *)bytes };
+    CSSM_CONTEXT_ATTRIBUTE attribute;
+    attribute.AttributeType = CSSM_ATTRIBUTE_INIT_VECTOR;
+    attribute.AttributeLength = sizeof(CSSM_DATA);
+    attribute.Attribute.Data = &cssm_iv;
+    OSStatus status = CSSM_UpdateContextAttributes(_cchandle, 1, &attribute);
+    if (status) {
+        LKKCReportError(status, error, @"Can't update initialization vector");
+        return NO;
+    }
+    return YES;
+}
+
 - (NSData *)encryptData:(NSData *)plaintext error:(NSError **)error
 {
-    NSData *result = nil;
-    CSSM_DATA input = { .Length = [plaintext length], .Data = (void *)[plaintext bytes] };
-    CSSM_DATA output = { .Length = 0, .Data = NULL };
+    NSMutableData *result = [NSMutableData data];
+    if (![self encryptData:plaintext appendingToData:result error:error])
+        return nil;
+    return result;
+}
+
+- (NSData *)decryptData:(NSData *)ciphertext error:(NSError **)error
+{
+    NSMutableData *result = [NSMutableData data];
+    if (![self decryptData:ciphertext appendingToData:result error:error])
+        return nil;
+    return result;
+}
+
+#pragma mark - Caller-Provided Output
+
+- (size_t)outputLengthForInputLength:(size_t)length
+{
+    if (!_symmetric) {
+        CSSM_QUERY_SIZE_DATA querySize = { .SizeInputBlock = (uint32)length, .SizeOutputBlock = 0 };
+        OSStatus status = CSSM_QuerySize(_cchandle, (_encrypt ? CSSM_TRUE : CSSM_FALSE), 1, &querySize);
+        if (status) {
+            LKKCReportError(status, NULL, @"Can't query output size");
+            return 0;
+        }
+        return querySize.SizeOutputBlock;
+    }
+    if (_blockSize < 2 || !_encrypt || !_padded)
+        return length;
+    // All our block cipher modes use PKCS#7 padding, which adds a full block to aligned input.
+    return (length / _blockSize + 1) * _blockSize;
+}
+
+- (BOOL)supportsInPlaceOperation
+{
+    return _symmetric && _blockSize == 1;
+}
+
+- (BOOL)_process:(BOOL)encrypt bytes:(const void *)bytes length:(size_t)length output:(void *)output capacity:(size_t)capacity outputLength:(size_t *)outputLength error:(NSError **)error
+{
+    const uint8_t *inputStart = bytes;
+    const uint8_t *outputStart = output;
+    BOOL overlaps = (outputStart < inputStart + length && inputStart < outputStart + capacity);
+    if (overlaps && !(outputStart == inputStart && self.supportsInPlaceOperation)) {
+        LKKCReportError(errSecParam, error, @"Input and output buffers overlap");
+        return NO;
+    }
+    size_t produced = 0;
+    if (![self _encrypt:encrypt bytes:bytes length:length output:output capacity:capacity produced:&produced error:error])
+        return NO;
+    if (outputLength != NULL)
+        *outputLength = produced;
+    return YES;
+}
+
+- (BOOL)encryptBytes:(const void *)bytes length:(size_t)length output:(void *)output capacity:(size_t)capacity outputLength:(size_t *)outputLength error:(NSError **)error
+{
+    return [self _process:YES bytes:bytes length:length output:output capacity:capacity outputLength:outputLength error:error];
+}
+
+- (BOOL)decryptBytes:(const void *)bytes length:(size_t)length output:(void *)output capacity:(size_t)capacity outputLength:(size_t *)outputLength error:(NSError **)error
+{
+    return [self _process:NO bytes:bytes length:length output:output capacity:capacity outputLength:outputLength error:error];
+}
+
+- (BOOL)_process:(BOOL)encrypt data:(NSData *)input appendingToData:(NSMutableData *)output error:(NSError **)error
+{
+    NSUInteger start = [output length];
+    size_t capacity = [self outputLengthForInputLength:[input length]];
+    [output increaseLengthBy:capacity];
+    size_t produced = 0;
+    if (![self _encrypt:encrypt bytes:[input bytes] length:[input length] output:(uint8_t *)[output mutableBytes] + start capacity:capacity produced:&produced error:error]) {
+        [output setLength:start];
+        return NO;
+    }
+    [output setLength:start + produced];
+    return YES;
+}
+
+- (BOOL)encryptData:(NSData *)plaintext appendingToData:(NSMutableData *)output error:(NSError **)error
+{
+    return [self _process:YES data:plaintext appendingToData:output error:error];
+}
+
+- (BOOL)decryptData:(NSData *)ciphertext appendingToData:(NSMutableData *)output error:(NSError **)error
+{
+    return [self _process:NO data:ciphertext appendingToData:output error:error];
+}
+
+#pragma mark - Batch Processing
+
+- (BOOL)_encrypt:(BOOL)encrypt bytes:(const void *)bytes length:(size_t)length output:(void *)output capacity:(size_t)capacity produced:(size_t *)produced error:(NSError **)error
+{
+    // When the output buffer is large enough, the CSP writes into it instead of allocating memory.
+    BOOL result = NO;
+    CSSM_DATA input = { .Length = length, .Data = (void *)bytes };
+    CSSM_DATA outputData = { .Length = capacity, .Data = output };
     CSSM_DATA remData = { .Length = 0, .Data = NULL };
-    CSSM_SIZE bytesEncrypted = 0;
-    OSStatus status = CSSM_EncryptData(_cchandle, &input, 1, &output, 1, &bytesEncrypted, &remData);
+    CSSM_SIZE count = 0;
+    OSStatus status;
+    if (encrypt)
+        status = CSSM_EncryptData(_cchandle, &input, 1, &outputData, 1, &count, &remData);
+    else
+        status = CSSM_DecryptData(_cchandle, &input, 1, &outputData, 1, &count, &remData);
     if (status) {
-        LKKCReportError(status, error, @"Can't encrypt data");
+        LKKCReportError(status, error, (encrypt ? @"Can't encrypt data" : @"Can't decrypt data"));
         goto exit;
     }
-    if (remData.Length != 0) {
-        LKKCReportError(errSecInternalError, error, @"Leftover data after encryption");
+    if (remData.Length != 0 || outputData.Data != output) {
+        LKKCReportError(errSecBufferTooSmall, error, @"Output buffer is too small");
         goto exit;
     }
-    
-    result = [NSData dataWithBytesNoCopy:output.Data length:bytesEncrypted freeWhenDone:YES];
-    output.Data = NULL;
+    *produced = count;
+    result = YES;
     
 exit:
-    if (output.Data != NULL)
-        free(output.Data);
+    if (outputData.Data != output && outputData.Data != NULL)
+        free(outputData.Data);
     if (remData.Data != NULL)
         free(remData.Data);
     return result;
 }
 
-- (NSData *)decryptData:(NSData *)ciphertext error:(NSError **)error
+- (BOOL)_processBatch:(const LKKCCryptoBatchItem *)items count:(NSUInteger)count encrypt:(BOOL)encrypt output:(void *)output capacity:(size_t)capacity offsets:(size_t *)offsets error:(NSError **)error
 {
-    NSData *result = nil;
-    CSSM_DATA input = { .Length = [ciphertext length], .Data = (void *)[ciphertext bytes] };
-    CSSM_DATA output = { .Length = 0, .Data = NULL };
-    CSSM_DATA remData = { .Length = 0, .Data = NULL };
-    CSSM_SIZE bytesDecrypted = 0;
+    [self _abortStreaming];
     
-    OSStatus status = CSSM_DecryptData(_cchandle, &input, 1, &output, 1, &bytesDecrypted, &remData);
-    if (status) {
-        LKKCReportError(status, error, @"Can't decrypt data");
-        goto exit;
+    BOOL result = NO;
+    size_t offset = 0;
+    const void *iv = NULL;
+    for (NSUInteger i = 0; i < count; i++) {
+        if (_symmetric && items[i].initVector != iv) {
+            if (items[i].initVector == NULL) {
+                LKKCReportError(errSecParam, error, @"Missing initialization vector");
+                goto exit;
+            }
+            iv = items[i].initVector;
+            if (![self _setInitVectorBytes:iv length:_blockSize error:error])
+                goto exit;
+        }
+        offsets[i] = offset;
+        size_t produced = 0;
+        if (![self _encrypt:encrypt bytes:items[i].bytes length:items[i].length output:(uint8_t *)output + offset capacity:capacity - offset produced:&produced error:error])
+            goto exit;
+        offset += produced;
     }
-    if (remData.Length != 0) {
-        LKKCReportError(errSecInternalError, error, @"Leftover data after decryption");
-        goto exit;
+    offsets[count] = offset;
+    result = YES;
+    
+exit:
+    if (iv != NULL) {
+        // Keep initVector in sync with the context.
+        [_iv release];
+        _iv = [[NSData alloc] initWithBytes:iv length:_blockSize];
+    }
+    return result;
+}
+
+- (BOOL)encryptBatch:(const LKKCCryptoBatchItem *)items count:(NSUInteger)count output:(void *)output capacity:(size_t)capacity offsets:(size_t *)offsets error:(NSError **)error
+{
+    return [self _processBatch:items count:count encrypt:YES output:output capacity:capacity offsets:offsets error:error];
+}
+
+- (BOOL)decryptBatch:(const LKKCCryptoBatchItem *)items count:(NSUInteger)count output:(void *)output capacity:(size_t)capacity offsets:(size_t *)offsets error:(NSError **)error
+{
+    return [self _processBatch:items count:count encrypt:NO output:output capacity:capacity offsets:offsets error:error];
+}
+
+#pragma mark - Incremental Processing
+
+- (size_t)_outputCapacityForInputLength:(size_t)length
+{
+    // Block ciphers may release a held-back partial block along with the new input, 
+    // and the final call may add a full block of padding.
+    return length + 2 * _blockSize;
+}
+
+- (BOOL)_beginStreamingWithError:(NSError **)error
+{
+    if (_streaming)
+        return YES;
+    if (!_symmetric) {
+        LKKCReportError(errSecParam, error, @"Incremental processing needs a symmetric key");
+        return NO;
     }
+    OSStatus status = (_encrypt ? CSSM_EncryptDataInit(_cchandle) : CSSM_DecryptDataInit(_cchandle));
+    if (status) {
+        LKKCReportError(status, error, @"Can't start incremental processing");
+        return NO;
+    }
+    _streaming = YES;
+    return YES;
+}
+
+- (BOOL)_updateWithBytes:(const void *)bytes length:(size_t)length output:(void *)output capacity:(size_t)capacity produced:(size_t *)produced error:(NSError **)error
+{
+    if (![self _beginStreamingWithError:error])
+        return NO;
     
-    result = [NSData dataWithBytesNoCopy:output.Data length:bytesDecrypted freeWhenDone:YES];
-    output.Data = NULL;
+    OSStatus status;
+    CSSM_DATA input = { .Length = length, .Data = (void *)bytes };
+    CSSM_DATA outputData = { .Length = capacity, .Data = output };
+    CSSM_SIZE count = 0;
+    if (_encrypt)
+        status = CSSM_EncryptDataUpdate(_cchandle, &input, 1, &outputData, 1, &count);
+    else
+        status = CSSM_DecryptDataUpdate(_cchandle, &input, 1, &outputData, 1, &count);
+    if (status) {
+        [self _abortStreaming];
+        LKKCReportError(status, error, (_encrypt ? @"Can't encrypt data" : @"Can't decrypt data"));
+        return NO;
+    }
+    *produced = count;
+    return YES;
+}
+
+- (BOOL)_finishWithOutput:(void *)output capacity:(size_t)capacity produced:(size_t *)produced error:(NSError **)error
+{
+    // An empty message still needs to be initialized so that we get the padding.
+    if (![self _beginStreamingWithError:error])
+        return NO;
     
-exit:
-    if (output.Data != NULL)
-        free(output.Data);
+    CSSM_DATA remData = { .Length = capacity, .Data = output };
+    OSStatus status = (_encrypt ? CSSM_EncryptDataFinal(_cchandle, &remData) : CSSM_DecryptDataFinal(_cchandle, &remData));
+    _streaming = NO;
+    if (status) {
+        LKKCReportError(status, error, (_encrypt ? @"Can't finish encryption" : @"Can't finish decryption"));
+        return NO;
+    }
+    *produced = remData.Length;
+    return YES;
+}
+
+- (void)_abortStreaming
+{
+    if (!_streaming)
+        return;
+    CSSM_DATA remData = { .Length = 0, .Data = NULL };
+    if (_encrypt)
+        CSSM_EncryptDataFinal(_cchandle, &remData);
+    else
+        CSSM_DecryptDataFinal(_cchandle, &remData);
     if (remData.Data != NULL)
         free(remData.Data);
+    _streaming = NO;
+}
+
+- (NSData *)updateWithData:(NSData *)data error:(NSError **)error
+{
+    size_t length = [data length];
+    size_t capacity = [self _outputCapacityForInputLength:length];
+    NSMutableData *result = [NSMutableData dataWithLength:capacity];
+    size_t produced = 0;
+    if (![self _updateWithBytes:[data bytes] length:length output:[result mutableBytes] capacity:capacity produced:&produced error:error])
+        return nil;
+    [result setLength:produced];
     return result;
 }
 
+- (NSData *)finishWithError:(NSError **)error
+{
+    size_t capacity = [self _outputCapacityForInputLength:0];
+    NSMutableData *result = [NSMutableData dataWithLength:capacity];
+    size_t produced = 0;
+    if (![self _finishWithOutput:[result mutableBytes] capacity:capacity produced:&produced error:error])
+        return nil;
+    [result setLength:produced];
+    return result;
+}
+
+- (BOOL)_processWithReader:(LKKCCryptoContextReader)reader writer:(LKKCCryptoContextWriter)writer error:(NSError **)error
+{
+    // We alternate between two output buffers; one of them is being written on the write queue 
+    // while the other is filled with the output of the next chunk.
+    const size_t inputSize = LKKCCryptoContextStreamBufferSize;
+    const size_t outputSize = [self _outputCapacityForInputLength:inputSize];
+    uint8_t *input = malloc(inputSize);
+    uint8_t *outputs[2] = { malloc(outputSize), malloc(outputSize) };
+    dispatch_semaphore_t available[2] = { dispatch_semaphore_create(1), dispatch_semaphore_create(1) };
+    dispatch_queue_t writeQueue = dispatch_queue_create("hu.lorentey.LKKeychain.LKKCCryptoContext.write", NULL);
+    __block NSError *writeError = nil;
+    
+    BOOL result = (input != NULL && outputs[0] != NULL && outputs[1] != NULL);
+    if (!result)
+        LKKCReportError(errSecAllocate, error, @"Can't allocate buffers");
+    
+    BOOL done = NO;
+    int current = 0;
+    while (result && !done) {
+        NSError *readError = nil;
+        ssize_t count = reader(input, inputSize, &readError);
+        if (count < 0) {
+            LKKCReportErrorObj(readError, error, @"Can't read input");
+            result = NO;
+            break;
+        }
+        
+        dispatch_semaphore_wait(available[current], DISPATCH_TIME_FOREVER);
+        if (writeError != nil) {
+            // The write queue has already failed; it will be reported below.
+            dispatch_semaphore_signal(available[current]);
+            break;
+        }
+        
+        size_t produced = 0;
+        if (count == 0) {
+            result = [self _finishWithOutput:outputs[current] capacity:outputSize produced:&produced error:error];
+            done = YES;
+        }
+        else {
+            result = [self _updateWithBytes:input length:count output:outputs[current] capacity:outputSize produced:&produced error:error];
+        }
+        if (!result || produced == 0) {
+            dispatch_semaphore_signal(available[current]);
+            continue;
+        }
+        
+        uint8_t *bytes = outputs[current];
+        dispatch_semaphore_t semaphore = available[current];
+        dispatch_async(writeQueue, ^{
+            @autoreleasepool {
+                NSError *e = nil;
+                if (writeError == nil && !writer(bytes, produced, &e))
+                    writeError = [e retain];
+            }
+            dispatch_semaphore_signal(semaphore);
+        });
+        current = 1 - current;
+    }
+    
+    // Wait for pending writes.
+    dispatch_sync(writeQueue, ^{});
+    if (writeError != nil) {
+        if (result)
+            LKKCReportErrorObj([[writeError retain] autorelease], error, @"Can't write output");
+        [writeError release];
+        result = NO;
+    }
+    if (!result)
+        [self _abortStreaming];
+    
+    dispatch_release(writeQueue);
+    dispatch_release(available[0]);
+    dispatch_release(available[1]);
+    free(input);
+    free(outputs[0]);
+    free(outputs[1]);
+    return result;
+}
+
+- (BOOL)processInputStream:(NSInputStream *)input outputStream:(NSOutputStream *)output error:(NSError **)error
+{
+    if ([input streamStatus] == NSStreamStatusNotOpen)
+        [input open];
+    if ([output streamStatus] == NSStreamStatusNotOpen)
+        [output open];
+    
+    LKKCCryptoContextReader reader = ^ssize_t(void *buffer, size_t length, NSError **e) {
+        NSInteger count = [input read:buffer maxLength:length];
+        if (count < 0)
+            *e = [input streamError];
+        return count;
+    };
+    LKKCCryptoContextWriter writer = ^BOOL(const void *buffer, size_t length, NSError **e) {
+        while (length > 0) {
+            NSInteger count = [output write:buffer maxLength:length];
+            if (count <= 0) {
+                *e = [output streamError];
+                if (*e == nil)
+                    *e = [NSError errorWithDomain:NSPOSIXErrorDomain code:ENOSPC userInfo:nil];
+                return NO;
+            }
+            buffer = (const uint8_t *)buffer + count;
+            length -= count;
+        }
+        return YES;
+    };
+    return [self _processWithReader:reader writer:writer error:error];
+}
+
+- (BOOL)processFileDescriptor:(int)input outputFileDescriptor:(int)output error:(NSError **)error
+{
+    LKKCCryptoContextReader reader = ^ssize_t(void *buffer, size_t length, NSError **e) {
+        ssize_t count;
+        do {
+            count = read(input, buffer, length);
+        } while (count < 0 && errno == EINTR);
+        if (count < 0)
+            *e = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        return count;
+    };
+    LKKCCryptoContextWriter writer = ^BOOL(const void *buffer, size_t length, NSError **e) {
+        while (length > 0) {
+            ssize_t count = write(output, buffer, length);
+            if (count < 0) {
+                if (errno == EINTR)
+                    continue;
+                *e = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+                return NO;
+            }
+            buffer = (const uint8_t *)buffer + count;
+            length -= count;
+        }
+        return YES;
+    };
+    return [self _processWithReader:reader writer:writer error:error];
+}
+
 @end
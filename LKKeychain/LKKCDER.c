@@ -0,0 +1,457 @@
+//
+//  LKKCDER.c
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright © 2011, Károly Lőrentey. All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//  
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of Károly Lőrentey nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+//  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL KÁROLY LŐRENTEY BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+//  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+#include "LKKCDER.h"
+#include <stdio.h>
+#include <string.h>
+
+const uint8_t LKKCDEROIDSubjectKeyIdentifier[3] = { 0x55, 0x1d, 0x0e };
+const uint8_t LKKCDEROIDSubjectAlternativeName[3] = { 0x55, 0x1d, 0x11 };
+
+// Items
+
+void
+LKKCDERReaderInit(LKKCDERReader *reader, LKKCDERSlice slice)
+{
+    reader->next = slice.bytes;
+    reader->end = (slice.bytes != NULL ? slice.bytes + slice.length : NULL);
+}
+
+int
+LKKCDERReaderNext(LKKCDERReader *reader, LKKCDERItem *item)
+{
+    const uint8_t *p = reader->next;
+    if (p == reader->end)
+        return 1;
+    size_t remaining = (size_t)(reader->end - p);
+    if (remaining < 2)
+        return -1;
+    
+    uint8_t tag = p[0];
+    if ((tag & 0x1f) == 0x1f) // High tag numbers aren't used by X.509.
+        return -1;
+    
+    size_t header = 2;
+    size_t length = p[1];
+    if (length >= 0x80) {
+        size_t count = length & 0x7f;
+        // Indefinite lengths (count == 0) aren't DER; lengths that don't fit in a size_t can't be in memory.
+        if (count == 0 || count > sizeof(size_t) || count > remaining - 2)
+            return -1;
+        if (p[2] == 0) // Leading zeros
+            return -1;
+        length = 0;
+        for (size_t i = 0; i < count; i++)
+            length = (length << 8) | p[2 + i];
+        if (length < 0x80) // Should have used the short form
+            return -1;
+        header += count;
+    }
+    if (length > remaining - header)
+        return -1;
+    
+    item->tag = tag;
+    item->content.bytes = p + header;
+    item->content.length = length;
+    item->encoding.bytes = p;
+    item->encoding.length = header + length;
+    reader->next = p + header + length;
+    return 0;
+}
+
+int
+LKKCDERDecodeItem(LKKCDERSlice slice, LKKCDERItem *item)
+{
+    LKKCDERReader reader;
+    LKKCDERReaderInit(&reader, slice);
+    if (LKKCDERReaderNext(&reader, item) != 0 || reader.next != reader.end)
+        return -1;
+    return 0;
+}
+
+// Decode the next item and check its tag.
+static int
+LKKCDERReaderExpect(LKKCDERReader *reader, uint8_t tag, LKKCDERItem *item)
+{
+    if (LKKCDERReaderNext(reader, item) != 0 || item->tag != tag)
+        return -1;
+    return 0;
+}
+
+// Return whether the next item has the given tag, without consuming it.
+static int
+LKKCDERReaderPeek(const LKKCDERReader *reader, uint8_t tag)
+{
+    return reader->next != reader->end && reader->next[0] == tag;
+}
+
+// Check that the content of an INTEGER is present and minimally encoded.
+static int
+LKKCDERCheckInteger(const LKKCDERItem *item)
+{
+    const uint8_t *p = item->content.bytes;
+    if (item->tag != LKKCDERTagInteger || item->content.length == 0)
+        return -1;
+    if (item->content.length > 1 && ((p[0] == 0x00 && (p[1] & 0x80) == 0) || (p[0] == 0xff && (p[1] & 0x80) != 0)))
+        return -1;
+    return 0;
+}
+
+// Strip the unused-bits byte from the content of a BIT STRING that must be a whole number of bytes.
+static int
+LKKCDERBitStringBytes(const LKKCDERItem *item, LKKCDERSlice *bytes)
+{
+    if (item->tag != LKKCDERTagBitString || item->content.length < 1 || item->content.bytes[0] != 0)
+        return -1;
+    bytes->bytes = item->content.bytes + 1;
+    bytes->length = item->content.length - 1;
+    return 0;
+}
+
+size_t
+LKKCDEREncodeLength(size_t length, uint8_t *buffer)
+{
+    if (length < 0x80) {
+        buffer[0] = (uint8_t)length;
+        return 1;
+    }
+    size_t count = 0;
+    for (size_t l = length; l != 0; l >>= 8)
+        count++;
+    buffer[0] = (uint8_t)(0x80 | count);
+    for (size_t i = 0; i < count; i++)
+        buffer[count - i] = (uint8_t)(length >> (8 * i));
+    return 1 + count;
+}
+
+// Values
+
+int
+LKKCDERFormatOID(LKKCDERSlice oid, char *buffer, size_t capacity)
+{
+    if (oid.length == 0 || (oid.bytes[oid.length - 1] & 0x80) != 0 || capacity == 0)
+        return -1;
+    size_t used = 0;
+    int first = 1;
+    uint64_t value = 0;
+    int start = 1;
+    for (size_t i = 0; i < oid.length; i++) {
+        uint8_t b = oid.bytes[i];
+        if (start && b == 0x80) // Leading zeros
+            return -1;
+        if (value > (UINT64_MAX >> 7))
+            return -1;
+        value = (value << 7) | (b & 0x7f);
+        start = 0;
+        if (b & 0x80)
+            continue;
+        
+        int n;
+        if (first) {
+            // The first subidentifier combines the first two arcs.
+            unsigned arc = (value < 40 ? 0 : value < 80 ? 1 : 2);
+            n = snprintf(buffer + used, capacity - used, "%u.%llu", arc, (unsigned long long)(value - 40 * arc));
+            first = 0;
+        }
+        else
+            n = snprintf(buffer + used, capacity - used, ".%llu", (unsigned long long)value);
+        if (n < 0 || (size_t)n >= capacity - used)
+            return -1;
+        used += (size_t)n;
+        value = 0;
+        start = 1;
+    }
+    return 0;
+}
+
+// Parse count decimal digits.
+static int
+LKKCDERDigits(const uint8_t *p, int count, int *value)
+{
+    *value = 0;
+    for (int i = 0; i < count; i++) {
+        if (p[i] < '0' || p[i] > '9')
+            return -1;
+        *value = *value * 10 + (p[i] - '0');
+    }
+    return 0;
+}
+
+// Days between 1970-01-01 and the given date in the proleptic Gregorian calendar.
+static int64_t
+LKKCDERDaysFromCivil(int64_t year, int month, int day)
+{
+    year -= (month <= 2);
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t yearOfEra = year - era * 400;
+    int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+int
+LKKCDERDecodeTime(uint8_t tag, LKKCDERSlice content, int64_t *seconds)
+{
+    const uint8_t *p = content.bytes;
+    int year, month, day, hour, minute, second;
+    if (tag == LKKCDERTagUTCTime) {
+        // YYMMDDHHMMSSZ
+        if (content.length != 13 || LKKCDERDigits(p, 2, &year) != 0)
+            return -1;
+        year += (year >= 50 ? 1900 : 2000);
+        p += 2;
+    }
+    else if (tag == LKKCDERTagGeneralizedTime) {
+        // YYYYMMDDHHMMSSZ
+        if (content.length != 15 || LKKCDERDigits(p, 4, &year) != 0)
+            return -1;
+        p += 4;
+    }
+    else
+        return -1;
+    
+    if (LKKCDERDigits(p, 2, &month) != 0 || LKKCDERDigits(p + 2, 2, &day) != 0 
+        || LKKCDERDigits(p + 4, 2, &hour) != 0 || LKKCDERDigits(p + 6, 2, &minute) != 0 
+        || LKKCDERDigits(p + 8, 2, &second) != 0 || p[10] != 'Z')
+        return -1;
+    
+    static const int daysInMonth[12] = { 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    if (month < 1 || month > 12 || day < 1 || day > daysInMonth[month - 1])
+        return -1;
+    int leap = (year % 4 == 0 && (year % 100 != 0 || year % 400 == 0));
+    if (month == 2 && day == 29 && !leap)
+        return -1;
+    if (hour > 23 || minute > 59 || second > 59)
+        return -1;
+    
+    *seconds = LKKCDERDaysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+    return 0;
+}
+
+// Certificates
+
+int
+LKKCDERReaderNextExtension(LKKCDERReader *reader, LKKCDERExtension *extension)
+{
+    LKKCDERItem item;
+    int result = LKKCDERReaderNext(reader, &item);
+    if (result != 0)
+        return result;
+    if (item.tag != LKKCDERTagSequence)
+        return -1;
+    
+    LKKCDERReader fields;
+    LKKCDERReaderInit(&fields, item.content);
+    if (LKKCDERReaderExpect(&fields, LKKCDERTagObjectIdentifier, &item) != 0 || item.content.length == 0)
+        return -1;
+    extension->oid = item.content;
+    extension->critical = 0;
+    if (LKKCDERReaderPeek(&fields, LKKCDERTagBoolean)) {
+        if (LKKCDERReaderNext(&fields, &item) != 0)
+            return -1;
+        // critical BOOLEAN DEFAULT FALSE: DER omits the default, so an encoded value must be TRUE.
+        if (item.content.length != 1 || item.content.bytes[0] != 0xff)
+            return -1;
+        extension->critical = 1;
+    }
+    if (LKKCDERReaderExpect(&fields, LKKCDERTagOctetString, &item) != 0 || fields.next != fields.end)
+        return -1;
+    extension->value = item.content;
+    return 0;
+}
+
+int
+LKKCDERFindExtension(const LKKCDERCertificate *certificate, const uint8_t *oid, size_t oidLength, LKKCDERExtension *extension)
+{
+    LKKCDERReader reader;
+    LKKCDERReaderInit(&reader, certificate->extensions);
+    for (;;) {
+        int result = LKKCDERReaderNextExtension(&reader, extension);
+        if (result != 0)
+            return result;
+        if (extension->oid.length == oidLength && memcmp(extension->oid.bytes, oid, oidLength) == 0)
+            return 0;
+    }
+}
+
+int
+LKKCDERReaderInitGeneralNames(LKKCDERReader *reader, const LKKCDERExtension *extension)
+{
+    LKKCDERItem names;
+    if (LKKCDERDecodeItem(extension->value, &names) != 0 || names.tag != LKKCDERTagSequence)
+        return -1;
+    LKKCDERReaderInit(reader, names.content);
+    return 0;
+}
+
+// Decode a Time item, which may be either a UTCTime or a GeneralizedTime.
+static int
+LKKCDERReaderNextTime(LKKCDERReader *reader, uint8_t *tag, LKKCDERSlice *time)
+{
+    LKKCDERItem item;
+    int64_t seconds;
+    if (LKKCDERReaderNext(reader, &item) != 0 || LKKCDERDecodeTime(item.tag, item.content, &seconds) != 0)
+        return -1;
+    *tag = item.tag;
+    *time = item.content;
+    return 0;
+}
+
+static int
+LKKCDERDecodeTBSCertificate(LKKCDERSlice content, LKKCDERCertificate *certificate)
+{
+    LKKCDERReader reader;
+    LKKCDERItem item;
+    LKKCDERReaderInit(&reader, content);
+    
+    // version [0] EXPLICIT INTEGER DEFAULT v1; DER omits the default, so an encoded version must be v2 or v3.
+    certificate->version = 0;
+    if (LKKCDERReaderPeek(&reader, LKKCDERTagContextConstructed | 0)) {
+        if (LKKCDERReaderNext(&reader, &item) != 0)
+            return -1;
+        LKKCDERItem version;
+        if (LKKCDERDecodeItem(item.content, &version) != 0 || version.tag != LKKCDERTagInteger 
+            || version.content.length != 1 || version.content.bytes[0] < 1 || version.content.bytes[0] > 2)
+            return -1;
+        certificate->version = version.content.bytes[0];
+    }
+    
+    if (LKKCDERReaderNext(&reader, &item) != 0 || LKKCDERCheckInteger(&item) != 0)
+        return -1;
+    certificate->serialNumber = item.content;
+    
+    if (LKKCDERReaderExpect(&reader, LKKCDERTagSequence, &item) != 0)
+        return -1;
+    certificate->signature = item.encoding;
+    
+    if (LKKCDERReaderExpect(&reader, LKKCDERTagSequence, &item) != 0)
+        return -1;
+    certificate->issuer = item.encoding;
+    
+    if (LKKCDERReaderExpect(&reader, LKKCDERTagSequence, &item) != 0)
+        return -1;
+    LKKCDERReader validity;
+    LKKCDERReaderInit(&validity, item.content);
+    if (LKKCDERReaderNextTime(&validity, &certificate->notBeforeTag, &certificate->notBefore) != 0
+        || LKKCDERReaderNextTime(&validity, &certificate->notAfterTag, &certificate->notAfter) != 0
+        || validity.next != validity.end)
+        return -1;
+    
+    if (LKKCDERReaderExpect(&reader, LKKCDERTagSequence, &item) != 0)
+        return -1;
+    certificate->subject = item.encoding;
+    
+    if (LKKCDERReaderExpect(&reader, LKKCDERTagSequence, &item) != 0)
+        return -1;
+    certificate->subjectPublicKeyInfo = item.encoding;
+    LKKCDERReader keyInfo;
+    LKKCDERReaderInit(&keyInfo, item.content);
+    if (LKKCDERReaderExpect(&keyInfo, LKKCDERTagSequence, &item) != 0)
+        return -1;
+    certificate->publicKeyAlgorithm = item.encoding;
+    if (LKKCDERReaderNext(&keyInfo, &item) != 0 || LKKCDERBitStringBytes(&item, &certificate->subjectPublicKey) != 0
+        || keyInfo.next != keyInfo.end)
+        return -1;
+    
+    // issuerUniqueID [1] IMPLICIT BIT STRING OPTIONAL, subjectUniqueID [2] IMPLICIT BIT STRING OPTIONAL
+    if (LKKCDERReaderPeek(&reader, LKKCDERTagContext | 1)) {
+        if (LKKCDERReaderNext(&reader, &item) != 0)
+            return -1;
+        if (item.content.length == 0)
+            return -1;
+        certificate->issuerUniqueID = item.content;
+    }
+    if (LKKCDERReaderPeek(&reader, LKKCDERTagContext | 2)) {
+        if (LKKCDERReaderNext(&reader, &item) != 0)
+            return -1;
+        if (item.content.length == 0)
+            return -1;
+        certificate->subjectUniqueID = item.content;
+    }
+    
+    // extensions [3] EXPLICIT SEQUENCE SIZE (1..MAX) OF Extension OPTIONAL
+    if (LKKCDERReaderPeek(&reader, LKKCDERTagContextConstructed | 3)) {
+        if (LKKCDERReaderNext(&reader, &item) != 0)
+            return -1;
+        LKKCDERItem extensions;
+        if (LKKCDERDecodeItem(item.content, &extensions) != 0 || extensions.tag != LKKCDERTagSequence 
+            || extensions.content.length == 0)
+            return -1;
+        certificate->extensions = extensions.content;
+        
+        LKKCDERReader extensionReader;
+        LKKCDERExtension extension;
+        LKKCDERReaderInit(&extensionReader, extensions.content);
+        int result;
+        while ((result = LKKCDERReaderNextExtension(&extensionReader, &extension)) == 0)
+            ;
+        if (result < 0)
+            return -1;
+    }
+    
+    if (reader.next != reader.end)
+        return -1;
+    return 0;
+}
+
+int
+LKKCDERDecodeCertificate(const uint8_t *bytes, size_t length, LKKCDERCertificate *certificate)
+{
+    memset(certificate, 0, sizeof(*certificate));
+    LKKCDERSlice input = { bytes, length };
+    LKKCDERItem item;
+    if (bytes == NULL || LKKCDERDecodeItem(input, &item) != 0 || item.tag != LKKCDERTagSequence)
+        goto fail;
+    
+    LKKCDERReader reader;
+    LKKCDERReaderInit(&reader, item.content);
+    if (LKKCDERReaderExpect(&reader, LKKCDERTagSequence, &item) != 0)
+        goto fail;
+    certificate->tbsCertificate = item.encoding;
+    if (LKKCDERDecodeTBSCertificate(item.content, certificate) != 0)
+        goto fail;
+    
+    if (LKKCDERReaderExpect(&reader, LKKCDERTagSequence, &item) != 0)
+        goto fail;
+    certificate->signatureAlgorithm = item.encoding;
+    if (LKKCDERReaderNext(&reader, &item) != 0 || LKKCDERBitStringBytes(&item, &certificate->signatureValue) != 0
+        || reader.next != reader.end)
+        goto fail;
+    return 0;
+    
+fail:
+    memset(certificate, 0, sizeof(*certificate));
+    return -1;
+}
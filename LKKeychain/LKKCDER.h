@@ -0,0 +1,178 @@
+//
+//  LKKCDER.h
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright © 2011, Károly Lőrentey. All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//  
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of Károly Lőrentey nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+//  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL KÁROLY LŐRENTEY BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+//  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+#ifndef LKKCDER_h
+#define LKKCDER_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A strict, non-allocating DER decoder for X.509 certificates.
+// Every decoded field is a slice into the caller's buffer, which must outlive the results.
+// Like LKKCEngine, it has no dependencies beyond the C library, so it also builds on Linux (`cc -c LKKCDER.c`).
+//
+// The decoder never reads outside the input and never recurses. It rejects indefinite lengths, 
+// non-minimal length and INTEGER encodings, high tag numbers, trailing data and explicitly encoded
+// DEFAULT values (a v1 version or a FALSE critical flag). It doesn't check the contents of Names, 
+// algorithm parameters or extension values, which are returned as they are.
+// Functions that can fail return 0 on success and -1 if the input is malformed.
+// LKKeychainTests/CTests has a test driver and a fuzzing entry point that build from LKKCDER.c alone.
+
+// Universal tags.
+enum {
+    LKKCDERTagBoolean = 0x01,
+    LKKCDERTagInteger = 0x02,
+    LKKCDERTagBitString = 0x03,
+    LKKCDERTagOctetString = 0x04,
+    LKKCDERTagNull = 0x05,
+    LKKCDERTagObjectIdentifier = 0x06,
+    LKKCDERTagUTF8String = 0x0c,
+    LKKCDERTagPrintableString = 0x13,
+    LKKCDERTagIA5String = 0x16,
+    LKKCDERTagUTCTime = 0x17,
+    LKKCDERTagGeneralizedTime = 0x18,
+    LKKCDERTagSequence = 0x30,
+    LKKCDERTagSet = 0x31
+};
+
+// Context-specific tags: LKKCDERTagContext | n for primitive [n], LKKCDERTagContextConstructed | n for constructed [n].
+enum {
+    LKKCDERTagContext = 0x80,
+    LKKCDERTagContextConstructed = 0xa0
+};
+
+// GeneralName choices in subject alternative names (RFC 5280, section 4.2.1.6).
+enum {
+    LKKCDERGeneralNameEmail = LKKCDERTagContext | 1,
+    LKKCDERGeneralNameDNS = LKKCDERTagContext | 2,
+    LKKCDERGeneralNameURI = LKKCDERTagContext | 6,
+    LKKCDERGeneralNameIPAddress = LKKCDERTagContext | 7
+};
+
+// A range of bytes in a DER buffer. Absent optional fields have a NULL bytes pointer.
+typedef struct {
+    const uint8_t *bytes;
+    size_t length;
+} LKKCDERSlice;
+
+// One decoded tag-length-value triple.
+typedef struct {
+    uint8_t tag;
+    LKKCDERSlice content;  // The value.
+    LKKCDERSlice encoding; // The whole triple, including the tag and the length.
+} LKKCDERItem;
+
+// Reads the items of a SEQUENCE or SET one after the other.
+typedef struct {
+    const uint8_t *next;
+    const uint8_t *end;
+} LKKCDERReader;
+
+// Start reading the items in slice.
+void LKKCDERReaderInit(LKKCDERReader *reader, LKKCDERSlice slice);
+
+// Decode the next item. Returns 1 at the end of the input.
+int LKKCDERReaderNext(LKKCDERReader *reader, LKKCDERItem *item);
+
+// Decode a single item that must span all of slice.
+int LKKCDERDecodeItem(LKKCDERSlice slice, LKKCDERItem *item);
+
+// Write the DER encoding of a length into buffer, which must have room for 1 + sizeof(size_t) bytes.
+// Returns the number of bytes written.
+size_t LKKCDEREncodeLength(size_t length, uint8_t *buffer);
+
+// Format the content of an OBJECT IDENTIFIER in dotted decimal form into buffer as a NUL-terminated string.
+// Fails if the identifier is malformed or if it doesn't fit.
+int LKKCDERFormatOID(LKKCDERSlice oid, char *buffer, size_t capacity);
+
+// Convert the content of a UTCTime or GeneralizedTime into seconds since 1970-01-01 00:00:00 UTC.
+// Only the forms allowed by RFC 5280 are accepted: Zulu time with seconds and without fractions.
+int LKKCDERDecodeTime(uint8_t tag, LKKCDERSlice content, int64_t *seconds);
+
+// The fields of a certificate. Names, algorithm identifiers and the public key info include their outer tags;
+// other fields are contents only.
+typedef struct LKKCDERCertificate {
+    LKKCDERSlice tbsCertificate;       // The signed part of the certificate, including its tag.
+    int version;                       // 0 for v1, 1 for v2, 2 for v3.
+    LKKCDERSlice serialNumber;         // The INTEGER content.
+    LKKCDERSlice signature;            // The AlgorithmIdentifier inside the signed part.
+    LKKCDERSlice issuer;               // The issuer Name, exactly as encoded (not normalized).
+    uint8_t notBeforeTag;
+    LKKCDERSlice notBefore;            // Decode with LKKCDERDecodeTime(notBeforeTag, notBefore, ...).
+    uint8_t notAfterTag;
+    LKKCDERSlice notAfter;
+    LKKCDERSlice subject;              // The subject Name, exactly as encoded (not normalized).
+    LKKCDERSlice subjectPublicKeyInfo;
+    LKKCDERSlice publicKeyAlgorithm;   // The AlgorithmIdentifier of the public key.
+    LKKCDERSlice subjectPublicKey;     // The key bits, without the unused-bits byte of the BIT STRING.
+    LKKCDERSlice issuerUniqueID;       // Optional.
+    LKKCDERSlice subjectUniqueID;      // Optional.
+    LKKCDERSlice extensions;           // The content of the Extensions SEQUENCE; optional.
+    LKKCDERSlice signatureAlgorithm;
+    LKKCDERSlice signatureValue;       // Without the unused-bits byte.
+} LKKCDERCertificate;
+
+// Decode a certificate. The extensions are checked to be well-formed, but not interpreted.
+int LKKCDERDecodeCertificate(const uint8_t *bytes, size_t length, LKKCDERCertificate *certificate);
+
+typedef struct {
+    LKKCDERSlice oid;                  // The OBJECT IDENTIFIER content.
+    int critical;
+    LKKCDERSlice value;                // The OCTET STRING content.
+} LKKCDERExtension;
+
+// Decode the next extension from a reader over the extensions of a certificate. Returns 1 after the last one.
+int LKKCDERReaderNextExtension(LKKCDERReader *reader, LKKCDERExtension *extension);
+
+// Find the extension with the given OBJECT IDENTIFIER content. Returns 1 if the certificate doesn't have it.
+int LKKCDERFindExtension(const LKKCDERCertificate *certificate, const uint8_t *oid, size_t oidLength, LKKCDERExtension *extension);
+
+// Well-known extension identifiers, as OBJECT IDENTIFIER contents.
+extern const uint8_t LKKCDEROIDSubjectKeyIdentifier[3];     // 2.5.29.14
+extern const uint8_t LKKCDEROIDSubjectAlternativeName[3];   // 2.5.29.17
+
+// Start reading the GeneralNames of a subject alternative name extension.
+// Each item's tag selects the kind of name (LKKCDERGeneralName*), and its content is the name itself.
+int LKKCDERReaderInitGeneralNames(LKKCDERReader *reader, const LKKCDERExtension *extension);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,123 @@
+//
+//  LKKCDigestContext.h
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright © 2011, Károly Lőrentey. All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//  
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of Károly Lőrentey nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+//  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL KÁROLY LŐRENTEY BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+//  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+#import <Foundation/Foundation.h>
+#import <Security/Security.h>
+#import <LKKeychain/LKKCKey.h>
+
+/** An incremental message digest or HMAC computation.
+ 
+ Feed the message to the context in pieces with updateWithData:, then finish with finish or 
+ finishWithOutput:. After that, the context can be used for a new message.
+ 
+ HMAC contexts read the key bits once, when they are created, and keep only the precomputed 
+ inner and outer HMAC states; computing a MAC never exports the key again.
+ 
+ Contexts are not thread-safe, but copies made with `copy` are independent.
+ */
+@interface LKKCDigestContext : NSObject <NSCopying>
+{
+@private
+    SecKeyRef _skey;
+    LKKCDigestAlgorithm _algorithm;
+    void *_states;
+}
+
+/** Return the length in bytes of digests produced by `algorithm`, or 0 if `algorithm` is invalid. */
++ (size_t)digestLengthForAlgorithm:(LKKCDigestAlgorithm)algorithm;
+
+/** Create a new context that computes plain message digests.
+ @param algorithm The digest algorithm to use.
+ @param error On output, the error that occurred in case the context could not be created (optional).
+ @return A new digest context, or nil on error.
+ */
++ (LKKCDigestContext *)digestContextWithAlgorithm:(LKKCDigestAlgorithm)algorithm error:(NSError **)error;
+
+/** Create a new context that computes HMACs with a symmetric key.
+ @param key The key to use. It must be symmetric and extractable; its type doesn't matter.
+ @param algorithm The underlying digest algorithm.
+ @param error On output, the error that occurred in case the context could not be created (optional).
+ @return A new HMAC context, or nil on error.
+ */
++ (LKKCDigestContext *)hmacContextForKey:(LKKCKey *)key digestAlgorithm:(LKKCDigestAlgorithm)algorithm error:(NSError **)error;
+
+/** The digest algorithm of this context. */
+@property (nonatomic, readonly) LKKCDigestAlgorithm digestAlgorithm;
+
+/** The length in bytes of the digests computed by this context. */
+@property (nonatomic, readonly) size_t digestLength;
+
+/** The key of an HMAC context, or NULL for plain digests. */
+@property (nonatomic, readonly) SecKeyRef SecKey;
+
+/** --------------------------------------------------------------------------------
+ @name Incremental Operation
+ -------------------------------------------------------------------------------- */
+
+/** Add the next piece of the message. */
+- (void)updateWithData:(NSData *)data;
+
+/** Add the next piece of the message. */
+- (void)updateWithBytes:(const void *)bytes length:(size_t)length;
+
+/** Finish the message and write its digest to `output`, which must have room for <digestLength> bytes. */
+- (void)finishWithOutput:(void *)output;
+
+/** Finish the message and return its digest. */
+- (NSData *)finish;
+
+/** Finish the message and compare its digest with `digest` in constant time.
+ @return YES if the digests match.
+ */
+- (BOOL)finishAndVerifyDigest:(NSData *)digest;
+
+/** --------------------------------------------------------------------------------
+ @name Complete Messages
+ -------------------------------------------------------------------------------- */
+
+/** Return the digest of a complete message. Any message in progress is discarded. */
+- (NSData *)digestData:(NSData *)data;
+
+/** Compute the digests of many messages.
+ 
+ The digest of message `i` is written to `output + i * digestLength`. No memory is allocated per message.
+ Any message in progress is discarded.
+ 
+ @param messages An array of NSData messages.
+ @param output The buffer that receives the digests. It must have room for `[messages count] * digestLength` bytes.
+ */
+- (void)digestMessages:(NSArray *)messages output:(void *)output;
+
+@end
@@ -0,0 +1,298 @@
+//
+//  LKKCDigestContext.m
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright © 2011, Károly Lőrentey. All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//  
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of Károly Lőrentey nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+//  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL KÁROLY LŐRENTEY BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+//  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+#import "LKKCDigestContext.h"
+#import "LKKCKey.h"
+#import "LKKCKey+Private.h"
+#import "LKKCUtil.h"
+#import <CommonCrypto/CommonDigest.h>
+
+typedef union {
+    CC_SHA1_CTX sha1;
+    CC_SHA256_CTX sha256;
+    CC_SHA512_CTX sha512;
+} LKKCDigestState;
+
+// _states holds three digest states: the message in progress, the state to restart from 
+// (the inner HMAC state after the key block, or a fresh state for plain digests), and the 
+// outer HMAC state after the key block.
+enum {
+    LKKCDigestStateCurrent = 0,
+    LKKCDigestStateInner = 1,
+    LKKCDigestStateOuter = 2,
+    LKKCDigestStateCount = 3
+};
+
+#define LKKC_DIGEST_FUNCTIONS(name, field) \
+    static void name##Init(LKKCDigestState *s) { CC_##name##_Init(&s->field); } \
+    static void name##Update(LKKCDigestState *s, const void *bytes, CC_LONG length) { CC_##name##_Update(&s->field, bytes, length); } \
+    static void name##Final(unsigned char *md, LKKCDigestState *s) { CC_##name##_Final(md, &s->field); }
+
+LKKC_DIGEST_FUNCTIONS(SHA1, sha1)
+LKKC_DIGEST_FUNCTIONS(SHA224, sha256)
+LKKC_DIGEST_FUNCTIONS(SHA256, sha256)
+LKKC_DIGEST_FUNCTIONS(SHA384, sha512)
+LKKC_DIGEST_FUNCTIONS(SHA512, sha512)
+
+typedef struct {
+    size_t digestLength;
+    size_t blockSize;
+    void (*init)(LKKCDigestState *s);
+    void (*update)(LKKCDigestState *s, const void *bytes, CC_LONG length);
+    void (*final)(unsigned char *md, LKKCDigestState *s);
+} LKKCDigestDescriptor;
+
+// Digest implementations, indexed by LKKCDigestAlgorithm.
+static const LKKCDigestDescriptor digestDescriptors[] = {
+    { CC_SHA1_DIGEST_LENGTH, CC_SHA1_BLOCK_BYTES, SHA1Init, SHA1Update, SHA1Final },
+    { CC_SHA224_DIGEST_LENGTH, CC_SHA224_BLOCK_BYTES, SHA224Init, SHA224Update, SHA224Final },
+    { CC_SHA256_DIGEST_LENGTH, CC_SHA256_BLOCK_BYTES, SHA256Init, SHA256Update, SHA256Final },
+    { CC_SHA384_DIGEST_LENGTH, CC_SHA384_BLOCK_BYTES, SHA384Init, SHA384Update, SHA384Final },
+    { CC_SHA512_DIGEST_LENGTH, CC_SHA512_BLOCK_BYTES, SHA512Init, SHA512Update, SHA512Final }
+};
+
+static const int cDigestDescriptors = sizeof(digestDescriptors) / sizeof(LKKCDigestDescriptor);
+
+// The largest block size of any supported digest.
+#define LKKCDigestMaxBlockSize CC_SHA512_BLOCK_BYTES
+
+@interface LKKCDigestContext()
+- (id)initWithAlgorithm:(LKKCDigestAlgorithm)algorithm SecKey:(SecKeyRef)skey;
+- (BOOL)_setHMACKeyFromSecKey:(SecKeyRef)skey error:(NSError **)error;
+@end
+
+@implementation LKKCDigestContext
+
++ (size_t)digestLengthForAlgorithm:(LKKCDigestAlgorithm)algorithm
+{
+    if (algorithm < 0 || algorithm >= cDigestDescriptors)
+        return 0;
+    return digestDescriptors[algorithm].digestLength;
+}
+
++ (LKKCDigestContext *)digestContextWithAlgorithm:(LKKCDigestAlgorithm)algorithm error:(NSError **)error
+{
+    if (algorithm < 0 || algorithm >= cDigestDescriptors) {
+        LKKCReportError(errSecParam, error, @"Invalid digest algorithm");
+        return nil;
+    }
+    LKKCDigestContext *context = [[[LKKCDigestContext alloc] initWithAlgorithm:algorithm SecKey:NULL] autorelease];
+    LKKCDigestState *states = context->_states;
+    digestDescriptors[algorithm].init(&states[LKKCDigestStateInner]);
+    states[LKKCDigestStateCurrent] = states[LKKCDigestStateInner];
+    return context;
+}
+
++ (LKKCDigestContext *)hmacContextForKey:(LKKCKey *)key digestAlgorithm:(LKKCDigestAlgorithm)algorithm error:(NSError **)error
+{
+    if (algorithm < 0 || algorithm >= cDigestDescriptors) {
+        LKKCReportError(errSecParam, error, @"Invalid digest algorithm");
+        return nil;
+    }
+    SecKeyRef skey = key.SecKey;
+    if (skey == nil) {
+        LKKCReportError(errSecInvalidKeyRef, error, @"Key has been deleted");
+        return nil;
+    }
+    if (key.keyClass != LKKCKeyClassSymmetric) {
+        LKKCReportError(errSecParam, error, @"HMAC needs a symmetric key");
+        return nil;
+    }
+    LKKCDigestContext *context = [[[LKKCDigestContext alloc] initWithAlgorithm:algorithm SecKey:skey] autorelease];
+    if (![context _setHMACKeyFromSecKey:skey error:error])
+        return nil;
+    return context;
+}
+
+- (id)initWithAlgorithm:(LKKCDigestAlgorithm)algorithm SecKey:(SecKeyRef)skey
+{
+    self = [super init];
+    if (self == nil)
+        return nil;
+    _skey = (skey != NULL ? (SecKeyRef)CFRetain(skey) : NULL);
+    _algorithm = algorithm;
+    _states = calloc(LKKCDigestStateCount, sizeof(LKKCDigestState));
+    return self;
+}
+
+- (void)dealloc
+{
+    LKKCWipe(_states, LKKCDigestStateCount * sizeof(LKKCDigestState));
+    free(_states);
+    if (_skey != NULL)
+        CFRelease(_skey);
+    [super dealloc];
+}
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    LKKCDigestContext *copy = [[LKKCDigestContext allocWithZone:zone] initWithAlgorithm:_algorithm SecKey:_skey];
+    memcpy(copy->_states, _states, LKKCDigestStateCount * sizeof(LKKCDigestState));
+    return copy;
+}
+
+// Read the raw key bits with a null wrap, and precompute the HMAC states that follow the padded key blocks (RFC 2104).
+// The key bits never leave this method.
+- (BOOL)_setHMACKeyFromSecKey:(SecKeyRef)skey error:(NSError **)error
+{
+    const LKKCDigestDescriptor *desc = &digestDescriptors[_algorithm];
+    LKKCDigestState *states = _states;
+    LKKCRawKeyReader reader = { 0, 0 };
+    CSSM_KEY rawKey;
+    uint8_t block[LKKCDigestMaxBlockSize];
+    
+    if (!LKKCRawKeyReaderReadKey(&reader, skey, &rawKey, error)) {
+        LKKCRawKeyReaderClose(&reader);
+        return NO;
+    }
+    
+    bzero(block, sizeof(block));
+    if (rawKey.KeyData.Length > desc->blockSize) {
+        desc->init(&states[LKKCDigestStateCurrent]);
+        desc->update(&states[LKKCDigestStateCurrent], rawKey.KeyData.Data, (CC_LONG)rawKey.KeyData.Length);
+        desc->final(block, &states[LKKCDigestStateCurrent]);
+    }
+    else {
+        memcpy(block, rawKey.KeyData.Data, rawKey.KeyData.Length);
+    }
+    LKKCRawKeyReaderFreeKey(&reader, &rawKey);
+    LKKCRawKeyReaderClose(&reader);
+    
+    for (size_t i = 0; i < desc->blockSize; i++)
+        block[i] ^= 0x36;
+    desc->init(&states[LKKCDigestStateInner]);
+    desc->update(&states[LKKCDigestStateInner], block, (CC_LONG)desc->blockSize);
+    
+    for (size_t i = 0; i < desc->blockSize; i++)
+        block[i] ^= 0x36 ^ 0x5c;
+    desc->init(&states[LKKCDigestStateOuter]);
+    desc->update(&states[LKKCDigestStateOuter], block, (CC_LONG)desc->blockSize);
+    
+    states[LKKCDigestStateCurrent] = states[LKKCDigestStateInner];
+    LKKCWipe(block, sizeof(block));
+    return YES;
+}
+
+@synthesize digestAlgorithm = _algorithm;
+@synthesize SecKey = _skey;
+
+- (size_t)digestLength
+{
+    return digestDescriptors[_algorithm].digestLength;
+}
+
+#pragma mark - Incremental Operation
+
+- (void)updateWithBytes:(const void *)bytes length:(size_t)length
+{
+    const LKKCDigestDescriptor *desc = &digestDescriptors[_algorithm];
+    LKKCDigestState *state = &((LKKCDigestState *)_states)[LKKCDigestStateCurrent];
+    // CommonCrypto takes 32-bit lengths.
+    const uint8_t *p = bytes;
+    while (length > 0) {
+        CC_LONG chunk = (CC_LONG)MIN(length, (size_t)1 << 30);
+        desc->update(state, p, chunk);
+        p += chunk;
+        length -= chunk;
+    }
+}
+
+- (void)updateWithData:(NSData *)data
+{
+    [self updateWithBytes:[data bytes] length:[data length]];
+}
+
+- (void)finishWithOutput:(void *)output
+{
+    const LKKCDigestDescriptor *desc = &digestDescriptors[_algorithm];
+    LKKCDigestState *states = _states;
+    if (_skey == NULL) {
+        desc->final(output, &states[LKKCDigestStateCurrent]);
+    }
+    else {
+        uint8_t inner[CC_SHA512_DIGEST_LENGTH];
+        desc->final(inner, &states[LKKCDigestStateCurrent]);
+        states[LKKCDigestStateCurrent] = states[LKKCDigestStateOuter];
+        desc->update(&states[LKKCDigestStateCurrent], inner, (CC_LONG)desc->digestLength);
+        desc->final(output, &states[LKKCDigestStateCurrent]);
+    }
+    states[LKKCDigestStateCurrent] = states[LKKCDigestStateInner];
+}
+
+- (NSData *)finish
+{
+    NSMutableData *digest = [NSMutableData dataWithLength:self.digestLength];
+    [self finishWithOutput:[digest mutableBytes]];
+    return digest;
+}
+
+- (BOOL)finishAndVerifyDigest:(NSData *)digest
+{
+    uint8_t computed[CC_SHA512_DIGEST_LENGTH];
+    size_t length = self.digestLength;
+    [self finishWithOutput:computed];
+    if ([digest length] != length)
+        return NO;
+    const uint8_t *expected = [digest bytes];
+    uint8_t diff = 0;
+    for (size_t i = 0; i < length; i++)
+        diff |= computed[i] ^ expected[i];
+    return diff == 0;
+}
+
+#pragma mark - Complete Messages
+
+- (NSData *)digestData:(NSData *)data
+{
+    LKKCDigestState *states = _states;
+    states[LKKCDigestStateCurrent] = states[LKKCDigestStateInner];
+    [self updateWithData:data];
+    return [self finish];
+}
+
+- (void)digestMessages:(NSArray *)messages output:(void *)output
+{
+    LKKCDigestState *states = _states;
+    size_t length = self.digestLength;
+    uint8_t *p = output;
+    states[LKKCDigestStateCurrent] = states[LKKCDigestStateInner];
+    for (NSData *message in messages) {
+        [self updateWithData:message];
+        [self finishWithOutput:p];
+        p += length;
+    }
+}
+
+@end
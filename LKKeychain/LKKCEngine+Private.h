@@ -0,0 +1,61 @@
+//
+//  LKKCEngine+Private.h
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright © 2011, Károly Lőrentey. All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//  
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of Károly Lőrentey nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+//  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL KÁROLY LŐRENTEY BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+//  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+#include "LKKCEngine.h"
+
+// Kernels shared between the portable engine and its processor-specific variants.
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LKKC_ENGINE_X86 1
+#else
+#define LKKC_ENGINE_X86 0
+#endif
+
+typedef void (*LKKCEngineAESECBKernel)(const LKKCEngineAESKey *key, const uint8_t *input, uint8_t *output, size_t blocks);
+typedef void (*LKKCEngineAESChainKernel)(const LKKCEngineAESKey *key, uint8_t block[16], const uint8_t *input, uint8_t *output, size_t blocks);
+typedef void (*LKKCEngineGHASHKernel)(const LKKCEngineGHASHKey *key, uint8_t y[16], const uint8_t *data, size_t length);
+typedef void (*LKKCEngineSHA256Kernel)(uint32_t state[8], const uint8_t *data, size_t blocks);
+
+#if LKKC_ENGINE_X86
+unsigned LKKCEngineX86Features(void);
+
+void LKKCEngineAESEncryptECBAESNI(const LKKCEngineAESKey *key, const uint8_t *input, uint8_t *output, size_t blocks);
+void LKKCEngineAESDecryptECBAESNI(const LKKCEngineAESKey *key, const uint8_t *input, uint8_t *output, size_t blocks);
+void LKKCEngineAESEncryptCBCAESNI(const LKKCEngineAESKey *key, uint8_t iv[16], const uint8_t *input, uint8_t *output, size_t blocks);
+void LKKCEngineAESDecryptCBCAESNI(const LKKCEngineAESKey *key, uint8_t iv[16], const uint8_t *input, uint8_t *output, size_t blocks);
+void LKKCEngineAESCTR32AESNI(const LKKCEngineAESKey *key, uint8_t counter[16], const uint8_t *input, uint8_t *output, size_t blocks);
+void LKKCEngineGHASHUpdatePCLMUL(const LKKCEngineGHASHKey *key, uint8_t y[16], const uint8_t *data, size_t length);
+void LKKCEngineSHA256BlocksSHA(uint32_t state[8], const uint8_t *data, size_t blocks);
+#endif
@@ -0,0 +1,774 @@
+//
+//  LKKCEngine.c
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright © 2011, Károly Lőrentey. All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//  
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of Károly Lőrentey nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+//  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL KÁROLY LŐRENTEY BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+//  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+#include "LKKCEngine+Private.h"
+#include <pthread.h>
+#include <string.h>
+
+// Dispatch
+
+static LKKCEngineAESECBKernel aesEncryptECB;
+static LKKCEngineAESECBKernel aesDecryptECB;
+static LKKCEngineAESChainKernel aesEncryptCBC;
+static LKKCEngineAESChainKernel aesDecryptCBC;
+static LKKCEngineAESChainKernel aesCTR32;
+static LKKCEngineAESECBKernel aesEncryptECBConstantTime;
+static LKKCEngineAESECBKernel aesDecryptECBConstantTime;
+static LKKCEngineGHASHKernel ghashUpdate;
+static LKKCEngineSHA256Kernel sha256Blocks;
+static unsigned availableFeatures;
+static unsigned activeFeatures;
+
+static pthread_once_t engineOnce = PTHREAD_ONCE_INIT;
+
+static void LKKCEngineInitialize(void);
+
+static inline void
+LKKCEngineEnsureInitialized(void)
+{
+    pthread_once(&engineOnce, LKKCEngineInitialize);
+}
+
+// Clear memory that held key material; unlike memset, this isn't optimized away.
+static void
+Wipe(void *bytes, size_t length)
+{
+    volatile uint8_t *p = bytes;
+    while (length--)
+        *p++ = 0;
+}
+
+static inline uint32_t
+GetBE32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline void
+PutBE32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static inline uint64_t
+GetBE64(const uint8_t *p)
+{
+    return ((uint64_t)GetBE32(p) << 32) | GetBE32(p + 4);
+}
+
+static inline void
+PutBE64(uint8_t *p, uint64_t v)
+{
+    PutBE32(p, (uint32_t)(v >> 32));
+    PutBE32(p + 4, (uint32_t)v);
+}
+
+static inline void
+XorBlock(uint8_t *dst, const uint8_t *a, const uint8_t *b)
+{
+    for (int i = 0; i < 16; i++)
+        dst[i] = a[i] ^ b[i];
+}
+
+static inline void
+Increment32(uint8_t counter[16])
+{
+    PutBE32(counter + 12, GetBE32(counter + 12) + 1);
+}
+
+// Portable AES
+
+// S-boxes and round tables (as in the reference "fst" implementation), generated on first use.
+static uint8_t sbox[256];
+static uint8_t invSbox[256];
+static uint32_t te[4][256];
+static uint32_t td[4][256];
+
+static inline uint8_t
+XTime(uint8_t x)
+{
+    return (uint8_t)((x << 1) ^ (0x1b & -(x >> 7)));
+}
+
+static uint8_t
+Multiply(uint8_t a, uint8_t b)
+{
+    uint8_t result = 0;
+    while (b) {
+        if (b & 1)
+            result ^= a;
+        a = XTime(a);
+        b >>= 1;
+    }
+    return result;
+}
+
+// Look up a byte in an S-box without a data-dependent memory access: read every entry and keep the matching one.
+static inline uint8_t
+SubByte(const uint8_t table[256], uint8_t x)
+{
+    uint8_t result = 0;
+    for (unsigned i = 0; i < 256; i++) {
+        uint8_t mask = (uint8_t)(((i ^ x) - 1) >> 8); // 0xff iff i == x.
+        result |= table[i] & mask;
+    }
+    return result;
+}
+
+static inline uint32_t
+SubWord(uint32_t v)
+{
+    return ((uint32_t)SubByte(sbox, (uint8_t)(v >> 24)) << 24) | ((uint32_t)SubByte(sbox, (uint8_t)(v >> 16)) << 16)
+        | ((uint32_t)SubByte(sbox, (uint8_t)(v >> 8)) << 8) | (uint32_t)SubByte(sbox, (uint8_t)v);
+}
+
+static inline void
+MixColumn(uint8_t *a)
+{
+    uint8_t t = a[0] ^ a[1] ^ a[2] ^ a[3];
+    uint8_t a0 = a[0];
+    a[0] ^= t ^ XTime(a[0] ^ a[1]);
+    a[1] ^= t ^ XTime(a[1] ^ a[2]);
+    a[2] ^= t ^ XTime(a[2] ^ a[3]);
+    a[3] ^= t ^ XTime(a[3] ^ a0);
+}
+
+static inline void
+InvMixColumn(uint8_t *a)
+{
+    // InvMixColumns is MixColumns after a multiplication by {04}x^2 + {05} (FIPS-197, section 5.3.3).
+    uint8_t u = XTime(XTime(a[0] ^ a[2]));
+    uint8_t v = XTime(XTime(a[1] ^ a[3]));
+    a[0] ^= u;
+    a[1] ^= v;
+    a[2] ^= u;
+    a[3] ^= v;
+    MixColumn(a);
+}
+
+// n may be 0; the mask keeps the left shift below 32.
+static inline uint32_t
+RotateRight(uint32_t v, int n)
+{
+    return (v >> n) | (v << ((32 - n) & 31));
+}
+
+static inline uint8_t
+RotateLeft8(uint8_t v, int n)
+{
+    return (uint8_t)((v << n) | (v >> (8 - n)));
+}
+
+static void
+AESInitTables(void)
+{
+    // Walk the multiplicative group with generator 3, so that q is always the inverse of p.
+    uint8_t p = 1, q = 1;
+    do {
+        p = p ^ XTime(p);
+        q ^= q << 1;
+        q ^= q << 2;
+        q ^= q << 4;
+        if (q & 0x80)
+            q ^= 0x09;
+        sbox[p] = q ^ RotateLeft8(q, 1) ^ RotateLeft8(q, 2) ^ RotateLeft8(q, 3) ^ RotateLeft8(q, 4) ^ 0x63;
+    } while (p != 1);
+    sbox[0] = 0x63;
+    
+    for (int i = 0; i < 256; i++)
+        invSbox[sbox[i]] = (uint8_t)i;
+    
+    for (int i = 0; i < 256; i++) {
+        uint8_t s = sbox[i];
+        uint32_t e = ((uint32_t)XTime(s) << 24) | ((uint32_t)s << 16) | ((uint32_t)s << 8) | (uint32_t)(XTime(s) ^ s);
+        uint8_t is = invSbox[i];
+        uint32_t d = ((uint32_t)Multiply(is, 0x0e) << 24) | ((uint32_t)Multiply(is, 0x09) << 16) 
+            | ((uint32_t)Multiply(is, 0x0d) << 8) | (uint32_t)Multiply(is, 0x0b);
+        for (int t = 0; t < 4; t++) {
+            te[t][i] = RotateRight(e, 8 * t);
+            td[t][i] = RotateRight(d, 8 * t);
+        }
+    }
+}
+
+int
+LKKCEngineAESSetKey(LKKCEngineAESKey *key, const void *bytes, size_t length)
+{
+    if (length != 16 && length != 24 && length != 32)
+        return -1;
+    LKKCEngineEnsureInitialized();
+    
+    unsigned nk = (unsigned)(length / 4);
+    unsigned rounds = nk + 6;
+    unsigned total = 4 * (rounds + 1);
+    uint32_t w[60];
+    for (unsigned i = 0; i < nk; i++)
+        w[i] = GetBE32((const uint8_t *)bytes + 4 * i);
+    uint8_t rcon = 1;
+    for (unsigned i = nk; i < total; i++) {
+        uint32_t t = w[i - 1];
+        // The schedule doesn't index tables with key bytes, so it is safe for key-wrapping keys.
+        if (i % nk == 0) {
+            t = SubWord((t << 8) | (t >> 24));
+            t ^= (uint32_t)rcon << 24;
+            rcon = XTime(rcon);
+        }
+        else if (nk > 6 && i % nk == 4) {
+            t = SubWord(t);
+        }
+        w[i] = w[i - nk] ^ t;
+    }
+    
+    key->rounds = rounds;
+    for (unsigned i = 0; i < total; i++)
+        PutBE32(key->encryptionKeys + 4 * i, w[i]);
+    
+    // The equivalent inverse cipher uses the round keys in reverse order, 
+    // with InvMixColumns applied to all but the first and last.
+    for (unsigned r = 0; r <= rounds; r++) {
+        for (unsigned c = 0; c < 4; c++) {
+            uint8_t *column = key->decryptionKeys + 16 * r + 4 * c;
+            PutBE32(column, w[4 * (rounds - r) + c]);
+            if (r > 0 && r < rounds)
+                InvMixColumn(column);
+        }
+    }
+    Wipe(w, sizeof(w));
+    return 0;
+}
+
+void
+LKKCEngineAESClearKey(LKKCEngineAESKey *key)
+{
+    Wipe(key, sizeof(*key));
+}
+
+static void
+AESEncryptBlock(const LKKCEngineAESKey *key, const uint8_t *input, uint8_t *output)
+{
+    const uint8_t *rk = key->encryptionKeys;
+    uint32_t s0 = GetBE32(input) ^ GetBE32(rk);
+    uint32_t s1 = GetBE32(input + 4) ^ GetBE32(rk + 4);
+    uint32_t s2 = GetBE32(input + 8) ^ GetBE32(rk + 8);
+    uint32_t s3 = GetBE32(input + 12) ^ GetBE32(rk + 12);
+    for (unsigned r = 1; r < key->rounds; r++) {
+        rk += 16;
+        uint32_t t0 = te[0][s0 >> 24] ^ te[1][(s1 >> 16) & 0xff] ^ te[2][(s2 >> 8) & 0xff] ^ te[3][s3 & 0xff] ^ GetBE32(rk);
+        uint32_t t1 = te[0][s1 >> 24] ^ te[1][(s2 >> 16) & 0xff] ^ te[2][(s3 >> 8) & 0xff] ^ te[3][s0 & 0xff] ^ GetBE32(rk + 4);
+        uint32_t t2 = te[0][s2 >> 24] ^ te[1][(s3 >> 16) & 0xff] ^ te[2][(s0 >> 8) & 0xff] ^ te[3][s1 & 0xff] ^ GetBE32(rk + 8);
+        uint32_t t3 = te[0][s3 >> 24] ^ te[1][(s0 >> 16) & 0xff] ^ te[2][(s1 >> 8) & 0xff] ^ te[3][s2 & 0xff] ^ GetBE32(rk + 12);
+        s0 = t0;
+        s1 = t1;
+        s2 = t2;
+        s3 = t3;
+    }
+    rk += 16;
+#define LKKC_AES_FINAL(a, b, c, d) \
+    (((uint32_t)sbox[a >> 24] << 24) | ((uint32_t)sbox[(b >> 16) & 0xff] << 16) | ((uint32_t)sbox[(c >> 8) & 0xff] << 8) | (uint32_t)sbox[d & 0xff])
+    PutBE32(output, LKKC_AES_FINAL(s0, s1, s2, s3) ^ GetBE32(rk));
+    PutBE32(output + 4, LKKC_AES_FINAL(s1, s2, s3, s0) ^ GetBE32(rk + 4));
+    PutBE32(output + 8, LKKC_AES_FINAL(s2, s3, s0, s1) ^ GetBE32(rk + 8));
+    PutBE32(output + 12, LKKC_AES_FINAL(s3, s0, s1, s2) ^ GetBE32(rk + 12));
+#undef LKKC_AES_FINAL
+}
+
+static void
+AESDecryptBlock(const LKKCEngineAESKey *key, const uint8_t *input, uint8_t *output)
+{
+    const uint8_t *rk = key->decryptionKeys;
+    uint32_t s0 = GetBE32(input) ^ GetBE32(rk);
+    uint32_t s1 = GetBE32(input + 4) ^ GetBE32(rk + 4);
+    uint32_t s2 = GetBE32(input + 8) ^ GetBE32(rk + 8);
+    uint32_t s3 = GetBE32(input + 12) ^ GetBE32(rk + 12);
+    for (unsigned r = 1; r < key->rounds; r++) {
+        rk += 16;
+        uint32_t t0 = td[0][s0 >> 24] ^ td[1][(s3 >> 16) & 0xff] ^ td[2][(s2 >> 8) & 0xff] ^ td[3][s1 & 0xff] ^ GetBE32(rk);
+        uint32_t t1 = td[0][s1 >> 24] ^ td[1][(s0 >> 16) & 0xff] ^ td[2][(s3 >> 8) & 0xff] ^ td[3][s2 & 0xff] ^ GetBE32(rk + 4);
+        uint32_t t2 = td[0][s2 >> 24] ^ td[1][(s1 >> 16) & 0xff] ^ td[2][(s0 >> 8) & 0xff] ^ td[3][s3 & 0xff] ^ GetBE32(rk + 8);
+        uint32_t t3 = td[0][s3 >> 24] ^ td[1][(s2 >> 16) & 0xff] ^ td[2][(s1 >> 8) & 0xff] ^ td[3][s0 & 0xff] ^ GetBE32(rk + 12);
+        s0 = t0;
+        s1 = t1;
+        s2 = t2;
+        s3 = t3;
+    }
+    rk += 16;
+#define LKKC_AES_FINAL(a, b, c, d) \
+    (((uint32_t)invSbox[a >> 24] << 24) | ((uint32_t)invSbox[(b >> 16) & 0xff] << 16) | ((uint32_t)invSbox[(c >> 8) & 0xff] << 8) | (uint32_t)invSbox[d & 0xff])
+    PutBE32(output, LKKC_AES_FINAL(s0, s3, s2, s1) ^ GetBE32(rk));
+    PutBE32(output + 4, LKKC_AES_FINAL(s1, s0, s3, s2) ^ GetBE32(rk + 4));
+    PutBE32(output + 8, LKKC_AES_FINAL(s2, s1, s0, s3) ^ GetBE32(rk + 8));
+    PutBE32(output + 12, LKKC_AES_FINAL(s3, s2, s1, s0) ^ GetBE32(rk + 12));
+#undef LKKC_AES_FINAL
+}
+
+// Byte-oriented AES that computes S-box lookups with SubByte instead of T-tables.
+// It is many times slower than AESEncryptBlock, but its memory access pattern doesn't depend on the key or the data.
+
+static inline void
+AddRoundKey(uint8_t state[16], const uint8_t *rk)
+{
+    for (int i = 0; i < 16; i++)
+        state[i] ^= rk[i];
+}
+
+// SubBytes and ShiftRows in one step (FIPS-197, sections 5.1.1 and 5.1.2).
+static inline void
+SubBytesShiftRows(uint8_t state[16], const uint8_t table[256], int direction)
+{
+    uint8_t t[16];
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++)
+            t[r + 4 * c] = SubByte(table, state[r + 4 * ((c + direction * r + 4) & 3)]);
+    }
+    memcpy(state, t, 16);
+    Wipe(t, sizeof(t));
+}
+
+static void
+AESEncryptBlockConstantTime(const LKKCEngineAESKey *key, const uint8_t *input, uint8_t *output)
+{
+    uint8_t state[16];
+    memcpy(state, input, 16);
+    AddRoundKey(state, key->encryptionKeys);
+    for (unsigned r = 1; r <= key->rounds; r++) {
+        SubBytesShiftRows(state, sbox, 1);
+        if (r < key->rounds) {
+            for (int c = 0; c < 4; c++)
+                MixColumn(state + 4 * c);
+        }
+        AddRoundKey(state, key->encryptionKeys + 16 * r);
+    }
+    memcpy(output, state, 16);
+    Wipe(state, sizeof(state));
+}
+
+// The equivalent inverse cipher (FIPS-197, section 5.3.5), which matches the layout of decryptionKeys.
+static void
+AESDecryptBlockConstantTime(const LKKCEngineAESKey *key, const uint8_t *input, uint8_t *output)
+{
+    uint8_t state[16];
+    memcpy(state, input, 16);
+    AddRoundKey(state, key->decryptionKeys);
+    for (unsigned r = 1; r <= key->rounds; r++) {
+        SubBytesShiftRows(state, invSbox, -1);
+        if (r < key->rounds) {
+            for (int c = 0; c < 4; c++)
+                InvMixColumn(state + 4 * c);
+        }
+        AddRoundKey(state, key->decryptionKeys + 16 * r);
+    }
+    memcpy(output, state, 16);
+    Wipe(state, sizeof(state));
+}
+
+static void
+AESEncryptECBConstantTime(const LKKCEngineAESKey *key, const uint8_t *input, uint8_t *output, size_t blocks)
+{
+    for (size_t i = 0; i < blocks; i++)
+        AESEncryptBlockConstantTime(key, input + 16 * i, output + 16 * i);
+}
+
+static void
+AESDecryptECBConstantTime(const LKKCEngineAESKey *key, const uint8_t *input, uint8_t *output, size_t blocks)
+{
+    for (size_t i = 0; i < blocks; i++)
+        AESDecryptBlockConstantTime(key, input + 16 * i, output + 16 * i);
+}
+
+static void
+AESEncryptECBPortable(const LKKCEngineAESKey *key, const uint8_t *input, uint8_t *output, size_t blocks)
+{
+    for (size_t i = 0; i < blocks; i++)
+        AESEncryptBlock(key, input + 16 * i, output + 16 * i);
+}
+
+static void
+AESDecryptECBPortable(const LKKCEngineAESKey *key, const uint8_t *input, uint8_t *output, size_t blocks)
+{
+    for (size_t i = 0; i < blocks; i++)
+        AESDecryptBlock(key, input + 16 * i, output + 16 * i);
+}
+
+static void
+AESEncryptCBCPortable(const LKKCEngineAESKey *key, uint8_t iv[16], const uint8_t *input, uint8_t *output, size_t blocks)
+{
+    for (size_t i = 0; i < blocks; i++) {
+        XorBlock(iv, iv, input + 16 * i);
+        AESEncryptBlock(key, iv, iv);
+        memcpy(output + 16 * i, iv, 16);
+    }
+}
+
+static void
+AESDecryptCBCPortable(const LKKCEngineAESKey *key, uint8_t iv[16], const uint8_t *input, uint8_t *output, size_t blocks)
+{
+    uint8_t ciphertext[16];
+    uint8_t plaintext[16];
+    for (size_t i = 0; i < blocks; i++) {
+        // Keep a copy of the ciphertext in case we are decrypting in place.
+        memcpy(ciphertext, input + 16 * i, 16);
+        AESDecryptBlock(key, ciphertext, plaintext);
+        XorBlock(output + 16 * i, plaintext, iv);
+        memcpy(iv, ciphertext, 16);
+    }
+    Wipe(plaintext, sizeof(plaintext));
+}
+
+static void
+AESCTR32Portable(const LKKCEngineAESKey *key, uint8_t counter[16], const uint8_t *input, uint8_t *output, size_t blocks)
+{
+    uint8_t keystream[16];
+    for (size_t i = 0; i < blocks; i++) {
+        AESEncryptBlock(key, counter, keystream);
+        Increment32(counter);
+        XorBlock(output + 16 * i, input + 16 * i, keystream);
+    }
+    Wipe(keystream, sizeof(keystream));
+}
+
+void
+LKKCEngineAESEncryptECB(const LKKCEngineAESKey *key, const void *input, void *output, size_t blocks)
+{
+    LKKCEngineEnsureInitialized();
+    aesEncryptECB(key, input, output, blocks);
+}
+
+void
+LKKCEngineAESDecryptECB(const LKKCEngineAESKey *key, const void *input, void *output, size_t blocks)
+{
+    LKKCEngineEnsureInitialized();
+    aesDecryptECB(key, input, output, blocks);
+}
+
+void
+LKKCEngineAESEncryptECBConstantTime(const LKKCEngineAESKey *key, const void *input, void *output, size_t blocks)
+{
+    LKKCEngineEnsureInitialized();
+    aesEncryptECBConstantTime(key, input, output, blocks);
+}
+
+void
+LKKCEngineAESDecryptECBConstantTime(const LKKCEngineAESKey *key, const void *input, void *output, size_t blocks)
+{
+    LKKCEngineEnsureInitialized();
+    aesDecryptECBConstantTime(key, input, output, blocks);
+}
+
+void
+LKKCEngineAESEncryptCBC(const LKKCEngineAESKey *key, uint8_t iv[16], const void *input, void *output, size_t blocks)
+{
+    LKKCEngineEnsureInitialized();
+    aesEncryptCBC(key, iv, input, output, blocks);
+}
+
+void
+LKKCEngineAESDecryptCBC(const LKKCEngineAESKey *key, uint8_t iv[16], const void *input, void *output, size_t blocks)
+{
+    LKKCEngineEnsureInitialized();
+    aesDecryptCBC(key, iv, input, output, blocks);
+}
+
+void
+LKKCEngineAESCTR32(const LKKCEngineAESKey *key, uint8_t counter[16], const void *input, void *output, size_t blocks)
+{
+    LKKCEngineEnsureInitialized();
+    aesCTR32(key, counter, input, output, blocks);
+}
+
+// Portable GHASH
+
+// GHASH multiplication using 4-bit tables (Shoup's method); see "The Galois/Counter Mode of Operation" by McGrew and Viega.
+static const uint64_t ghashReduction[16] = {
+    0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+    0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+};
+
+void
+LKKCEngineGHASHSetKey(LKKCEngineGHASHKey *key, const uint8_t h[16])
+{
+    uint64_t *hl = key->hl;
+    uint64_t *hh = key->hh;
+    memcpy(key->h, h, 16);
+    uint64_t vh = GetBE64(h);
+    uint64_t vl = GetBE64(h + 8);
+    hl[0] = hh[0] = 0;
+    hl[8] = vl;
+    hh[8] = vh;
+    for (int i = 4; i > 0; i >>= 1) {
+        uint64_t t = (vl & 1) * 0xe1000000U;
+        vl = (vh << 63) | (vl >> 1);
+        vh = (vh >> 1) ^ (t << 32);
+        hl[i] = vl;
+        hh[i] = vh;
+    }
+    for (int i = 2; i <= 8; i *= 2) {
+        vh = hh[i];
+        vl = hl[i];
+        for (int j = 1; j < i; j++) {
+            hh[i + j] = vh ^ hh[j];
+            hl[i + j] = vl ^ hl[j];
+        }
+    }
+}
+
+void
+LKKCEngineGHASHClearKey(LKKCEngineGHASHKey *key)
+{
+    Wipe(key, sizeof(*key));
+}
+
+// x = x * H
+static void
+GHASHMultiply(const LKKCEngineGHASHKey *key, uint8_t x[16])
+{
+    const uint64_t *hl = key->hl;
+    const uint64_t *hh = key->hh;
+    uint8_t lo = x[15] & 0xf;
+    uint64_t zh = hh[lo];
+    uint64_t zl = hl[lo];
+    for (int i = 15; i >= 0; i--) {
+        lo = x[i] & 0xf;
+        uint8_t hi = x[i] >> 4;
+        if (i != 15) {
+            uint8_t rem = zl & 0xf;
+            zl = (zh << 60) | (zl >> 4);
+            zh = (zh >> 4) ^ (ghashReduction[rem] << 48);
+            zh ^= hh[lo];
+            zl ^= hl[lo];
+        }
+        uint8_t rem = zl & 0xf;
+        zl = (zh << 60) | (zl >> 4);
+        zh = (zh >> 4) ^ (ghashReduction[rem] << 48);
+        zh ^= hh[hi];
+        zl ^= hl[hi];
+    }
+    PutBE64(x, zh);
+    PutBE64(x + 8, zl);
+}
+
+static void
+GHASHUpdatePortable(const LKKCEngineGHASHKey *key, uint8_t y[16], const uint8_t *data, size_t length)
+{
+    while (length > 0) {
+        size_t n = (length < 16 ? length : 16);
+        for (size_t i = 0; i < n; i++)
+            y[i] ^= data[i];
+        GHASHMultiply(key, y);
+        data += n;
+        length -= n;
+    }
+}
+
+void
+LKKCEngineGHASHUpdate(const LKKCEngineGHASHKey *key, uint8_t y[16], const void *data, size_t length)
+{
+    LKKCEngineEnsureInitialized();
+    ghashUpdate(key, y, data, length);
+}
+
+// Portable SHA-256
+
+static const uint32_t sha256InitialState[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static const uint32_t sha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static void
+SHA256BlocksPortable(uint32_t state[8], const uint8_t *data, size_t blocks)
+{
+    uint32_t w[64];
+    while (blocks--) {
+        for (int i = 0; i < 16; i++)
+            w[i] = GetBE32(data + 4 * i);
+        for (int i = 16; i < 64; i++) {
+            uint32_t s0 = RotateRight(w[i - 15], 7) ^ RotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = RotateRight(w[i - 2], 17) ^ RotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; i++) {
+            uint32_t t1 = h + (RotateRight(e, 6) ^ RotateRight(e, 11) ^ RotateRight(e, 25)) + ((e & f) ^ (~e & g)) + sha256K[i] + w[i];
+            uint32_t t2 = (RotateRight(a, 2) ^ RotateRight(a, 13) ^ RotateRight(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+        data += LKKCEngineSHA256BlockLength;
+    }
+    Wipe(w, sizeof(w));
+}
+
+void
+LKKCEngineSHA256Init(LKKCEngineSHA256Context *context)
+{
+    LKKCEngineEnsureInitialized();
+    memcpy(context->state, sha256InitialState, sizeof(sha256InitialState));
+    context->length = 0;
+}
+
+void
+LKKCEngineSHA256Update(LKKCEngineSHA256Context *context, const void *data, size_t length)
+{
+    const uint8_t *p = data;
+    size_t used = (size_t)(context->length % LKKCEngineSHA256BlockLength);
+    context->length += length;
+    if (used > 0) {
+        size_t n = LKKCEngineSHA256BlockLength - used;
+        if (n > length)
+            n = length;
+        memcpy(context->buffer + used, p, n);
+        p += n;
+        length -= n;
+        if (used + n < LKKCEngineSHA256BlockLength)
+            return;
+        sha256Blocks(context->state, context->buffer, 1);
+    }
+    size_t blocks = length / LKKCEngineSHA256BlockLength;
+    if (blocks > 0) {
+        sha256Blocks(context->state, p, blocks);
+        p += blocks * LKKCEngineSHA256BlockLength;
+        length -= blocks * LKKCEngineSHA256BlockLength;
+    }
+    memcpy(context->buffer, p, length);
+}
+
+void
+LKKCEngineSHA256Final(LKKCEngineSHA256Context *context, uint8_t digest[LKKCEngineSHA256DigestLength])
+{
+    uint64_t bits = context->length * 8;
+    uint8_t padding[LKKCEngineSHA256BlockLength + 8];
+    size_t used = (size_t)(context->length % LKKCEngineSHA256BlockLength);
+    size_t n = (used < 56 ? 56 - used : 120 - used);
+    memset(padding, 0, sizeof(padding));
+    padding[0] = 0x80;
+    PutBE64(padding + n, bits);
+    LKKCEngineSHA256Update(context, padding, n + 8);
+    for (int i = 0; i < 8; i++)
+        PutBE32(digest + 4 * i, context->state[i]);
+    Wipe(context, sizeof(*context));
+}
+
+// Feature selection
+
+static void
+LKKCEngineSelectKernels(unsigned mask)
+{
+    unsigned features = availableFeatures & mask;
+    aesEncryptECB = AESEncryptECBPortable;
+    aesDecryptECB = AESDecryptECBPortable;
+    aesEncryptCBC = AESEncryptCBCPortable;
+    aesDecryptCBC = AESDecryptCBCPortable;
+    aesCTR32 = AESCTR32Portable;
+    aesEncryptECBConstantTime = AESEncryptECBConstantTime;
+    aesDecryptECBConstantTime = AESDecryptECBConstantTime;
+    ghashUpdate = GHASHUpdatePortable;
+    sha256Blocks = SHA256BlocksPortable;
+#if LKKC_ENGINE_X86
+    if (features & LKKCEngineFeatureAESNI) {
+        aesEncryptECB = LKKCEngineAESEncryptECBAESNI;
+        aesDecryptECB = LKKCEngineAESDecryptECBAESNI;
+        aesEncryptCBC = LKKCEngineAESEncryptCBCAESNI;
+        aesDecryptCBC = LKKCEngineAESDecryptCBCAESNI;
+        aesCTR32 = LKKCEngineAESCTR32AESNI;
+        aesEncryptECBConstantTime = LKKCEngineAESEncryptECBAESNI;
+        aesDecryptECBConstantTime = LKKCEngineAESDecryptECBAESNI;
+    }
+    if (features & LKKCEngineFeaturePCLMUL)
+        ghashUpdate = LKKCEngineGHASHUpdatePCLMUL;
+    if (features & LKKCEngineFeatureSHA)
+        sha256Blocks = LKKCEngineSHA256BlocksSHA;
+#endif
+    activeFeatures = features;
+}
+
+static void
+LKKCEngineInitialize(void)
+{
+    AESInitTables();
+#if LKKC_ENGINE_X86
+    availableFeatures = LKKCEngineX86Features();
+#else
+    availableFeatures = 0;
+#endif
+    LKKCEngineSelectKernels(~0U);
+}
+
+unsigned
+LKKCEngineAvailableFeatures(void)
+{
+    LKKCEngineEnsureInitialized();
+    return availableFeatures;
+}
+
+unsigned
+LKKCEngineActiveFeatures(void)
+{
+    LKKCEngineEnsureInitialized();
+    return activeFeatures;
+}
+
+void
+LKKCEngineSetFeatureMask(unsigned mask)
+{
+    LKKCEngineEnsureInitialized();
+    LKKCEngineSelectKernels(mask);
+}
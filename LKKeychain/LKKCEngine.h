@@ -0,0 +1,145 @@
+//
+//  LKKCEngine.h
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright © 2011, Károly Lőrentey. All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//  
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of Károly Lőrentey nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+//  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL KÁROLY LŐRENTEY BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+//  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+#ifndef LKKCEngine_h
+#define LKKCEngine_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A self-contained implementation of the primitives that the rest of LKKeychain computes in software:
+// AES (ECB, CBC and 32-bit counter mode), GHASH and SHA-256.
+// It has no dependencies beyond the C library, so it also builds on Linux (e.g., `cc -c LKKCEngine.c LKKCEngineX86.c`).
+// `make check` in LKKeychainTests/CTests runs its tests without Xcode.
+// 
+// Each primitive has a portable implementation and, on x86, kernels that use AES-NI, PCLMULQDQ and SHA extensions.
+// The fastest kernels supported by the processor are selected at runtime.
+// 
+// The portable AES and GHASH kernels use lookup tables indexed by secret data, so they are NOT safe against
+// cache-timing side channels. Use the ConstantTime AES functions below for encrypting key material.
+
+// Processor features used by the engine.
+enum {
+    LKKCEngineFeatureAESNI = 1 << 0,
+    LKKCEngineFeaturePCLMUL = 1 << 1,
+    LKKCEngineFeatureSHA = 1 << 2
+};
+
+// Return the features supported by this processor.
+unsigned LKKCEngineAvailableFeatures(void);
+
+// Return the features currently in use by the engine.
+unsigned LKKCEngineActiveFeatures(void);
+
+// Restrict the engine to the given features, e.g., 0 selects the portable implementation everywhere.
+// Features that the processor doesn't support are ignored.
+// Only call this when no other thread is using the engine; it is intended for testing and benchmarking.
+void LKKCEngineSetFeatureMask(unsigned mask);
+
+// AES
+
+typedef struct {
+    // Round keys in FIPS-197 byte order, and the equivalent inverse cipher's round keys for decryption.
+    uint8_t encryptionKeys[15 * 16];
+    uint8_t decryptionKeys[15 * 16];
+    unsigned rounds;
+} LKKCEngineAESKey;
+
+// Expand a 16, 24 or 32 byte AES key. Returns 0 on success, -1 if the key length is invalid.
+int LKKCEngineAESSetKey(LKKCEngineAESKey *key, const void *bytes, size_t length);
+
+// Erase a key schedule.
+void LKKCEngineAESClearKey(LKKCEngineAESKey *key);
+
+// The following functions process whole 16-byte blocks. Output may be the same buffer as input.
+void LKKCEngineAESEncryptECB(const LKKCEngineAESKey *key, const void *input, void *output, size_t blocks);
+void LKKCEngineAESDecryptECB(const LKKCEngineAESKey *key, const void *input, void *output, size_t blocks);
+
+// Like the ECB functions above, but without the portable T-table kernel: 
+// these use AES-NI when available and a much slower constant-time implementation otherwise.
+void LKKCEngineAESEncryptECBConstantTime(const LKKCEngineAESKey *key, const void *input, void *output, size_t blocks);
+void LKKCEngineAESDecryptECBConstantTime(const LKKCEngineAESKey *key, const void *input, void *output, size_t blocks);
+
+// iv is updated to the last ciphertext block, so consecutive calls continue the same message.
+void LKKCEngineAESEncryptCBC(const LKKCEngineAESKey *key, uint8_t iv[16], const void *input, void *output, size_t blocks);
+void LKKCEngineAESDecryptCBC(const LKKCEngineAESKey *key, uint8_t iv[16], const void *input, void *output, size_t blocks);
+
+// XOR the input with the encryption of consecutive counter blocks, incrementing the last 32 bits
+// of the counter as a big-endian integer (as in GCM). counter is updated to the next unused block.
+void LKKCEngineAESCTR32(const LKKCEngineAESKey *key, uint8_t counter[16], const void *input, void *output, size_t blocks);
+
+// GHASH
+
+typedef struct {
+    uint8_t h[16];
+    // 4-bit multiplication tables for the portable implementation.
+    uint64_t hl[16];
+    uint64_t hh[16];
+} LKKCEngineGHASHKey;
+
+// Set up GHASH with the hash subkey h (the encryption of the zero block in GCM).
+void LKKCEngineGHASHSetKey(LKKCEngineGHASHKey *key, const uint8_t h[16]);
+
+// Erase a GHASH key.
+void LKKCEngineGHASHClearKey(LKKCEngineGHASHKey *key);
+
+// Hash data into y, zero-padding the last partial block.
+void LKKCEngineGHASHUpdate(const LKKCEngineGHASHKey *key, uint8_t y[16], const void *data, size_t length);
+
+// SHA-256
+
+#define LKKCEngineSHA256DigestLength 32
+#define LKKCEngineSHA256BlockLength 64
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;
+    uint8_t buffer[LKKCEngineSHA256BlockLength];
+} LKKCEngineSHA256Context;
+
+void LKKCEngineSHA256Init(LKKCEngineSHA256Context *context);
+void LKKCEngineSHA256Update(LKKCEngineSHA256Context *context, const void *data, size_t length);
+// Write the digest and erase the context.
+void LKKCEngineSHA256Final(LKKCEngineSHA256Context *context, uint8_t digest[LKKCEngineSHA256DigestLength]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
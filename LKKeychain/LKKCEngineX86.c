@@ -0,0 +1,370 @@
+//
+//  LKKCEngineX86.c
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright © 2011, Károly Lőrentey. All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//  
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of Károly Lőrentey nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+//  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL KÁROLY LŐRENTEY BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+//  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+#include "LKKCEngine+Private.h"
+
+#if LKKC_ENGINE_X86
+
+#include <cpuid.h>
+#include <immintrin.h>
+#include <string.h>
+
+// Each kernel is compiled for the instruction set extensions it needs, so that this file builds 
+// without any special compiler flags. The dispatcher in LKKCEngine.c only calls kernels 
+// whose extensions LKKCEngineX86Features reports.
+#define LKKC_TARGET_AESNI __attribute__((target("sse2,ssse3,aes")))
+#define LKKC_TARGET_PCLMUL __attribute__((target("sse2,ssse3,pclmul")))
+#define LKKC_TARGET_SHA __attribute__((target("sse2,ssse3,sse4.1,sha")))
+
+unsigned
+LKKCEngineX86Features(void)
+{
+    unsigned eax, ebx, ecx, edx;
+    unsigned features = 0;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return 0;
+    int ssse3 = (ecx & bit_SSSE3) != 0;
+    int sse41 = (ecx & bit_SSE4_1) != 0;
+    if (ssse3 && (ecx & bit_AES))
+        features |= LKKCEngineFeatureAESNI;
+    if (ssse3 && (ecx & bit_PCLMUL))
+        features |= LKKCEngineFeaturePCLMUL;
+    
+    if (__get_cpuid_max(0, NULL) >= 7) {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        if (ssse3 && sse41 && (ebx & (1U << 29)))
+            features |= LKKCEngineFeatureSHA;
+    }
+    return features;
+}
+
+// AES-NI
+
+// The number of blocks processed in parallel by the AES-NI kernels, to hide the latency of AESENC.
+#define LKKC_AESNI_LANES 4
+
+LKKC_TARGET_AESNI static inline __m128i
+AESNIEncrypt(const __m128i *rk, unsigned rounds, __m128i b)
+{
+    b = _mm_xor_si128(b, rk[0]);
+    for (unsigned r = 1; r < rounds; r++)
+        b = _mm_aesenc_si128(b, rk[r]);
+    return _mm_aesenclast_si128(b, rk[rounds]);
+}
+
+LKKC_TARGET_AESNI static inline __m128i
+AESNIDecrypt(const __m128i *rk, unsigned rounds, __m128i b)
+{
+    b = _mm_xor_si128(b, rk[0]);
+    for (unsigned r = 1; r < rounds; r++)
+        b = _mm_aesdec_si128(b, rk[r]);
+    return _mm_aesdeclast_si128(b, rk[rounds]);
+}
+
+LKKC_TARGET_AESNI static inline void
+AESNIEncrypt4(const __m128i *rk, unsigned rounds, __m128i b[LKKC_AESNI_LANES])
+{
+    for (int i = 0; i < LKKC_AESNI_LANES; i++)
+        b[i] = _mm_xor_si128(b[i], rk[0]);
+    for (unsigned r = 1; r < rounds; r++) {
+        for (int i = 0; i < LKKC_AESNI_LANES; i++)
+            b[i] = _mm_aesenc_si128(b[i], rk[r]);
+    }
+    for (int i = 0; i < LKKC_AESNI_LANES; i++)
+        b[i] = _mm_aesenclast_si128(b[i], rk[rounds]);
+}
+
+LKKC_TARGET_AESNI static inline void
+AESNIDecrypt4(const __m128i *rk, unsigned rounds, __m128i b[LKKC_AESNI_LANES])
+{
+    for (int i = 0; i < LKKC_AESNI_LANES; i++)
+        b[i] = _mm_xor_si128(b[i], rk[0]);
+    for (unsigned r = 1; r < rounds; r++) {
+        for (int i = 0; i < LKKC_AESNI_LANES; i++)
+            b[i] = _mm_aesdec_si128(b[i], rk[r]);
+    }
+    for (int i = 0; i < LKKC_AESNI_LANES; i++)
+        b[i] = _mm_aesdeclast_si128(b[i], rk[rounds]);
+}
+
+LKKC_TARGET_AESNI static void
+AESNILoadKeys(__m128i rk[15], const uint8_t *bytes, unsigned rounds)
+{
+    for (unsigned r = 0; r <= rounds; r++)
+        rk[r] = _mm_loadu_si128((const __m128i *)(bytes + 16 * r));
+}
+
+LKKC_TARGET_AESNI void
+LKKCEngineAESEncryptECBAESNI(const LKKCEngineAESKey *key, const uint8_t *input, uint8_t *output, size_t blocks)
+{
+    __m128i rk[15];
+    AESNILoadKeys(rk, key->encryptionKeys, key->rounds);
+    for (; blocks >= LKKC_AESNI_LANES; blocks -= LKKC_AESNI_LANES) {
+        __m128i b[LKKC_AESNI_LANES];
+        for (int i = 0; i < LKKC_AESNI_LANES; i++)
+            b[i] = _mm_loadu_si128((const __m128i *)(input + 16 * i));
+        AESNIEncrypt4(rk, key->rounds, b);
+        for (int i = 0; i < LKKC_AESNI_LANES; i++)
+            _mm_storeu_si128((__m128i *)(output + 16 * i), b[i]);
+        input += 16 * LKKC_AESNI_LANES;
+        output += 16 * LKKC_AESNI_LANES;
+    }
+    for (; blocks > 0; blocks--) {
+        _mm_storeu_si128((__m128i *)output, AESNIEncrypt(rk, key->rounds, _mm_loadu_si128((const __m128i *)input)));
+        input += 16;
+        output += 16;
+    }
+}
+
+LKKC_TARGET_AESNI void
+LKKCEngineAESDecryptECBAESNI(const LKKCEngineAESKey *key, const uint8_t *input, uint8_t *output, size_t blocks)
+{
+    __m128i rk[15];
+    AESNILoadKeys(rk, key->decryptionKeys, key->rounds);
+    for (; blocks >= LKKC_AESNI_LANES; blocks -= LKKC_AESNI_LANES) {
+        __m128i b[LKKC_AESNI_LANES];
+        for (int i = 0; i < LKKC_AESNI_LANES; i++)
+            b[i] = _mm_loadu_si128((const __m128i *)(input + 16 * i));
+        AESNIDecrypt4(rk, key->rounds, b);
+        for (int i = 0; i < LKKC_AESNI_LANES; i++)
+            _mm_storeu_si128((__m128i *)(output + 16 * i), b[i]);
+        input += 16 * LKKC_AESNI_LANES;
+        output += 16 * LKKC_AESNI_LANES;
+    }
+    for (; blocks > 0; blocks--) {
+        _mm_storeu_si128((__m128i *)output, AESNIDecrypt(rk, key->rounds, _mm_loadu_si128((const __m128i *)input)));
+        input += 16;
+        output += 16;
+    }
+}
+
+// CBC encryption is inherently serial.
+LKKC_TARGET_AESNI void
+LKKCEngineAESEncryptCBCAESNI(const LKKCEngineAESKey *key, uint8_t iv[16], const uint8_t *input, uint8_t *output, size_t blocks)
+{
+    __m128i rk[15];
+    AESNILoadKeys(rk, key->encryptionKeys, key->rounds);
+    __m128i c = _mm_loadu_si128((const __m128i *)iv);
+    for (; blocks > 0; blocks--) {
+        c = AESNIEncrypt(rk, key->rounds, _mm_xor_si128(c, _mm_loadu_si128((const __m128i *)input)));
+        _mm_storeu_si128((__m128i *)output, c);
+        input += 16;
+        output += 16;
+    }
+    _mm_storeu_si128((__m128i *)iv, c);
+}
+
+LKKC_TARGET_AESNI void
+LKKCEngineAESDecryptCBCAESNI(const LKKCEngineAESKey *key, uint8_t iv[16], const uint8_t *input, uint8_t *output, size_t blocks)
+{
+    __m128i rk[15];
+    AESNILoadKeys(rk, key->decryptionKeys, key->rounds);
+    __m128i previous = _mm_loadu_si128((const __m128i *)iv);
+    for (; blocks >= LKKC_AESNI_LANES; blocks -= LKKC_AESNI_LANES) {
+        __m128i c[LKKC_AESNI_LANES];
+        __m128i b[LKKC_AESNI_LANES];
+        for (int i = 0; i < LKKC_AESNI_LANES; i++)
+            b[i] = c[i] = _mm_loadu_si128((const __m128i *)(input + 16 * i));
+        AESNIDecrypt4(rk, key->rounds, b);
+        for (int i = 0; i < LKKC_AESNI_LANES; i++) {
+            _mm_storeu_si128((__m128i *)(output + 16 * i), _mm_xor_si128(b[i], previous));
+            previous = c[i];
+        }
+        input += 16 * LKKC_AESNI_LANES;
+        output += 16 * LKKC_AESNI_LANES;
+    }
+    for (; blocks > 0; blocks--) {
+        __m128i c = _mm_loadu_si128((const __m128i *)input);
+        _mm_storeu_si128((__m128i *)output, _mm_xor_si128(AESNIDecrypt(rk, key->rounds, c), previous));
+        previous = c;
+        input += 16;
+        output += 16;
+    }
+    _mm_storeu_si128((__m128i *)iv, previous);
+}
+
+LKKC_TARGET_AESNI void
+LKKCEngineAESCTR32AESNI(const LKKCEngineAESKey *key, uint8_t counter[16], const uint8_t *input, uint8_t *output, size_t blocks)
+{
+    __m128i rk[15];
+    AESNILoadKeys(rk, key->encryptionKeys, key->rounds);
+    uint32_t n = ((uint32_t)counter[12] << 24) | ((uint32_t)counter[13] << 16) | ((uint32_t)counter[14] << 8) | counter[15];
+    uint8_t block[16];
+    memcpy(block, counter, 12);
+    while (blocks > 0) {
+        unsigned lanes = (blocks >= LKKC_AESNI_LANES ? LKKC_AESNI_LANES : (unsigned)blocks);
+        __m128i b[LKKC_AESNI_LANES];
+        for (unsigned i = 0; i < LKKC_AESNI_LANES; i++) {
+            uint32_t v = n + i;
+            block[12] = (uint8_t)(v >> 24);
+            block[13] = (uint8_t)(v >> 16);
+            block[14] = (uint8_t)(v >> 8);
+            block[15] = (uint8_t)v;
+            b[i] = _mm_loadu_si128((const __m128i *)block);
+        }
+        AESNIEncrypt4(rk, key->rounds, b);
+        for (unsigned i = 0; i < lanes; i++) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(input + 16 * i));
+            _mm_storeu_si128((__m128i *)(output + 16 * i), _mm_xor_si128(x, b[i]));
+        }
+        n += lanes;
+        input += 16 * lanes;
+        output += 16 * lanes;
+        blocks -= lanes;
+    }
+    counter[12] = (uint8_t)(n >> 24);
+    counter[13] = (uint8_t)(n >> 16);
+    counter[14] = (uint8_t)(n >> 8);
+    counter[15] = (uint8_t)n;
+}
+
+// GHASH with carry-less multiplication; see Intel's "Carry-Less Multiplication and Its Usage for 
+// Computing the GCM Mode" by Gueron and Kounavis, algorithms 1 and 5.
+
+LKKC_TARGET_PCLMUL static inline __m128i
+ByteSwap(__m128i x)
+{
+    return _mm_shuffle_epi8(x, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+// Multiply two byte-swapped field elements.
+LKKC_TARGET_PCLMUL static inline __m128i
+GFMultiply(__m128i a, __m128i b)
+{
+    __m128i lo = _mm_clmulepi64_si128(a, b, 0x00);
+    __m128i mid = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01));
+    __m128i hi = _mm_clmulepi64_si128(a, b, 0x11);
+    lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+    
+    // GHASH bit order is reflected, so shift the 256-bit product left by one.
+    __m128i loCarry = _mm_srli_epi32(lo, 31);
+    __m128i hiCarry = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    __m128i crossCarry = _mm_srli_si128(loCarry, 12);
+    hiCarry = _mm_slli_si128(hiCarry, 4);
+    loCarry = _mm_slli_si128(loCarry, 4);
+    lo = _mm_or_si128(lo, loCarry);
+    hi = _mm_or_si128(hi, hiCarry);
+    hi = _mm_or_si128(hi, crossCarry);
+    
+    // Reduce modulo x^128 + x^7 + x^2 + x + 1.
+    __m128i t = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)), _mm_slli_epi32(lo, 25));
+    __m128i tHigh = _mm_srli_si128(t, 4);
+    t = _mm_slli_si128(t, 12);
+    lo = _mm_xor_si128(lo, t);
+    __m128i u = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)), _mm_srli_epi32(lo, 7));
+    u = _mm_xor_si128(u, tHigh);
+    lo = _mm_xor_si128(lo, u);
+    return _mm_xor_si128(hi, lo);
+}
+
+LKKC_TARGET_PCLMUL void
+LKKCEngineGHASHUpdatePCLMUL(const LKKCEngineGHASHKey *key, uint8_t y[16], const uint8_t *data, size_t length)
+{
+    __m128i h = ByteSwap(_mm_loadu_si128((const __m128i *)key->h));
+    __m128i x = ByteSwap(_mm_loadu_si128((const __m128i *)y));
+    while (length >= 16) {
+        x = _mm_xor_si128(x, ByteSwap(_mm_loadu_si128((const __m128i *)data)));
+        x = GFMultiply(x, h);
+        data += 16;
+        length -= 16;
+    }
+    if (length > 0) {
+        uint8_t block[16] = { 0 };
+        memcpy(block, data, length);
+        x = _mm_xor_si128(x, ByteSwap(_mm_loadu_si128((const __m128i *)block)));
+        x = GFMultiply(x, h);
+    }
+    _mm_storeu_si128((__m128i *)y, ByteSwap(x));
+}
+
+// SHA-256 with the SHA extensions.
+
+static const uint32_t sha256K[64] __attribute__((aligned(16))) = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+LKKC_TARGET_SHA void
+LKKCEngineSHA256BlocksSHA(uint32_t state[8], const uint8_t *data, size_t blocks)
+{
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    
+    // The SHA-256 instructions keep the state as ABEF and CDGH.
+    __m128i t = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state), 0xb1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(state + 4)), 0x1b);
+    __m128i state0 = _mm_alignr_epi8(t, state1, 8);
+    state1 = _mm_blend_epi16(state1, t, 0xf0);
+    
+    while (blocks--) {
+        __m128i abef = state0;
+        __m128i cdgh = state1;
+        __m128i w[4];
+        for (int g = 0; g < 16; g++) {
+            __m128i m;
+            if (g < 4) {
+                m = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16 * g)), byteSwap);
+            }
+            else {
+                // w[g % 4] holds the schedule words from four groups ago.
+                m = _mm_sha256msg1_epu32(w[g % 4], w[(g + 1) % 4]);
+                m = _mm_add_epi32(m, _mm_alignr_epi8(w[(g + 3) % 4], w[(g + 2) % 4], 4));
+                m = _mm_sha256msg2_epu32(m, w[(g + 3) % 4]);
+            }
+            w[g % 4] = m;
+            __m128i k = _mm_add_epi32(m, _mm_load_si128((const __m128i *)(sha256K + 4 * g)));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, k);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(k, 0x0e));
+        }
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+        data += LKKCEngineSHA256BlockLength;
+    }
+    
+    t = _mm_shuffle_epi32(state0, 0x1b);
+    state1 = _mm_shuffle_epi32(state1, 0xb1);
+    _mm_storeu_si128((__m128i *)state, _mm_blend_epi16(t, state1, 0xf0));
+    _mm_storeu_si128((__m128i *)(state + 4), _mm_alignr_epi8(state1, t, 8));
+}
+
+#endif
@@ -0,0 +1,85 @@
+//
+//  LKKCGCMContext.h
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright © 2011, Károly Lőrentey. All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//  
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of Károly Lőrentey nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+//  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL KÁROLY LŐRENTEY BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+//  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+#import <Foundation/Foundation.h>
+#import <Security/Security.h>
+#import "LKKCEngine.h"
+
+@class LKKCKey;
+@class LKKCCryptoContext;
+
+// The length of GCM authentication tags, in bytes.
+#define LKKCGCMTagLength 16
+// The recommended length of GCM nonces, in bytes.
+#define LKKCGCMNonceLength 12
+
+// AES in Galois/Counter Mode (NIST SP 800-38D).
+// The CSP doesn't implement GCM, so we generate the counter mode keystream with an AES-ECB context
+// and compute GHASH with LKKCEngine.
+// Contexts are not thread-safe; LKKCKey keeps a pool of them.
+@interface LKKCGCMContext : NSObject
+{
+@private
+    LKKCCryptoContext *_ecb;
+    LKKCEngineGHASHKey _ghash;
+}
+
++ (LKKCGCMContext *)gcmContextForKey:(LKKCKey *)key error:(NSError **)error;
+
+@property (nonatomic, readonly) SecKeyRef SecKey;
+
+// Output may be the same buffer as the input. Tag must have room for LKKCGCMTagLength bytes.
+- (BOOL)encryptBytes:(const void *)bytes 
+              length:(size_t)length 
+              output:(void *)output 
+               nonce:(const void *)nonce 
+         nonceLength:(size_t)nonceLength 
+      additionalData:(const void *)additionalData 
+additionalDataLength:(size_t)additionalDataLength 
+                 tag:(void *)tag 
+               error:(NSError **)error;
+
+// The tag is verified before any plaintext is written to output.
+- (BOOL)decryptBytes:(const void *)bytes 
+              length:(size_t)length 
+              output:(void *)output 
+               nonce:(const void *)nonce 
+         nonceLength:(size_t)nonceLength 
+      additionalData:(const void *)additionalData 
+additionalDataLength:(size_t)additionalDataLength 
+                 tag:(const void *)tag 
+               error:(NSError **)error;
+
+@end
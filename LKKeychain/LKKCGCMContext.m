@@ -0,0 +1,246 @@
+//
+//  LKKCGCMContext.m
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright © 2011, Károly Lőrentey. All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//  
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of Károly Lőrentey nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+//  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL KÁROLY LŐRENTEY BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+//  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+#import "LKKCGCMContext.h"
+#import "LKKCCryptoContext.h"
+#import "LKKCCryptoContext+Private.h"
+#import "LKKCKey.h"
+#import "LKKCUtil.h"
+
+// The number of counter blocks we encrypt with a single CSSM call.
+#define LKKCGCMKeystreamBlocks 256
+
+#pragma mark - GHASH
+
+static inline void
+PutBE64(uint8_t *p, uint64_t v)
+{
+    for (int i = 7; i >= 0; i--) {
+        p[i] = (uint8_t)v;
+        v >>= 8;
+    }
+}
+
+static void
+GHashFinish(const LKKCEngineGHASHKey *key, uint8_t y[16], uint64_t aLength, uint64_t cLength)
+{
+    uint8_t block[16];
+    PutBE64(block, aLength * 8);
+    PutBE64(block + 8, cLength * 8);
+    LKKCEngineGHASHUpdate(key, y, block, 16);
+}
+
+static inline void
+Increment32(uint8_t counter[16])
+{
+    for (int i = 15; i >= 12; i--) {
+        if (++counter[i] != 0)
+            break;
+    }
+}
+
+#pragma mark -
+
+@interface LKKCGCMContext()
+- (id)initWithECBContext:(LKKCCryptoContext *)ecb error:(NSError **)error;
+- (BOOL)_getPreCounterBlock:(uint8_t *)j0 nonce:(const void *)nonce nonceLength:(size_t)nonceLength error:(NSError **)error;
+- (BOOL)_applyKeystreamFromCounter:(uint8_t *)counter input:(const uint8_t *)input output:(uint8_t *)output length:(size_t)length error:(NSError **)error;
+- (BOOL)_computeTag:(uint8_t *)tag j0:(const uint8_t *)j0 additionalData:(const void *)additionalData additionalDataLength:(size_t)additionalDataLength ciphertext:(const void *)ciphertext length:(size_t)length error:(NSError **)error;
+@end
+
+@implementation LKKCGCMContext
+
++ (LKKCGCMContext *)gcmContextForKey:(LKKCKey *)key error:(NSError **)error
+{
+    if (key.keyType != LKKCKeyTypeAES) {
+        LKKCReportError(errSecInvalidAlgorithm, error, @"GCM needs an AES key");
+        return nil;
+    }
+    // GCM only uses the forward cipher, even for decryption.
+    LKKCCryptoContext *ecb = [LKKCCryptoContext _cryptoContextForKey:key 
+                                                           operation:CSSM_ACL_AUTHORIZATION_ENCRYPT 
+                                                                mode:CSSM_ALGMODE_ECB 
+                                                             padding:CSSM_PADDING_NONE 
+                                                          initVector:nil 
+                                                               error:error];
+    if (ecb == nil)
+        return nil;
+    return [[[LKKCGCMContext alloc] initWithECBContext:ecb error:error] autorelease];
+}
+
+- (id)initWithECBContext:(LKKCCryptoContext *)ecb error:(NSError **)error
+{
+    self = [super init];
+    if (self == nil)
+        return nil;
+    _ecb = [ecb retain];
+    
+    uint8_t zero[16] = { 0 };
+    uint8_t h[16];
+    if (![_ecb encryptBytes:zero length:16 output:h capacity:16 outputLength:NULL error:error]) {
+        [self release];
+        return nil;
+    }
+    LKKCEngineGHASHSetKey(&_ghash, h);
+    memset(h, 0, sizeof(h));
+    return self;
+}
+
+- (void)dealloc
+{
+    LKKCEngineGHASHClearKey(&_ghash);
+    [_ecb release];
+    [super dealloc];
+}
+
+- (SecKeyRef)SecKey
+{
+    return _ecb.SecKey;
+}
+
+- (BOOL)_getPreCounterBlock:(uint8_t *)j0 nonce:(const void *)nonce nonceLength:(size_t)nonceLength error:(NSError **)error
+{
+    if (nonce == NULL || nonceLength == 0) {
+        LKKCReportError(errSecParam, error, @"Missing nonce");
+        return NO;
+    }
+    if (nonceLength == LKKCGCMNonceLength) {
+        memcpy(j0, nonce, LKKCGCMNonceLength);
+        j0[12] = j0[13] = j0[14] = 0;
+        j0[15] = 1;
+    }
+    else {
+        memset(j0, 0, 16);
+        LKKCEngineGHASHUpdate(&_ghash, j0, nonce, nonceLength);
+        GHashFinish(&_ghash, j0, 0, nonceLength);
+    }
+    return YES;
+}
+
+- (BOOL)_applyKeystreamFromCounter:(uint8_t *)counter input:(const uint8_t *)input output:(uint8_t *)output length:(size_t)length error:(NSError **)error
+{
+    uint8_t counters[LKKCGCMKeystreamBlocks * 16];
+    uint8_t keystream[LKKCGCMKeystreamBlocks * 16];
+    BOOL result = YES;
+    while (length > 0) {
+        size_t chunk = MIN(length, sizeof(keystream));
+        size_t blocks = (chunk + 15) / 16;
+        for (size_t b = 0; b < blocks; b++) {
+            memcpy(counters + 16 * b, counter, 16);
+            Increment32(counter);
+        }
+        if (![_ecb encryptBytes:counters length:16 * blocks output:keystream capacity:sizeof(keystream) outputLength:NULL error:error]) {
+            result = NO;
+            break;
+        }
+        for (size_t i = 0; i < chunk; i++)
+            output[i] = input[i] ^ keystream[i];
+        input += chunk;
+        output += chunk;
+        length -= chunk;
+    }
+    memset(keystream, 0, sizeof(keystream));
+    return result;
+}
+
+- (BOOL)_computeTag:(uint8_t *)tag j0:(const uint8_t *)j0 additionalData:(const void *)additionalData additionalDataLength:(size_t)additionalDataLength ciphertext:(const void *)ciphertext length:(size_t)length error:(NSError **)error
+{
+    uint8_t s[16] = { 0 };
+    LKKCEngineGHASHUpdate(&_ghash, s, additionalData, additionalDataLength);
+    LKKCEngineGHASHUpdate(&_ghash, s, ciphertext, length);
+    GHashFinish(&_ghash, s, additionalDataLength, length);
+    
+    uint8_t ej0[16];
+    if (![_ecb encryptBytes:j0 length:16 output:ej0 capacity:16 outputLength:NULL error:error])
+        return NO;
+    for (int i = 0; i < 16; i++)
+        tag[i] = ej0[i] ^ s[i];
+    return YES;
+}
+
+- (BOOL)encryptBytes:(const void *)bytes 
+              length:(size_t)length 
+              output:(void *)output 
+               nonce:(const void *)nonce 
+         nonceLength:(size_t)nonceLength 
+      additionalData:(const void *)additionalData 
+additionalDataLength:(size_t)additionalDataLength 
+                 tag:(void *)tag 
+               error:(NSError **)error
+{
+    uint8_t j0[16];
+    if (![self _getPreCounterBlock:j0 nonce:nonce nonceLength:nonceLength error:error])
+        return NO;
+    uint8_t counter[16];
+    memcpy(counter, j0, 16);
+    Increment32(counter);
+    if (![self _applyKeystreamFromCounter:counter input:bytes output:output length:length error:error])
+        return NO;
+    return [self _computeTag:tag j0:j0 additionalData:additionalData additionalDataLength:additionalDataLength ciphertext:output length:length error:error];
+}
+
+- (BOOL)decryptBytes:(const void *)bytes 
+              length:(size_t)length 
+              output:(void *)output 
+               nonce:(const void *)nonce 
+         nonceLength:(size_t)nonceLength 
+      additionalData:(const void *)additionalData 
+additionalDataLength:(size_t)additionalDataLength 
+                 tag:(const void *)tag 
+               error:(NSError **)error
+{
+    uint8_t j0[16];
+    if (![self _getPreCounterBlock:j0 nonce:nonce nonceLength:nonceLength error:error])
+        return NO;
+    
+    uint8_t expectedTag[LKKCGCMTagLength];
+    if (![self _computeTag:expectedTag j0:j0 additionalData:additionalData additionalDataLength:additionalDataLength ciphertext:bytes length:length error:error])
+        return NO;
+    // Compare in constant time.
+    uint8_t difference = 0;
+    for (int i = 0; i < LKKCGCMTagLength; i++)
+        difference |= expectedTag[i] ^ ((const uint8_t *)tag)[i];
+    if (difference != 0) {
+        LKKCReportError(CSSMERR_CSP_VERIFY_FAILED, error, @"Authentication tag mismatch");
+        return NO;
+    }
+    
+    uint8_t counter[16];
+    memcpy(counter, j0, 16);
+    Increment32(counter);
+    return [self _applyKeystreamFromCounter:counter input:bytes output:output length:length error:error];
+}
+
+@end
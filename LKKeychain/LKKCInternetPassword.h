@@ -44,7 +44,8 @@ typedef enum {
     LKKCAuthenticationTypeHTTPBasic,
     LKKCAuthenticationTypeHTTPDigest,
     LKKCAuthenticationTypeHTMLForm,
-    LKKCAuthenticationTypeDefault  
+    LKKCAuthenticationTypeDefault,
+    LKKCAuthenticationTypeCount // The number of authentication types above; not a valid value.
 } LKKCAuthenticationType;
 
 /** Supported protocol types.
@@ -81,7 +82,8 @@ typedef enum {
     LKKCProtocolTelnetS,
     LKKCProtocolIMAPS,
     LKKCProtocolIRCS,
-    LKKCProtocolPOP3S
+    LKKCProtocolPOP3S,
+    LKKCProtocolCount // The number of protocols above; not a valid value.
 } LKKCProtocol;
 
 /** Represents an internet password in a keychain.
@@ -111,7 +113,8 @@ typedef enum {
      }
  
  To retrieve a password for a URL, iterate over all passwords with the same server, 
- and find the one that's the best match.
+ and find the one that's the best match. (<LKKCInternetPasswordResolver> does this for you, 
+ and it is much faster when you need to look up many URLs.)
  
      LKKCKeychain *keychain = [LKKCKeychain defaultKeychain];
      for (LKKCInternetPassword *item in [keychain internetPasswordsForServer:@"example.com"]) {
@@ -143,6 +146,15 @@ typedef enum {
  */
 + (NSString *)urlSchemeFromProtocol:(LKKCProtocol)protocol;
 
+/** Returns the protocol value for a URL scheme.
+ 
+ This is the inverse of <urlSchemeFromProtocol:>. Unknown schemes are converted to `LKKCProtocolAny`.
+ 
+ @param scheme A URL scheme, in lowercase.
+ @return The protocol value for the given URL scheme.
+ */
++ (LKKCProtocol)protocolFromURLScheme:(NSString *)scheme;
+
 /** --------------------------------------------------------------------------------
  @name Creating new passwords
  -------------------------------------------------------------------------------- */
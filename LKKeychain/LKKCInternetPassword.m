@@ -44,73 +44,104 @@ typedef struct ProtocolDesc {
     CFStringRef scheme;
 } ProtocolDesc;
 
+// Indexed by LKKCProtocol - 1, so the lookup from an enum value is a plain array access.
 // Entries marked with "*" have no standard URL scheme.
-static ProtocolDesc protocolDescs[] = {
-	{ &kSecAttrProtocolFTP, LKKCProtocolFTP, CFSTR("ftp") },
-	{ &kSecAttrProtocolFTPAccount, LKKCProtocolFTPAccount, CFSTR("ftp-account") }, // *
-	{ &kSecAttrProtocolHTTP, LKKCProtocolHTTP, CFSTR("http") },
-	{ &kSecAttrProtocolIRC, LKKCProtocolIRC, CFSTR("irc") },
-	{ &kSecAttrProtocolNNTP, LKKCProtocolNNTP, CFSTR("nntp") },
-	{ &kSecAttrProtocolPOP3, LKKCProtocolPOP3, CFSTR("pop") },
-	{ &kSecAttrProtocolSMTP, LKKCProtocolSMTP, CFSTR("smtp") }, // *
-	{ &kSecAttrProtocolSOCKS, LKKCProtocolSOCKS, CFSTR("socks") }, // *
-	{ &kSecAttrProtocolIMAP, LKKCProtocolIMAP, CFSTR("imap") },
-	{ &kSecAttrProtocolLDAP, LKKCProtocolLDAP, CFSTR("ldap") },
-	{ &kSecAttrProtocolAppleTalk, LKKCProtocolAppleTalk, CFSTR("afpat") }, // *, should be afp:/at/...
-	{ &kSecAttrProtocolAFP, LKKCProtocolAFP, CFSTR("afp") },
-	{ &kSecAttrProtocolTelnet, LKKCProtocolTelnet, CFSTR("telnet") },
-	{ &kSecAttrProtocolSSH, LKKCProtocolSSH, CFSTR("ssh") },
-	{ &kSecAttrProtocolFTPS, LKKCProtocolFTPS, CFSTR("ftps") },
-	{ &kSecAttrProtocolHTTPS, LKKCProtocolHTTPS, CFSTR("https") },
-	{ &kSecAttrProtocolHTTPProxy, LKKCProtocolHTTPProxy, CFSTR("http-proxy") }, // *
-	{ &kSecAttrProtocolHTTPSProxy, LKKCProtocolHTTPSProxy, CFSTR("https-proxy") }, // *
-	{ &kSecAttrProtocolFTPProxy, LKKCProtocolFTPProxy, CFSTR("ftp-proxy") }, // *
-	{ &kSecAttrProtocolSMB, LKKCProtocolSMB, CFSTR("smb") },
-	{ &kSecAttrProtocolRTSP, LKKCProtocolRTSP, CFSTR("rtsp") },
-	{ &kSecAttrProtocolRTSPProxy, LKKCProtocolRTSPProxy, CFSTR("rtsp-proxy") }, // *
-	{ &kSecAttrProtocolDAAP, LKKCProtocolDAAP, CFSTR("daap") },
-	{ &kSecAttrProtocolEPPC, LKKCProtocolEPPC, CFSTR("eppc") }, // *
-	{ &kSecAttrProtocolIPP, LKKCProtocolIPP, CFSTR("ipp") },
-	{ &kSecAttrProtocolNNTPS, LKKCProtocolNNTPS, CFSTR("nntps") },
-	{ &kSecAttrProtocolLDAPS, LKKCProtocolLDAPS, CFSTR("ldaps") },
-	{ &kSecAttrProtocolTelnetS, LKKCProtocolTelnetS, CFSTR("telnets") },
-	{ &kSecAttrProtocolIMAPS, LKKCProtocolIMAPS, CFSTR("imaps") },
-	{ &kSecAttrProtocolIRCS, LKKCProtocolIRCS, CFSTR("ircs") },
-	{ &kSecAttrProtocolPOP3S, LKKCProtocolPOP3S, CFSTR("pops") }
+static ProtocolDesc protocolDescs[LKKCProtocolCount - 1] = {
+	[LKKCProtocolFTP - 1] = { &kSecAttrProtocolFTP, LKKCProtocolFTP, CFSTR("ftp") },
+	[LKKCProtocolFTPAccount - 1] = { &kSecAttrProtocolFTPAccount, LKKCProtocolFTPAccount, CFSTR("ftp-account") }, // *
+	[LKKCProtocolHTTP - 1] = { &kSecAttrProtocolHTTP, LKKCProtocolHTTP, CFSTR("http") },
+	[LKKCProtocolIRC - 1] = { &kSecAttrProtocolIRC, LKKCProtocolIRC, CFSTR("irc") },
+	[LKKCProtocolNNTP - 1] = { &kSecAttrProtocolNNTP, LKKCProtocolNNTP, CFSTR("nntp") },
+	[LKKCProtocolPOP3 - 1] = { &kSecAttrProtocolPOP3, LKKCProtocolPOP3, CFSTR("pop") },
+	[LKKCProtocolSMTP - 1] = { &kSecAttrProtocolSMTP, LKKCProtocolSMTP, CFSTR("smtp") }, // *
+	[LKKCProtocolSOCKS - 1] = { &kSecAttrProtocolSOCKS, LKKCProtocolSOCKS, CFSTR("socks") }, // *
+	[LKKCProtocolIMAP - 1] = { &kSecAttrProtocolIMAP, LKKCProtocolIMAP, CFSTR("imap") },
+	[LKKCProtocolLDAP - 1] = { &kSecAttrProtocolLDAP, LKKCProtocolLDAP, CFSTR("ldap") },
+	[LKKCProtocolAppleTalk - 1] = { &kSecAttrProtocolAppleTalk, LKKCProtocolAppleTalk, CFSTR("afpat") }, // *, should be afp:/at/...
+	[LKKCProtocolAFP - 1] = { &kSecAttrProtocolAFP, LKKCProtocolAFP, CFSTR("afp") },
+	[LKKCProtocolTelnet - 1] = { &kSecAttrProtocolTelnet, LKKCProtocolTelnet, CFSTR("telnet") },
+	[LKKCProtocolSSH - 1] = { &kSecAttrProtocolSSH, LKKCProtocolSSH, CFSTR("ssh") },
+	[LKKCProtocolFTPS - 1] = { &kSecAttrProtocolFTPS, LKKCProtocolFTPS, CFSTR("ftps") },
+	[LKKCProtocolHTTPS - 1] = { &kSecAttrProtocolHTTPS, LKKCProtocolHTTPS, CFSTR("https") },
+	[LKKCProtocolHTTPProxy - 1] = { &kSecAttrProtocolHTTPProxy, LKKCProtocolHTTPProxy, CFSTR("http-proxy") }, // *
+	[LKKCProtocolHTTPSProxy - 1] = { &kSecAttrProtocolHTTPSProxy, LKKCProtocolHTTPSProxy, CFSTR("https-proxy") }, // *
+	[LKKCProtocolFTPProxy - 1] = { &kSecAttrProtocolFTPProxy, LKKCProtocolFTPProxy, CFSTR("ftp-proxy") }, // *
+	[LKKCProtocolSMB - 1] = { &kSecAttrProtocolSMB, LKKCProtocolSMB, CFSTR("smb") },
+	[LKKCProtocolRTSP - 1] = { &kSecAttrProtocolRTSP, LKKCProtocolRTSP, CFSTR("rtsp") },
+	[LKKCProtocolRTSPProxy - 1] = { &kSecAttrProtocolRTSPProxy, LKKCProtocolRTSPProxy, CFSTR("rtsp-proxy") }, // *
+	[LKKCProtocolDAAP - 1] = { &kSecAttrProtocolDAAP, LKKCProtocolDAAP, CFSTR("daap") },
+	[LKKCProtocolEPPC - 1] = { &kSecAttrProtocolEPPC, LKKCProtocolEPPC, CFSTR("eppc") }, // *
+	[LKKCProtocolIPP - 1] = { &kSecAttrProtocolIPP, LKKCProtocolIPP, CFSTR("ipp") },
+	[LKKCProtocolNNTPS - 1] = { &kSecAttrProtocolNNTPS, LKKCProtocolNNTPS, CFSTR("nntps") },
+	[LKKCProtocolLDAPS - 1] = { &kSecAttrProtocolLDAPS, LKKCProtocolLDAPS, CFSTR("ldaps") },
+	[LKKCProtocolTelnetS - 1] = { &kSecAttrProtocolTelnetS, LKKCProtocolTelnetS, CFSTR("telnets") },
+	[LKKCProtocolIMAPS - 1] = { &kSecAttrProtocolIMAPS, LKKCProtocolIMAPS, CFSTR("imaps") },
+	[LKKCProtocolIRCS - 1] = { &kSecAttrProtocolIRCS, LKKCProtocolIRCS, CFSTR("ircs") },
+	[LKKCProtocolPOP3S - 1] = { &kSecAttrProtocolPOP3S, LKKCProtocolPOP3S, CFSTR("pops") }
 };
 
-static const int cProtocolDescs = sizeof(protocolDescs) / sizeof(ProtocolDesc);
+// The table is sized by the enum, so a protocol without a descriptor leaves a zero-filled entry.
+// Such entries are skipped below and map to no protocol; the unit tests check that there are none.
+static const int cProtocolDescs = LKKCProtocolCount - 1;
+
+// Lookup tables for converting to and from protocol descriptors in constant time.
+// The keys of the pointer-keyed tables are the kSecAttrProtocol* constants themselves; 
+// values returned by the Security framework are usually identical to these, so most lookups 
+// don't even need to hash a string. The other tables hash string contents.
+static CFDictionaryRef protocolDescsBySecAttrPointer;
+static CFDictionaryRef protocolDescsBySecAttrValue;
+static CFDictionaryRef protocolDescsByScheme;
+
+static void
+ProtocolDescsInitialize(void)
+{
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        CFMutableDictionaryRef byPointer = CFDictionaryCreateMutable(kCFAllocatorDefault, cProtocolDescs, NULL, NULL);
+        CFMutableDictionaryRef byValue = CFDictionaryCreateMutable(kCFAllocatorDefault, cProtocolDescs, &kCFTypeDictionaryKeyCallBacks, NULL);
+        CFMutableDictionaryRef byScheme = CFDictionaryCreateMutable(kCFAllocatorDefault, cProtocolDescs, &kCFTypeDictionaryKeyCallBacks, NULL);
+        for (CFIndex i = 0; i < cProtocolDescs; i++) {
+            if (protocolDescs[i].sprotocol == NULL)
+                continue;
+            CFDictionarySetValue(byPointer, *(protocolDescs[i].sprotocol), &protocolDescs[i]);
+            CFDictionarySetValue(byValue, *(protocolDescs[i].sprotocol), &protocolDescs[i]);
+            CFDictionarySetValue(byScheme, protocolDescs[i].scheme, &protocolDescs[i]);
+        }
+        protocolDescsBySecAttrPointer = byPointer;
+        protocolDescsBySecAttrValue = byValue;
+        protocolDescsByScheme = byScheme;
+    });
+}
 
 static ProtocolDesc *
 ProtocolDescFromSecAttrProtocol(CFTypeRef sprotocol)
 {
 	if (sprotocol == NULL)
         return NULL;
-    for (CFIndex i = 0; i < cProtocolDescs; i++) {
-        if (CFEqual(sprotocol, *(protocolDescs[i].sprotocol)))
-            return &protocolDescs[i];
-    }
-	return NULL;
+    ProtocolDescsInitialize();
+    ProtocolDesc *desc = (ProtocolDesc *)CFDictionaryGetValue(protocolDescsBySecAttrPointer, sprotocol);
+    if (desc == NULL)
+        desc = (ProtocolDesc *)CFDictionaryGetValue(protocolDescsBySecAttrValue, sprotocol);
+	return desc;
 }
 
 static ProtocolDesc *
 ProtocolDescFromLKKCProtocol(LKKCProtocol protocol)
 {
-    for (CFIndex i = 0; i < cProtocolDescs; i++) {
-        if (protocol == protocolDescs[i].protocol)
-            return &protocolDescs[i];
-    }
-	return NULL;
+    if (protocol <= LKKCProtocolAny || protocol > cProtocolDescs)
+        return NULL;
+    if (protocolDescs[protocol - 1].sprotocol == NULL)
+        return NULL;
+    return &protocolDescs[protocol - 1];
 }
 
 static ProtocolDesc *
 ProtocolDescFromScheme(NSString *scheme)
 {
-    for (CFIndex i = 0; i < cProtocolDescs; i++) {
-        if ([scheme isEqualToString:(NSString *)protocolDescs[i].scheme])
-            return &protocolDescs[i];
-    }
-	return NULL;
+    if (scheme == nil)
+        return NULL;
+    ProtocolDescsInitialize();
+    return (ProtocolDesc *)CFDictionaryGetValue(protocolDescsByScheme, (CFStringRef)scheme);
 }
 
 
@@ -122,40 +153,62 @@ typedef struct AuthenticationTypeDesc {
     CFStringRef description;
 } AuthenticationTypeDesc;
 
-static AuthenticationTypeDesc authenticationTypeDescs[] = {
-	{ &kSecAttrAuthenticationTypeNTLM, LKKCAuthenticationTypeNTLM, CFSTR("NTLM") },
-	{ &kSecAttrAuthenticationTypeMSN, LKKCAuthenticationTypeMSN, CFSTR("MSN") },
-	{ &kSecAttrAuthenticationTypeDPA, LKKCAuthenticationTypeDPA, CFSTR("DPA") },
-	{ &kSecAttrAuthenticationTypeRPA, LKKCAuthenticationTypeRPA, CFSTR("RPA") },
-	{ &kSecAttrAuthenticationTypeHTTPBasic, LKKCAuthenticationTypeHTTPBasic, CFSTR("HTTPBasic") },
-	{ &kSecAttrAuthenticationTypeHTTPDigest, LKKCAuthenticationTypeHTTPDigest, CFSTR("HTTPDigest") },
-	{ &kSecAttrAuthenticationTypeHTMLForm, LKKCAuthenticationTypeHTMLForm, CFSTR("HTMLForm") },
-	{ &kSecAttrAuthenticationTypeDefault, LKKCAuthenticationTypeDefault, CFSTR("Default") }
+// Indexed by LKKCAuthenticationType - 1.
+static AuthenticationTypeDesc authenticationTypeDescs[LKKCAuthenticationTypeCount - 1] = {
+	[LKKCAuthenticationTypeNTLM - 1] = { &kSecAttrAuthenticationTypeNTLM, LKKCAuthenticationTypeNTLM, CFSTR("NTLM") },
+	[LKKCAuthenticationTypeMSN - 1] = { &kSecAttrAuthenticationTypeMSN, LKKCAuthenticationTypeMSN, CFSTR("MSN") },
+	[LKKCAuthenticationTypeDPA - 1] = { &kSecAttrAuthenticationTypeDPA, LKKCAuthenticationTypeDPA, CFSTR("DPA") },
+	[LKKCAuthenticationTypeRPA - 1] = { &kSecAttrAuthenticationTypeRPA, LKKCAuthenticationTypeRPA, CFSTR("RPA") },
+	[LKKCAuthenticationTypeHTTPBasic - 1] = { &kSecAttrAuthenticationTypeHTTPBasic, LKKCAuthenticationTypeHTTPBasic, CFSTR("HTTPBasic") },
+	[LKKCAuthenticationTypeHTTPDigest - 1] = { &kSecAttrAuthenticationTypeHTTPDigest, LKKCAuthenticationTypeHTTPDigest, CFSTR("HTTPDigest") },
+	[LKKCAuthenticationTypeHTMLForm - 1] = { &kSecAttrAuthenticationTypeHTMLForm, LKKCAuthenticationTypeHTMLForm, CFSTR("HTMLForm") },
+	[LKKCAuthenticationTypeDefault - 1] = { &kSecAttrAuthenticationTypeDefault, LKKCAuthenticationTypeDefault, CFSTR("Default") }
 };
 
-static const int cAuthenticationTypeDescs = sizeof(authenticationTypeDescs) / sizeof(AuthenticationTypeDesc);
+static const int cAuthenticationTypeDescs = LKKCAuthenticationTypeCount - 1;
+
+// Same scheme as for protocols above.
+static CFDictionaryRef authenticationTypeDescsBySecAttrPointer;
+static CFDictionaryRef authenticationTypeDescsBySecAttrValue;
+
+static void
+AuthenticationTypeDescsInitialize(void)
+{
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        CFMutableDictionaryRef byPointer = CFDictionaryCreateMutable(kCFAllocatorDefault, cAuthenticationTypeDescs, NULL, NULL);
+        CFMutableDictionaryRef byValue = CFDictionaryCreateMutable(kCFAllocatorDefault, cAuthenticationTypeDescs, &kCFTypeDictionaryKeyCallBacks, NULL);
+        for (CFIndex i = 0; i < cAuthenticationTypeDescs; i++) {
+            if (authenticationTypeDescs[i].sauthenticationType == NULL)
+                continue;
+            CFDictionarySetValue(byPointer, *(authenticationTypeDescs[i].sauthenticationType), &authenticationTypeDescs[i]);
+            CFDictionarySetValue(byValue, *(authenticationTypeDescs[i].sauthenticationType), &authenticationTypeDescs[i]);
+        }
+        authenticationTypeDescsBySecAttrPointer = byPointer;
+        authenticationTypeDescsBySecAttrValue = byValue;
+    });
+}
 
 static AuthenticationTypeDesc *
 AuthenticationTypeDescFromSecAttrAuthenticationType(CFTypeRef sauthenticationType)
 {
 	if (sauthenticationType == NULL)
         return NULL;
-    for (CFIndex i = 0; i < cAuthenticationTypeDescs; i++) {
-        if (CFEqual(sauthenticationType, *(authenticationTypeDescs[i].sauthenticationType))) {
-            return &authenticationTypeDescs[i];
-        }
-    }
-	return NULL;    
+    AuthenticationTypeDescsInitialize();
+    AuthenticationTypeDesc *desc = (AuthenticationTypeDesc *)CFDictionaryGetValue(authenticationTypeDescsBySecAttrPointer, sauthenticationType);
+    if (desc == NULL)
+        desc = (AuthenticationTypeDesc *)CFDictionaryGetValue(authenticationTypeDescsBySecAttrValue, sauthenticationType);
+	return desc;
 }
 
 static AuthenticationTypeDesc *
 AuthenticationTypeDescFromLKKCAuthenticationType(LKKCAuthenticationType authenticationType)
 {
-    for (CFIndex i = 0; i < cAuthenticationTypeDescs; i++) {
-        if (authenticationType == authenticationTypeDescs[i].authenticationType)
-            return &authenticationTypeDescs[i];
-    }
-	return NULL;
+    if (authenticationType <= LKKCAuthenticationTypeAny || authenticationType > cAuthenticationTypeDescs)
+        return NULL;
+    if (authenticationTypeDescs[authenticationType - 1].sauthenticationType == NULL)
+        return NULL;
+    return &authenticationTypeDescs[authenticationType - 1];
 }
 
 #pragma mark - Implementation
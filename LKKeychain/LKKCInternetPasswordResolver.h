@@ -0,0 +1,106 @@
+//
+//  LKKCInternetPasswordResolver.h
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright © 2011, Károly Lőrentey. All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//  
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of Károly Lőrentey nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+//  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL KÁROLY LŐRENTEY BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+//  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+#import <Foundation/Foundation.h>
+
+@class LKKCKeychain;
+@class LKKCInternetPassword;
+
+/** Finds the internet password that best matches a URL.
+ 
+ `-[LKKCKeychain internetPasswordsForServer:]` only matches exact server names, and it runs a full
+ keychain search on every call. A resolver loads all internet passwords on a keychain once, 
+ and indexes them in an in-memory trie keyed by server name and path components.
+ Lookups then only walk the trie; they don't touch the keychain at all.
+ 
+ The resolver matches the URL's host against the <[LKKCInternetPassword server]> attribute
+ (case insensitively), and its path against <[LKKCInternetPassword path]> on path component boundaries. 
+ The <[LKKCInternetPassword protocol]> and <[LKKCInternetPassword port]> attributes must either match
+ the URL's scheme and port, or be unspecified (`LKKCProtocolAny` and 0, respectively).
+ URLs without an explicit port match the well-known port of their scheme, e.g., 443 for `https`.
+ If the URL includes a username, the <[LKKCInternetPassword account]> must match it too.
+ 
+ When there are several matching passwords, the most specific one wins: 
+ longer path prefixes beat shorter ones, and exact protocol, port and account matches beat 
+ unspecified values.
+ 
+     LKKCInternetPasswordResolver *resolver = [LKKCInternetPasswordResolver resolverWithKeychain:keychain];
+     LKKCInternetPassword *item = [resolver internetPasswordForURL:[request URL]];
+     if (item != nil) {
+         NSString *password = item.password;
+         ...
+     }
+ 
+ The index is rebuilt automatically on the next lookup after any item is added, modified or 
+ deleted in any keychain. Keychain change notifications are delivered through the main run loop, 
+ so changes made by other processes are only noticed when the main thread is running its run loop.
+ Use <reload> to force an immediate rebuild.
+ 
+ Resolvers are safe to use from multiple threads.
+ */
+@interface LKKCInternetPasswordResolver : NSObject
+{
+@private
+    LKKCKeychain *_keychain;
+    NSMutableDictionary *_servers;
+    int32_t _generation;
+    BOOL _loaded;
+}
+
+/** Returns a resolver for the internet passwords on the specified keychain.
+ @param keychain The keychain whose internet passwords the resolver should return.
+ @return A new resolver instance.
+ */
++ (LKKCInternetPasswordResolver *)resolverWithKeychain:(LKKCKeychain *)keychain;
+
+/** The keychain whose internet passwords this resolver returns. */
+@property (nonatomic, readonly) LKKCKeychain *keychain;
+
+/** Returns the most specific internet password that matches a URL.
+ @param url The URL to match.
+ @return The best matching internet password, or nil if there is no match.
+ */
+- (LKKCInternetPassword *)internetPasswordForURL:(NSURL *)url;
+
+/** Returns all internet passwords that match a URL, most specific first.
+ @param url The URL to match.
+ @return An array of matching <LKKCInternetPassword> instances, possibly empty.
+ */
+- (NSArray *)internetPasswordsForURL:(NSURL *)url;
+
+/** Discards the index and reloads all internet passwords from the keychain. */
+- (void)reload;
+
+@end
@@ -0,0 +1,332 @@
+//
+//  LKKCInternetPasswordResolver.m
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright © 2011, Károly Lőrentey. All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//  
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of Károly Lőrentey nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+//  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL KÁROLY LŐRENTEY BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+//  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+#import <libkern/OSAtomic.h>
+
+#import "LKKCInternetPasswordResolver.h"
+#import "LKKCKeychain.h"
+#import "LKKCInternetPassword.h"
+#import "LKKCUtil.h"
+
+#pragma mark - Keychain change tracking
+
+// Incremented on every keychain change event. Resolvers compare this to the value they saw 
+// when they last built their index.
+static volatile int32_t keychainGeneration = 0;
+
+static OSStatus
+KeychainChanged(SecKeychainEvent keychainEvent, SecKeychainCallbackInfo *info, void *context)
+{
+    OSAtomicIncrement32Barrier(&keychainGeneration);
+    return errSecSuccess;
+}
+
+static NSArray *
+PathComponents(NSString *path)
+{
+    if (path == nil)
+        return [NSArray array];
+    NSMutableArray *components = [NSMutableArray array];
+    for (NSString *component in [path componentsSeparatedByString:@"/"]) {
+        if ([component length] > 0)
+            [components addObject:component];
+    }
+    return components;
+}
+
+// The port a URL uses when it doesn't specify one, or 0 if the protocol has no well-known port.
+static int
+DefaultPortForProtocol(LKKCProtocol protocol)
+{
+    switch (protocol) {
+        case LKKCProtocolFTP: return 21;
+        case LKKCProtocolSSH: return 22;
+        case LKKCProtocolTelnet: return 23;
+        case LKKCProtocolSMTP: return 25;
+        case LKKCProtocolHTTP: return 80;
+        case LKKCProtocolPOP3: return 110;
+        case LKKCProtocolNNTP: return 119;
+        case LKKCProtocolIMAP: return 143;
+        case LKKCProtocolLDAP: return 389;
+        case LKKCProtocolHTTPS: return 443;
+        case LKKCProtocolSMB: return 445;
+        case LKKCProtocolRTSP: return 554;
+        case LKKCProtocolNNTPS: return 563;
+        case LKKCProtocolIPP: return 631;
+        case LKKCProtocolLDAPS: return 636;
+        case LKKCProtocolAFP: return 548;
+        case LKKCProtocolFTPS: return 990;
+        case LKKCProtocolTelnetS: return 992;
+        case LKKCProtocolIMAPS: return 993;
+        case LKKCProtocolPOP3S: return 995;
+        case LKKCProtocolSOCKS: return 1080;
+        case LKKCProtocolDAAP: return 3689;
+        case LKKCProtocolIRC: return 6667;
+        case LKKCProtocolIRCS: return 6697;
+        default: return 0;
+    }
+}
+
+#pragma mark - Index
+
+// An internet password, with the attributes needed for matching decoded in advance.
+@interface LKKCResolverEntry : NSObject
+{
+@public
+    LKKCInternetPassword *_item;
+    LKKCProtocol _protocol;
+    int _port;
+    NSString *_account;
+}
+@end
+
+@implementation LKKCResolverEntry
+- (void)dealloc
+{
+    [_item release];
+    [_account release];
+    [super dealloc];
+}
+@end
+
+// A node in the path trie of a server. 
+@interface LKKCResolverNode : NSObject
+{
+@public
+    NSMutableDictionary *_children; // Path component -> LKKCResolverNode
+    NSMutableArray *_entries; // LKKCResolverEntry instances whose path ends at this node
+}
+@end
+
+@implementation LKKCResolverNode
+- (void)dealloc
+{
+    [_children release];
+    [_entries release];
+    [super dealloc];
+}
+@end
+
+#pragma mark - Implementation
+
+@interface LKKCInternetPasswordResolver()
+- (id)initWithKeychain:(LKKCKeychain *)keychain;
+- (void)_loadIfNeeded;
+- (void)_matchURL:(NSURL *)url usingBlock:(void (^)(LKKCResolverEntry *entry, NSUInteger score))block;
+@end
+
+@implementation LKKCInternetPasswordResolver
+
++ (void)initialize
+{
+    if (self != [LKKCInternetPasswordResolver class])
+        return;
+    OSStatus status = SecKeychainAddCallback(KeychainChanged, 
+                                             kSecAddEventMask | kSecDeleteEventMask | kSecUpdateEventMask | kSecKeychainListChangedMask, 
+                                             NULL);
+    if (status) {
+        LKKCReportError(status, NULL, @"Can't register keychain callback; resolvers won't notice keychain changes");
+    }
+}
+
++ (LKKCInternetPasswordResolver *)resolverWithKeychain:(LKKCKeychain *)keychain
+{
+    return [[[LKKCInternetPasswordResolver alloc] initWithKeychain:keychain] autorelease];
+}
+
+- (id)initWithKeychain:(LKKCKeychain *)keychain
+{
+    self = [super init];
+    if (self == nil)
+        return nil;
+    _keychain = [keychain retain];
+    return self;
+}
+
+- (void)dealloc
+{
+    [_keychain release];
+    [_servers release];
+    [super dealloc];
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@ %p %@>", [self className], self, _keychain];
+}
+
+- (LKKCKeychain *)keychain
+{
+    return _keychain;
+}
+
+- (void)reload
+{
+    @synchronized(self) {
+        _loaded = NO;
+        [self _loadIfNeeded];
+    }
+}
+
+- (void)_loadIfNeeded
+{
+    // Read the generation before loading, so that changes made while we're loading trigger another reload.
+    int32_t generation = keychainGeneration;
+    OSMemoryBarrier();
+    if (_loaded && generation == _generation)
+        return;
+    
+    NSMutableDictionary *servers = [NSMutableDictionary dictionary];
+    for (LKKCInternetPassword *item in [_keychain internetPasswords]) {
+        NSString *server = [item.server lowercaseString];
+        if (server == nil)
+            continue;
+        LKKCResolverNode *node = [servers objectForKey:server];
+        if (node == nil) {
+            node = [[[LKKCResolverNode alloc] init] autorelease];
+            [servers setObject:node forKey:server];
+        }
+        for (NSString *component in PathComponents(item.path)) {
+            if (node->_children == nil)
+                node->_children = [[NSMutableDictionary alloc] init];
+            LKKCResolverNode *child = [node->_children objectForKey:component];
+            if (child == nil) {
+                child = [[[LKKCResolverNode alloc] init] autorelease];
+                [node->_children setObject:child forKey:component];
+            }
+            node = child;
+        }
+        
+        LKKCResolverEntry *entry = [[[LKKCResolverEntry alloc] init] autorelease];
+        entry->_item = [item retain];
+        entry->_protocol = item.protocol;
+        entry->_port = item.port;
+        entry->_account = [item.account retain];
+        if (node->_entries == nil)
+            node->_entries = [[NSMutableArray alloc] init];
+        [node->_entries addObject:entry];
+    }
+    
+    [_servers release];
+    _servers = [servers retain];
+    _generation = generation;
+    _loaded = YES;
+}
+
+// Calls block for each matching entry. Higher scores indicate more specific matches.
+- (void)_matchURL:(NSURL *)url usingBlock:(void (^)(LKKCResolverEntry *entry, NSUInteger score))block
+{
+    NSString *host = [[url host] lowercaseString];
+    if (host == nil)
+        return;
+    LKKCResolverNode *node = [_servers objectForKey:host];
+    if (node == nil)
+        return;
+    
+    LKKCProtocol protocol = [LKKCInternetPassword protocolFromURLScheme:[[url scheme] lowercaseString]];
+    // A URL without a port uses the default port of its scheme, so that items stored with an explicit
+    // default port (e.g., 443 for https) still match.
+    int port = ([url port] != nil ? [[url port] intValue] : DefaultPortForProtocol(protocol));
+    NSString *account = [url user];
+    
+    NSArray *components = PathComponents([url path]);
+    NSUInteger count = [components count];
+    NSUInteger depth = 0;
+    while (node != nil) {
+        for (LKKCResolverEntry *entry in node->_entries) {
+            if (entry->_protocol != LKKCProtocolAny && entry->_protocol != protocol)
+                continue;
+            if (entry->_port != 0 && entry->_port != port)
+                continue;
+            if (account != nil && entry->_account != nil && ![entry->_account isEqualToString:account])
+                continue;
+            
+            // Path depth dominates; protocol, port and account break ties, in that order.
+            NSUInteger score = depth << 3;
+            if (entry->_protocol != LKKCProtocolAny)
+                score |= 4;
+            if (entry->_port != 0)
+                score |= 2;
+            if (account != nil && entry->_account != nil)
+                score |= 1;
+            block(entry, score);
+        }
+        if (depth == count)
+            break;
+        node = [node->_children objectForKey:[components objectAtIndex:depth]];
+        depth++;
+    }
+}
+
+- (LKKCInternetPassword *)internetPasswordForURL:(NSURL *)url
+{
+    @synchronized(self) {
+        [self _loadIfNeeded];
+        
+        __block LKKCResolverEntry *best = nil;
+        __block NSUInteger bestScore = 0;
+        [self _matchURL:url usingBlock:^(LKKCResolverEntry *entry, NSUInteger score) {
+            if (best == nil || score > bestScore) {
+                best = entry;
+                bestScore = score;
+            }
+        }];
+        if (best == nil)
+            return nil;
+        // The index may be replaced by another thread as soon as we return.
+        return [[best->_item retain] autorelease];
+    }
+}
+
+- (NSArray *)internetPasswordsForURL:(NSURL *)url
+{
+    @synchronized(self) {
+        [self _loadIfNeeded];
+        
+        NSMutableArray *matches = [NSMutableArray array];
+        NSMutableArray *scores = [NSMutableArray array];
+        [self _matchURL:url usingBlock:^(LKKCResolverEntry *entry, NSUInteger score) {
+            // Insertion sort; there are rarely more than a handful of matches.
+            NSUInteger index = [scores count];
+            while (index > 0 && [[scores objectAtIndex:index - 1] unsignedIntegerValue] < score)
+                index--;
+            [matches insertObject:entry->_item atIndex:index];
+            [scores insertObject:[NSNumber numberWithUnsignedInteger:score] atIndex:index];
+        }];
+        return matches;
+    }
+}
+
+@end
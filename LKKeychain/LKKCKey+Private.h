@@ -35,9 +35,39 @@
 
 #import <LKKeychain/LKKCKey.h>
 
+@class LKKCDigestContext;
+
+// Reads the raw bits of extractable keys through a null wrap. A reader keeps its wrapping context 
+// between reads, so reading many keys on the same CSP only sets it up once. Start with a zeroed reader.
+typedef struct {
+    CSSM_CSP_HANDLE csphandle;
+    CSSM_CC_HANDLE cchandle;
+} LKKCRawKeyReader;
+
+// Read the bits of skey into rawKey. Release them with LKKCRawKeyReaderFreeKey before the next read.
+BOOL LKKCRawKeyReaderReadKey(LKKCRawKeyReader *reader, SecKeyRef skey, CSSM_KEY *rawKey, NSError **error);
+// Wipe and free key bits returned by LKKCRawKeyReaderReadKey.
+void LKKCRawKeyReaderFreeKey(LKKCRawKeyReader *reader, CSSM_KEY *rawKey);
+// Release the reader's wrapping context.
+void LKKCRawKeyReaderClose(LKKCRawKeyReader *reader);
+
+// A process-wide attachment to the Apple CSP, for keys that don't belong to a keychain. Returns 0 on error.
+CSSM_CSP_HANDLE LKKCAppleCSPHandle(NSError **error);
+
 @interface LKKCKey (Private)
+// Like keyWithData:keyClass:keyType:keySize:, but also passes the given kSecAttr* attributes (label, application label, 
+// application tag) to SecKeyCreateFromData, so that the floating key carries them into the keychain when it's added.
++ (LKKCKey *)_keyWithData:(NSData *)data 
+                 keyClass:(LKKCKeyClass)keyClass
+                  keyType:(LKKCKeyType)keyType 
+                  keySize:(UInt32)keySize
+               attributes:(NSDictionary *)attributes;
 + (CFTypeRef)_algorithmFromLKKCKeyType:(LKKCKeyType)keyType;
 + (CSSM_ALGORITHMS)_cssmAlgorithmFromLKKCKeyType:(LKKCKeyType)keyType;
 + (LKKCKeyType)_keyTypeFromAlgorithm:(CFTypeRef)algorithm;
 + (LKKCKeyType)_keyTypeFromCSSMAlgorithm:(CSSM_ALGORITHMS)algorithm;
+
+// Borrow an HMAC context keyed by this key from its pool of idle contexts; return it with _checkInHMACContext:.
+- (LKKCDigestContext *)_checkOutHMACContextWithDigestAlgorithm:(LKKCDigestAlgorithm)digestAlgorithm error:(NSError **)error;
+- (void)_checkInHMACContext:(LKKCDigestContext *)hmac;
 @end
@@ -52,11 +52,42 @@ typedef enum {
     LKKCKeyTypeRC4,
     LKKCKeyTypeRC2,
     LKKCKeyTypeCAST,
-    LKKCKeyTypeECDSA
+    LKKCKeyTypeECDSA,
+    LKKCKeyTypeCount // The number of key types above; not a valid value.
 } LKKCKeyType;
 
+typedef enum {
+    LKKCDigestAlgorithmSHA1,
+    LKKCDigestAlgorithmSHA224,
+    LKKCDigestAlgorithmSHA256,
+    LKKCDigestAlgorithmSHA384,
+    LKKCDigestAlgorithmSHA512
+} LKKCDigestAlgorithm;
+
+/** One message in a batch encryption or decryption operation.
+ @see [LKKCKey encryptBatch:count:output:capacity:offsets:error:]
+ */
+typedef struct {
+    /** The plaintext or ciphertext of the message. */
+    const void *bytes;
+    /** The length of the message in bytes. */
+    size_t length;
+    /** The initialization vector for this message; it must be <[LKKCKey blockSize]> bytes long. Ignored for asymmetric keys. */
+    const void *initVector;
+} LKKCCryptoBatchItem;
+
 /** Represents a cryptographic key. */
 @interface LKKCKey : LKKCKeychainItem
+{
+@private
+    // Idle crypto contexts for this key, reused across encryptData:initVector:error: and decryptData:initVector:error: calls.
+    struct LKKCObjectPool *volatile _encryptionContexts;
+    struct LKKCObjectPool *volatile _decryptionContexts;
+    struct LKKCObjectPool *volatile _gcmContexts;
+    NSMutableArray *_hmacContexts;
+    // Class, type, sizes and usage flags, decoded on first use. They never change for a given key.
+    struct LKKCKeyProperties *volatile _properties;
+}
 
 + (LKKCKey *)keyWithSecKey:(SecKeyRef)skey;
 
@@ -251,6 +282,268 @@ typedef enum {
  */
 - (NSData *)decryptData:(NSData *)ciphertext initVector:(NSData *)iv error:(NSError **)error;
 
+/** Decrypt a large piece of ciphertext produced by encryptData:initVector:error: on all available cores.
+ 
+ Each CBC block only depends on the previous ciphertext block, so the ciphertext is split into chunks at block boundaries, 
+ and each chunk is decrypted independently with the last ciphertext block of the previous chunk as its IV.
+ The result is identical to that of decryptData:initVector:error:, which calls this method itself for large inputs.
+ 
+ @param ciphertext The encrypted data.
+ @param iv The initialization vector that was used to encrypt.
+ @param error On output, the error that occured in case the data could not be decrypted (optional).
+ @return The decrypted data.
+ */
+- (NSData *)decryptDataInParallel:(NSData *)ciphertext initVector:(NSData *)iv error:(NSError **)error;
+
+/** --------------------------------------------------------------------------------
+ @name Authenticated Encryption
+ -------------------------------------------------------------------------------- */
+
+/** Return a random 12-byte nonce for use with encryptData:nonce:additionalData:tag:error:. 
+ Never encrypt two messages with the same key and nonce.
+ */
+- (NSData *)randomNonce;
+
+/** Encrypt and authenticate a piece of data with this key using AES-GCM.
+ 
+ The additional data is authenticated but not encrypted; it must be supplied unchanged for decryption.
+ 
+ @param plaintext The data to encrypt.
+ @param nonce A unique nonce, preferably 12 bytes long. 
+ @param additionalData Data to authenticate along with the plaintext (optional).
+ @param tag On output, the 16-byte authentication tag. 
+ @param error On output, the error that occured in case the data could not be encrypted (optional).
+ @return The encrypted data, which is the same length as the plaintext.
+ @see randomNonce
+ */
+- (NSData *)encryptData:(NSData *)plaintext 
+                  nonce:(NSData *)nonce 
+         additionalData:(NSData *)additionalData 
+                    tag:(NSData **)tag 
+                  error:(NSError **)error;
+
+/** Verify and decrypt a piece of data encrypted by encryptData:nonce:additionalData:tag:error:.
+ 
+ @param ciphertext The encrypted data.
+ @param nonce The nonce that was used to encrypt.
+ @param additionalData The additional data that was authenticated during encryption (optional).
+ @param tag The authentication tag.
+ @param error On output, the error that occured in case the data could not be decrypted or is not authentic (optional).
+ @return The decrypted data, or nil if the ciphertext, the additional data or the tag has been modified.
+ */
+- (NSData *)decryptData:(NSData *)ciphertext 
+                  nonce:(NSData *)nonce 
+         additionalData:(NSData *)additionalData 
+                    tag:(NSData *)tag 
+                  error:(NSError **)error;
+
+/** --------------------------------------------------------------------------------
+ @name Parallel Authenticated Encryption
+ -------------------------------------------------------------------------------- */
+
+/** Encrypt a large piece of data on all available cores, using 1 MiB segments.
+ @see encryptDataInParallel:segmentSize:error:
+ */
+- (NSData *)encryptDataInParallel:(NSData *)plaintext error:(NSError **)error;
+
+/** Encrypt a large piece of data on all available cores.
+ 
+ The plaintext is split into segments that are encrypted independently with AES-GCM, each with its own nonce 
+ and authentication tag. The result starts with a header that records the segment size, the plaintext length
+ and a random nonce prefix; the header is authenticated along with every segment, so segments can't be
+ reordered, dropped or moved between messages.
+ 
+ @param plaintext The data to encrypt.
+ @param segmentSize The length of each segment in bytes; the last one may be shorter.
+ @param error On output, the error that occured in case the data could not be encrypted (optional).
+ @return The header followed by the encrypted segments, each followed by its tag.
+ */
+- (NSData *)encryptDataInParallel:(NSData *)plaintext segmentSize:(uint32_t)segmentSize error:(NSError **)error;
+
+/** Verify and decrypt data encrypted by encryptDataInParallel:segmentSize:error: on all available cores.
+ @param ciphertext The encrypted data, including its header.
+ @param error On output, the error that occured in case the data could not be decrypted or is not authentic (optional).
+ @return The decrypted data, or nil if any part of the ciphertext has been modified.
+ */
+- (NSData *)decryptDataInParallel:(NSData *)ciphertext error:(NSError **)error;
+
+/** --------------------------------------------------------------------------------
+ @name Signatures
+ -------------------------------------------------------------------------------- */
+
+/** Sign a piece of data with this private key.
+ 
+ To sign a message that doesn't fit in memory, use <LKKCSignatureContext> directly.
+ 
+ @param data The data to sign.
+ @param digestAlgorithm The digest algorithm to use. DSA keys only support SHA-1.
+ @param error On output, the error that occured in case the data could not be signed (optional).
+ @return The signature.
+ */
+- (NSData *)signData:(NSData *)data digestAlgorithm:(LKKCDigestAlgorithm)digestAlgorithm error:(NSError **)error;
+
+/** Verify the signature of a piece of data with this public key.
+ 
+ @param signature The signature to check.
+ @param data The data that was signed.
+ @param digestAlgorithm The digest algorithm that was used to create the signature.
+ @param error On output, the error that occured in case the signature is invalid or could not be verified (optional).
+ @return YES if the signature is valid.
+ */
+- (BOOL)verifySignature:(NSData *)signature forData:(NSData *)data digestAlgorithm:(LKKCDigestAlgorithm)digestAlgorithm error:(NSError **)error;
+
+/** Verify many signatures with this public key on all available cores.
+ 
+ @param signatures An array of NSData signatures.
+ @param messages An array of NSData messages, with the same number of elements as `signatures`.
+ @param digestAlgorithm The digest algorithm that was used to create the signatures.
+ @param results On output, whether each signature is valid (optional). Must have room for as many values as there are signatures.
+ @param error On output, the error that occured in case the signatures could not be verified (optional). Invalid signatures are not errors.
+ @return YES if all signatures could be checked, even if some of them are invalid; NO on error.
+ */
+- (BOOL)verifySignatures:(NSArray *)signatures 
+             forMessages:(NSArray *)messages 
+         digestAlgorithm:(LKKCDigestAlgorithm)digestAlgorithm 
+                 results:(BOOL *)results 
+                   error:(NSError **)error;
+
+/** --------------------------------------------------------------------------------
+ @name Message Authentication
+ -------------------------------------------------------------------------------- */
+
+/** Compute the HMAC of a piece of data with this symmetric key.
+ 
+ The key bits are read only the first time; later calls reuse the precomputed HMAC state.
+ To authenticate a message that doesn't fit in memory, use <LKKCDigestContext> directly.
+ 
+ @param data The data to authenticate.
+ @param digestAlgorithm The underlying digest algorithm.
+ @param error On output, the error that occured in case the HMAC could not be computed (optional).
+ @return The HMAC of `data`.
+ */
+- (NSData *)hmacForData:(NSData *)data digestAlgorithm:(LKKCDigestAlgorithm)digestAlgorithm error:(NSError **)error;
+
+/** Check the HMAC of a piece of data in constant time.
+ 
+ @param hmac The HMAC to check.
+ @param data The data that was authenticated.
+ @param digestAlgorithm The underlying digest algorithm.
+ @param error On output, the error that occured in case the HMAC is invalid or could not be checked (optional).
+ Invalid HMACs are reported with CSSMERR_CSP_VERIFY_FAILED.
+ @return YES if the HMAC is valid.
+ */
+- (BOOL)verifyHMAC:(NSData *)hmac forData:(NSData *)data digestAlgorithm:(LKKCDigestAlgorithm)digestAlgorithm error:(NSError **)error;
+
+/** --------------------------------------------------------------------------------
+ @name Batch Encryption and Decryption
+ -------------------------------------------------------------------------------- */
+
+/** Return the length of the ciphertext produced by encrypting `length` bytes with this key, including padding.
+ Decrypting a ciphertext never produces more bytes than the length of the ciphertext.
+ */
+- (size_t)encryptedLengthForPlaintextLength:(size_t)length;
+
+/** Encrypt many messages into a single contiguous buffer.
+ 
+ The ciphertexts are written to `output` back to back; the ciphertext of message `i` is at `offsets[i]`,
+ and its length is `offsets[i + 1] - offsets[i]`. No memory is allocated per message.
+ 
+ @param items The messages to encrypt.
+ @param count The number of messages in `items`.
+ @param output The buffer that receives the ciphertexts.
+ @param capacity The size of `output`. Use encryptedLengthForPlaintextLength: to calculate the space needed by each message.
+ @param offsets On output, the offsets of each ciphertext in `output`, followed by the total length. Must have room for `count + 1` values.
+ @param error On output, the error that occured in case the messages could not be encrypted (optional).
+ @return YES if all messages were encrypted.
+ */
+- (BOOL)encryptBatch:(const LKKCCryptoBatchItem *)items 
+               count:(NSUInteger)count 
+              output:(void *)output 
+            capacity:(size_t)capacity 
+             offsets:(size_t *)offsets 
+               error:(NSError **)error;
+
+/** Decrypt many messages into a single contiguous buffer.
+ 
+ This works the same way as encryptBatch:count:output:capacity:offsets:error:. 
+ A buffer as large as the sum of the ciphertext lengths is always sufficient.
+ */
+- (BOOL)decryptBatch:(const LKKCCryptoBatchItem *)items 
+               count:(NSUInteger)count 
+              output:(void *)output 
+            capacity:(size_t)capacity 
+             offsets:(size_t *)offsets 
+               error:(NSError **)error;
+
+/** --------------------------------------------------------------------------------
+ @name Key Wrapping
+ -------------------------------------------------------------------------------- */
+
+/** Wrap (encrypt) a symmetric key with this key, so that it can be stored or transmitted outside the keychain.
+ 
+ AES keys wrap with the AES Key Wrap algorithm (RFC 3394) inside their own CSP, so an AES wrapping key never leaves it 
+ and may be non-extractable; a key that lives on the same CSP (e.g., the same keychain) is wrapped without leaving it either. 
+ RSA public keys wrap with PKCS#1 v1.5 encryption.
+ 
+ @param key The symmetric key to wrap.
+ @param error On output, the error that occurred in case the key could not be wrapped (optional).
+ @return The wrapped key, or nil on error.
+ @see unwrapKey:keyType:keySize:error:
+ */
+- (NSData *)wrapKey:(LKKCKey *)key error:(NSError **)error;
+
+/** Wrap many symmetric keys with this key.
+ 
+ This is much faster than calling wrapKey:error: for each key: the wrapping key is set up once, 
+ and the same contexts are reused for every key in the batch.
+ 
+ @param keys An array of symmetric LKKCKeys to wrap.
+ @param error On output, the error that occurred in case the keys could not be wrapped (optional).
+ @return An array of NSData objects with the wrapped keys, in the same order as `keys`, or nil if any key could not be wrapped.
+ */
+- (NSArray *)wrapKeys:(NSArray *)keys error:(NSError **)error;
+
+/** Unwrap a key that was wrapped by wrapKey:error: with this key or, for RSA private keys, with its public key.
+ 
+ The unwrapped key is not added to any keychain.
+ 
+ @param wrappedKey The wrapped key.
+ @param keyType The type of the wrapped key.
+ @param keySize The size of the wrapped key in bits.
+ @param error On output, the error that occurred in case the key could not be unwrapped (optional).
+ @return The unwrapped key, or nil if the wrapped key is corrupt or was wrapped with a different key.
+ */
+- (LKKCKey *)unwrapKey:(NSData *)wrappedKey keyType:(LKKCKeyType)keyType keySize:(UInt32)keySize error:(NSError **)error;
+
+/** Unwrap many keys of the same type and size, reusing the same setup for all of them. 
+ 
+ @param wrappedKeys An array of NSData objects produced by wrapKey:error: or wrapKeys:error:.
+ @param keyType The type of the wrapped keys.
+ @param keySize The size of the wrapped keys in bits.
+ @param error On output, the error that occurred in case the keys could not be unwrapped (optional).
+ @return An array of unwrapped LKKCKeys in the same order as `wrappedKeys`, or nil if any key could not be unwrapped.
+ */
+- (NSArray *)unwrapKeys:(NSArray *)wrappedKeys keyType:(LKKCKeyType)keyType keySize:(UInt32)keySize error:(NSError **)error;
+
+/** --------------------------------------------------------------------------------
+ @name Key Agreement
+ -------------------------------------------------------------------------------- */
+
+/** Compute an ECDH shared secret from this elliptic curve private key and the other party's public key.
+ 
+ The other party gets the same secret from its own private key and this key's public key. 
+ The secret isn't uniformly random, so don't use it as a key directly; 
+ run it through <[LKKCKeyDeriver deriveKeyFromKeyMaterial:salt:info:error:]> first.
+ 
+ For per-session key exchange, generate the ephemeral key pair with a generator that has no keychain;
+ see <[LKKCKeyGenerator keyPairPoolSize]>.
+ 
+ @param publicKey The other party's public key. It must be on the same curve as this key, and it must be extractable.
+ @param error On output, the error that occurred in case the secret could not be computed (optional).
+ @return The shared secret, which is as long as a coordinate of the curve, or nil on error.
+ */
+- (NSData *)sharedSecretWithPublicKey:(LKKCKey *)publicKey error:(NSError **)error;
+
 @end
 
 //kSecClassKey item attributes:
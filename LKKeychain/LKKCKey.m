@@ -36,45 +36,385 @@
 #import "LKKCKey.h"
 #import "LKKCKeychain.h"
 #import "LKKCKeychainItem+Subclasses.h"
+#import "LKKCKey+Private.h"
 #import "LKKCUtil.h"
 #import "LKKCCryptoContext.h"
+#import "LKKCCryptoContext+Private.h"
+#import "LKKCGCMContext.h"
+#import "LKKCSignatureContext.h"
+#import "LKKCDigestContext.h"
+#import <libkern/OSByteOrder.h>
+#import <libkern/OSAtomic.h>
 
 @interface LKKCKey()
 + (NSString *)stringFromKeyType:(LKKCKeyType)keyType;
 + (NSString *)stringFromKeyClass:(LKKCKeyClass)keyClass;
 
 - (BOOL)_getBooleanAttribute:(CFTypeRef)attribute flag:(CSSM_KEYATTR_FLAGS)flag use:(CSSM_KEYUSE)use;
+- (BOOL)_decodeProperties:(struct LKKCKeyProperties *)properties;
+- (void)_getProperties:(struct LKKCKeyProperties *)properties;
+
+- (LKKCCryptoContext *)_checkOutCryptoContextForOperation:(CSSM_ACL_AUTHORIZATION_TAG)operation initVector:(NSData *)iv error:(NSError **)error;
+- (void)_checkInCryptoContext:(LKKCCryptoContext *)cc operation:(CSSM_ACL_AUTHORIZATION_TAG)operation;
+- (void)_flushCryptoContexts;
+- (LKKCGCMContext *)_checkOutGCMContextWithError:(NSError **)error;
+- (void)_checkInGCMContext:(LKKCGCMContext *)gcm;
+- (CSSM_CC_HANDLE)_createKeyWrapContextForOperation:(CSSM_ACL_AUTHORIZATION_TAG)operation cspHandle:(CSSM_CSP_HANDLE *)csphandle error:(NSError **)error;
+- (BOOL)_processSegments:(NSUInteger)count 
+                 encrypt:(BOOL)encrypt 
+                  header:(const uint8_t *)header 
+                   input:(const uint8_t *)input 
+                  output:(uint8_t *)output 
+                  length:(uint64_t)length 
+             segmentSize:(uint32_t)segmentSize 
+                   error:(NSError **)error;
 @end
 
 static NSString *LKKCAttrKeyID = @"LKKCKeyID";
 
+// The properties of a key that never change. Reading them from the attributes or the CSSM key header
+// on every access is slow, so LKKCKey decodes them once.
+struct LKKCKeyProperties {
+    LKKCKeyClass keyClass;
+    LKKCKeyType keyType;
+    int keySize;
+    int effectiveKeySize;
+    size_t blockSize;
+    CSSM_KEYUSE usage; // The CSSM_KEYUSE_* bits of the can* properties that are set.
+};
+
+static const CFTypeRef *keyUsageAttributes[] = {
+    &kSecAttrCanEncrypt,
+    &kSecAttrCanDecrypt,
+    &kSecAttrCanDerive,
+    &kSecAttrCanSign,
+    &kSecAttrCanVerify,
+    &kSecAttrCanWrap,
+    &kSecAttrCanUnwrap
+};
+static const CSSM_KEYUSE keyUsageFlags[] = {
+    CSSM_KEYUSE_ENCRYPT,
+    CSSM_KEYUSE_DECRYPT,
+    CSSM_KEYUSE_DERIVE,
+    CSSM_KEYUSE_SIGN,
+    CSSM_KEYUSE_VERIFY,
+    CSSM_KEYUSE_WRAP,
+    CSSM_KEYUSE_UNWRAP
+};
+static const int cKeyUsageAttributes = sizeof(keyUsageAttributes) / sizeof(CFTypeRef *);
+
+// Segmented ciphertexts start with this header, which is also the additional authenticated data of every segment:
+//   "LKSG" | version (1) | reserved (3) | segment size (4) | plaintext length (8) | nonce prefix (8)
+// Integers are big-endian. The nonce of segment i is the nonce prefix followed by i as a 32-bit integer.
+#define LKKCSegmentedMagic "LKSG"
+static const uint8_t LKKCSegmentedVersion = 1;
+static const size_t LKKCSegmentedHeaderLength = 28;
+static const uint32_t LKKCSegmentedDefaultSegmentSize = 1024 * 1024;
+
+// decryptData:initVector:error: switches to parallel CBC decryption for inputs at least this long.
+static const size_t LKKCKeyParallelDecryptionThreshold = 1024 * 1024;
+// The minimum chunk length for parallel CBC decryption; shorter chunks aren't worth the context setup.
+static const size_t LKKCKeyParallelDecryptionMinimumChunk = 64 * 1024;
+
+// The maximum number of idle crypto contexts kept for each key and operation.
+static const NSUInteger LKKCKeyMaxIdleCryptoContexts = 4;
+
+// Encryption, decryption and GCM contexts are kept in lock-free pools with two slots per core,
+// so that every worker thread can keep a context of its own.
+static NSUInteger
+LKKCKeyCryptoContextPoolCapacity(void)
+{
+    static NSUInteger capacity = 0;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        capacity = MAX(LKKCKeyMaxIdleCryptoContexts, 2 * [[NSProcessInfo processInfo] activeProcessorCount]);
+    });
+    return capacity;
+}
+
+// kSecAttrKeyType values, indexed by LKKCKeyType.
+static const CFTypeRef *keyTypeAlgorithms[LKKCKeyTypeCount] = {
+    [LKKCKeyTypeUnknown] = NULL,
+    [LKKCKeyTypeRSA] = &kSecAttrKeyTypeRSA,
+    [LKKCKeyTypeDSA] = &kSecAttrKeyTypeDSA,
+    [LKKCKeyTypeAES] = &kSecAttrKeyTypeAES,
+    [LKKCKeyTypeDES] = &kSecAttrKeyTypeDES,
+    [LKKCKeyType3DES] = &kSecAttrKeyType3DES,
+    [LKKCKeyTypeRC4] = &kSecAttrKeyTypeRC4,
+    [LKKCKeyTypeRC2] = &kSecAttrKeyTypeRC2,
+    [LKKCKeyTypeCAST] = &kSecAttrKeyTypeCAST,
+    [LKKCKeyTypeECDSA] = &kSecAttrKeyTypeECDSA
+};
+
+// A key type without an algorithm has a NULL entry, which is skipped below and maps to no algorithm;
+// the unit tests check that there are none.
+static const int cKeyTypeAlgorithms = LKKCKeyTypeCount;
+
+// Reverse mappings from kSecAttrKeyType values to LKKCKeyType.
+// Values returned by the Security framework are usually the kSecAttrKeyType* constants themselves, 
+// so we try a pointer-keyed table before hashing string contents.
+static CFDictionaryRef keyTypesByAlgorithmPointer;
+static CFDictionaryRef keyTypesByAlgorithmValue;
+
+static void
+KeyTypeTablesInitialize(void)
+{
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        CFMutableDictionaryRef byPointer = CFDictionaryCreateMutable(kCFAllocatorDefault, cKeyTypeAlgorithms, NULL, NULL);
+        CFMutableDictionaryRef byValue = CFDictionaryCreateMutable(kCFAllocatorDefault, cKeyTypeAlgorithms + 1, &kCFTypeDictionaryKeyCallBacks, NULL);
+        for (int keyType = LKKCKeyTypeUnknown + 1; keyType < cKeyTypeAlgorithms; keyType++) {
+            if (keyTypeAlgorithms[keyType] == NULL)
+                continue;
+            CFDictionarySetValue(byPointer, *keyTypeAlgorithms[keyType], (const void *)(uintptr_t)keyType);
+            CFDictionarySetValue(byValue, *keyTypeAlgorithms[keyType], (const void *)(uintptr_t)keyType);
+        }
+        // SecKeyGenerateSymmetric sets kSecAttrKeyType to CSSM_ALGID_3DES_3KEY_EDE for 3DES keys. (rdar://10617623)
+        CFDictionarySetValue(byValue, CFSTR("17"), (const void *)(uintptr_t)LKKCKeyType3DES);
+        keyTypesByAlgorithmPointer = byPointer;
+        keyTypesByAlgorithmValue = byValue;
+    });
+}
+
+BOOL
+LKKCRawKeyReaderReadKey(LKKCRawKeyReader *reader, SecKeyRef skey, CSSM_KEY *rawKey, NSError **error)
+{
+    bzero(rawKey, sizeof(*rawKey));
+    
+    CSSM_CSP_HANDLE csphandle = 0;
+    OSStatus status = SecKeyGetCSPHandle(skey, &csphandle);
+    if (status) {
+        LKKCReportError(status, error, @"Can't get CSP handle");
+        return NO;
+    }
+    
+    const CSSM_KEY *cssmkey = NULL;
+    status = SecKeyGetCSSMKey(skey, &cssmkey);
+    if (status) {
+        LKKCReportError(status, error, @"Can't get CSSM key");
+        return NO;
+    }
+    
+    const CSSM_ACCESS_CREDENTIALS *credentials = NULL;
+    status = SecKeyGetCredentials(skey, CSSM_ACL_AUTHORIZATION_EXPORT_CLEAR, kSecCredentialTypeDefault, &credentials);
+    if (status) {
+        LKKCReportError(status, error, @"Can't get credentials");
+        return NO;
+    }
+    
+    if (reader->cchandle != 0 && reader->csphandle != csphandle)
+        LKKCRawKeyReaderClose(reader);
+    if (reader->cchandle == 0) {
+        status = CSSM_CSP_CreateSymmetricContext(csphandle, CSSM_ALGID_NONE, CSSM_ALGMODE_NONE, credentials, NULL, NULL, CSSM_PADDING_NONE, NULL, &reader->cchandle);
+        if (status) {
+            LKKCReportError(status, error, @"Can't create wrapping context");
+            reader->cchandle = 0;
+            return NO;
+        }
+        reader->csphandle = csphandle;
+    }
+    
+    CSSM_DATA descriptiveData = { .Length = 0, .Data = NULL };
+    status = CSSM_WrapKey(reader->cchandle, credentials, cssmkey, &descriptiveData, rawKey);
+    if (status) {
+        LKKCReportError(status, error, @"Can't read key bits");
+        return NO;
+    }
+    if (rawKey->KeyHeader.BlobType != CSSM_KEYBLOB_RAW) {
+        LKKCRawKeyReaderFreeKey(reader, rawKey);
+        LKKCReportError(errSecUnsupportedFormat, error, @"Unexpected key format");
+        return NO;
+    }
+    return YES;
+}
+
+void
+LKKCRawKeyReaderFreeKey(LKKCRawKeyReader *reader, CSSM_KEY *rawKey)
+{
+    if (rawKey->KeyData.Data != NULL) {
+        LKKCWipe(rawKey->KeyData.Data, rawKey->KeyData.Length);
+        CSSM_FreeKey(reader->csphandle, NULL, rawKey, CSSM_FALSE);
+    }
+    bzero(rawKey, sizeof(*rawKey));
+}
+
+void
+LKKCRawKeyReaderClose(LKKCRawKeyReader *reader)
+{
+    if (reader->cchandle != 0)
+        CSSM_DeleteContext(reader->cchandle);
+    reader->cchandle = 0;
+    reader->csphandle = 0;
+}
+
+static void *
+LKKCCSSMMalloc(CSSM_SIZE size, void *allocRef)
+{
+    return malloc(size);
+}
+
+static void
+LKKCCSSMFree(void *block, void *allocRef)
+{
+    free(block);
+}
+
+static void *
+LKKCCSSMRealloc(void *block, CSSM_SIZE size, void *allocRef)
+{
+    return realloc(block, size);
+}
+
+static void *
+LKKCCSSMCalloc(uint32 count, CSSM_SIZE size, void *allocRef)
+{
+    return calloc(count, size);
+}
+
+// Key bits allocated on our attachment are freed by the Security framework with free(), so these must be malloc-based.
+static const CSSM_API_MEMORY_FUNCS LKKCCSSMMemoryFuncs = { LKKCCSSMMalloc, LKKCCSSMFree, LKKCCSSMRealloc, LKKCCSSMCalloc, NULL };
+static const CSSM_VERSION LKKCCSSMVersion = { 2, 0 };
+static const CSSM_GUID LKKCCSSMCallerGUID = { 0x4c4b4b43, 0x4b65, 0x7963, { 'L', 'K', 'K', 'e', 'y', 'c', 'h', 'n' } };
+
+CSSM_CSP_HANDLE
+LKKCAppleCSPHandle(NSError **error)
+{
+    static CSSM_CSP_HANDLE csphandle = 0;
+    static CSSM_RETURN crtn = CSSM_OK;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        CSSM_PVC_MODE pvcPolicy = CSSM_PVC_NONE;
+        crtn = CSSM_Init(&LKKCCSSMVersion, CSSM_PRIVILEGE_SCOPE_NONE, &LKKCCSSMCallerGUID, CSSM_KEY_HIERARCHY_NONE, &pvcPolicy, NULL);
+        if (crtn == CSSM_OK)
+            crtn = CSSM_ModuleLoad(&gGuidAppleCSP, CSSM_KEY_HIERARCHY_NONE, NULL, NULL);
+        if (crtn == CSSM_OK)
+            crtn = CSSM_ModuleAttach(&gGuidAppleCSP, &LKKCCSSMVersion, &LKKCCSSMMemoryFuncs, 0, CSSM_SERVICE_CSP, 0, 
+                                     CSSM_KEY_HIERARCHY_NONE, NULL, 0, NULL, &csphandle);
+    });
+    if (crtn != CSSM_OK) {
+        LKKCReportError(crtn, error, @"Can't attach to the Apple CSP");
+        return 0;
+    }
+    return csphandle;
+}
+
+// Wrap skey with AES Key Wrap (RFC 3394), using a context that was created on csphandle around the key encryption key.
+// CSSM can only wrap keys that belong to the context's CSP or raw keys, so keys from a different CSP 
+// (such as in-memory keys wrapped with a keychain key) are read out with reader first.
+static NSData *
+LKKCKeyWrapKey(CSSM_CC_HANDLE cchandle, CSSM_CSP_HANDLE csphandle, SecKeyRef skey, LKKCRawKeyReader *reader, NSError **error)
+{
+    CSSM_CSP_HANDLE keyCSPHandle = 0;
+    OSStatus status = SecKeyGetCSPHandle(skey, &keyCSPHandle);
+    if (status) {
+        LKKCReportError(status, error, @"Can't get CSP handle");
+        return nil;
+    }
+    
+    CSSM_KEY rawKey;
+    bzero(&rawKey, sizeof(rawKey));
+    const CSSM_KEY *cssmkey = NULL;
+    const CSSM_ACCESS_CREDENTIALS *credentials = NULL;
+    if (keyCSPHandle == csphandle) {
+        status = SecKeyGetCSSMKey(skey, &cssmkey);
+        if (status) {
+            LKKCReportError(status, error, @"Can't get CSSM key");
+            return nil;
+        }
+        status = SecKeyGetCredentials(skey, CSSM_ACL_AUTHORIZATION_EXPORT_WRAPPED, kSecCredentialTypeDefault, &credentials);
+        if (status) {
+            LKKCReportError(status, error, @"Can't get credentials");
+            return nil;
+        }
+    }
+    else {
+        if (!LKKCRawKeyReaderReadKey(reader, skey, &rawKey, error))
+            return nil;
+        cssmkey = &rawKey;
+    }
+    
+    NSData *result = nil;
+    uint32 length = cssmkey->KeyHeader.LogicalKeySizeInBits / 8;
+    if (length < 16 || length % 8 != 0) {
+        LKKCReportError(errSecParam, error, @"AES Key Wrap needs keys of at least 16 bytes, in 8-byte multiples");
+    }
+    else {
+        CSSM_KEY wrappedKey;
+        bzero(&wrappedKey, sizeof(wrappedKey));
+        CSSM_DATA descriptiveData = { .Length = 0, .Data = NULL };
+        status = CSSM_WrapKey(cchandle, credentials, cssmkey, &descriptiveData, &wrappedKey);
+        if (status) {
+            LKKCReportError(status, error, @"Can't wrap key");
+        }
+        else {
+            // RFC 3394 adds a single 64-bit integrity block.
+            if (wrappedKey.KeyData.Length == length + 8)
+                result = [NSData dataWithBytes:wrappedKey.KeyData.Data length:wrappedKey.KeyData.Length];
+            else
+                LKKCReportError(errSecUnsupportedFormat, error, @"Unexpected wrapped key format");
+            CSSM_FreeKey(csphandle, NULL, &wrappedKey, CSSM_FALSE);
+        }
+    }
+    if (cssmkey == &rawKey)
+        LKKCRawKeyReaderFreeKey(reader, &rawKey);
+    return result;
+}
+
+// Unwrap an AES Key Wrap (RFC 3394) blob into an in-memory key, using a context that was created on csphandle 
+// around the key encryption key. Returns nil if the blob fails the integrity check.
+static LKKCKey *
+LKKCKeyUnwrapKey(CSSM_CC_HANDLE cchandle, CSSM_CSP_HANDLE csphandle, NSData *data, LKKCKeyType keyType, UInt32 keySize)
+{
+    CSSM_KEY wrappedKey;
+    bzero(&wrappedKey, sizeof(wrappedKey));
+    wrappedKey.KeyHeader.HeaderVersion = CSSM_KEYHEADER_VERSION;
+    wrappedKey.KeyHeader.BlobType = CSSM_KEYBLOB_WRAPPED;
+    wrappedKey.KeyHeader.Format = CSSM_KEYBLOB_WRAPPED_FORMAT_NONE;
+    wrappedKey.KeyHeader.AlgorithmId = [LKKCKey _cssmAlgorithmFromLKKCKeyType:keyType];
+    wrappedKey.KeyHeader.KeyClass = CSSM_KEYCLASS_SESSION_KEY;
+    wrappedKey.KeyHeader.LogicalKeySizeInBits = keySize;
+    wrappedKey.KeyHeader.KeyAttr = CSSM_KEYATTR_EXTRACTABLE;
+    wrappedKey.KeyHeader.KeyUsage = CSSM_KEYUSE_ANY;
+    wrappedKey.KeyHeader.WrapAlgorithmId = CSSM_ALGID_AES;
+    wrappedKey.KeyHeader.WrapMode = CSSM_ALGMODE_WRAP;
+    wrappedKey.KeyData.Length = [data length];
+    wrappedKey.KeyData.Data = (uint8 *)[data bytes];
+    
+    // Like keyWithData:keyClass:keyType:keySize:, the result is a raw in-memory key.
+    CSSM_KEY cssmkey;
+    bzero(&cssmkey, sizeof(cssmkey));
+    CSSM_DATA keyLabel = { .Length = 9, .Data = (uint8 *)"unwrapped" };
+    CSSM_DATA descriptiveData = { .Length = 0, .Data = NULL };
+    CSSM_RETURN crtn = CSSM_UnwrapKey(cchandle, NULL, &wrappedKey, CSSM_KEYUSE_ANY, 
+                                      CSSM_KEYATTR_RETURN_DATA | CSSM_KEYATTR_EXTRACTABLE, 
+                                      &keyLabel, NULL, &cssmkey, &descriptiveData);
+    if (descriptiveData.Data != NULL)
+        free(descriptiveData.Data);
+    if (crtn)
+        return nil;
+    
+    // SecKeyCreateWithCSSMKey takes over the key bits.
+    SecKeyRef skey = NULL;
+    OSStatus status = errSecDecode;
+    if (cssmkey.KeyData.Length == keySize / 8)
+        status = SecKeyCreateWithCSSMKey(&cssmkey, &skey);
+    if (status) {
+        LKKCWipe(cssmkey.KeyData.Data, cssmkey.KeyData.Length);
+        CSSM_FreeKey(csphandle, NULL, &cssmkey, CSSM_FALSE);
+        return nil;
+    }
+    LKKCKey *key = [LKKCKey keyWithSecKey:skey];
+    CFRelease(skey);
+    return key;
+}
+
 @implementation LKKCKey
 
 + (CFTypeRef)_algorithmFromLKKCKeyType:(LKKCKeyType)keyType
 {
-    switch (keyType) {
-        case LKKCKeyTypeRSA:
-            return kSecAttrKeyTypeRSA;
-        case LKKCKeyTypeDSA:
-            return kSecAttrKeyTypeDSA;
-        case LKKCKeyTypeAES:
-            return kSecAttrKeyTypeAES;
-        case LKKCKeyTypeDES:
-            return kSecAttrKeyTypeDES;
-        case LKKCKeyType3DES:
-            return kSecAttrKeyType3DES;
-        case LKKCKeyTypeRC4:
-            return kSecAttrKeyTypeRC4;
-        case LKKCKeyTypeRC2:
-            return kSecAttrKeyTypeRC2;
-        case LKKCKeyTypeCAST:
-            return kSecAttrKeyTypeCAST;
-        case LKKCKeyTypeECDSA:
-            return kSecAttrKeyTypeECDSA;
-        case LKKCKeyTypeUnknown:
-        default:
-            return NULL;
-    }
+    if (keyType <= LKKCKeyTypeUnknown || keyType >= cKeyTypeAlgorithms || keyTypeAlgorithms[keyType] == NULL)
+        return NULL;
+    return *keyTypeAlgorithms[keyType];
 }
 
 + (CSSM_ALGORITHMS)_cssmAlgorithmFromLKKCKeyType:(LKKCKeyType)keyType
@@ -107,25 +447,14 @@ static NSString *LKKCAttrKeyID = @"LKKCKeyID";
 
 + (LKKCKeyType)_keyTypeFromAlgorithm:(CFTypeRef)algorithm
 {
-    if (CFEqual(algorithm, kSecAttrKeyTypeRSA))
-        return LKKCKeyTypeRSA;
-    if (CFEqual(algorithm, kSecAttrKeyTypeDSA))
-        return LKKCKeyTypeDSA;
-    if (CFEqual(algorithm, kSecAttrKeyTypeAES))
-        return LKKCKeyTypeAES;
-    if (CFEqual(algorithm, kSecAttrKeyTypeDES))
-        return LKKCKeyTypeDES;
-    if (CFEqual(algorithm, kSecAttrKeyType3DES) || CFEqual(algorithm, CFSTR("17"))) // CSSM_ALGID_3DES_3KEY_EDE
-        return LKKCKeyType3DES;
-    if (CFEqual(algorithm, kSecAttrKeyTypeRC4))
-        return LKKCKeyTypeRC4;
-    if (CFEqual(algorithm, kSecAttrKeyTypeRC2))
-        return LKKCKeyTypeRC2;
-    if (CFEqual(algorithm, kSecAttrKeyTypeCAST))
-        return LKKCKeyTypeCAST;
-    if (CFEqual(algorithm, kSecAttrKeyTypeECDSA))
-        return LKKCKeyTypeECDSA;
-    return LKKCKeyTypeUnknown;
+    if (algorithm == NULL)
+        return LKKCKeyTypeUnknown;
+    KeyTypeTablesInitialize();
+    // The values in these tables are LKKCKeyType values; LKKCKeyTypeUnknown is never stored.
+    LKKCKeyType keyType = (LKKCKeyType)(uintptr_t)CFDictionaryGetValue(keyTypesByAlgorithmPointer, algorithm);
+    if (keyType == LKKCKeyTypeUnknown)
+        keyType = (LKKCKeyType)(uintptr_t)CFDictionaryGetValue(keyTypesByAlgorithmValue, algorithm);
+    return keyType;
 }
 
 + (LKKCKeyType)_keyTypeFromCSSMAlgorithm:(CSSM_ALGORITHMS)algorithm
@@ -218,8 +547,19 @@ static NSString *LKKCAttrKeyID = @"LKKCKeyID";
                 keyClass:(LKKCKeyClass)keyClass
                  keyType:(LKKCKeyType)keyType 
                  keySize:(UInt32)keySize
+{
+    return [self _keyWithData:data keyClass:keyClass keyType:keyType keySize:keySize attributes:nil];
+}
+
++ (LKKCKey *)_keyWithData:(NSData *)data 
+                 keyClass:(LKKCKeyClass)keyClass
+                  keyType:(LKKCKeyType)keyType 
+                  keySize:(UInt32)keySize
+               attributes:(NSDictionary *)attributes
 {
     NSMutableDictionary *parameters = [NSMutableDictionary dictionary];
+    if (attributes != nil)
+        [parameters addEntriesFromDictionary:attributes];
     
     CFTypeRef skeyType = [[self class] _algorithmFromLKKCKeyType:keyType];
     if (skeyType == NULL) {
@@ -260,6 +600,16 @@ static NSString *LKKCAttrKeyID = @"LKKCKeyID";
     return key;
 }
 
+- (void)dealloc
+{
+    LKKCObjectPoolDestroy(_encryptionContexts);
+    LKKCObjectPoolDestroy(_decryptionContexts);
+    LKKCObjectPoolDestroy(_gcmContexts);
+    [_hmacContexts release];
+    free(_properties);
+    [super dealloc];
+}
+
 - (NSString *)description
 {
     NSMutableString *result = [NSMutableString string];
@@ -363,61 +713,155 @@ static NSString *LKKCAttrKeyID = @"LKKCKeyID";
     [self setAttribute:kSecAttrApplicationTag toValue:tag];
 }
 
-- (LKKCKeyClass)keyClass
+// Decode the immutable properties of this key, calling SecKeyGetCSSMKey at most once.
+// Returns NO if some of them couldn't be determined; the result mustn't be cached then.
+- (BOOL)_decodeProperties:(struct LKKCKeyProperties *)properties
 {
+    memset(properties, 0, sizeof(*properties));
     SecKeyRef skey = self.SecKey;
     if (skey == NULL)
-        return LKKCKeyClassUnknown;
-    CFTypeRef value = (CFTypeRef)[self valueForAttribute:kSecAttrKeyClass];
-    if (value == kSecAttrKeyClassSymmetric)
-        return LKKCKeyClassSymmetric;
-    if (value == kSecAttrKeyClassPublic)
-        return LKKCKeyClassPublic;
-    if (value == kSecAttrKeyClassPrivate)
-        return LKKCKeyClassPrivate;
-    if (value != NULL) // CSSM_KEYCLASS value as a string in "%d" format
-        return LKKCKeyClassUnknown;
-
-    const CSSM_KEY *cssmkey;
+        return NO;
+    
+    BOOL complete = YES;
+    const CSSM_KEY *cssmkey = NULL;
     OSStatus status = SecKeyGetCSSMKey(skey, &cssmkey);
     if (status) {
         LKKCReportError(status, NULL, @"Can't get CSSM key");
-        return LKKCKeyClassUnknown;
-    }
-    
-    switch (cssmkey->KeyHeader.KeyClass) {
-        case CSSM_KEYCLASS_PUBLIC_KEY:
-            return LKKCKeyClassPublic;
-        case CSSM_KEYCLASS_PRIVATE_KEY:
-            return LKKCKeyClassPrivate;
-        case CSSM_KEYCLASS_SESSION_KEY:
-            return LKKCKeyClassSymmetric;
-        case CSSM_KEYCLASS_SECRET_PART:
-        case CSSM_KEYCLASS_OTHER:
+        cssmkey = NULL;
+    }
+    
+    CFTypeRef value = (CFTypeRef)[self valueForAttribute:kSecAttrKeyClass];
+    if (value == kSecAttrKeyClassSymmetric)
+        properties->keyClass = LKKCKeyClassSymmetric;
+    else if (value == kSecAttrKeyClassPublic)
+        properties->keyClass = LKKCKeyClassPublic;
+    else if (value == kSecAttrKeyClassPrivate)
+        properties->keyClass = LKKCKeyClassPrivate;
+    else if (value != NULL) // CSSM_KEYCLASS value as a string in "%d" format
+        properties->keyClass = LKKCKeyClassUnknown;
+    else if (cssmkey == NULL)
+        complete = NO;
+    else {
+        switch (cssmkey->KeyHeader.KeyClass) {
+            case CSSM_KEYCLASS_PUBLIC_KEY:
+                properties->keyClass = LKKCKeyClassPublic;
+                break;
+            case CSSM_KEYCLASS_PRIVATE_KEY:
+                properties->keyClass = LKKCKeyClassPrivate;
+                break;
+            case CSSM_KEYCLASS_SESSION_KEY:
+                properties->keyClass = LKKCKeyClassSymmetric;
+                break;
+            case CSSM_KEYCLASS_SECRET_PART:
+            case CSSM_KEYCLASS_OTHER:
+            default:
+                properties->keyClass = LKKCKeyClassUnknown;
+                break;
+        }
+    }
+    
+    // value is a CSSM_ALGORITHM value as a CFString in "%d" format
+    value = (CFTypeRef)[self valueForAttribute:kSecAttrKeyType];
+    if (value != NULL)
+        properties->keyType = [[self class] _keyTypeFromAlgorithm:value];
+    else if (cssmkey != NULL)
+        properties->keyType = [[self class] _keyTypeFromCSSMAlgorithm:cssmkey->KeyHeader.AlgorithmId];
+    else
+        complete = NO;
+    
+    NSNumber *size = [self valueForAttribute:kSecAttrKeySizeInBits];
+    if (size != nil)
+        properties->keySize = [size intValue];
+    else if (cssmkey != NULL)
+        properties->keySize = cssmkey->KeyHeader.LogicalKeySizeInBits;
+    else
+        complete = NO;
+    
+    size = [self valueForAttribute:kSecAttrEffectiveKeySize];
+    if (size != nil)
+        properties->effectiveKeySize = [size intValue];
+    else {
+        properties->effectiveKeySize = properties->keySize;
+        CSSM_CSP_HANDLE cspHandle;
+        CSSM_KEY_SIZE keySize;
+        if (cssmkey == NULL)
+            complete = NO;
+        else if ((status = SecKeyGetCSPHandle(skey, &cspHandle))) {
+            LKKCReportError(status, NULL, @"Can't get CSP handle");
+            complete = NO;
+        }
+        else if ((status = CSSM_QueryKeySizeInBits(cspHandle, 0, cssmkey, &keySize)) != CSSM_OK) {
+            LKKCReportError(status, NULL, @"Can't get key size");
+            complete = NO;
+        }
+        else
+            properties->effectiveKeySize = keySize.EffectiveKeySizeInBits;
+    }
+    
+    for (int i = 0; i < cKeyUsageAttributes; i++) {
+        value = (CFTypeRef)[self valueForAttribute:*keyUsageAttributes[i]];
+        if (value == kCFBooleanTrue)
+            properties->usage |= keyUsageFlags[i];
+        else if (value == kCFBooleanFalse)
+            continue;
+        else if (cssmkey == NULL)
+            complete = NO;
+        else if ((cssmkey->KeyHeader.KeyUsage & (keyUsageFlags[i] | CSSM_KEYUSE_ANY)) != 0)
+            properties->usage |= keyUsageFlags[i];
+    }
+    
+    switch (properties->keyType) {
+        case LKKCKeyTypeAES:
+            properties->blockSize = 16;
+            break;
+        case LKKCKeyTypeDES:
+        case LKKCKeyType3DES:
+        case LKKCKeyTypeCAST:
+        case LKKCKeyTypeRC2:
+            properties->blockSize = 8;
+            break;
+        case LKKCKeyTypeRC4:
+            properties->blockSize = 1;
+            break;
+        case LKKCKeyTypeDSA:
+        case LKKCKeyTypeECDSA:
+        case LKKCKeyTypeRSA:
         default:
-            return LKKCKeyClassUnknown;
+            // BUG: SecKeyGetBlockSize returns the logical key size in bits, not the bock size in bytes.
+            properties->blockSize = (SecKeyGetBlockSize(skey) + 7) / 8;
+            break;
     }
+    
+    return complete;
 }
 
-- (LKKCKeyType)keyType
+- (void)_getProperties:(struct LKKCKeyProperties *)properties
 {
-    SecKeyRef skey = self.SecKey;
-    if (skey == NULL)
-        return LKKCKeyTypeUnknown;
-    CFTypeRef value = (CFTypeRef)[self valueForAttribute:kSecAttrKeyType];
+    struct LKKCKeyProperties *cached = _properties;
+    if (cached != NULL && _sitem != NULL) {
+        *properties = *cached;
+        return;
+    }
+    if (![self _decodeProperties:properties])
+        return;
+    cached = malloc(sizeof(*cached));
+    *cached = *properties;
+    if (!OSAtomicCompareAndSwapPtrBarrier(NULL, cached, (void * volatile *)&_properties))
+        free(cached);
+}
 
-    // value is a CSSM_ALGORITHM value as a CFString in "%d" format
-    if (value != NULL)
-        return [[self class] _keyTypeFromAlgorithm:value];
+- (LKKCKeyClass)keyClass
+{
+    struct LKKCKeyProperties properties;
+    [self _getProperties:&properties];
+    return properties.keyClass;
+}
 
-    const CSSM_KEY *cssmkey;
-    OSStatus status = SecKeyGetCSSMKey(skey, &cssmkey);
-    if (status) {
-        LKKCReportError(status, NULL, @"Can't get CSSM key");
-        return LKKCKeyTypeUnknown;
-    }
-    
-    return [[self class] _keyTypeFromCSSMAlgorithm:cssmkey->KeyHeader.AlgorithmId];
+- (LKKCKeyType)keyType
+{
+    struct LKKCKeyProperties properties;
+    [self _getProperties:&properties];
+    return properties.keyType;
 }
 
 - (BOOL)_getBooleanAttribute:(CFTypeRef)attribute flag:(CSSM_KEYATTR_FLAGS)flag use:(CSSM_KEYUSE)use
@@ -453,37 +897,51 @@ static NSString *LKKCAttrKeyID = @"LKKCKeyID";
 
 - (BOOL)canEncrypt
 {
-    return [self _getBooleanAttribute:kSecAttrCanEncrypt flag:0 use:CSSM_KEYUSE_ENCRYPT];
+    struct LKKCKeyProperties properties;
+    [self _getProperties:&properties];
+    return (properties.usage & CSSM_KEYUSE_ENCRYPT) != 0;
 }
 
 - (BOOL)canDecrypt
 {
-    return [self _getBooleanAttribute:kSecAttrCanDecrypt flag:0 use:CSSM_KEYUSE_DECRYPT];
+    struct LKKCKeyProperties properties;
+    [self _getProperties:&properties];
+    return (properties.usage & CSSM_KEYUSE_DECRYPT) != 0;
 }
 
 - (BOOL)canDerive
 {
-    return [self _getBooleanAttribute:kSecAttrCanDerive flag:0 use:CSSM_KEYUSE_DERIVE];
+    struct LKKCKeyProperties properties;
+    [self _getProperties:&properties];
+    return (properties.usage & CSSM_KEYUSE_DERIVE) != 0;
 }
 
 - (BOOL)canSign
 {
-    return [self _getBooleanAttribute:kSecAttrCanSign flag:0 use:CSSM_KEYUSE_SIGN];
+    struct LKKCKeyProperties properties;
+    [self _getProperties:&properties];
+    return (properties.usage & CSSM_KEYUSE_SIGN) != 0;
 }
 
 - (BOOL)canVerify
 {
-    return [self _getBooleanAttribute:kSecAttrCanVerify flag:0 use:CSSM_KEYUSE_VERIFY];
+    struct LKKCKeyProperties properties;
+    [self _getProperties:&properties];
+    return (properties.usage & CSSM_KEYUSE_VERIFY) != 0;
 }
 
 - (BOOL)canWrap
 {
-    return [self _getBooleanAttribute:kSecAttrCanWrap flag:0 use:CSSM_KEYUSE_WRAP];
+    struct LKKCKeyProperties properties;
+    [self _getProperties:&properties];
+    return (properties.usage & CSSM_KEYUSE_WRAP) != 0;
 }
 
 - (BOOL)canUnwrap
 {
-    return [self _getBooleanAttribute:kSecAttrCanUnwrap flag:0 use:CSSM_KEYUSE_UNWRAP];
+    struct LKKCKeyProperties properties;
+    [self _getProperties:&properties];
+    return (properties.usage & CSSM_KEYUSE_UNWRAP) != 0;
 }
 
 - (BOOL)_getCSSMKeySize:(CSSM_KEY_SIZE_PTR)keySize
@@ -517,56 +975,16 @@ static NSString *LKKCAttrKeyID = @"LKKCKeyID";
 
 - (int)keySize
 {
-    NSNumber *value = [self valueForAttribute:kSecAttrKeySizeInBits];
-    if (value != nil)
-        return [value intValue];
-    
-    SecKeyRef skey = self.SecKey;
-    if (skey == NULL)
-        return 0;
-
-    const CSSM_KEY *cssmkey;
-    OSStatus status = SecKeyGetCSSMKey(skey, &cssmkey);
-    if (status) {
-        LKKCReportError(status, NULL, @"Can't get CSSM key");
-        return 0;
-    }
-    
-    return cssmkey->KeyHeader.LogicalKeySizeInBits;
+    struct LKKCKeyProperties properties;
+    [self _getProperties:&properties];
+    return properties.keySize;
 }
 
 - (int)effectiveKeySize
 {
-    NSNumber *value = [self valueForAttribute:kSecAttrEffectiveKeySize];
-    if (value != nil)
-        return [value intValue];
-
-    SecKeyRef skey = self.SecKey;
-    if (skey == NULL)
-        return self.keySize;
-    
-    CSSM_CSP_HANDLE cspHandle;
-    OSStatus status = SecKeyGetCSPHandle(skey, &cspHandle);
-    if (status) {
-        LKKCReportError(status, NULL, @"Can't get CSP handle");
-        return self.keySize;
-    }
-    
-    const CSSM_KEY *cssmkey;
-    status = SecKeyGetCSSMKey(skey, &cssmkey);
-    if (status) {
-        LKKCReportError(status, NULL, @"Can't get CSSM key");
-        return self.keySize;
-    }
-    
-    CSSM_KEY_SIZE keySize;
-    status = CSSM_QueryKeySizeInBits(cspHandle, 0, cssmkey, &keySize);
-    if (status != CSSM_OK) {
-        LKKCReportError(status, NULL, @"Can't get key size");
-        return self.keySize;
-    }
-    
-    return keySize.EffectiveKeySizeInBits;
+    struct LKKCKeyProperties properties;
+    [self _getProperties:&properties];
+    return properties.effectiveKeySize;
 }
 
 - (SecKeyRef)SecKey
@@ -625,14 +1043,7 @@ static NSString *LKKCAttrKeyID = @"LKKCKeyID";
 
 - (SecAccessRef)access
 {
-    SecAccessRef saccess = NULL;
-    OSStatus status = SecAccessCreate((CFStringRef)self.label, NULL /* current app */, &saccess);
-    if (status) {
-        LKKCReportError(status, NULL, @"Can't create access object for newly generated key");
-        return nil;
-    }
-    [(id)saccess autorelease];
-    return saccess;
+    return [LKKCKeychainItem sharedAccessWithLabel:self.label trustedApplications:nil /* current app */ error:NULL];
 }
 
 - (BOOL)addToKeychain:(LKKCKeychain *)keychain error:(NSError **)error
@@ -643,6 +1054,8 @@ static NSString *LKKCAttrKeyID = @"LKKCKeyID";
         [_updatedAttributes removeObjectForKey:kSecAttrApplicationTag];
     }
     
+    // Adding the key replaces its SecKey.
+    [self _flushCryptoContexts];
     BOOL res = [super addToKeychain:keychain error:error];
 
     if (applicationTag != nil) {
@@ -655,6 +1068,12 @@ static NSString *LKKCAttrKeyID = @"LKKCKeyID";
     return [self saveItemWithError:error];
 }
 
+- (BOOL)deleteItemWithError:(NSError **)error
+{
+    [self _flushCryptoContexts];
+    return [super deleteItemWithError:error];
+}
+
 - (BOOL)saveItemWithError:(NSError **)error
 {
     if (_sitem == nil) {
@@ -719,23 +1138,9 @@ static NSString *LKKCAttrKeyID = @"LKKCKeyID";
 
 - (size_t)blockSize
 {
-    switch (self.keyType) {
-        case LKKCKeyTypeAES:
-            return 16;
-        case LKKCKeyTypeDES:
-        case LKKCKeyType3DES:
-        case LKKCKeyTypeCAST:
-        case LKKCKeyTypeRC2:
-            return 8;
-        case LKKCKeyTypeRC4:
-            return 1;
-        case LKKCKeyTypeDSA:
-        case LKKCKeyTypeECDSA:
-        case LKKCKeyTypeRSA:
-        default:
-            // BUG: SecKeyGetBlockSize returns the logical key size in bits, not the bock size in bytes.
-            return (SecKeyGetBlockSize(self.SecKey) + 7) / 8;
-    }
+    struct LKKCKeyProperties properties;
+    [self _getProperties:&properties];
+    return properties.blockSize;
 }
 
 - (NSData *)randomInitVector
@@ -743,47 +1148,750 @@ static NSString *LKKCAttrKeyID = @"LKKCKeyID";
     size_t blockSize = self.blockSize;
     if (blockSize < 2 || self.keyClass != LKKCKeyClassSymmetric)
         return nil;
-    char *buf[blockSize];
-    arc4random_buf(&buf, blockSize);
-    return [NSData dataWithBytes:buf length:blockSize];
+    NSMutableData *iv = [NSMutableData dataWithLength:blockSize];
+    LKKCRandomBytes([iv mutableBytes], blockSize);
+    return iv;
+}
+
+- (LKKCCryptoContext *)_checkOutCryptoContextForOperation:(CSSM_ACL_AUTHORIZATION_TAG)operation initVector:(NSData *)iv error:(NSError **)error
+{
+    LKKCObjectPool *pool = (operation == CSSM_ACL_AUTHORIZATION_ENCRYPT ? _encryptionContexts : _decryptionContexts);
+    LKKCCryptoContext *cc = (pool != NULL ? LKKCObjectPoolCheckOut(pool) : nil);
+    if (cc != nil && cc.SecKey == self.SecKey && [cc resetWithInitVector:iv error:NULL])
+        return cc;
+    return [LKKCCryptoContext cryptoContextForKey:self operation:operation initVector:iv error:error];
+}
+
+- (void)_checkInCryptoContext:(LKKCCryptoContext *)cc operation:(CSSM_ACL_AUTHORIZATION_TAG)operation
+{
+    // Contexts checked out before the key was added or deleted are stale.
+    if (cc.SecKey != self.SecKey)
+        return;
+    LKKCObjectPool *volatile *pool = (operation == CSSM_ACL_AUTHORIZATION_ENCRYPT ? &_encryptionContexts : &_decryptionContexts);
+    LKKCObjectPoolCheckIn(LKKCObjectPoolGet(pool, LKKCKeyCryptoContextPoolCapacity()), cc);
+}
+
+- (void)_flushCryptoContexts
+{
+    LKKCObjectPoolDrain(_encryptionContexts);
+    LKKCObjectPoolDrain(_decryptionContexts);
+    LKKCObjectPoolDrain(_gcmContexts);
+    @synchronized(self) {
+        [_hmacContexts removeAllObjects];
+    }
 }
 
 - (NSData *)encryptData:(NSData *)plaintext initVector:(NSData *)iv error:(NSError **)error
 {
-    NSData *result = nil;
-    @autoreleasepool {
-        LKKCCryptoContext *cc = [LKKCCryptoContext cryptoContextForKey:self
-                                                             operation:CSSM_ACL_AUTHORIZATION_ENCRYPT
-                                                            initVector:iv 
-                                                                 error:error];
+    LKKCCryptoContext *cc = [self _checkOutCryptoContextForOperation:CSSM_ACL_AUTHORIZATION_ENCRYPT initVector:iv error:error];
+    if (cc == nil)
+        return nil;
+    NSData *result = [cc encryptData:plaintext error:error];
+    if (result != nil)
+        [self _checkInCryptoContext:cc operation:CSSM_ACL_AUTHORIZATION_ENCRYPT];
+    return result;
+}
+
+- (NSData *)decryptData:(NSData *)ciphertext initVector:(NSData *)iv error:(NSError **)error
+{
+    if ([ciphertext length] >= LKKCKeyParallelDecryptionThreshold && self.keyClass == LKKCKeyClassSymmetric && self.blockSize > 1)
+        return [self decryptDataInParallel:ciphertext initVector:iv error:error];
+    LKKCCryptoContext *cc = [self _checkOutCryptoContextForOperation:CSSM_ACL_AUTHORIZATION_DECRYPT initVector:iv error:error];
+    if (cc == nil)
+        return nil;
+    NSData *result = [cc decryptData:ciphertext error:error];
+    if (result != nil)
+        [self _checkInCryptoContext:cc operation:CSSM_ACL_AUTHORIZATION_DECRYPT];
+    return result;
+}
+
+- (size_t)encryptedLengthForPlaintextLength:(size_t)length
+{
+    size_t blockSize = self.blockSize;
+    if (self.keyClass != LKKCKeyClassSymmetric)
+        return blockSize;
+    if (blockSize < 2)
+        return length;
+    // Block ciphers always add PKCS#7 padding; a full block of it if the length is already aligned.
+    return (length / blockSize + 1) * blockSize;
+}
+
+- (BOOL)encryptBatch:(const LKKCCryptoBatchItem *)items count:(NSUInteger)count output:(void *)output capacity:(size_t)capacity offsets:(size_t *)offsets error:(NSError **)error
+{
+    if (count == 0) {
+        offsets[0] = 0;
+        return YES;
+    }
+    NSData *iv = (items[0].initVector != NULL ? [NSData dataWithBytes:items[0].initVector length:self.blockSize] : nil);
+    LKKCCryptoContext *cc = [self _checkOutCryptoContextForOperation:CSSM_ACL_AUTHORIZATION_ENCRYPT initVector:iv error:error];
+    if (cc == nil)
+        return NO;
+    BOOL result = [cc encryptBatch:items count:count output:output capacity:capacity offsets:offsets error:error];
+    if (result)
+        [self _checkInCryptoContext:cc operation:CSSM_ACL_AUTHORIZATION_ENCRYPT];
+    return result;
+}
+
+- (BOOL)decryptBatch:(const LKKCCryptoBatchItem *)items count:(NSUInteger)count output:(void *)output capacity:(size_t)capacity offsets:(size_t *)offsets error:(NSError **)error
+{
+    if (count == 0) {
+        offsets[0] = 0;
+        return YES;
+    }
+    NSData *iv = (items[0].initVector != NULL ? [NSData dataWithBytes:items[0].initVector length:self.blockSize] : nil);
+    LKKCCryptoContext *cc = [self _checkOutCryptoContextForOperation:CSSM_ACL_AUTHORIZATION_DECRYPT initVector:iv error:error];
+    if (cc == nil)
+        return NO;
+    BOOL result = [cc decryptBatch:items count:count output:output capacity:capacity offsets:offsets error:error];
+    if (result)
+        [self _checkInCryptoContext:cc operation:CSSM_ACL_AUTHORIZATION_DECRYPT];
+    return result;
+}
+
+- (NSData *)decryptDataInParallel:(NSData *)ciphertext initVector:(NSData *)iv error:(NSError **)error
+{
+    size_t blockSize = self.blockSize;
+    size_t length = [ciphertext length];
+    if (self.keyClass != LKKCKeyClassSymmetric || blockSize < 2 || length < 2 * blockSize)
+        return [self decryptData:ciphertext initVector:iv error:error];
+    if (length % blockSize != 0 || [iv length] != blockSize) {
+        LKKCReportError(errSecParam, error, @"Invalid ciphertext or initialization vector length");
+        return nil;
+    }
+    
+    // Split the ciphertext into a few chunks per core, at block boundaries.
+    size_t blocks = length / blockSize;
+    size_t chunkBlocks = MAX(LKKCKeyParallelDecryptionMinimumChunk / blockSize, blocks / (4 * [[NSProcessInfo processInfo] activeProcessorCount]) + 1);
+    NSUInteger chunks = (blocks + chunkBlocks - 1) / chunkBlocks;
+    const uint8_t *input = [ciphertext bytes];
+    NSMutableData *result = [NSMutableData dataWithLength:length];
+    uint8_t *output = [result mutableBytes];
+    
+    // The last chunk carries the padding, so it is decrypted by a regular padded context.
+    size_t lastOffset = (chunks - 1) * chunkBlocks * blockSize;
+    NSData *lastIV = (chunks > 1 ? [NSData dataWithBytes:input + lastOffset - blockSize length:blockSize] : iv);
+    LKKCCryptoContext *padded = [self _checkOutCryptoContextForOperation:CSSM_ACL_AUTHORIZATION_DECRYPT initVector:lastIV error:error];
+    if (padded == nil)
+        return nil;
+    size_t lastLength = 0;
+    if (![padded decryptBytes:input + lastOffset length:length - lastOffset output:output + lastOffset capacity:length - lastOffset outputLength:&lastLength error:error])
+        return nil;
+    [self _checkInCryptoContext:padded operation:CSSM_ACL_AUTHORIZATION_DECRYPT];
+    
+    // Other chunks are decrypted without padding, so their plaintext is exactly as long as their ciphertext.
+    NSError *failure = nil;
+    BOOL success = LKKCParallelApply(chunks - 1, ^id(NSError **e) {
+        return [LKKCCryptoContext _cryptoContextForKey:self 
+                                             operation:CSSM_ACL_AUTHORIZATION_DECRYPT 
+                                                  mode:CSSM_ALGMODE_CBC_IV8 
+                                               padding:CSSM_PADDING_NONE 
+                                            initVector:iv 
+                                                 error:e];
+    }, ^BOOL(id cc, NSUInteger chunk, NSError **e) {
+        size_t offset = chunk * chunkBlocks * blockSize;
+        size_t chunkLength = chunkBlocks * blockSize;
+        if (chunk > 0) {
+            NSData *chunkIV = [NSData dataWithBytesNoCopy:(void *)(input + offset - blockSize) length:blockSize freeWhenDone:NO];
+            if (![cc resetWithInitVector:chunkIV error:e])
+                return NO;
+        }
+        else if (![cc resetWithInitVector:iv error:e]) 
+            return NO;
+        return [cc decryptBytes:input + offset length:chunkLength output:output + offset capacity:chunkLength outputLength:NULL error:e];
+    }, nil, &failure);
+    if (!success) {
+        LKKCReportErrorObj(failure, error, @"Can't decrypt data");
+        return nil;
+    }
+    
+    [result setLength:lastOffset + lastLength];
+    return result;
+}
+
+#pragma mark - Authenticated Encryption
+
+- (LKKCGCMContext *)_checkOutGCMContextWithError:(NSError **)error
+{
+    LKKCGCMContext *gcm = (_gcmContexts != NULL ? LKKCObjectPoolCheckOut(_gcmContexts) : nil);
+    if (gcm != nil && gcm.SecKey == self.SecKey)
+        return gcm;
+    return [LKKCGCMContext gcmContextForKey:self error:error];
+}
+
+- (void)_checkInGCMContext:(LKKCGCMContext *)gcm
+{
+    if (gcm.SecKey != self.SecKey)
+        return;
+    LKKCObjectPoolCheckIn(LKKCObjectPoolGet(&_gcmContexts, LKKCKeyCryptoContextPoolCapacity()), gcm);
+}
+
+- (NSData *)randomNonce
+{
+    NSMutableData *nonce = [NSMutableData dataWithLength:LKKCGCMNonceLength];
+    LKKCRandomBytes([nonce mutableBytes], LKKCGCMNonceLength);
+    return nonce;
+}
+
+- (NSData *)encryptData:(NSData *)plaintext nonce:(NSData *)nonce additionalData:(NSData *)additionalData tag:(NSData **)tag error:(NSError **)error
+{
+    LKKCGCMContext *gcm = [self _checkOutGCMContextWithError:error];
+    if (gcm == nil)
+        return nil;
+    NSMutableData *ciphertext = [NSMutableData dataWithLength:[plaintext length]];
+    uint8_t tagBytes[LKKCGCMTagLength];
+    BOOL result = [gcm encryptBytes:[plaintext bytes] 
+                             length:[plaintext length] 
+                             output:[ciphertext mutableBytes] 
+                              nonce:[nonce bytes] 
+                        nonceLength:[nonce length] 
+                     additionalData:[additionalData bytes] 
+               additionalDataLength:[additionalData length] 
+                                tag:tagBytes 
+                              error:error];
+    if (!result)
+        return nil;
+    [self _checkInGCMContext:gcm];
+    if (tag != NULL)
+        *tag = [NSData dataWithBytes:tagBytes length:sizeof(tagBytes)];
+    return ciphertext;
+}
+
+- (NSData *)decryptData:(NSData *)ciphertext nonce:(NSData *)nonce additionalData:(NSData *)additionalData tag:(NSData *)tag error:(NSError **)error
+{
+    if ([tag length] != LKKCGCMTagLength) {
+        LKKCReportError(errSecParam, error, @"Invalid authentication tag length");
+        return nil;
+    }
+    LKKCGCMContext *gcm = [self _checkOutGCMContextWithError:error];
+    if (gcm == nil)
+        return nil;
+    NSMutableData *plaintext = [NSMutableData dataWithLength:[ciphertext length]];
+    BOOL result = [gcm decryptBytes:[ciphertext bytes] 
+                             length:[ciphertext length] 
+                             output:[plaintext mutableBytes] 
+                              nonce:[nonce bytes] 
+                        nonceLength:[nonce length] 
+                     additionalData:[additionalData bytes] 
+               additionalDataLength:[additionalData length] 
+                                tag:[tag bytes] 
+                              error:error];
+    // A failed authentication doesn't make the context unusable.
+    [self _checkInGCMContext:gcm];
+    if (!result)
+        return nil;
+    return plaintext;
+}
+
+#pragma mark - Parallel Authenticated Encryption
+
+static NSUInteger
+SegmentCount(uint64_t length, uint32_t segmentSize)
+{
+    // Empty messages still have one (empty) segment so that their header is authenticated.
+    if (length == 0)
+        return 1;
+    return (NSUInteger)((length + segmentSize - 1) / segmentSize);
+}
+
+- (BOOL)_processSegments:(NSUInteger)count 
+                 encrypt:(BOOL)encrypt 
+                  header:(const uint8_t *)header 
+                   input:(const uint8_t *)input 
+                  output:(uint8_t *)output 
+                  length:(uint64_t)length 
+             segmentSize:(uint32_t)segmentSize 
+                   error:(NSError **)error
+{
+    NSError *failure = nil;
+    BOOL result = LKKCParallelApply(count, ^id(NSError **e) {
+        return [self _checkOutGCMContextWithError:e];
+    }, ^BOOL(id gcm, NSUInteger i, NSError **e) {
+        uint64_t offset = (uint64_t)i * segmentSize;
+        size_t segmentLength = (size_t)MIN(segmentSize, length - offset);
+        uint8_t nonce[LKKCGCMNonceLength];
+        memcpy(nonce, header + LKKCSegmentedHeaderLength - 8, 8);
+        OSWriteBigInt32(nonce, 8, (uint32_t)i);
+        // Encrypted segments are followed by their tags.
+        uint8_t *sealed = (uint8_t *)(encrypt ? output : input) + (uint64_t)i * (segmentSize + LKKCGCMTagLength);
+        if (encrypt) {
+            return [gcm encryptBytes:input + offset length:segmentLength output:sealed 
+                               nonce:nonce nonceLength:sizeof(nonce) 
+                      additionalData:header additionalDataLength:LKKCSegmentedHeaderLength 
+                                 tag:sealed + segmentLength error:e];
+        }
+        return [gcm decryptBytes:sealed length:segmentLength output:output + offset 
+                           nonce:nonce nonceLength:sizeof(nonce) 
+                  additionalData:header additionalDataLength:LKKCSegmentedHeaderLength 
+                             tag:sealed + segmentLength error:e];
+    }, ^(id gcm) {
+        [self _checkInGCMContext:gcm];
+    }, &failure);
+    if (!result) {
+        LKKCReportErrorObj(failure, error, (encrypt ? @"Can't encrypt segment" : @"Can't decrypt segment"));
+        return NO;
+    }
+    return YES;
+}
+
+- (NSData *)encryptDataInParallel:(NSData *)plaintext error:(NSError **)error
+{
+    return [self encryptDataInParallel:plaintext segmentSize:LKKCSegmentedDefaultSegmentSize error:error];
+}
+
+- (NSData *)encryptDataInParallel:(NSData *)plaintext segmentSize:(uint32_t)segmentSize error:(NSError **)error
+{
+    uint64_t length = [plaintext length];
+    if (segmentSize == 0 || length / segmentSize >= UINT32_MAX) {
+        LKKCReportError(errSecParam, error, @"Invalid segment size");
+        return nil;
+    }
+    NSUInteger count = SegmentCount(length, segmentSize);
+    NSMutableData *result = [NSMutableData dataWithLength:LKKCSegmentedHeaderLength + length + count * LKKCGCMTagLength];
+    uint8_t *header = [result mutableBytes];
+    memcpy(header, LKKCSegmentedMagic, 4);
+    header[4] = LKKCSegmentedVersion;
+    OSWriteBigInt32(header, 8, segmentSize);
+    OSWriteBigInt64(header, 12, length);
+    LKKCRandomBytes(header + 20, 8);
+    
+    if (![self _processSegments:count 
+                        encrypt:YES 
+                         header:header 
+                          input:[plaintext bytes] 
+                         output:header + LKKCSegmentedHeaderLength 
+                         length:length 
+                    segmentSize:segmentSize 
+                          error:error])
+        return nil;
+    return result;
+}
+
+- (NSData *)decryptDataInParallel:(NSData *)ciphertext error:(NSError **)error
+{
+    const uint8_t *header = [ciphertext bytes];
+    if ([ciphertext length] < LKKCSegmentedHeaderLength 
+        || memcmp(header, LKKCSegmentedMagic, 4) != 0 
+        || header[4] != LKKCSegmentedVersion) {
+        LKKCReportError(errSecDecode, error, @"Invalid segmented ciphertext header");
+        return nil;
+    }
+    uint32_t segmentSize = OSReadBigInt32(header, 8);
+    uint64_t length = OSReadBigInt64(header, 12);
+    if (segmentSize == 0 || length / segmentSize >= UINT32_MAX || length > [ciphertext length]) {
+        LKKCReportError(errSecDecode, error, @"Invalid segmented ciphertext header");
+        return nil;
+    }
+    NSUInteger count = SegmentCount(length, segmentSize);
+    if ([ciphertext length] != LKKCSegmentedHeaderLength + length + count * LKKCGCMTagLength) {
+        LKKCReportError(errSecDecode, error, @"Segmented ciphertext has invalid length");
+        return nil;
+    }
+    
+    NSMutableData *result = [NSMutableData dataWithLength:(NSUInteger)length];
+    if (![self _processSegments:count 
+                        encrypt:NO 
+                         header:header 
+                          input:header + LKKCSegmentedHeaderLength 
+                         output:[result mutableBytes] 
+                         length:length 
+                    segmentSize:segmentSize 
+                          error:error])
+        return nil;
+    return result;
+}
+
+#pragma mark - Message Authentication
+
+- (LKKCDigestContext *)_checkOutHMACContextWithDigestAlgorithm:(LKKCDigestAlgorithm)digestAlgorithm error:(NSError **)error
+{
+    LKKCDigestContext *hmac = nil;
+    @synchronized(self) {
+        for (NSUInteger i = [_hmacContexts count]; i > 0; i--) {
+            LKKCDigestContext *candidate = [_hmacContexts objectAtIndex:i - 1];
+            if (candidate.digestAlgorithm == digestAlgorithm) {
+                hmac = [[candidate retain] autorelease];
+                [_hmacContexts removeObjectAtIndex:i - 1];
+                break;
+            }
+        }
+    }
+    if (hmac != nil && hmac.SecKey == self.SecKey)
+        return hmac;
+    return [LKKCDigestContext hmacContextForKey:self digestAlgorithm:digestAlgorithm error:error];
+}
+
+- (void)_checkInHMACContext:(LKKCDigestContext *)hmac
+{
+    @synchronized(self) {
+        if (hmac.SecKey != self.SecKey)
+            return;
+        if (_hmacContexts == nil)
+            _hmacContexts = [[NSMutableArray alloc] initWithCapacity:LKKCKeyMaxIdleCryptoContexts];
+        if ([_hmacContexts count] < LKKCKeyMaxIdleCryptoContexts)
+            [_hmacContexts addObject:hmac];
+    }
+}
+
+- (NSData *)hmacForData:(NSData *)data digestAlgorithm:(LKKCDigestAlgorithm)digestAlgorithm error:(NSError **)error
+{
+    LKKCDigestContext *hmac = [self _checkOutHMACContextWithDigestAlgorithm:digestAlgorithm error:error];
+    if (hmac == nil)
+        return nil;
+    NSData *result = [hmac digestData:data];
+    [self _checkInHMACContext:hmac];
+    return result;
+}
+
+- (BOOL)verifyHMAC:(NSData *)hmac forData:(NSData *)data digestAlgorithm:(LKKCDigestAlgorithm)digestAlgorithm error:(NSError **)error
+{
+    LKKCDigestContext *context = [self _checkOutHMACContextWithDigestAlgorithm:digestAlgorithm error:error];
+    if (context == nil)
+        return NO;
+    [context updateWithData:data];
+    BOOL valid = [context finishAndVerifyDigest:hmac];
+    [self _checkInHMACContext:context];
+    if (!valid) {
+        // Invalid HMACs are routine; don't log them.
+        if (error != NULL)
+            *error = [NSError errorWithDomain:(NSString *)LKKCErrorDomain code:CSSMERR_CSP_VERIFY_FAILED userInfo:nil];
+        return NO;
+    }
+    return YES;
+}
+
+#pragma mark - Signatures
+
+- (NSData *)signData:(NSData *)data digestAlgorithm:(LKKCDigestAlgorithm)digestAlgorithm error:(NSError **)error
+{
+    LKKCSignatureContext *sc = [LKKCSignatureContext signatureContextForKey:self digestAlgorithm:digestAlgorithm error:error];
+    if (sc == nil)
+        return nil;
+    return [sc signData:data error:error];
+}
+
+- (BOOL)verifySignature:(NSData *)signature forData:(NSData *)data digestAlgorithm:(LKKCDigestAlgorithm)digestAlgorithm error:(NSError **)error
+{
+    LKKCSignatureContext *sc = [LKKCSignatureContext signatureContextForKey:self digestAlgorithm:digestAlgorithm error:error];
+    if (sc == nil)
+        return NO;
+    return [sc verifySignature:signature forData:data error:error];
+}
+
+- (BOOL)verifySignatures:(NSArray *)signatures 
+             forMessages:(NSArray *)messages 
+         digestAlgorithm:(LKKCDigestAlgorithm)digestAlgorithm 
+                 results:(BOOL *)results 
+                   error:(NSError **)error
+{
+    NSUInteger count = [signatures count];
+    if ([messages count] != count) {
+        LKKCReportError(errSecParam, error, @"Number of signatures and messages don't match");
+        return NO;
+    }
+    // Snapshot the arrays into C arrays so that workers don't contend on them.
+    id *signatureObjects = malloc(count * sizeof(id));
+    id *messageObjects = malloc(count * sizeof(id));
+    [signatures getObjects:signatureObjects range:NSMakeRange(0, count)];
+    [messages getObjects:messageObjects range:NSMakeRange(0, count)];
+    
+    NSError *failure = nil;
+    BOOL result = LKKCParallelApply(count, ^id(NSError **e) {
+        return [LKKCSignatureContext signatureContextForKey:self digestAlgorithm:digestAlgorithm error:e];
+    }, ^BOOL(id sc, NSUInteger i, NSError **e) {
+        NSError *verifyError = nil;
+        BOOL valid = [sc verifySignature:signatureObjects[i] forData:messageObjects[i] error:&verifyError];
+        if (results != NULL)
+            results[i] = valid;
+        if (!valid && [verifyError code] != CSSMERR_CSP_VERIFY_FAILED) {
+            *e = verifyError;
+            return NO;
+        }
+        return YES;
+    }, nil, &failure);
+    
+    free(signatureObjects);
+    free(messageObjects);
+    if (!result) {
+        LKKCReportErrorObj(failure, error, @"Can't verify signatures");
+        return NO;
+    }
+    return YES;
+}
+
+#pragma mark - Key Wrapping
+
+// Create an AES Key Wrap context around this key on its own CSP, so that the key encryption key never leaves it.
+// Returns 0 on error.
+- (CSSM_CC_HANDLE)_createKeyWrapContextForOperation:(CSSM_ACL_AUTHORIZATION_TAG)operation cspHandle:(CSSM_CSP_HANDLE *)csphandle error:(NSError **)error
+{
+    SecKeyRef skey = (SecKeyRef)_sitem;
+    OSStatus status = SecKeyGetCSPHandle(skey, csphandle);
+    if (status) {
+        LKKCReportError(status, error, @"Can't get CSP handle");
+        return 0;
+    }
+    
+    const CSSM_KEY *cssmkey = NULL;
+    status = SecKeyGetCSSMKey(skey, &cssmkey);
+    if (status) {
+        LKKCReportError(status, error, @"Can't get CSSM key");
+        return 0;
+    }
+    
+    const CSSM_ACCESS_CREDENTIALS *credentials = NULL;
+    status = SecKeyGetCredentials(skey, operation, kSecCredentialTypeDefault, &credentials);
+    if (status) {
+        LKKCReportError(status, error, @"Can't get credentials");
+        return 0;
+    }
+    
+    CSSM_CC_HANDLE cchandle = 0;
+    status = CSSM_CSP_CreateSymmetricContext(*csphandle, CSSM_ALGID_AES, CSSM_ALGMODE_WRAP, credentials, cssmkey, 
+                                             NULL, CSSM_PADDING_NONE, NULL, &cchandle);
+    if (status) {
+        LKKCReportError(status, error, @"Can't create key wrap context");
+        return 0;
+    }
+    return cchandle;
+}
+
+- (NSData *)wrapKey:(LKKCKey *)key error:(NSError **)error
+{
+    if (key == nil) {
+        LKKCReportError(errSecParam, error, @"Missing key");
+        return nil;
+    }
+    return [[self wrapKeys:[NSArray arrayWithObject:key] error:error] objectAtIndex:0];
+}
+
+- (NSArray *)wrapKeys:(NSArray *)keys error:(NSError **)error
+{
+    LKKCKeyClass keyClass = self.keyClass;
+    LKKCKeyType keyType = self.keyType;
+    BOOL keyWrap = (keyClass == LKKCKeyClassSymmetric && keyType == LKKCKeyTypeAES);
+    if (!keyWrap && !(keyClass == LKKCKeyClassPublic && keyType == LKKCKeyTypeRSA)) {
+        LKKCReportError(errSecParam, error, @"Keys can only be wrapped with AES keys or RSA public keys");
+        return nil;
+    }
+    
+    NSMutableArray *result = [NSMutableArray arrayWithCapacity:[keys count]];
+    LKKCRawKeyReader reader = { 0, 0 };
+    CSSM_CSP_HANDLE csphandle = 0;
+    CSSM_CC_HANDLE cchandle = 0;
+    LKKCCryptoContext *cc = nil;
+    BOOL ok = NO;
+    
+    if (keyWrap) {
+        cchandle = [self _createKeyWrapContextForOperation:CSSM_ACL_AUTHORIZATION_ENCRYPT cspHandle:&csphandle error:error];
+        if (cchandle == 0)
+            goto exit;
+    }
+    else {
+        cc = [self _checkOutCryptoContextForOperation:CSSM_ACL_AUTHORIZATION_ENCRYPT initVector:nil error:error];
         if (cc == nil)
-            return nil;
-        result = [[cc encryptData:plaintext error:error] retain];
-        if (*error)
-            [*error retain];
+            goto exit;
     }
-    if (*error)
-        [*error autorelease];
-    return [result autorelease];
+    
+    for (LKKCKey *key in keys) {
+        if (key.keyClass != LKKCKeyClassSymmetric) {
+            LKKCReportError(errSecParam, error, @"Only symmetric keys can be wrapped");
+            goto exit;
+        }
+        NSData *wrappedKey = nil;
+        if (keyWrap) {
+            wrappedKey = LKKCKeyWrapKey(cchandle, csphandle, key.SecKey, &reader, error);
+        }
+        else {
+            CSSM_KEY rawKey;
+            if (!LKKCRawKeyReaderReadKey(&reader, key.SecKey, &rawKey, error))
+                goto exit;
+            NSData *bits = [NSData dataWithBytesNoCopy:rawKey.KeyData.Data length:rawKey.KeyData.Length freeWhenDone:NO];
+            wrappedKey = [cc encryptData:bits error:error];
+            LKKCRawKeyReaderFreeKey(&reader, &rawKey);
+        }
+        if (wrappedKey == nil)
+            goto exit;
+        [result addObject:wrappedKey];
+    }
+    ok = YES;
+    
+exit:
+    LKKCRawKeyReaderClose(&reader);
+    if (cchandle != 0)
+        CSSM_DeleteContext(cchandle);
+    if (cc != nil && ok)
+        [self _checkInCryptoContext:cc operation:CSSM_ACL_AUTHORIZATION_ENCRYPT];
+    return (ok ? result : nil);
 }
 
-- (NSData *)decryptData:(NSData *)ciphertext initVector:(NSData *)iv error:(NSError **)error
+- (LKKCKey *)unwrapKey:(NSData *)wrappedKey keyType:(LKKCKeyType)keyType keySize:(UInt32)keySize error:(NSError **)error
 {
-    NSData *result = nil;
-    @autoreleasepool {
-        LKKCCryptoContext *cc = [LKKCCryptoContext cryptoContextForKey:self
-                                                             operation:CSSM_ACL_AUTHORIZATION_DECRYPT
-                                                            initVector:iv 
-                                                                 error:error];
+    if (wrappedKey == nil) {
+        LKKCReportError(errSecParam, error, @"Missing wrapped key");
+        return nil;
+    }
+    return [[self unwrapKeys:[NSArray arrayWithObject:wrappedKey] keyType:keyType keySize:keySize error:error] objectAtIndex:0];
+}
+
+- (NSArray *)unwrapKeys:(NSArray *)wrappedKeys keyType:(LKKCKeyType)keyType keySize:(UInt32)keySize error:(NSError **)error
+{
+    LKKCKeyClass keyClass = self.keyClass;
+    BOOL keyWrap = (keyClass == LKKCKeyClassSymmetric && self.keyType == LKKCKeyTypeAES);
+    if (!keyWrap && !(keyClass == LKKCKeyClassPrivate && self.keyType == LKKCKeyTypeRSA)) {
+        LKKCReportError(errSecParam, error, @"Keys can only be unwrapped with AES keys or RSA private keys");
+        return nil;
+    }
+    if (keySize == 0 || keySize % 8 != 0) {
+        LKKCReportError(errSecParam, error, @"Invalid key size");
+        return nil;
+    }
+    size_t length = keySize / 8;
+    
+    NSMutableArray *result = [NSMutableArray arrayWithCapacity:[wrappedKeys count]];
+    CSSM_CSP_HANDLE csphandle = 0;
+    CSSM_CC_HANDLE cchandle = 0;
+    LKKCCryptoContext *cc = nil;
+    uint8_t *bits = NULL;
+    BOOL ok = NO;
+    
+    if (keyWrap) {
+        cchandle = [self _createKeyWrapContextForOperation:CSSM_ACL_AUTHORIZATION_DECRYPT cspHandle:&csphandle error:error];
+        if (cchandle == 0)
+            goto exit;
+    }
+    else {
+        bits = malloc(length);
+        if (bits == NULL) {
+            LKKCReportError(errSecAllocate, error, @"Can't allocate key buffer");
+            goto exit;
+        }
+        cc = [self _checkOutCryptoContextForOperation:CSSM_ACL_AUTHORIZATION_DECRYPT initVector:nil error:error];
         if (cc == nil)
-            return nil;
-        result = [[cc decryptData:ciphertext error:error] retain];
-        if (*error)
-            [*error retain];
+            goto exit;
     }
-    if (*error)
-        [*error autorelease];
-    return [result autorelease];
+    
+    for (NSData *wrappedKey in wrappedKeys) {
+        LKKCKey *key = nil;
+        if (keyWrap) {
+            if ([wrappedKey length] == length + 8 && length >= 16 && length % 8 == 0)
+                key = LKKCKeyUnwrapKey(cchandle, csphandle, wrappedKey, keyType, keySize);
+            if (key == nil) {
+                LKKCReportError(errSecDecode, error, @"Can't unwrap key");
+                goto exit;
+            }
+        }
+        else {
+            NSData *decrypted = [cc decryptData:wrappedKey error:NULL];
+            if (decrypted == nil || [decrypted length] != length) {
+                LKKCReportError(errSecDecode, error, @"Can't unwrap key");
+                goto exit;
+            }
+            memcpy(bits, [decrypted bytes], length);
+            key = [LKKCKey keyWithData:[NSData dataWithBytesNoCopy:bits length:length freeWhenDone:NO] 
+                              keyClass:LKKCKeyClassSymmetric 
+                               keyType:keyType 
+                               keySize:keySize];
+            LKKCWipe(bits, length);
+            if (key == nil) {
+                LKKCReportError(errSecParam, error, @"Can't create unwrapped key");
+                goto exit;
+            }
+        }
+        [result addObject:key];
+    }
+    ok = YES;
+    
+exit:
+    if (cchandle != 0)
+        CSSM_DeleteContext(cchandle);
+    if (bits != NULL) {
+        LKKCWipe(bits, length);
+        free(bits);
+    }
+    if (cc != nil && ok)
+        [self _checkInCryptoContext:cc operation:CSSM_ACL_AUTHORIZATION_DECRYPT];
+    return (ok ? result : nil);
+}
+
+#pragma mark - Key Agreement
+
+- (NSData *)sharedSecretWithPublicKey:(LKKCKey *)publicKey error:(NSError **)error
+{
+    if (self.keyClass != LKKCKeyClassPrivate || self.keyType != LKKCKeyTypeECDSA) {
+        LKKCReportError(errSecParam, error, @"Key agreement needs an elliptic curve private key");
+        return nil;
+    }
+    if (publicKey.keyClass != LKKCKeyClassPublic || publicKey.keyType != LKKCKeyTypeECDSA || publicKey.keySize != self.keySize) {
+        LKKCReportError(errSecParam, error, @"Key agreement needs a public key on the same curve");
+        return nil;
+    }
+    
+    SecKeyRef skey = self.SecKey;
+    CSSM_CSP_HANDLE csphandle = 0;
+    OSStatus status = SecKeyGetCSPHandle(skey, &csphandle);
+    if (status) {
+        LKKCReportError(status, error, @"Can't get CSP handle");
+        return nil;
+    }
+    const CSSM_KEY *cssmkey = NULL;
+    status = SecKeyGetCSSMKey(skey, &cssmkey);
+    if (status) {
+        LKKCReportError(status, error, @"Can't get CSSM key");
+        return nil;
+    }
+    const CSSM_ACCESS_CREDENTIALS *credentials = NULL;
+    status = SecKeyGetCredentials(skey, CSSM_ACL_AUTHORIZATION_DERIVE, kSecCredentialTypeDefault, &credentials);
+    if (status) {
+        LKKCReportError(status, error, @"Can't get credentials");
+        return nil;
+    }
+    
+    // The peer's key goes to the CSP in raw form, so it doesn't matter which CSP or keychain it lives on.
+    LKKCRawKeyReader reader = { 0, 0 };
+    CSSM_KEY peerKey;
+    if (!LKKCRawKeyReaderReadKey(&reader, publicKey.SecKey, &peerKey, error)) {
+        LKKCRawKeyReaderClose(&reader);
+        return nil;
+    }
+    
+    NSData *secret = nil;
+    CSSM_CC_HANDLE cchandle = 0;
+    CSSM_KEY derivedKey;
+    bzero(&derivedKey, sizeof(derivedKey));
+    
+    // The shared secret is the x coordinate of the agreed point, which is as long as a field element.
+    // It comes back as the bits of an RC4 key, because RC4 accepts keys of any length.
+    uint32 secretSize = 8 * ((self.keySize + 7) / 8);
+    status = CSSM_CSP_CreateDeriveKeyContext(csphandle, CSSM_ALGID_ECDH, CSSM_ALGID_RC4, secretSize, credentials, cssmkey, 0, NULL, NULL, &cchandle);
+    if (status) {
+        LKKCReportError(status, error, @"Can't create key agreement context");
+        cchandle = 0;
+        goto exit;
+    }
+    CSSM_CONTEXT_ATTRIBUTE attribute = { .AttributeType = CSSM_ATTRIBUTE_PUBLIC_KEY, .AttributeLength = sizeof(CSSM_KEY), .Attribute.Key = &peerKey };
+    status = CSSM_UpdateContextAttributes(cchandle, 1, &attribute);
+    if (status) {
+        LKKCReportError(status, error, @"Can't set peer public key");
+        goto exit;
+    }
+    
+    CSSM_DATA param = { .Length = 0, .Data = NULL };
+    CSSM_DATA label = { .Length = 4, .Data = (uint8 *)"ECDH" };
+    status = CSSM_DeriveKey(cchandle, &param, CSSM_KEYUSE_ANY, CSSM_KEYATTR_RETURN_DATA | CSSM_KEYATTR_EXTRACTABLE, &label, NULL, &derivedKey);
+    if (status) {
+        LKKCReportError(status, error, @"Can't compute shared secret");
+        goto exit;
+    }
+    secret = [NSData dataWithBytes:derivedKey.KeyData.Data length:derivedKey.KeyData.Length];
+    LKKCWipe(derivedKey.KeyData.Data, derivedKey.KeyData.Length);
+    CSSM_FreeKey(csphandle, NULL, &derivedKey, CSSM_FALSE);
+    
+exit:
+    if (cchandle != 0)
+        CSSM_DeleteContext(cchandle);
+    LKKCRawKeyReaderFreeKey(&reader, &peerKey);
+    LKKCRawKeyReaderClose(&reader);
+    return secret;
 }
 
 @end
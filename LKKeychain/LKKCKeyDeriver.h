@@ -0,0 +1,152 @@
+//
+//  LKKCKeyDeriver.h
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright © 2011, Károly Lőrentey. All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//  
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of Károly Lőrentey nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+//  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL KÁROLY LŐRENTEY BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+//  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+#import <Foundation/Foundation.h>
+#import <LKKeychain/LKKCKey.h>
+
+/** Derives symmetric keys from passwords (PBKDF2, scrypt) and from other keys (HKDF).
+ 
+ Derived keys are floating keys of the configured type and size; add them to a keychain with 
+ <[LKKCKeychainItem addToKeychain:error:]> if they need to persist.
+ 
+ The deriver remembers its most recently derived keys, so repeating a derivation with the same inputs 
+ costs a hash lookup instead of running the (deliberately slow) derivation function again.
+ The cache is indexed by a keyed hash of the inputs; passwords are not stored. 
+ 
+ Derivation methods may be called from several threads at once, as long as the key parameters aren't changed meanwhile.
+ */
+@interface LKKCKeyDeriver : NSObject
+{
+@private
+    LKKCKeyType _keyType;
+    UInt32 _keySize;
+    LKKCDigestAlgorithm _digestAlgorithm;
+    NSCache *_cache;
+    NSUInteger _cacheLimit;
+    uint8_t _cacheSecret[32];
+}
+
+/** --------------------------------------------------------------------------------
+ @name Factory Method
+ -------------------------------------------------------------------------------- */
+
+/** Return a new deriver that creates 256-bit AES keys, using SHA-256 as the pseudorandom function. */
++ (LKKCKeyDeriver *)deriver;
+
+/** --------------------------------------------------------------------------------
+ @name Key Parameters
+ -------------------------------------------------------------------------------- */
+
+/** The type of the derived keys. Must be a symmetric key type. Defaults to LKKCKeyTypeAES. */
+@property (nonatomic, assign) LKKCKeyType keyType;
+
+/** The size of the derived keys in bits. Defaults to 256. */
+@property (nonatomic, assign) UInt32 keySize;
+
+/** The digest algorithm underlying the HMAC pseudorandom function of PBKDF2 and HKDF. Defaults to LKKCDigestAlgorithmSHA256. 
+ scrypt always uses SHA-256. */
+@property (nonatomic, assign) LKKCDigestAlgorithm digestAlgorithm;
+
+/** The maximum number of derived keys to remember. Defaults to 64; set it to 0 to disable caching. 
+ 
+ Keys returned from the cache are the same objects that were returned by the original derivation; don't modify them. */
+@property (nonatomic, assign) NSUInteger cacheLimit;
+
+/** Forget all remembered keys. */
+- (void)removeAllCachedKeys;
+
+/** --------------------------------------------------------------------------------
+ @name Password-Based Derivation
+ -------------------------------------------------------------------------------- */
+
+/** Return the number of PBKDF2 iterations that take about `duration` seconds on this machine
+ with the current key parameters.
+ @param duration The target derivation time, in seconds.
+ @param passwordLength The length of typical passwords in bytes.
+ @param saltLength The length of the salt in bytes.
+ */
+- (unsigned int)calibratedIterationsForDuration:(NSTimeInterval)duration passwordLength:(size_t)passwordLength saltLength:(size_t)saltLength;
+
+/** Derive a key from a password with PBKDF2 (RFC 2898).
+ @param password The password; it is encoded in UTF-8.
+ @param salt A random salt of at least 8 bytes.
+ @param iterations The number of iterations. See calibratedIterationsForDuration:passwordLength:saltLength:.
+ @param error On output, the error that occurred in case the key could not be derived (optional).
+ @return The derived key, or nil on error.
+ */
+- (LKKCKey *)deriveKeyFromPassword:(NSString *)password salt:(NSData *)salt iterations:(unsigned int)iterations error:(NSError **)error;
+
+/** Derive a key from a password with scrypt (RFC 7914).
+ @param password The password; it is encoded in UTF-8.
+ @param salt A random salt.
+ @param cost The CPU/memory cost parameter N; a power of two larger than 1.
+ @param blockSize The block size parameter r. scrypt uses 128 * N * r bytes of memory.
+ @param parallelism The parallelization parameter p.
+ @param error On output, the error that occurred in case the key could not be derived (optional).
+ @return The derived key, or nil on error.
+ */
+- (LKKCKey *)deriveKeyFromPassword:(NSString *)password 
+                              salt:(NSData *)salt 
+                        scryptCost:(uint64_t)cost 
+                         blockSize:(uint32_t)blockSize 
+                       parallelism:(uint32_t)parallelism 
+                             error:(NSError **)error;
+
+/** --------------------------------------------------------------------------------
+ @name Key-Based Derivation
+ -------------------------------------------------------------------------------- */
+
+/** Derive a key from input key material with HKDF (RFC 5869).
+ @param keyMaterial The input key material, e.g. a Diffie-Hellman shared secret.
+ @param salt An optional salt.
+ @param info Optional context information that binds the derived key to its purpose.
+ @param error On output, the error that occurred in case the key could not be derived (optional).
+ @return The derived key, or nil on error.
+ */
+- (LKKCKey *)deriveKeyFromKeyMaterial:(NSData *)keyMaterial salt:(NSData *)salt info:(NSData *)info error:(NSError **)error;
+
+/** Derive a subkey from a symmetric master key with HKDF-Expand (RFC 5869, section 2.3).
+ 
+ The master key is used directly as the pseudorandom key, so it must be uniformly random, like a generated key. 
+ Its bits are read once into a pooled HMAC context, like in <[LKKCKey hmacForData:digestAlgorithm:error:]>.
+ 
+ @param key The master key.
+ @param info Context information that distinguishes subkeys of the same master key.
+ @param error On output, the error that occurred in case the key could not be derived (optional).
+ @return The derived key, or nil on error.
+ */
+- (LKKCKey *)deriveSubkeyFromKey:(LKKCKey *)key info:(NSData *)info error:(NSError **)error;
+
+@end
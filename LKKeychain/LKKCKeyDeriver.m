@@ -0,0 +1,545 @@
+//
+//  LKKCKeyDeriver.m
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright © 2011, Károly Lőrentey. All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//  
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of Károly Lőrentey nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+//  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL KÁROLY LŐRENTEY BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+//  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+#import "LKKCKeyDeriver.h"
+#import "LKKCKey.h"
+#import "LKKCKey+Private.h"
+#import "LKKCDigestContext.h"
+#import "LKKCUtil.h"
+#import <CommonCrypto/CommonHMAC.h>
+#import <CommonCrypto/CommonKeyDerivation.h>
+#import <libkern/OSByteOrder.h>
+
+// PRFs for PBKDF2 and HKDF, indexed by LKKCDigestAlgorithm.
+static const CCPseudoRandomAlgorithm pbkdfAlgorithms[] = {
+    kCCPRFHmacAlgSHA1,
+    kCCPRFHmacAlgSHA224,
+    kCCPRFHmacAlgSHA256,
+    kCCPRFHmacAlgSHA384,
+    kCCPRFHmacAlgSHA512
+};
+static const int cPBKDFAlgorithms = sizeof(pbkdfAlgorithms) / sizeof(CCPseudoRandomAlgorithm);
+
+static const CCHmacAlgorithm hmacAlgorithms[] = {
+    kCCHmacAlgSHA1,
+    kCCHmacAlgSHA224,
+    kCCHmacAlgSHA256,
+    kCCHmacAlgSHA384,
+    kCCHmacAlgSHA512
+};
+
+// The derivation function, as recorded in cache tags.
+enum {
+    LKKCDerivationPBKDF2 = 1,
+    LKKCDerivationScrypt = 2,
+    LKKCDerivationHKDF = 3,
+    LKKCDerivationSubkey = 4
+};
+
+// scrypt refuses parameters that would need more memory than this in a single lane.
+#define LKKCScryptMaxMemory (1ull << 30)
+
+#define LKKCRotate(a, b) (((a) << (b)) | ((a) >> (32 - (b))))
+
+// The Salsa20/8 core (RFC 7914, section 3).
+static void 
+LKKCSalsa208(uint32_t B[16])
+{
+    uint32_t x[16];
+    memcpy(x, B, sizeof(x));
+    for (int i = 0; i < 8; i += 2) {
+        x[ 4] ^= LKKCRotate(x[ 0] + x[12],  7);  x[ 8] ^= LKKCRotate(x[ 4] + x[ 0],  9);
+        x[12] ^= LKKCRotate(x[ 8] + x[ 4], 13);  x[ 0] ^= LKKCRotate(x[12] + x[ 8], 18);
+        x[ 9] ^= LKKCRotate(x[ 5] + x[ 1],  7);  x[13] ^= LKKCRotate(x[ 9] + x[ 5],  9);
+        x[ 1] ^= LKKCRotate(x[13] + x[ 9], 13);  x[ 5] ^= LKKCRotate(x[ 1] + x[13], 18);
+        x[14] ^= LKKCRotate(x[10] + x[ 6],  7);  x[ 2] ^= LKKCRotate(x[14] + x[10],  9);
+        x[ 6] ^= LKKCRotate(x[ 2] + x[14], 13);  x[10] ^= LKKCRotate(x[ 6] + x[ 2], 18);
+        x[ 3] ^= LKKCRotate(x[15] + x[11],  7);  x[ 7] ^= LKKCRotate(x[ 3] + x[15],  9);
+        x[11] ^= LKKCRotate(x[ 7] + x[ 3], 13);  x[15] ^= LKKCRotate(x[11] + x[ 7], 18);
+        x[ 1] ^= LKKCRotate(x[ 0] + x[ 3],  7);  x[ 2] ^= LKKCRotate(x[ 1] + x[ 0],  9);
+        x[ 3] ^= LKKCRotate(x[ 2] + x[ 1], 13);  x[ 0] ^= LKKCRotate(x[ 3] + x[ 2], 18);
+        x[ 6] ^= LKKCRotate(x[ 5] + x[ 4],  7);  x[ 7] ^= LKKCRotate(x[ 6] + x[ 5],  9);
+        x[ 4] ^= LKKCRotate(x[ 7] + x[ 6], 13);  x[ 5] ^= LKKCRotate(x[ 4] + x[ 7], 18);
+        x[11] ^= LKKCRotate(x[10] + x[ 9],  7);  x[ 8] ^= LKKCRotate(x[11] + x[10],  9);
+        x[ 9] ^= LKKCRotate(x[ 8] + x[11], 13);  x[10] ^= LKKCRotate(x[ 9] + x[ 8], 18);
+        x[12] ^= LKKCRotate(x[15] + x[14],  7);  x[13] ^= LKKCRotate(x[12] + x[15],  9);
+        x[14] ^= LKKCRotate(x[13] + x[12], 13);  x[15] ^= LKKCRotate(x[14] + x[13], 18);
+    }
+    for (int i = 0; i < 16; i++)
+        B[i] += x[i];
+}
+
+// scryptBlockMix (RFC 7914, section 4) on 2r 64-byte blocks, held as 32-bit words. in and out must not overlap.
+static void 
+LKKCScryptBlockMix(const uint32_t *in, uint32_t *out, uint32_t r)
+{
+    uint32_t X[16];
+    memcpy(X, &in[(2 * r - 1) * 16], sizeof(X));
+    for (uint32_t i = 0; i < 2 * r; i++) {
+        for (int k = 0; k < 16; k++)
+            X[k] ^= in[16 * i + k];
+        LKKCSalsa208(X);
+        // Even blocks go to the first half of the output, odd blocks to the second.
+        memcpy(&out[16 * ((i & 1) * r + i / 2)], X, sizeof(X));
+    }
+}
+
+// scryptROMix (RFC 7914, section 5) on the 128r bytes at B, in place. 
+// V is scratch space for 32rN words, XY for 64r words. N is a power of two larger than 1.
+static void 
+LKKCScryptROMix(uint8_t *B, uint32_t r, uint64_t N, uint32_t *V, uint32_t *XY)
+{
+    size_t words = 32 * r;
+    uint32_t *X = XY;
+    uint32_t *Y = XY + words;
+    for (size_t k = 0; k < words; k++)
+        X[k] = OSReadLittleInt32(B, 4 * k);
+    // Two steps per iteration, so that X and Y swap roles without copying.
+    for (uint64_t i = 0; i < N; i += 2) {
+        memcpy(&V[i * words], X, 4 * words);
+        LKKCScryptBlockMix(X, Y, r);
+        memcpy(&V[(i + 1) * words], Y, 4 * words);
+        LKKCScryptBlockMix(Y, X, r);
+    }
+    for (uint64_t i = 0; i < N; i += 2) {
+        uint64_t j = (X[words - 16] | ((uint64_t)X[words - 15] << 32)) & (N - 1);
+        for (size_t k = 0; k < words; k++)
+            X[k] ^= V[j * words + k];
+        LKKCScryptBlockMix(X, Y, r);
+        j = (Y[words - 16] | ((uint64_t)Y[words - 15] << 32)) & (N - 1);
+        for (size_t k = 0; k < words; k++)
+            Y[k] ^= V[j * words + k];
+        LKKCScryptBlockMix(Y, X, r);
+    }
+    for (size_t k = 0; k < words; k++)
+        OSWriteLittleInt32(B, 4 * k, X[k]);
+}
+
+// Feed a length-prefixed input to a cache tag, so that no two different input sequences give the same tag.
+static void
+LKKCCacheTagAppend(CCHmacContext *context, const void *bytes, size_t length)
+{
+    uint8_t prefix[8];
+    OSWriteBigInt64(prefix, 0, length);
+    CCHmacUpdate(context, prefix, sizeof(prefix));
+    CCHmacUpdate(context, bytes, length);
+}
+
+@interface LKKCKeyDeriver()
+- (size_t)_keyLengthWithError:(NSError **)error;
+- (NSData *)_cacheTagForDerivation:(uint8_t)derivation 
+                        parameters:(const uint64_t *)parameters 
+                             count:(size_t)count 
+                            inputs:(const void *const *)inputs 
+                           lengths:(const size_t *)lengths 
+                        inputCount:(size_t)inputCount;
+- (LKKCKey *)_keyWithBytes:(uint8_t *)bytes length:(size_t)length cacheTag:(NSData *)tag error:(NSError **)error;
+@end
+
+@implementation LKKCKeyDeriver
+
++ (LKKCKeyDeriver *)deriver
+{
+    return [[[LKKCKeyDeriver alloc] init] autorelease];
+}
+
+- (id)init
+{
+    self = [super init];
+    if (self == nil)
+        return nil;
+    _keyType = LKKCKeyTypeAES;
+    _keySize = 256;
+    _digestAlgorithm = LKKCDigestAlgorithmSHA256;
+    _cacheLimit = 64;
+    _cache = [[NSCache alloc] init];
+    [_cache setCountLimit:_cacheLimit];
+    LKKCRandomBytes(_cacheSecret, sizeof(_cacheSecret));
+    return self;
+}
+
+- (void)dealloc
+{
+    LKKCWipe(_cacheSecret, sizeof(_cacheSecret));
+    [_cache release];
+    [super dealloc];
+}
+
+@synthesize keyType = _keyType;
+@synthesize keySize = _keySize;
+@synthesize digestAlgorithm = _digestAlgorithm;
+@synthesize cacheLimit = _cacheLimit;
+
+- (void)setCacheLimit:(NSUInteger)cacheLimit
+{
+    _cacheLimit = cacheLimit;
+    if (cacheLimit == 0)
+        [_cache removeAllObjects];
+    else
+        [_cache setCountLimit:cacheLimit];
+}
+
+- (void)removeAllCachedKeys
+{
+    [_cache removeAllObjects];
+}
+
+// Return the length of derived keys in bytes, or 0 if the key parameters are invalid.
+- (size_t)_keyLengthWithError:(NSError **)error
+{
+    switch (_keyType) {
+        case LKKCKeyTypeAES:
+        case LKKCKeyTypeDES:
+        case LKKCKeyType3DES:
+        case LKKCKeyTypeRC4:
+        case LKKCKeyTypeRC2:
+        case LKKCKeyTypeCAST:
+            break;
+        default:
+            LKKCReportError(errSecParam, error, @"Derived keys must be symmetric");
+            return 0;
+    }
+    if (_keySize == 0 || _keySize % 8 != 0) {
+        LKKCReportError(errSecParam, error, @"Invalid key size");
+        return 0;
+    }
+    if (_digestAlgorithm < 0 || _digestAlgorithm >= cPBKDFAlgorithms) {
+        LKKCReportError(errSecParam, error, @"Invalid digest algorithm");
+        return 0;
+    }
+    return _keySize / 8;
+}
+
+// Return a tag identifying a derivation and the current key parameters, or nil if caching is disabled.
+// Tags are HMACs under a secret that never leaves this deriver, so they don't reveal the inputs.
+- (NSData *)_cacheTagForDerivation:(uint8_t)derivation 
+                        parameters:(const uint64_t *)parameters 
+                             count:(size_t)count 
+                            inputs:(const void *const *)inputs 
+                           lengths:(const size_t *)lengths 
+                        inputCount:(size_t)inputCount
+{
+    if (_cacheLimit == 0)
+        return nil;
+    CCHmacContext context;
+    CCHmacInit(&context, kCCHmacAlgSHA256, _cacheSecret, sizeof(_cacheSecret));
+    uint64_t settings[4] = { derivation, _keyType, _keySize, _digestAlgorithm };
+    CCHmacUpdate(&context, settings, sizeof(settings));
+    LKKCCacheTagAppend(&context, parameters, count * sizeof(uint64_t));
+    for (size_t i = 0; i < inputCount; i++)
+        LKKCCacheTagAppend(&context, inputs[i], lengths[i]);
+    NSMutableData *tag = [NSMutableData dataWithLength:CC_SHA256_DIGEST_LENGTH];
+    CCHmacFinal(&context, [tag mutableBytes]);
+    LKKCWipe(&context, sizeof(context));
+    return tag;
+}
+
+// Create a key from derived bytes, then wipe and free them.
+- (LKKCKey *)_keyWithBytes:(uint8_t *)bytes length:(size_t)length cacheTag:(NSData *)tag error:(NSError **)error
+{
+    NSData *data = [NSData dataWithBytesNoCopy:bytes length:length freeWhenDone:NO];
+    LKKCKey *key = [LKKCKey keyWithData:data keyClass:LKKCKeyClassSymmetric keyType:_keyType keySize:_keySize];
+    LKKCWipe(bytes, length);
+    free(bytes);
+    if (key == nil) {
+        LKKCReportError(errSecInternalComponent, error, @"Can't create derived key");
+        return nil;
+    }
+    if (tag != nil && _cacheLimit > 0)
+        [_cache setObject:key forKey:tag];
+    return key;
+}
+
+#pragma mark - Password-Based Derivation
+
+- (unsigned int)calibratedIterationsForDuration:(NSTimeInterval)duration passwordLength:(size_t)passwordLength saltLength:(size_t)saltLength
+{
+    size_t length = [self _keyLengthWithError:NULL];
+    if (length == 0)
+        return 0;
+    uint32_t msec = (uint32_t)MAX(1.0, round(1000.0 * duration));
+    return CCCalibratePBKDF(kCCPBKDF2, passwordLength, saltLength, pbkdfAlgorithms[_digestAlgorithm], length, msec);
+}
+
+- (LKKCKey *)deriveKeyFromPassword:(NSString *)password salt:(NSData *)salt iterations:(unsigned int)iterations error:(NSError **)error
+{
+    size_t length = [self _keyLengthWithError:error];
+    if (length == 0)
+        return nil;
+    if (password == nil || salt == nil || iterations == 0) {
+        LKKCReportError(errSecParam, error, @"Invalid PBKDF2 parameters");
+        return nil;
+    }
+    const char *passwordBytes = [password UTF8String];
+    size_t passwordLength = strlen(passwordBytes);
+    
+    uint64_t parameters[] = { iterations };
+    const void *inputs[] = { passwordBytes, [salt bytes] };
+    size_t lengths[] = { passwordLength, [salt length] };
+    NSData *tag = [self _cacheTagForDerivation:LKKCDerivationPBKDF2 parameters:parameters count:1 inputs:inputs lengths:lengths inputCount:2];
+    if (tag != nil) {
+        LKKCKey *key = [_cache objectForKey:tag];
+        if (key != nil)
+            return key;
+    }
+    
+    uint8_t *bytes = malloc(length);
+    if (bytes == NULL) {
+        LKKCReportError(errSecAllocate, error, @"Can't allocate key");
+        return nil;
+    }
+    int status = CCKeyDerivationPBKDF(kCCPBKDF2, passwordBytes, passwordLength, [salt bytes], [salt length], 
+                                      pbkdfAlgorithms[_digestAlgorithm], iterations, bytes, length);
+    if (status != kCCSuccess) {
+        free(bytes);
+        LKKCReportError(errSecParam, error, @"Can't derive key (%d)", status);
+        return nil;
+    }
+    return [self _keyWithBytes:bytes length:length cacheTag:tag error:error];
+}
+
+- (LKKCKey *)deriveKeyFromPassword:(NSString *)password 
+                              salt:(NSData *)salt 
+                        scryptCost:(uint64_t)cost 
+                         blockSize:(uint32_t)blockSize 
+                       parallelism:(uint32_t)parallelism 
+                             error:(NSError **)error
+{
+    size_t length = [self _keyLengthWithError:error];
+    if (length == 0)
+        return nil;
+    if (password == nil || salt == nil 
+        || cost < 2 || (cost & (cost - 1)) != 0 
+        || blockSize == 0 || parallelism == 0 
+        || (uint64_t)blockSize * parallelism >= (1ull << 30)) {
+        LKKCReportError(errSecParam, error, @"Invalid scrypt parameters");
+        return nil;
+    }
+    uint64_t blockLength = 128 * (uint64_t)blockSize;
+    if (cost > LKKCScryptMaxMemory / blockLength || parallelism > LKKCScryptMaxMemory / blockLength) {
+        LKKCReportError(errSecParam, error, @"scrypt parameters need too much memory");
+        return nil;
+    }
+    const char *passwordBytes = [password UTF8String];
+    size_t passwordLength = strlen(passwordBytes);
+    
+    uint64_t parameters[] = { cost, blockSize, parallelism };
+    const void *inputs[] = { passwordBytes, [salt bytes] };
+    size_t lengths[] = { passwordLength, [salt length] };
+    NSData *tag = [self _cacheTagForDerivation:LKKCDerivationScrypt parameters:parameters count:3 inputs:inputs lengths:lengths inputCount:2];
+    if (tag != nil) {
+        LKKCKey *key = [_cache objectForKey:tag];
+        if (key != nil)
+            return key;
+    }
+    
+    size_t BLength = (size_t)(parallelism * blockLength);
+    size_t scratchLength = (size_t)((32 * cost + 64) * blockSize * sizeof(uint32_t));
+    uint8_t *B = malloc(BLength);
+    uint8_t *bytes = malloc(length);
+    LKKCKey *result = nil;
+    if (B == NULL || bytes == NULL) {
+        LKKCReportError(errSecAllocate, error, @"Can't allocate scrypt buffers");
+        goto exit;
+    }
+    int status = CCKeyDerivationPBKDF(kCCPBKDF2, passwordBytes, passwordLength, [salt bytes], [salt length], 
+                                      kCCPRFHmacAlgSHA256, 1, B, BLength);
+    if (status != kCCSuccess) {
+        LKKCReportError(errSecParam, error, @"Can't derive key (%d)", status);
+        goto exit;
+    }
+    
+    // Lanes are independent; run them in parallel when their scratch buffers fit in the memory limit together.
+    NSUInteger workers = MIN(parallelism, [[NSProcessInfo processInfo] activeProcessorCount]);
+    if (workers > 1 && scratchLength <= LKKCScryptMaxMemory / workers) {
+        BOOL ok = LKKCParallelApply(parallelism, 
+                                    ^id(NSError **e) {
+                                        NSMutableData *scratch = [NSMutableData dataWithLength:scratchLength];
+                                        if (scratch == nil)
+                                            LKKCReportError(errSecAllocate, e, @"Can't allocate scrypt buffers");
+                                        return scratch;
+                                    }, 
+                                    ^BOOL(id scratch, NSUInteger index, NSError **e) {
+                                        uint32_t *V = [scratch mutableBytes];
+                                        LKKCScryptROMix(B + index * blockLength, blockSize, cost, V, V + 32 * cost * blockSize);
+                                        return YES;
+                                    }, 
+                                    ^(id scratch) {
+                                        LKKCWipe([scratch mutableBytes], scratchLength);
+                                    }, 
+                                    error);
+        if (!ok)
+            goto exit;
+    }
+    else {
+        uint32_t *V = malloc(scratchLength);
+        if (V == NULL) {
+            LKKCReportError(errSecAllocate, error, @"Can't allocate scrypt buffers");
+            goto exit;
+        }
+        for (uint32_t i = 0; i < parallelism; i++)
+            LKKCScryptROMix(B + i * blockLength, blockSize, cost, V, V + 32 * cost * blockSize);
+        LKKCWipe(V, scratchLength);
+        free(V);
+    }
+    
+    status = CCKeyDerivationPBKDF(kCCPBKDF2, passwordBytes, passwordLength, B, BLength, 
+                                  kCCPRFHmacAlgSHA256, 1, bytes, length);
+    if (status != kCCSuccess) {
+        LKKCReportError(errSecParam, error, @"Can't derive key (%d)", status);
+        goto exit;
+    }
+    result = [self _keyWithBytes:bytes length:length cacheTag:tag error:error];
+    bytes = NULL;
+    
+exit:
+    if (B != NULL) {
+        LKKCWipe(B, BLength);
+        free(B);
+    }
+    if (bytes != NULL) {
+        LKKCWipe(bytes, length);
+        free(bytes);
+    }
+    return result;
+}
+
+#pragma mark - Key-Based Derivation
+
+- (LKKCKey *)deriveKeyFromKeyMaterial:(NSData *)keyMaterial salt:(NSData *)salt info:(NSData *)info error:(NSError **)error
+{
+    size_t length = [self _keyLengthWithError:error];
+    if (length == 0)
+        return nil;
+    size_t hashLength = [LKKCDigestContext digestLengthForAlgorithm:_digestAlgorithm];
+    if (keyMaterial == nil || length > 255 * hashLength) {
+        LKKCReportError(errSecParam, error, @"Invalid HKDF parameters");
+        return nil;
+    }
+    
+    const void *inputs[] = { [keyMaterial bytes], [salt bytes], [info bytes] };
+    size_t lengths[] = { [keyMaterial length], [salt length], [info length] };
+    NSData *tag = [self _cacheTagForDerivation:LKKCDerivationHKDF parameters:NULL count:0 inputs:inputs lengths:lengths inputCount:3];
+    if (tag != nil) {
+        LKKCKey *key = [_cache objectForKey:tag];
+        if (key != nil)
+            return key;
+    }
+    
+    uint8_t *bytes = malloc(length);
+    if (bytes == NULL) {
+        LKKCReportError(errSecAllocate, error, @"Can't allocate key");
+        return nil;
+    }
+    CCHmacAlgorithm algorithm = hmacAlgorithms[_digestAlgorithm];
+    uint8_t prk[CC_SHA512_DIGEST_LENGTH];
+    uint8_t t[CC_SHA512_DIGEST_LENGTH];
+    
+    // Extract; a missing salt is a string of zeros, which is the same HMAC key as the empty string.
+    CCHmac(algorithm, [salt bytes], [salt length], [keyMaterial bytes], [keyMaterial length], prk);
+    
+    // Expand.
+    CCHmacContext context;
+    size_t tLength = 0;
+    for (size_t offset = 0, i = 1; offset < length; offset += hashLength, i++) {
+        uint8_t counter = (uint8_t)i;
+        CCHmacInit(&context, algorithm, prk, hashLength);
+        CCHmacUpdate(&context, t, tLength);
+        CCHmacUpdate(&context, [info bytes], [info length]);
+        CCHmacUpdate(&context, &counter, 1);
+        CCHmacFinal(&context, t);
+        tLength = hashLength;
+        memcpy(bytes + offset, t, MIN(hashLength, length - offset));
+    }
+    LKKCWipe(&context, sizeof(context));
+    LKKCWipe(prk, sizeof(prk));
+    LKKCWipe(t, sizeof(t));
+    return [self _keyWithBytes:bytes length:length cacheTag:tag error:error];
+}
+
+- (LKKCKey *)deriveSubkeyFromKey:(LKKCKey *)key info:(NSData *)info error:(NSError **)error
+{
+    size_t length = [self _keyLengthWithError:error];
+    if (length == 0)
+        return nil;
+    size_t hashLength = [LKKCDigestContext digestLengthForAlgorithm:_digestAlgorithm];
+    if (key == nil || length > 255 * hashLength) {
+        LKKCReportError(errSecParam, error, @"Invalid HKDF parameters");
+        return nil;
+    }
+    LKKCDigestContext *hmac = [key _checkOutHMACContextWithDigestAlgorithm:_digestAlgorithm error:error];
+    if (hmac == nil)
+        return nil;
+    
+    NSData *tag = nil;
+    if (_cacheLimit > 0) {
+        // Identify the master key by its own MAC of a fixed string; it can't be recovered from that.
+        static const char fingerprintLabel[] = "LKKCKeyDeriver master key fingerprint";
+        uint8_t fingerprint[CC_SHA512_DIGEST_LENGTH];
+        [hmac updateWithBytes:fingerprintLabel length:sizeof(fingerprintLabel) - 1];
+        [hmac finishWithOutput:fingerprint];
+        const void *inputs[] = { fingerprint, [info bytes] };
+        size_t lengths[] = { hashLength, [info length] };
+        tag = [self _cacheTagForDerivation:LKKCDerivationSubkey parameters:NULL count:0 inputs:inputs lengths:lengths inputCount:2];
+        LKKCKey *subkey = [_cache objectForKey:tag];
+        if (subkey != nil) {
+            [key _checkInHMACContext:hmac];
+            return subkey;
+        }
+    }
+    
+    uint8_t *bytes = malloc(length);
+    if (bytes == NULL) {
+        [key _checkInHMACContext:hmac];
+        LKKCReportError(errSecAllocate, error, @"Can't allocate key");
+        return nil;
+    }
+    uint8_t t[CC_SHA512_DIGEST_LENGTH];
+    size_t tLength = 0;
+    for (size_t offset = 0, i = 1; offset < length; offset += hashLength, i++) {
+        uint8_t counter = (uint8_t)i;
+        [hmac updateWithBytes:t length:tLength];
+        [hmac updateWithData:info];
+        [hmac updateWithBytes:&counter length:1];
+        [hmac finishWithOutput:t];
+        tLength = hashLength;
+        memcpy(bytes + offset, t, MIN(hashLength, length - offset));
+    }
+    LKKCWipe(t, sizeof(t));
+    [key _checkInHMACContext:hmac];
+    return [self _keyWithBytes:bytes length:length cacheTag:tag error:error];
+}
+
+@end
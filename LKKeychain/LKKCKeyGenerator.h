@@ -34,6 +34,7 @@
 // 
 
 #import <Foundation/Foundation.h>
+#import <LKKeychain/LKKCKey.h>
 
 @class LKKCKeychain;
 @class LKKCKeyPair;
@@ -50,6 +51,10 @@
     NSString *_applicationLabel;
     NSData *_tag;
     BOOL _extractable;
+    NSUInteger _keyPairPoolSize;
+    NSMutableDictionary *_keyPairPool; // Arrays of ready key pairs, keyed by type and size.
+    NSCountedSet *_pendingKeyPairs; // Pool keys of pairs being generated in the background.
+    NSUInteger _keyPairPoolGeneration; // Incremented whenever the pool is drained.
 }
 
 /** --------------------------------------------------------------------------------
@@ -90,6 +95,21 @@
  */
 - (LKKCKey *)generateAESKeyWithError:(NSError **)error;
 
+/** Generate many AES keys at once.
+ 
+ Extractable keys are created from random bits on all available cores, share a single access object, 
+ and are added to the keychain in batches. This is much faster than calling generateAESKeyWithError: repeatedly.
+ Non-extractable keys still have to be generated one by one, but they share the access object too.
+ 
+ All keys get the same label and tag. The keyID and applicationLabel properties are part of the primary key
+ of key items, so they must be nil when you generate more than one key into a keychain.
+ 
+ @param count The number of keys to generate.
+ @param error On output, the error that occurred in case the keys could not be generated (optional).
+ @return An array of `count` new AES keys, or nil if there was an error. Keys generated before an error are deleted.
+ */
+- (NSArray *)generateAESKeys:(NSUInteger)count error:(NSError **)error;
+
 /** Generate a new 3DES key. 
  @param error On output, the error that occurred in case the key could not be generated (optional).
  @return A new 3DES key, or nil if there was an error.
@@ -107,6 +127,9 @@
 @property (nonatomic, assign) unsigned int keySize;
 
 /** The keychain into which to put the generated key. 
+ 
+ Without a keychain, keys and key pairs are generated in memory and never touch a keychain. 
+ In-memory key pairs are always extractable. 
  */
 @property (nonatomic, retain) LKKCKeychain *keychain;
 
@@ -135,4 +158,40 @@
 @property (nonatomic, retain) NSData *tag;
 
 //@property (nonatomic, retain) LKKCAccess *access;
+
+/** --------------------------------------------------------------------------------
+ @name Pre-Generated Key Pairs
+ -------------------------------------------------------------------------------- */
+
+/** The number of key pairs to keep ready for each key type and size. Defaults to 0, which disables the pool.
+ 
+ Generating an RSA key pair takes hundreds of milliseconds or more. When the pool is enabled, 
+ generateRSAKeyPairWithError: and generateECDSAKeyPairWithError: hand out a ready pair if there is one, 
+ and generate a replacement on a low-priority background queue.
+ 
+ Ready pairs are kept in memory; they never touch a keychain until they're handed out, so unused pairs 
+ just go away when the pool is drained or the generator is deallocated. A pair that's handed out gets 
+ the current label, keyID, applicationLabel and tag, and is then added to the generator's keychain 
+ (if any) with the same access object a freshly generated pair would get. 
+ In-memory keys remain extractable when they're added to a keychain, so a generator with a keychain 
+ doesn't use the pool when extractable is NO. If a ready pair can't be added, a fresh one is generated instead.
+ 
+ A generator without a keychain pools in-memory pairs, which makes it a cheap source of ephemeral keys 
+ for per-session key exchange with <[LKKCKey sharedSecretWithPublicKey:error:]>: 
+ handing out an ephemeral pair involves no keychain writes at all.
+ */
+@property (nonatomic, assign) NSUInteger keyPairPoolSize;
+
+/** Start filling the pool for key pairs of the given type and size, so that even the first request is served from it.
+ Otherwise a pool starts filling when the first pair of its kind is requested.
+ @param keyType LKKCKeyTypeRSA or LKKCKeyTypeECDSA.
+ @param keySize The key size in bits, or 0 for the default size.
+ */
+- (void)fillKeyPairPoolWithKeyType:(LKKCKeyType)keyType keySize:(unsigned int)keySize;
+
+/** Return the number of pre-generated key pairs of the given type and size that are ready to be handed out. */
+- (NSUInteger)readyKeyPairCountWithKeyType:(LKKCKeyType)keyType keySize:(unsigned int)keySize;
+
+/** Discard all pre-generated key pairs that haven't been handed out yet, including those still being generated. */
+- (void)drainKeyPairPool;
 @end
@@ -42,11 +42,36 @@
 #import "LKKCUtil.h"
 
 @interface LKKCKeyGenerator()
-- (LKKCKeyPair *)_generateKeyPairWithKeyType:(LKKCKeyType)keyType keySize:(uint32)keySize error:(NSError **)error;
+- (unsigned int)_keyPairSizeWithKeyType:(LKKCKeyType)keyType keySize:(unsigned int)keySize error:(NSError **)error;
+- (LKKCKeyPair *)_keyPairWithKeyType:(LKKCKeyType)keyType keySize:(unsigned int)keySize error:(NSError **)error;
+- (LKKCKeyPair *)_checkOutPooledKeyPairWithKeyType:(LKKCKeyType)keyType keySize:(unsigned int)keySize;
+- (LKKCKeyPair *)_generateKeyPairWithKeyType:(LKKCKeyType)keyType 
+                                     keySize:(uint32)keySize 
+                                    keychain:(LKKCKeychain *)keychain 
+                                       label:(NSString *)label 
+                                         tag:(NSData *)tag 
+                                       error:(NSError **)error;
+- (LKKCKeyPair *)_generateFloatingKeyPairWithKeyType:(LKKCKeyType)keyType 
+                                             keySize:(uint32)keySize 
+                                               label:(NSString *)label 
+                                                 tag:(NSData *)tag 
+                                               error:(NSError **)error;
 - (SecKeyRef)_copyKey:(SecKeyRef)skey keyType:(LKKCKeyType)keyType keySize:(int)keySize error:(NSError **)error;
-- (LKKCKey *)_generateSymmetricKeyWithKeyType:(LKKCKeyType)keyType keySize:(uint32)keySize error:(NSError **)error;
+- (LKKCKey *)_generateSymmetricKeyWithKeyType:(LKKCKeyType)keyType keySize:(uint32)keySize access:(SecAccessRef)saccess error:(NSError **)error;
+- (NSArray *)_generateSymmetricKeys:(NSUInteger)count keyType:(LKKCKeyType)keyType keySize:(uint32)keySize error:(NSError **)error;
+- (BOOL)_addKeysToKeychain:(NSMutableArray *)keys access:(SecAccessRef)saccess error:(NSError **)error;
+- (NSDictionary *)_creationAttributes;
 @end
 
+// Bulk generation adds keys to the keychain this many at a time.
+static const NSUInteger LKKCKeyGeneratorInsertBatchSize = 256;
+
+static NSString *
+LKKCKeyPairPoolKey(LKKCKeyType keyType, unsigned int keySize)
+{
+    return [NSString stringWithFormat:@"%d/%u", (int)keyType, keySize];
+}
+
 @implementation LKKCKeyGenerator
 @synthesize keySize = _keySize;
 @synthesize keychain = _keychain;
@@ -55,6 +80,7 @@
 @synthesize applicationLabel = _applicationLabel;
 @synthesize tag = _tag;
 @synthesize extractable = _extractable;
+@synthesize keyPairPoolSize = _keyPairPoolSize;
 
 + (LKKCKeyGenerator *)generatorWithKeychain:(LKKCKeychain *)keychain
 {
@@ -69,11 +95,17 @@
     if (self == nil)
         return nil;
     _extractable = YES;
+    _keyPairPool = [[NSMutableDictionary alloc] init];
+    _pendingKeyPairs = [[NSCountedSet alloc] init];
     return self;
 }
 
 - (void)dealloc
 {
+    // Background generation blocks retain the generator, so nothing is pending at this point.
+    [self drainKeyPairPool];
+    [_keyPairPool release];
+    [_pendingKeyPairs release];
     [_keychain release];
     [_label release];
     [_keyID release];
@@ -82,7 +114,12 @@
     [super dealloc];
 }
 
-- (LKKCKeyPair *)_generateKeyPairWithKeyType:(LKKCKeyType)keyType keySize:(uint32)keySize error:(NSError **)error
+- (LKKCKeyPair *)_generateKeyPairWithKeyType:(LKKCKeyType)keyType 
+                                     keySize:(uint32)keySize 
+                                    keychain:(LKKCKeychain *)keychain 
+                                       label:(NSString *)label 
+                                         tag:(NSData *)tag 
+                                       error:(NSError **)error
 {
     OSStatus status;
     NSMutableDictionary *parameters = [NSMutableDictionary dictionary];
@@ -90,31 +127,23 @@
     [parameters setObject:[LKKCKey _algorithmFromLKKCKeyType:keyType] forKey:kSecAttrKeyType];
     [parameters setObject:[NSNumber numberWithInt:keySize] forKey:kSecAttrKeySizeInBits];
     
-    if (_label != nil)
-        [parameters setObject:_label forKey:kSecAttrLabel];
-    if (_tag != nil) {
-        [parameters setObject:_tag forKey:kSecAttrApplicationTag];
+    if (label != nil)
+        [parameters setObject:label forKey:kSecAttrLabel];
+    if (tag != nil) {
+        [parameters setObject:tag forKey:kSecAttrApplicationTag];
     }
     
-    if (_keychain != nil) {
-        [parameters setObject:(id)_keychain.SecKeychain forKey:kSecUseKeychain];
-        [parameters setObject:(id)kCFBooleanTrue forKey:kSecAttrIsPermanent];
-    }
-    else {
-        // BUG: This doesn't work. SecKeyGeneratePair always puts the result on a keychain.
-        [parameters setObject:(id)kCFBooleanFalse forKey:kSecAttrIsPermanent];
-        LKKCReportError(errSecParam, error, @"Can't generate a key pair without a keychain");
-        return nil;
+    if (keychain == nil) {
+        // SecKeyGeneratePair always puts the result on a keychain, even with kSecAttrIsPermanent set to false.
+        return [self _generateFloatingKeyPairWithKeyType:keyType keySize:keySize label:label tag:tag error:error];
     }
+    [parameters setObject:(id)keychain.SecKeychain forKey:kSecUseKeychain];
+    [parameters setObject:(id)kCFBooleanTrue forKey:kSecAttrIsPermanent];
     
-    SecAccessRef saccess = NULL;
-    status = SecAccessCreate((CFStringRef)_label, NULL /* current app */, &saccess);
-    if (status) {
-        LKKCReportError(status, error, @"Can't create initial access object for generated key");
+    SecAccessRef saccess = [LKKCKeychainItem sharedAccessWithLabel:label trustedApplications:nil /* current app */ error:error];
+    if (saccess == NULL)
         return nil;
-    }
     [parameters setObject:(id)saccess forKey:kSecAttrAccess];
-    CFRelease(saccess);
 
     SecKeyRef spublicKey = NULL;
     SecKeyRef sprivateKey = NULL;
@@ -134,29 +163,238 @@
     return keypair;
 }
 
-- (LKKCKeyPair *)generateRSAKeyPairWithError:(NSError **)error
+// Generate a key pair in memory with the Apple CSP. The keys are raw rather than reference keys, 
+// so they don't depend on our CSP attachment, and they're always extractable.
+- (LKKCKeyPair *)_generateFloatingKeyPairWithKeyType:(LKKCKeyType)keyType 
+                                             keySize:(uint32)keySize 
+                                               label:(NSString *)label 
+                                                 tag:(NSData *)tag 
+                                               error:(NSError **)error
 {
-    unsigned int keySize = _keySize;
-    if (keySize == 0)
-        keySize = 2048;
-    if ((keySize % 8) != 0 || keySize < kSecRSAMin || keySize > kSecRSAMax) {
-        LKKCReportError(errSecParam, error, @"Invalid key size");
+    CSSM_CSP_HANDLE csphandle = LKKCAppleCSPHandle(error);
+    if (csphandle == 0)
+        return nil;
+    
+    CSSM_CC_HANDLE cchandle = 0;
+    CSSM_RETURN crtn = CSSM_CSP_CreateKeyGenContext(csphandle, [LKKCKey _cssmAlgorithmFromLKKCKeyType:keyType], keySize, 
+                                                    NULL, NULL, NULL, NULL, NULL, &cchandle);
+    if (crtn) {
+        LKKCReportError(crtn, error, @"Can't create key generation context");
+        return nil;
+    }
+    
+    CSSM_KEY cssmPublicKey;
+    CSSM_KEY cssmPrivateKey;
+    bzero(&cssmPublicKey, sizeof(cssmPublicKey));
+    bzero(&cssmPrivateKey, sizeof(cssmPrivateKey));
+    CSSM_DATA keyLabel = { .Length = 9, .Data = (uint8 *)"ephemeral" };
+    crtn = CSSM_GenerateKeyPair(cchandle, 
+                                CSSM_KEYUSE_ENCRYPT | CSSM_KEYUSE_VERIFY | CSSM_KEYUSE_WRAP | CSSM_KEYUSE_DERIVE, 
+                                CSSM_KEYATTR_RETURN_DATA | CSSM_KEYATTR_EXTRACTABLE, 
+                                &keyLabel, 
+                                &cssmPublicKey, 
+                                CSSM_KEYUSE_DECRYPT | CSSM_KEYUSE_SIGN | CSSM_KEYUSE_UNWRAP | CSSM_KEYUSE_DERIVE, 
+                                CSSM_KEYATTR_RETURN_DATA | CSSM_KEYATTR_EXTRACTABLE, 
+                                &keyLabel, 
+                                NULL, 
+                                &cssmPrivateKey);
+    CSSM_DeleteContext(cchandle);
+    if (crtn) {
+        LKKCReportError(crtn, error, @"Can't generate key pair");
         return nil;
     }
     
-    return [self _generateKeyPairWithKeyType:LKKCKeyTypeRSA keySize:keySize error:error];
+    // SecKeyCreateWithCSSMKey takes over the key bits.
+    SecKeyRef spublicKey = NULL;
+    SecKeyRef sprivateKey = NULL;
+    OSStatus status = SecKeyCreateWithCSSMKey(&cssmPublicKey, &spublicKey);
+    if (status) {
+        CSSM_FreeKey(csphandle, NULL, &cssmPublicKey, CSSM_FALSE);
+    }
+    else {
+        status = SecKeyCreateWithCSSMKey(&cssmPrivateKey, &sprivateKey);
+    }
+    if (status) {
+        LKKCWipe(cssmPrivateKey.KeyData.Data, cssmPrivateKey.KeyData.Length);
+        CSSM_FreeKey(csphandle, NULL, &cssmPrivateKey, CSSM_FALSE);
+        if (spublicKey != NULL)
+            CFRelease(spublicKey);
+        LKKCReportError(status, error, @"Can't create key pair");
+        return nil;
+    }
+    
+    LKKCKey *publicKey = [LKKCKey keyWithSecKey:spublicKey];
+    CFRelease(spublicKey);
+    
+    LKKCKey *privateKey = [LKKCKey keyWithSecKey:sprivateKey];
+    CFRelease(sprivateKey);
+    
+    for (LKKCKey *key in [NSArray arrayWithObjects:publicKey, privateKey, nil]) {
+        if (label != nil)
+            key.label = label;
+        if (tag != nil)
+            key.tag = tag;
+    }
+    
+    return [[[LKKCKeyPair alloc] initWithPublicKey:publicKey privateKey:privateKey] autorelease];
+}
+
+// Return keySize, or the default size for keyType if keySize is 0. Returns 0 if the size or type is invalid.
+- (unsigned int)_keyPairSizeWithKeyType:(LKKCKeyType)keyType keySize:(unsigned int)keySize error:(NSError **)error
+{
+    switch (keyType) {
+        case LKKCKeyTypeRSA:
+            if (keySize == 0)
+                keySize = 2048;
+            if ((keySize % 8) != 0 || keySize < kSecRSAMin || keySize > kSecRSAMax) {
+                LKKCReportError(errSecParam, error, @"Invalid key size");
+                return 0;
+            }
+            return keySize;
+        case LKKCKeyTypeECDSA:
+            if (keySize == 0)
+                keySize = kSecp256r1;
+            if (keySize != kSecp192r1 && keySize != kSecp256r1 && keySize != kSecp384r1 && keySize != kSecp521r1) {
+                LKKCReportError(errSecParam, error, @"Invalid key size");
+                return 0;
+            }
+            return keySize;
+        default:
+            LKKCReportError(errSecParam, error, @"Invalid key pair type");
+            return 0;
+    }
+}
+
+- (LKKCKeyPair *)_keyPairWithKeyType:(LKKCKeyType)keyType keySize:(unsigned int)keySize error:(NSError **)error
+{
+    // Pooled pairs are generated in memory, and they stay extractable when they're added to a keychain.
+    if (_keyPairPoolSize > 0 && (_keychain == nil || _extractable)) {
+        LKKCKeyPair *keypair = [self _checkOutPooledKeyPairWithKeyType:keyType keySize:keySize];
+        [self fillKeyPairPoolWithKeyType:keyType keySize:keySize];
+        if (keypair != nil)
+            return keypair;
+    }
+    return [self _generateKeyPairWithKeyType:keyType keySize:keySize keychain:_keychain label:_label tag:_tag error:error];
+}
+
+- (LKKCKeyPair *)generateRSAKeyPairWithError:(NSError **)error
+{
+    unsigned int keySize = [self _keyPairSizeWithKeyType:LKKCKeyTypeRSA keySize:_keySize error:error];
+    if (keySize == 0)
+        return nil;
+    return [self _keyPairWithKeyType:LKKCKeyTypeRSA keySize:keySize error:error];
 }
 
 - (LKKCKeyPair *)generateECDSAKeyPairWithError:(NSError **)error
 {
-    unsigned int keySize = _keySize;    
+    unsigned int keySize = [self _keyPairSizeWithKeyType:LKKCKeyTypeECDSA keySize:_keySize error:error];
     if (keySize == 0)
-        keySize = kSecp256r1;
-    if (keySize != kSecp192r1 && keySize != kSecp256r1 && keySize != kSecp384r1 && keySize != kSecp521r1) {
-        LKKCReportError(errSecParam, error, @"Invalid key size");
         return nil;
+    return [self _keyPairWithKeyType:LKKCKeyTypeECDSA keySize:keySize error:error];
+}
+
+#pragma mark - Pre-Generated Key Pairs
+
+- (void)setKeyPairPoolSize:(NSUInteger)keyPairPoolSize
+{
+    _keyPairPoolSize = keyPairPoolSize;
+    if (keyPairPoolSize == 0)
+        [self drainKeyPairPool];
+}
+
+- (NSUInteger)readyKeyPairCountWithKeyType:(LKKCKeyType)keyType keySize:(unsigned int)keySize
+{
+    keySize = [self _keyPairSizeWithKeyType:keyType keySize:keySize error:NULL];
+    @synchronized(_keyPairPool) {
+        return [[_keyPairPool objectForKey:LKKCKeyPairPoolKey(keyType, keySize)] count];
+    }
+}
+
+// Take a ready in-memory pair from the pool, give it the current attributes and add it to the keychain, if any.
+// Returns nil if the pool is empty or the pair can't be added; the caller then generates a fresh pair.
+- (LKKCKeyPair *)_checkOutPooledKeyPairWithKeyType:(LKKCKeyType)keyType keySize:(unsigned int)keySize
+{
+    LKKCKeyPair *keypair = nil;
+    @synchronized(_keyPairPool) {
+        NSMutableArray *pairs = [_keyPairPool objectForKey:LKKCKeyPairPoolKey(keyType, keySize)];
+        if ([pairs count] == 0)
+            return nil;
+        keypair = [[[pairs objectAtIndex:0] retain] autorelease];
+        [pairs removeObjectAtIndex:0];
+    }
+    
+    LKKCKey *publicKey = keypair.publicKey;
+    LKKCKey *privateKey = keypair.privateKey;
+    for (LKKCKey *key in [NSArray arrayWithObjects:publicKey, privateKey, nil]) {
+        if (_label != nil)
+            key.label = _label;
+        if (_applicationLabel != nil)
+            key.applicationLabel = _applicationLabel;
+        if (_keyID != nil)
+            key.keyID = _keyID;
+        if (_tag != nil)
+            key.tag = _tag;
+    }
+    if (_keychain == nil)
+        return keypair;
+    
+    // Adding a key gives it the shared access object for its label, like SecKeyGeneratePair does.
+    if (![privateKey addToKeychain:_keychain error:NULL])
+        return nil;
+    if (![publicKey addToKeychain:_keychain error:NULL]) {
+        [privateKey deleteItemWithError:NULL];
+        return nil;
+    }
+    return keypair;
+}
+
+- (void)fillKeyPairPoolWithKeyType:(LKKCKeyType)keyType keySize:(unsigned int)keySize
+{
+    keySize = [self _keyPairSizeWithKeyType:keyType keySize:keySize error:NULL];
+    if (keySize == 0 || _keyPairPoolSize == 0)
+        return;
+    
+    NSString *poolKey = LKKCKeyPairPoolKey(keyType, keySize);
+    NSUInteger missing = 0;
+    NSUInteger generation;
+    @synchronized(_keyPairPool) {
+        NSUInteger available = [[_keyPairPool objectForKey:poolKey] count] + [_pendingKeyPairs countForObject:poolKey];
+        if (available < _keyPairPoolSize)
+            missing = _keyPairPoolSize - available;
+        for (NSUInteger i = 0; i < missing; i++)
+            [_pendingKeyPairs addObject:poolKey];
+        generation = _keyPairPoolGeneration;
+    }
+    
+    dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0);
+    for (NSUInteger i = 0; i < missing; i++) {
+        dispatch_async(queue, ^{
+            @autoreleasepool {
+                // Ready pairs stay in memory, so a pool that's never used leaves nothing behind in the keychain.
+                LKKCKeyPair *keypair = [self _generateFloatingKeyPairWithKeyType:keyType keySize:keySize label:nil tag:nil error:NULL];
+                @synchronized(_keyPairPool) {
+                    [_pendingKeyPairs removeObject:poolKey];
+                    // Pairs that finish after a drain are dropped.
+                    if (keypair != nil && generation == _keyPairPoolGeneration) {
+                        NSMutableArray *pairs = [_keyPairPool objectForKey:poolKey];
+                        if (pairs == nil) {
+                            pairs = [NSMutableArray array];
+                            [_keyPairPool setObject:pairs forKey:poolKey];
+                        }
+                        [pairs addObject:keypair];
+                    }
+                }
+            }
+        });
+    }
+}
+
+- (void)drainKeyPairPool
+{
+    @synchronized(_keyPairPool) {
+        _keyPairPoolGeneration++;
+        [_keyPairPool removeAllObjects];
     }
-    return [self _generateKeyPairWithKeyType:LKKCKeyTypeECDSA keySize:keySize error:error];
 }
 
 - (SecKeyRef)_copyKey:(SecKeyRef)skey keyType:(LKKCKeyType)keyType keySize:(int)keySize error:(NSError **)error
@@ -193,7 +431,8 @@
     return skeyCopy;
 }
 
-- (LKKCKey *)_generateSymmetricKeyWithKeyType:(LKKCKeyType)keyType keySize:(uint32)keySize error:(NSError **)error
+// saccess is the access object for the new key; pass NULL to use the shared one for the label.
+- (LKKCKey *)_generateSymmetricKeyWithKeyType:(LKKCKeyType)keyType keySize:(uint32)keySize access:(SecAccessRef)saccess error:(NSError **)error
 {
     if (_extractable || _keychain == nil) {
         // SecKeyGenerateSymmetric can only create non-extractable keys.
@@ -209,15 +448,12 @@
         
         CSSM_KEYATTR_FLAGS keyAttr = CSSM_KEYATTR_RETURN_DEFAULT | CSSM_KEYATTR_EXTRACTABLE;
         
-        SecAccessRef saccess = NULL;
-        OSStatus status = SecAccessCreate((CFStringRef)_label, NULL /* current app */, &saccess);
-        if (status) {
-            LKKCReportError(status, error, @"Can't create access object for newly generated key");
+        if (saccess == NULL)
+            saccess = [LKKCKeychainItem sharedAccessWithLabel:_label trustedApplications:nil /* current app */ error:error];
+        if (saccess == NULL)
             return nil;
-        }
         SecKeyRef skey = NULL;
-        status = SecKeyGenerate(skeychain, algid, keySize, 0, keyUse, keyAttr, saccess, &skey);
-        CFRelease(saccess);
+        OSStatus status = SecKeyGenerate(skeychain, algid, keySize, 0, keyUse, keyAttr, saccess, &skey);
         if (status) {
             LKKCReportError(status, error, @"Can't generate symmetric key");
             return nil;
@@ -277,14 +513,11 @@
             [parameters setObject:(id)kCFBooleanFalse forKey:kSecAttrIsPermanent];
         }
         
-        SecAccessRef saccess = NULL;
-        OSStatus status = SecAccessCreate((CFStringRef)_label, NULL /* current app */, &saccess);
-        if (status) {
-            LKKCReportError(status, error, @"Can't create access object for newly generated key");
+        if (saccess == NULL)
+            saccess = [LKKCKeychainItem sharedAccessWithLabel:_label trustedApplications:nil /* current app */ error:error];
+        if (saccess == NULL)
             return nil;
-        }
         [parameters setObject:(id)saccess forKey:kSecAttrAccess];
-        CFRelease(saccess);
 
         CFErrorRef cferror = NULL;
         SecKeyRef skey = SecKeyGenerateSymmetric((CFDictionaryRef)parameters, &cferror);
@@ -343,7 +576,191 @@
         LKKCReportError(errSecParam, NULL, @"Invalid key size");
         return nil;
     }
-    return [self _generateSymmetricKeyWithKeyType:LKKCKeyTypeAES keySize:keySize error:error];
+    return [self _generateSymmetricKeyWithKeyType:LKKCKeyTypeAES keySize:keySize access:NULL error:error];
+}
+
+- (NSArray *)generateAESKeys:(NSUInteger)count error:(NSError **)error
+{
+    unsigned int keySize = _keySize;    
+    if (keySize == 0)
+        keySize = kSecAES128;
+    if (keySize != kSecAES128 && keySize != kSecAES192 && keySize != kSecAES256) {
+        LKKCReportError(errSecParam, error, @"Invalid key size");
+        return nil;
+    }
+    if (_keychain != nil && count > 1 && (_keyID != nil || _applicationLabel != nil)) {
+        LKKCReportError(errSecDuplicateItem, error, @"Keys with the same application label would collide");
+        return nil;
+    }
+    return [self _generateSymmetricKeys:count keyType:LKKCKeyTypeAES keySize:keySize error:error];
+}
+
+- (NSArray *)_generateSymmetricKeys:(NSUInteger)count keyType:(LKKCKeyType)keyType keySize:(uint32)keySize error:(NSError **)error
+{
+    SecAccessRef saccess = NULL;
+    if (_keychain != nil) {
+        saccess = [LKKCKeychainItem sharedAccessWithLabel:_label trustedApplications:nil /* current app */ error:error];
+        if (saccess == NULL)
+            return nil;
+    }
+    
+    NSMutableArray *keys = [NSMutableArray arrayWithCapacity:count];
+    BOOL ok = YES;
+    if (_keychain != nil && !_extractable) {
+        // Only SecKeyGenerateSymmetric makes non-extractable keys.
+        NSError *failure = nil;
+        for (NSUInteger i = 0; ok && i < count; i++) {
+            @autoreleasepool {
+                LKKCKey *key = [self _generateSymmetricKeyWithKeyType:keyType keySize:keySize access:saccess error:&failure];
+                if (key != nil)
+                    [keys addObject:key];
+                else {
+                    [failure retain];
+                    ok = NO;
+                }
+            }
+        }
+        if (!ok) {
+            for (LKKCKey *key in keys)
+                [key deleteItemWithError:NULL];
+            LKKCReportErrorObj([failure autorelease], error, @"Can't generate keys");
+        }
+    }
+    else {
+        size_t length = keySize / 8;
+        id *created = calloc(count, sizeof(id));
+        if (created == NULL) {
+            LKKCReportError(errSecAllocate, error, @"Can't allocate keys");
+            return nil;
+        }
+        // Keys bound for a keychain carry their attributes from creation, so a single SecItemAdd stores everything.
+        NSDictionary *attributes = (_keychain != nil ? [self _creationAttributes] : nil);
+        ok = LKKCParallelApply(count, 
+                               ^id(NSError **e) {
+                                   return [NSMutableData dataWithLength:length];
+                               }, 
+                               ^BOOL(id bits, NSUInteger i, NSError **e) {
+                                   LKKCRandomBytes([bits mutableBytes], length);
+                                   LKKCKey *key = [LKKCKey _keyWithData:bits keyClass:LKKCKeyClassSymmetric keyType:keyType keySize:keySize attributes:attributes];
+                                   LKKCWipe([bits mutableBytes], length);
+                                   if (key == nil) {
+                                       LKKCReportError(errSecInternalComponent, e, @"Can't create key");
+                                       return NO;
+                                   }
+                                   created[i] = [key retain];
+                                   return YES;
+                               }, 
+                               nil, 
+                               error);
+        for (NSUInteger i = 0; i < count; i++) {
+            if (created[i] != nil) {
+                [keys addObject:created[i]];
+                [created[i] release];
+            }
+        }
+        free(created);
+        
+        if (ok && _keychain != nil)
+            ok = [self _addKeysToKeychain:keys access:saccess error:error];
+        else if (ok) {
+            // Store the attributes in the floating keys until they're added to a keychain.
+            for (LKKCKey *key in keys) {
+                if (_label != nil)
+                    key.label = _label;
+                if (_applicationLabel != nil)
+                    key.applicationLabel = _applicationLabel;
+                if (_keyID != nil)
+                    key.keyID = _keyID;
+                if (_tag != nil)
+                    key.tag = _tag;
+            }
+        }
+    }
+    
+    return (ok ? keys : nil);
+}
+
+// The attributes that floating keys created for the keychain are given by SecKeyCreateFromData.
+- (NSDictionary *)_creationAttributes
+{
+    NSMutableDictionary *attributes = [NSMutableDictionary dictionary];
+    if (_label != nil)
+        [attributes setObject:_label forKey:kSecAttrLabel];
+    if (_applicationLabel != nil)
+        [attributes setObject:_applicationLabel forKey:kSecAttrApplicationLabel];
+    if (_tag != nil)
+        [attributes setObject:_tag forKey:kSecAttrApplicationTag];
+    return attributes;
+}
+
+// Add floating keys created with _creationAttributes to the keychain, a batch per SecItemAdd call, 
+// and replace them in keys with their keychain items. On error, delete the keys that were already added.
+- (BOOL)_addKeysToKeychain:(NSMutableArray *)keys access:(SecAccessRef)saccess error:(NSError **)error
+{
+    NSUInteger count = [keys count];
+    NSUInteger added = 0;
+    NSError *failure = nil;
+    
+    while (added < count && failure == nil) {
+        @autoreleasepool {
+            NSRange range = NSMakeRange(added, MIN(LKKCKeyGeneratorInsertBatchSize, count - added));
+            NSMutableArray *items = [NSMutableArray arrayWithCapacity:range.length];
+            for (LKKCKey *key in [keys subarrayWithRange:range])
+                [items addObject:(id)key.SecKey];
+            
+            NSMutableDictionary *attributes = [NSMutableDictionary dictionary];
+            [attributes setObject:items forKey:kSecUseItemList];
+            [attributes setObject:kSecClassKey forKey:kSecClass];
+            [attributes setObject:(id)_keychain.SecKeychain forKey:kSecUseKeychain];
+            [attributes setObject:(id)saccess forKey:kSecAttrAccess];
+            [attributes setObject:[NSNumber numberWithBool:YES] forKey:kSecReturnRef];
+            
+            CFTypeRef result = NULL;
+            OSStatus status = SecItemAdd((CFDictionaryRef)attributes, &result);
+            if (status) {
+                LKKCReportError(status, &failure, @"Can't add keys to keychain");
+            }
+            else if (CFGetTypeID(result) != CFArrayGetTypeID() || CFArrayGetCount(result) != (CFIndex)range.length) {
+                LKKCReportError(errSecInternalComponent, &failure, @"SecItemAdd returned an unexpected number of items");
+                // We can't tell which of the items made it; delete them all.
+                if (CFGetTypeID(result) == CFArrayGetTypeID()) {
+                    for (id item in (NSArray *)result)
+                        [[LKKCKeychainItem itemWithClass:kSecClassKey SecKeychainItem:(SecKeychainItemRef)item attributes:nil] deleteItemWithError:NULL];
+                }
+                else
+                    [[LKKCKeychainItem itemWithClass:kSecClassKey SecKeychainItem:(SecKeychainItemRef)result attributes:nil] deleteItemWithError:NULL];
+            }
+            else {
+                for (CFIndex i = 0; i < (CFIndex)range.length; i++) {
+                    LKKCKey *key = [LKKCKeychainItem itemWithClass:kSecClassKey 
+                                                   SecKeychainItem:(SecKeychainItemRef)CFArrayGetValueAtIndex(result, i) 
+                                                        attributes:nil];
+                    [keys replaceObjectAtIndex:added + i withObject:key];
+                }
+                added += range.length;
+            }
+            if (result != NULL)
+                CFRelease(result);
+            [failure retain];
+        }
+        [failure autorelease];
+    }
+    
+    // The label, application label and tag were stored by SecItemAdd. The key ID has no creation parameter, 
+    // so it still needs a separate update; generateAESKeys:error: only allows it for a single key.
+    for (NSUInteger i = 0; _keyID != nil && failure == nil && i < added; i++) {
+        LKKCKey *key = [keys objectAtIndex:i];
+        key.keyID = _keyID;
+        [key saveItemWithError:&failure];
+    }
+    
+    if (failure != nil) {
+        for (NSUInteger i = 0; i < added; i++)
+            [[keys objectAtIndex:i] deleteItemWithError:NULL];
+        LKKCReportErrorObj(failure, error, @"Can't generate keys");
+        return NO;
+    }
+    return YES;
 }
 
 - (LKKCKey *)generate3DESKeyWithError:(NSError **)error
@@ -355,7 +772,7 @@
         LKKCReportError(errSecParam, NULL, @"Invalid key size");
         return nil;
     }
-    return [self _generateSymmetricKeyWithKeyType:LKKCKeyType3DES keySize:keySize error:error];
+    return [self _generateSymmetricKeyWithKeyType:LKKCKeyType3DES keySize:keySize access:NULL error:error];
 }
 
 @end
@@ -34,14 +34,21 @@
 // 
 
 #import <Foundation/Foundation.h>
+#import <LKKeychain/LKKCKey.h>
 
-@class LKKCKey;
 /** Represents a pair of asymetric keys. */
 @interface LKKCKeyPair : NSObject
 {
 @private
     LKKCKey *_publicKey;
     LKKCKey *_privateKey;
+    // The current envelope session key and its wrapped form, reused for up to _envelopeKeyReuseLimit messages.
+    LKKCKey *_envelopeKey;
+    NSData *_wrappedEnvelopeKey;
+    NSUInteger _envelopeKeyUses;
+    NSUInteger _envelopeKeyReuseLimit;
+    // Recently unwrapped session keys, keyed by their wrapped form.
+    NSCache *_unwrappedEnvelopeKeys;
 }
 
 - (id)initWithPublicKey:(LKKCKey *)publicKey privateKey:(LKKCKey *)privateKey;
@@ -49,7 +56,67 @@
 @property (nonatomic, readonly) LKKCKey *publicKey;
 @property (nonatomic, readonly) LKKCKey *privateKey;
 
+/** Encrypt a single block of data with the public key. The plaintext must be shorter than the key's modulus; 
+ use encryptEnvelope:error: for anything larger. */
 - (NSData *)encryptData:(NSData *)plaintext error:(NSError **)error;
 - (NSData *)decryptData:(NSData *)ciphertext error:(NSError **)error;
 
+/** --------------------------------------------------------------------------------
+ @name Envelope Encryption
+ -------------------------------------------------------------------------------- */
+
+/** Encrypt data of any size for the owner of this key pair.
+ 
+ The data is encrypted with a random AES-256 session key in authenticated segments on all available cores 
+ (see <[LKKCKey encryptDataInParallel:error:]>), and the session key is encrypted once with the RSA public key using OAEP padding. 
+ Only the public key is needed.
+ 
+ @param plaintext The data to encrypt.
+ @param error On output, the error that occured in case the data could not be encrypted (optional).
+ @return The envelope, which contains the encrypted session key and the encrypted data.
+ */
+- (NSData *)encryptEnvelope:(NSData *)plaintext error:(NSError **)error;
+
+/** Decrypt an envelope created by encryptEnvelope:error: with the private key.
+ 
+ Recently seen session keys are remembered, so consecutive envelopes that share a session key 
+ only need a single RSA operation.
+ 
+ A session key that can't be unwrapped and a payload that fails authentication produce the same error 
+ (errSecDecode), so that failed decryptions reveal nothing about the session key.
+ 
+ @param envelope The envelope to decrypt.
+ @param error On output, the error that occured in case the envelope could not be decrypted or is not authentic (optional).
+ @return The decrypted data, or nil if any part of the envelope has been modified.
+ */
+- (NSData *)decryptEnvelope:(NSData *)envelope error:(NSError **)error;
+
+/** The number of envelopes that encryptEnvelope:error: may encrypt with the same session key.
+ 
+ The default is 1, which generates a new session key (and performs an RSA operation) for every envelope. 
+ Larger values save the RSA operation at the cost of linking envelopes that share a session key. 
+ Each envelope still uses its own random nonces.
+ */
+@property (nonatomic, assign) NSUInteger envelopeKeyReuseLimit;
+
+/** Sign a piece of data with the private key. 
+ @see [LKKCKey signData:digestAlgorithm:error:] */
+- (NSData *)signData:(NSData *)data digestAlgorithm:(LKKCDigestAlgorithm)digestAlgorithm error:(NSError **)error;
+
+/** Verify a signature with the public key. 
+ @see [LKKCKey verifySignature:forData:digestAlgorithm:error:] */
+- (BOOL)verifySignature:(NSData *)signature forData:(NSData *)data digestAlgorithm:(LKKCDigestAlgorithm)digestAlgorithm error:(NSError **)error;
+
+/** Verify many signatures with the public key on all available cores. 
+ @see [LKKCKey verifySignatures:forMessages:digestAlgorithm:results:error:] */
+- (BOOL)verifySignatures:(NSArray *)signatures 
+             forMessages:(NSArray *)messages 
+         digestAlgorithm:(LKKCDigestAlgorithm)digestAlgorithm 
+                 results:(BOOL *)results 
+                   error:(NSError **)error;
+
+/** Compute an ECDH shared secret from the private key and the other party's public key. 
+ @see [LKKCKey sharedSecretWithPublicKey:error:] */
+- (NSData *)sharedSecretWithPublicKey:(LKKCKey *)publicKey error:(NSError **)error;
+
 @end
@@ -35,6 +35,24 @@
 
 #import "LKKCKeyPair.h"
 #import "LKKCKey.h"
+#import "LKKCUtil.h"
+#import <libkern/OSByteOrder.h>
+
+// Envelopes start with this header:
+//   "LKEV" | version (1) | reserved (1) | wrapped key length (2) | wrapped session key
+// followed by the payload in the segmented format of -[LKKCKey encryptDataInParallel:error:].
+// The session key is a raw AES-256 key encrypted with the RSA public key using OAEP padding; integers are big-endian.
+// (Version 1 used PKCS#1 v1.5 padding, which is open to padding oracle attacks; it is no longer accepted.)
+#define LKKCEnvelopeMagic "LKEV"
+static const uint8_t LKKCEnvelopeVersion = 2;
+static const size_t LKKCEnvelopeHeaderLength = 8;
+static const size_t LKKCEnvelopeSessionKeyLength = 32;
+// The number of unwrapped session keys remembered for decryption.
+static const NSUInteger LKKCEnvelopeKeyCacheSize = 16;
+
+@interface LKKCKeyPair()
+- (BOOL)_getEnvelopeKey:(LKKCKey **)key wrappedKey:(NSData **)wrappedKey error:(NSError **)error;
+@end
 
 @implementation LKKCKeyPair 
 
@@ -45,6 +63,7 @@
         return nil;
     _publicKey = [publicKey retain];
     _privateKey = [privateKey retain];
+    _envelopeKeyReuseLimit = 1;
     return self;
 }
 
@@ -52,6 +71,9 @@
 {
     [_publicKey release];
     [_privateKey release];
+    [_envelopeKey release];
+    [_wrappedEnvelopeKey release];
+    [_unwrappedEnvelopeKeys release];
     [super dealloc];
 }
 
@@ -81,4 +103,197 @@
     return [self.privateKey decryptData:ciphertext initVector:nil error:error];
 }
 
+#pragma mark - Envelope Encryption
+
+@synthesize envelopeKeyReuseLimit = _envelopeKeyReuseLimit;
+
+// Return the session key for the next envelope, generating and wrapping a new one when needed.
+- (BOOL)_getEnvelopeKey:(LKKCKey **)key wrappedKey:(NSData **)wrappedKey error:(NSError **)error
+{
+    @synchronized(self) {
+        if (_envelopeKey != nil && _envelopeKeyUses < _envelopeKeyReuseLimit) {
+            _envelopeKeyUses++;
+            *key = [[_envelopeKey retain] autorelease];
+            *wrappedKey = [[_wrappedEnvelopeKey retain] autorelease];
+            return YES;
+        }
+    }
+    
+    SecKeyRef spublicKey = self.publicKey.SecKey;
+    if (spublicKey == NULL) {
+        LKKCReportError(errSecParam, error, @"Key pair has no public key");
+        return NO;
+    }
+    // SecKeyGetBlockSize returns the modulus size in bits (see -[LKKCKey _getProperties:]).
+    size_t wrappedLength = (SecKeyGetBlockSize(spublicKey) + 7) / 8;
+    if (wrappedLength > UINT16_MAX) {
+        LKKCReportError(errSecParam, error, @"Public key is too large");
+        return NO;
+    }
+    NSMutableData *newWrappedKey = [NSMutableData dataWithLength:wrappedLength];
+    
+    uint8_t keyBytes[LKKCEnvelopeSessionKeyLength];
+    LKKCRandomBytes(keyBytes, sizeof(keyBytes));
+    NSData *keyData = [NSData dataWithBytesNoCopy:keyBytes length:sizeof(keyBytes) freeWhenDone:NO];
+    LKKCKey *newKey = [LKKCKey keyWithData:keyData keyClass:LKKCKeyClassSymmetric keyType:LKKCKeyTypeAES keySize:8 * LKKCEnvelopeSessionKeyLength];
+    OSStatus status = SecKeyEncrypt(spublicKey, kSecPaddingOAEP, keyBytes, sizeof(keyBytes), [newWrappedKey mutableBytes], &wrappedLength);
+    LKKCWipe(keyBytes, sizeof(keyBytes));
+    if (newKey == nil) {
+        LKKCReportError(errSecInternalComponent, error, @"Can't create session key");
+        return NO;
+    }
+    if (status) {
+        LKKCReportError(status, error, @"Can't encrypt session key");
+        return NO;
+    }
+    [newWrappedKey setLength:wrappedLength];
+    
+    @synchronized(self) {
+        if (_envelopeKeyReuseLimit > 1) {
+            [_envelopeKey release];
+            [_wrappedEnvelopeKey release];
+            _envelopeKey = [newKey retain];
+            _wrappedEnvelopeKey = [newWrappedKey retain];
+            _envelopeKeyUses = 1;
+        }
+    }
+    *key = newKey;
+    *wrappedKey = newWrappedKey;
+    return YES;
+}
+
+- (void)setEnvelopeKeyReuseLimit:(NSUInteger)limit
+{
+    @synchronized(self) {
+        _envelopeKeyReuseLimit = limit;
+        [_envelopeKey release];
+        [_wrappedEnvelopeKey release];
+        _envelopeKey = nil;
+        _wrappedEnvelopeKey = nil;
+        _envelopeKeyUses = 0;
+    }
+}
+
+- (NSData *)encryptEnvelope:(NSData *)plaintext error:(NSError **)error
+{
+    LKKCKey *sessionKey = nil;
+    NSData *wrappedKey = nil;
+    if (![self _getEnvelopeKey:&sessionKey wrappedKey:&wrappedKey error:error])
+        return nil;
+    NSData *payload = [sessionKey encryptDataInParallel:plaintext error:error];
+    if (payload == nil)
+        return nil;
+    
+    NSMutableData *envelope = [NSMutableData dataWithCapacity:LKKCEnvelopeHeaderLength + [wrappedKey length] + [payload length]];
+    uint8_t header[LKKCEnvelopeHeaderLength];
+    memcpy(header, LKKCEnvelopeMagic, 4);
+    header[4] = LKKCEnvelopeVersion;
+    header[5] = 0;
+    OSWriteBigInt16(header, 6, (uint16_t)[wrappedKey length]);
+    [envelope appendBytes:header length:sizeof(header)];
+    [envelope appendData:wrappedKey];
+    [envelope appendData:payload];
+    return envelope;
+}
+
+- (NSData *)decryptEnvelope:(NSData *)envelope error:(NSError **)error
+{
+    const uint8_t *bytes = [envelope bytes];
+    size_t length = [envelope length];
+    if (length < LKKCEnvelopeHeaderLength || memcmp(bytes, LKKCEnvelopeMagic, 4) != 0) {
+        LKKCReportError(errSecDecode, error, @"Not an envelope");
+        return nil;
+    }
+    if (bytes[4] != LKKCEnvelopeVersion || bytes[5] != 0) {
+        LKKCReportError(errSecDecode, error, @"Unsupported envelope version");
+        return nil;
+    }
+    size_t wrappedKeyLength = OSReadBigInt16(bytes, 6);
+    if (length - LKKCEnvelopeHeaderLength < wrappedKeyLength) {
+        LKKCReportError(errSecDecode, error, @"Truncated envelope");
+        return nil;
+    }
+    NSData *wrappedKey = [envelope subdataWithRange:NSMakeRange(LKKCEnvelopeHeaderLength, wrappedKeyLength)];
+    
+    SecKeyRef sprivateKey = self.privateKey.SecKey;
+    if (sprivateKey == NULL) {
+        LKKCReportError(errSecParam, error, @"Key pair has no private key");
+        return nil;
+    }
+    
+    LKKCKey *sessionKey = nil;
+    @synchronized(self) {
+        sessionKey = [[[_unwrappedEnvelopeKeys objectForKey:wrappedKey] retain] autorelease];
+    }
+    if (sessionKey == nil) {
+        // Decrypt the session key into a buffer we can wipe; an NSData would linger on the heap.
+        // If the session key can't be unwrapped, carry on with a random one: the payload will then fail 
+        // authentication, so a bad wrapped key is indistinguishable from a bad payload.
+        size_t capacity = MAX(wrappedKeyLength, LKKCEnvelopeSessionKeyLength);
+        uint8_t *keyBytes = malloc(capacity);
+        if (keyBytes == NULL) {
+            LKKCReportError(errSecAllocate, error, @"Can't allocate session key");
+            return nil;
+        }
+        size_t keyLength = capacity;
+        OSStatus status = SecKeyDecrypt(sprivateKey, kSecPaddingOAEP, [wrappedKey bytes], wrappedKeyLength, keyBytes, &keyLength);
+        BOOL unwrapped = (status == errSecSuccess && keyLength == LKKCEnvelopeSessionKeyLength);
+        if (!unwrapped)
+            LKKCRandomBytes(keyBytes, LKKCEnvelopeSessionKeyLength);
+        NSData *keyData = [NSData dataWithBytesNoCopy:keyBytes length:LKKCEnvelopeSessionKeyLength freeWhenDone:NO];
+        sessionKey = [LKKCKey keyWithData:keyData keyClass:LKKCKeyClassSymmetric keyType:LKKCKeyTypeAES keySize:8 * LKKCEnvelopeSessionKeyLength];
+        LKKCWipe(keyBytes, capacity);
+        free(keyBytes);
+        if (sessionKey == nil) {
+            LKKCReportError(errSecInternalComponent, error, @"Can't create session key");
+            return nil;
+        }
+        if (unwrapped) {
+            @synchronized(self) {
+                if (_unwrappedEnvelopeKeys == nil) {
+                    _unwrappedEnvelopeKeys = [[NSCache alloc] init];
+                    [_unwrappedEnvelopeKeys setCountLimit:LKKCEnvelopeKeyCacheSize];
+                }
+                [_unwrappedEnvelopeKeys setObject:sessionKey forKey:wrappedKey];
+            }
+        }
+    }
+    
+    size_t offset = LKKCEnvelopeHeaderLength + wrappedKeyLength;
+    NSData *payload = [NSData dataWithBytesNoCopy:(void *)(bytes + offset) length:length - offset freeWhenDone:NO];
+    NSData *plaintext = [sessionKey decryptDataInParallel:payload error:NULL];
+    if (plaintext == nil) {
+        // Every unwrapping and authentication failure gets this same error.
+        LKKCReportError(errSecDecode, error, @"Can't open envelope");
+        return nil;
+    }
+    return plaintext;
+}
+
+#pragma mark - Signatures
+
+- (NSData *)signData:(NSData *)data digestAlgorithm:(LKKCDigestAlgorithm)digestAlgorithm error:(NSError **)error
+{
+    return [self.privateKey signData:data digestAlgorithm:digestAlgorithm error:error];
+}
+
+- (BOOL)verifySignature:(NSData *)signature forData:(NSData *)data digestAlgorithm:(LKKCDigestAlgorithm)digestAlgorithm error:(NSError **)error
+{
+    return [self.publicKey verifySignature:signature forData:data digestAlgorithm:digestAlgorithm error:error];
+}
+
+- (BOOL)verifySignatures:(NSArray *)signatures 
+             forMessages:(NSArray *)messages 
+         digestAlgorithm:(LKKCDigestAlgorithm)digestAlgorithm 
+                 results:(BOOL *)results 
+                   error:(NSError **)error
+{
+    return [self.publicKey verifySignatures:signatures forMessages:messages digestAlgorithm:digestAlgorithm results:results error:error];
+}
+
+- (NSData *)sharedSecretWithPublicKey:(LKKCKey *)publicKey error:(NSError **)error
+{
+    return [self.privateKey sharedSecretWithPublicKey:publicKey error:error];
+}
+
 @end
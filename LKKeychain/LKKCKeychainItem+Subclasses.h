@@ -44,6 +44,11 @@
 + (CFTypeRef)itemClass;
 + (void)registerSubclass:(Class)cls;
 
+// Return an access object for new items with the given label that trusts the given applications
+// (SecTrustedApplicationRefs, or nil for the current application). SecAccessCreate is slow, so access objects 
+// are cached by label and trusted-application set and shared between items. Don't modify the result.
++ (SecAccessRef)sharedAccessWithLabel:(NSString *)label trustedApplications:(NSArray *)trustedApplications error:(NSError **)error;
+
 - (id)initWithSecKeychainItem:(SecKeychainItemRef)sitem attributes:(NSDictionary *)attributes;
 
 - (void)setAttribute:(CFTypeRef)attribute toValue:(CFTypeRef)value;
@@ -45,6 +45,9 @@
 
 static CFMutableDictionaryRef knownItemClasses;
 
+// The maximum number of access objects kept by +sharedAccessWithLabel:trustedApplications:error:.
+static const NSUInteger LKKCKeychainItemAccessCacheLimit = 64;
+
 @interface LKKCKeychainItem()
 @property (nonatomic, readonly) NSDictionary *attributes;
 @end
@@ -337,6 +340,48 @@ static CFMutableDictionaryRef knownItemClasses;
     _attributesFilled = NO;
 }
 
++ (SecAccessRef)sharedAccessWithLabel:(NSString *)label trustedApplications:(NSArray *)trustedApplications error:(NSError **)error
+{
+    static NSCache *cache = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        cache = [[NSCache alloc] init];
+        [cache setCountLimit:LKKCKeychainItemAccessCacheLimit];
+    });
+    
+    // Trusted applications are keyed by their opaque data. A nil list (the current application) differs from an empty one.
+    id applicationsKey = [NSNull null];
+    if (trustedApplications != nil) {
+        NSMutableSet *applications = [NSMutableSet setWithCapacity:[trustedApplications count]];
+        for (id application in trustedApplications) {
+            CFDataRef data = NULL;
+            OSStatus status = SecTrustedApplicationCopyData((SecTrustedApplicationRef)application, &data);
+            if (status) {
+                LKKCReportError(status, error, @"Can't get trusted application data");
+                return NULL;
+            }
+            [applications addObject:(id)data];
+            CFRelease(data);
+        }
+        applicationsKey = applications;
+    }
+    NSArray *key = [NSArray arrayWithObjects:(label != nil ? (id)label : (id)[NSNull null]), applicationsKey, nil];
+    
+    id saccess = [cache objectForKey:key];
+    if (saccess == nil) {
+        SecAccessRef snew = NULL;
+        OSStatus status = SecAccessCreate((CFStringRef)label, (CFArrayRef)trustedApplications, &snew);
+        if (status) {
+            LKKCReportError(status, error, @"Can't create access object");
+            return NULL;
+        }
+        saccess = [(id)snew autorelease];
+        [cache setObject:saccess forKey:key];
+    }
+    // The cache may evict the object at any time.
+    return (SecAccessRef)[[saccess retain] autorelease];
+}
+
 - (SecAccessRef)access
 {
     return NULL;
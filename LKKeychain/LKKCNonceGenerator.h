@@ -0,0 +1,111 @@
+//
+//  LKKCNonceGenerator.h
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright © 2011, Károly Lőrentey. All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//  
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of Károly Lőrentey nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+//  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL KÁROLY LŐRENTEY BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+//  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+#import <Foundation/Foundation.h>
+
+/** Produces initialization vectors and nonces at high message rates.
+ 
+ A counter generator produces nonces that consist of a fixed prefix followed by a big-endian invocation counter,
+ as in the deterministic construction of NIST SP 800-38D, section 8.2.1. Every nonce from a counter generator is unique
+ among the nonces of that generator; when the counter runs out, the generator fails instead of wrapping around.
+ Nothing coordinates separate generators: two generators with the same prefix produce the same nonces. Use counter nonces for GCM and CTR modes, 
+ where nonces must never repeat under the same key but need not be unpredictable.
+ 
+ A random generator produces nonces from a buffered cryptographically secure random generator.
+ Use random nonces for CBC initialization vectors, which must be unpredictable.
+ 
+ Generators are thread-safe; each nonce is handed out exactly once, even when several threads draw from the same generator.
+ */
+@interface LKKCNonceGenerator : NSObject
+{
+@private
+    size_t _length;
+    size_t _prefixLength;
+    uint8_t _prefix[16];
+    BOOL _random;
+    volatile int64_t _counter;
+    int64_t _limit;
+}
+
+/** --------------------------------------------------------------------------------
+ @name Factory Methods
+ -------------------------------------------------------------------------------- */
+
+/** Return a generator of 12-byte GCM nonces: a random 8-byte prefix followed by a 32-bit counter. 
+ 
+ This is the same layout as the segment nonces of <[LKKCKey encryptDataInParallel:segmentSize:error:]>.
+ Uniqueness is only guaranteed per generator. The 64-bit random prefix makes a collision between separate generators 
+ of the same key unlikely until about 2^32 generators; if you need a hard guarantee, give each generator a distinct 
+ prefix with counterNonceGeneratorWithPrefix:length: instead. A generator produces at most 2^32 nonces.
+ */
++ (LKKCNonceGenerator *)gcmNonceGenerator;
+
+/** Return a generator of counter nonces.
+ @param prefix The fixed leading part of every nonce; it must be shorter than `length`. Pass nil for a random prefix of `length - 4` bytes; this needs `length` to be at least 12.
+ @param length The length of the nonces in bytes; at most 16. 
+ @return A new generator, or nil if the parameters are invalid.
+ */
++ (LKKCNonceGenerator *)counterNonceGeneratorWithPrefix:(NSData *)prefix length:(size_t)length;
+
+/** Return a generator of random nonces of `length` bytes, such as CBC initialization vectors. 
+ @see [LKKCKey blockSize]
+ */
++ (LKKCNonceGenerator *)randomNonceGeneratorWithLength:(size_t)length;
+
+/** --------------------------------------------------------------------------------
+ @name Generating Nonces
+ -------------------------------------------------------------------------------- */
+
+/** The length of generated nonces in bytes. */
+@property (nonatomic, readonly) size_t length;
+
+/** The number of nonces that can still be generated, or `UINT64_MAX` for random generators. */
+@property (nonatomic, readonly) uint64_t remainingCount;
+
+/** Return a new nonce, or nil if the counter is exhausted. */
+- (NSData *)nextNonce;
+
+/** Generate many nonces into a contiguous buffer, e.g. for <[LKKCKey encryptBatch:count:output:capacity:offsets:error:]>.
+ 
+ Counter nonces produced by a single call are consecutive.
+ 
+ @param output The buffer that receives the nonces back to back; it must have room for `count * length` bytes.
+ @param count The number of nonces to generate.
+ @param error On output, the error that occurred in case the nonces could not be generated (optional).
+ @return YES if all nonces were generated; NO if the counter doesn't have `count` values left.
+ */
+- (BOOL)getNonces:(void *)output count:(NSUInteger)count error:(NSError **)error;
+
+@end
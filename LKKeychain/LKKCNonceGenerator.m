@@ -0,0 +1,166 @@
+//
+//  LKKCNonceGenerator.m
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright © 2011, Károly Lőrentey. All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//  
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of Károly Lőrentey nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+//  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL KÁROLY LŐRENTEY BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+//  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+#import "LKKCNonceGenerator.h"
+#import "LKKCUtil.h"
+#import <libkern/OSAtomic.h>
+
+// The longest supported nonce (one AES block).
+#define LKKCNonceMaxLength 16
+
+// The length of the counter after a random prefix, and the shortest random prefix we accept.
+#define LKKCNonceRandomCounterLength 4
+#define LKKCNonceMinRandomPrefixLength 8
+
+// Counters never go beyond this, so that reserving a batch of nonces can't overflow.
+static const int64_t LKKCNonceMaxCounter = INT64_MAX / 2;
+
+@interface LKKCNonceGenerator()
+- (id)initWithLength:(size_t)length prefix:(const void *)prefix prefixLength:(size_t)prefixLength random:(BOOL)random;
+@end
+
+@implementation LKKCNonceGenerator
+
++ (LKKCNonceGenerator *)gcmNonceGenerator
+{
+    return [self counterNonceGeneratorWithPrefix:nil length:12];
+}
+
++ (LKKCNonceGenerator *)counterNonceGeneratorWithPrefix:(NSData *)prefix length:(size_t)length
+{
+    if (length == 0 || length > LKKCNonceMaxLength) {
+        LKKCReportError(errSecParam, NULL, @"Invalid nonce length");
+        return nil;
+    }
+    if (prefix != nil && [prefix length] >= length) {
+        LKKCReportError(errSecParam, NULL, @"Nonce prefix leaves no room for the counter");
+        return nil;
+    }
+    if (prefix == nil && length < LKKCNonceMinRandomPrefixLength + LKKCNonceRandomCounterLength) {
+        // Shorter random prefixes collide too soon between generators.
+        LKKCReportError(errSecParam, NULL, @"Nonces are too short for a random prefix");
+        return nil;
+    }
+    uint8_t randomPrefix[LKKCNonceMaxLength];
+    size_t prefixLength;
+    if (prefix == nil) {
+        prefixLength = length - LKKCNonceRandomCounterLength;
+        LKKCRandomBytes(randomPrefix, prefixLength);
+    }
+    else {
+        prefixLength = [prefix length];
+    }
+    return [[[LKKCNonceGenerator alloc] initWithLength:length 
+                                                prefix:(prefix == nil ? randomPrefix : [prefix bytes]) 
+                                          prefixLength:prefixLength 
+                                                random:NO] autorelease];
+}
+
++ (LKKCNonceGenerator *)randomNonceGeneratorWithLength:(size_t)length
+{
+    if (length == 0) {
+        LKKCReportError(errSecParam, NULL, @"Invalid nonce length");
+        return nil;
+    }
+    return [[[LKKCNonceGenerator alloc] initWithLength:length prefix:NULL prefixLength:0 random:YES] autorelease];
+}
+
+- (id)initWithLength:(size_t)length prefix:(const void *)prefix prefixLength:(size_t)prefixLength random:(BOOL)random
+{
+    self = [super init];
+    if (self == nil)
+        return nil;
+    _length = length;
+    _random = random;
+    if (!random) {
+        _prefixLength = prefixLength;
+        memcpy(_prefix, prefix, prefixLength);
+        size_t counterLength = length - prefixLength;
+        _limit = (counterLength >= 8 ? LKKCNonceMaxCounter : (int64_t)1 << (8 * counterLength));
+    }
+    return self;
+}
+
+@synthesize length = _length;
+
+- (uint64_t)remainingCount
+{
+    if (_random)
+        return UINT64_MAX;
+    return (uint64_t)(_limit - _counter);
+}
+
+- (NSData *)nextNonce
+{
+    NSMutableData *nonce = [NSMutableData dataWithLength:_length];
+    if (![self getNonces:[nonce mutableBytes] count:1 error:NULL])
+        return nil;
+    return nonce;
+}
+
+- (BOOL)getNonces:(void *)output count:(NSUInteger)count error:(NSError **)error
+{
+    if (count == 0)
+        return YES;
+    if (_random) {
+        LKKCRandomBytes(output, count * _length);
+        return YES;
+    }
+    
+    // Reserve a range of counter values; other threads get disjoint ranges.
+    int64_t start;
+    do {
+        start = _counter;
+        if (count > (uint64_t)(_limit - start)) {
+            LKKCReportError(errSecParam, error, @"Nonce counter exhausted");
+            return NO;
+        }
+    } while (!OSAtomicCompareAndSwap64Barrier(start, start + (int64_t)count, &_counter));
+    
+    uint8_t *nonce = output;
+    size_t counterLength = _length - _prefixLength;
+    for (NSUInteger i = 0; i < count; i++) {
+        memcpy(nonce, _prefix, _prefixLength);
+        uint64_t counter = (uint64_t)start + i;
+        for (size_t k = 0; k < counterLength; k++) {
+            nonce[_length - 1 - k] = (uint8_t)counter;
+            counter >>= 8;
+        }
+        nonce += _length;
+    }
+    return YES;
+}
+
+@end
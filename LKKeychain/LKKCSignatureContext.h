@@ -0,0 +1,98 @@
+//
+//  LKKCSignatureContext.h
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright © 2011, Károly Lőrentey. All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//  
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of Károly Lőrentey nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+//  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL KÁROLY LŐRENTEY BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+//  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+#import <Foundation/Foundation.h>
+#import <Security/Security.h>
+#import <LKKeychain/LKKCKey.h>
+
+/** An incremental signing or verification operation with a specific key.
+ 
+ Contexts created for private keys sign data; contexts created for public keys verify signatures.
+ Feed the message to the context in pieces with updateWithData:error:, then finish with
+ signWithError: or verifySignature:error:. After that, the context can be used for a new message.
+ 
+ Contexts are not thread-safe.
+ */
+@interface LKKCSignatureContext : NSObject
+{
+@private
+    SecKeyRef _skey;
+    CSSM_CC_HANDLE _cchandle;
+    BOOL _signing;
+    BOOL _started;
+}
+
+/** Create a new signature context.
+ @param key A private key for signing, or a public key for verification. RSA, DSA and ECDSA keys are supported.
+ @param digestAlgorithm The digest algorithm to use. DSA keys only support SHA-1.
+ @param error On output, the error that occurred in case the context could not be created (optional).
+ @return A new signature context, or nil on error.
+ */
++ (LKKCSignatureContext *)signatureContextForKey:(LKKCKey *)key 
+                                 digestAlgorithm:(LKKCDigestAlgorithm)digestAlgorithm 
+                                           error:(NSError **)error;
+
+/** Whether this context signs data (YES) or verifies signatures (NO). */
+@property (nonatomic, readonly, getter = isSigning) BOOL signing;
+
+/** --------------------------------------------------------------------------------
+ @name Incremental Operation
+ -------------------------------------------------------------------------------- */
+
+/** Add the next piece of the message. */
+- (BOOL)updateWithData:(NSData *)data error:(NSError **)error;
+
+/** Add the next piece of the message. */
+- (BOOL)updateWithBytes:(const void *)bytes length:(size_t)length error:(NSError **)error;
+
+/** Finish the message and return its signature. Only works with private keys. */
+- (NSData *)signWithError:(NSError **)error;
+
+/** Finish the message and check it against `signature`. Only works with public keys.
+ @return YES if the signature is valid. If it isn't, `error` is set to a CSSMERR_CSP_VERIFY_FAILED error.
+ */
+- (BOOL)verifySignature:(NSData *)signature error:(NSError **)error;
+
+/** --------------------------------------------------------------------------------
+ @name Single Messages
+ -------------------------------------------------------------------------------- */
+
+/** Sign a complete message. */
+- (NSData *)signData:(NSData *)data error:(NSError **)error;
+
+/** Verify the signature of a complete message. */
+- (BOOL)verifySignature:(NSData *)signature forData:(NSData *)data error:(NSError **)error;
+
+@end
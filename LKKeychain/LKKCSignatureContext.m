@@ -0,0 +1,267 @@
+//
+//  LKKCSignatureContext.m
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright © 2011, Károly Lőrentey. All rights reserved.
+//  
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//  
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of Károly Lőrentey nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//  
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+//  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+//  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//  DISCLAIMED. IN NO EVENT SHALL KÁROLY LŐRENTEY BE LIABLE FOR ANY
+//  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+//  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+//  GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+//  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+//  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+#import "LKKCSignatureContext.h"
+#import "LKKCKey.h"
+#import "LKKCUtil.h"
+
+// Signature algorithms, indexed by LKKCDigestAlgorithm.
+static const CSSM_ALGORITHMS rsaSignatureAlgorithms[] = {
+    CSSM_ALGID_SHA1WithRSA,
+    CSSM_ALGID_SHA224WithRSA,
+    CSSM_ALGID_SHA256WithRSA,
+    CSSM_ALGID_SHA384WithRSA,
+    CSSM_ALGID_SHA512WithRSA
+};
+
+static const CSSM_ALGORITHMS ecdsaSignatureAlgorithms[] = {
+    CSSM_ALGID_SHA1WithECDSA,
+    CSSM_ALGID_SHA224WithECDSA,
+    CSSM_ALGID_SHA256WithECDSA,
+    CSSM_ALGID_SHA384WithECDSA,
+    CSSM_ALGID_SHA512WithECDSA
+};
+
+static const CSSM_ALGORITHMS dsaSignatureAlgorithms[] = {
+    CSSM_ALGID_SHA1WithDSA,
+    CSSM_ALGID_NONE,
+    CSSM_ALGID_NONE,
+    CSSM_ALGID_NONE,
+    CSSM_ALGID_NONE
+};
+
+static const int cDigestAlgorithms = sizeof(rsaSignatureAlgorithms) / sizeof(CSSM_ALGORITHMS);
+
+@interface LKKCSignatureContext()
+- (id)initWithSecKey:(SecKeyRef)skey ccHandle:(CSSM_CC_HANDLE)cchandle signing:(BOOL)signing;
+- (BOOL)_startWithError:(NSError **)error;
+@end
+
+@implementation LKKCSignatureContext
+
++ (LKKCSignatureContext *)signatureContextForKey:(LKKCKey *)key 
+                                 digestAlgorithm:(LKKCDigestAlgorithm)digestAlgorithm 
+                                           error:(NSError **)error
+{
+    SecKeyRef skey = key.SecKey;
+    if (skey == nil) {
+        LKKCReportError(errSecInvalidKeyRef, error, @"Key has been deleted");
+        return nil;
+    }
+    
+    BOOL signing;
+    switch (key.keyClass) {
+        case LKKCKeyClassPrivate:
+            signing = YES;
+            break;
+        case LKKCKeyClassPublic:
+            signing = NO;
+            break;
+        default:
+            LKKCReportError(errSecParam, error, @"Signatures need a public or private key");
+            return nil;
+    }
+    
+    CSSM_CSP_HANDLE csphandle = 0;
+    OSStatus status = SecKeyGetCSPHandle(skey, &csphandle);
+    if (status) {
+        LKKCReportError(status, error, @"Can't get CSP handle");
+        return nil;
+    }
+    
+    const CSSM_KEY *cssmkey = NULL;
+    status = SecKeyGetCSSMKey(skey, &cssmkey);
+    if (status) {
+        LKKCReportError(status, error, @"Can't get CSSM key");
+        return nil;
+    }
+    
+    // Public keys don't have an ACL.
+    const CSSM_ACCESS_CREDENTIALS *scredentials = NULL;
+    if (signing) {
+        status = SecKeyGetCredentials(skey, CSSM_ACL_AUTHORIZATION_SIGN, kSecCredentialTypeDefault, &scredentials);
+        if (status) {
+            LKKCReportError(status, error, @"Can't get credentials");
+            return nil;
+        }
+    }
+    
+    if (digestAlgorithm < 0 || digestAlgorithm >= cDigestAlgorithms) {
+        LKKCReportError(errSecParam, error, @"Invalid digest algorithm");
+        return nil;
+    }
+    CSSM_ALGORITHMS algid;
+    switch (cssmkey->KeyHeader.AlgorithmId) {
+        case CSSM_ALGID_RSA:
+            algid = rsaSignatureAlgorithms[digestAlgorithm];
+            break;
+        case CSSM_ALGID_ECDSA:
+            algid = ecdsaSignatureAlgorithms[digestAlgorithm];
+            break;
+        case CSSM_ALGID_DSA:
+            algid = dsaSignatureAlgorithms[digestAlgorithm];
+            break;
+        default:
+            algid = CSSM_ALGID_NONE;
+            break;
+    }
+    if (algid == CSSM_ALGID_NONE) {
+        LKKCReportError(errSecInvalidAlgorithm, error, @"Unsupported key type or digest algorithm");
+        return nil;
+    }
+    
+    CSSM_CC_HANDLE cchandle = 0;
+    status = CSSM_CSP_CreateSignatureContext(csphandle, algid, scredentials, cssmkey, &cchandle);
+    if (status) {
+        LKKCReportError(status, error, @"Can't create signature context");
+        return nil;
+    }
+    return [[[LKKCSignatureContext alloc] initWithSecKey:skey ccHandle:cchandle signing:signing] autorelease];
+}
+
+- (id)initWithSecKey:(SecKeyRef)skey ccHandle:(CSSM_CC_HANDLE)cchandle signing:(BOOL)signing
+{
+    self = [super init];
+    if (self == nil)
+        return nil;
+    _skey = (SecKeyRef)CFRetain(skey);
+    _cchandle = cchandle;
+    _signing = signing;
+    _started = NO;
+    return self;
+}
+
+- (void)dealloc
+{
+    CSSM_DeleteContext(_cchandle);
+    CFRelease(_skey);
+    [super dealloc];
+}
+
+@synthesize signing = _signing;
+
+#pragma mark - Incremental Operation
+
+- (BOOL)_startWithError:(NSError **)error
+{
+    if (_started)
+        return YES;
+    OSStatus status = (_signing ? CSSM_SignDataInit(_cchandle) : CSSM_VerifyDataInit(_cchandle));
+    if (status) {
+        LKKCReportError(status, error, @"Can't start signature operation");
+        return NO;
+    }
+    _started = YES;
+    return YES;
+}
+
+- (BOOL)updateWithBytes:(const void *)bytes length:(size_t)length error:(NSError **)error
+{
+    if (![self _startWithError:error])
+        return NO;
+    CSSM_DATA input = { .Length = length, .Data = (void *)bytes };
+    OSStatus status = (_signing ? CSSM_SignDataUpdate(_cchandle, &input, 1) : CSSM_VerifyDataUpdate(_cchandle, &input, 1));
+    if (status) {
+        _started = NO;
+        LKKCReportError(status, error, @"Can't process data");
+        return NO;
+    }
+    return YES;
+}
+
+- (BOOL)updateWithData:(NSData *)data error:(NSError **)error
+{
+    return [self updateWithBytes:[data bytes] length:[data length] error:error];
+}
+
+- (NSData *)signWithError:(NSError **)error
+{
+    if (!_signing) {
+        LKKCReportError(errSecParam, error, @"Can't sign with a public key");
+        return nil;
+    }
+    if (![self _startWithError:error])
+        return nil;
+    CSSM_DATA signature = { .Length = 0, .Data = NULL };
+    OSStatus status = CSSM_SignDataFinal(_cchandle, &signature);
+    _started = NO;
+    if (status) {
+        LKKCReportError(status, error, @"Can't sign data");
+        return nil;
+    }
+    return [NSData dataWithBytesNoCopy:signature.Data length:signature.Length freeWhenDone:YES];
+}
+
+- (BOOL)verifySignature:(NSData *)signature error:(NSError **)error
+{
+    if (_signing) {
+        LKKCReportError(errSecParam, error, @"Can't verify signatures with a private key");
+        return NO;
+    }
+    if (![self _startWithError:error])
+        return NO;
+    CSSM_DATA cssmSignature = { .Length = [signature length], .Data = (void *)[signature bytes] };
+    OSStatus status = CSSM_VerifyDataFinal(_cchandle, &cssmSignature);
+    _started = NO;
+    if (status) {
+        // Invalid signatures are routine during verification; don't log them.
+        if (status == CSSMERR_CSP_VERIFY_FAILED) {
+            if (error != NULL)
+                *error = [NSError errorWithDomain:(NSString *)LKKCErrorDomain code:status userInfo:nil];
+            return NO;
+        }
+        LKKCReportError(status, error, @"Can't verify signature");
+        return NO;
+    }
+    return YES;
+}
+
+#pragma mark - Single Messages
+
+- (NSData *)signData:(NSData *)data error:(NSError **)error
+{
+    if (![self updateWithData:data error:error])
+        return nil;
+    return [self signWithError:error];
+}
+
+- (BOOL)verifySignature:(NSData *)signature forData:(NSData *)data error:(NSError **)error
+{
+    if (![self updateWithData:data error:error])
+        return NO;
+    return [self verifySignature:signature error:error];
+}
+
+@end
@@ -42,4 +42,43 @@
 void LKKCReportErrorImpl(char *file, int line, OSStatus status, NSError **error, NSString *message, ...) NS_FORMAT_FUNCTION(5, 6);
 void LKKCReportErrorObjImpl(char *file, int line, NSError *errorIn, NSError **errorOut, NSString *message, ...) NS_FORMAT_FUNCTION(5, 6);
 
-extern const NSString *const LKKCErrorDomain;
\ No newline at end of file
+extern const NSString *const LKKCErrorDomain;
+
+// Clear memory that held key material; unlike bzero, this isn't optimized away.
+void LKKCWipe(void *bytes, size_t length);
+
+// Fill bytes with cryptographically secure random data. Small requests are served from a per-thread buffer
+// of arc4random output, so IVs and nonces don't pay for a generator call each. Bytes are erased from the buffer 
+// as they are handed out, and a forked child never reuses its parent's buffer.
+void LKKCRandomBytes(void *bytes, size_t length);
+
+// Return an immutable NSData for length bytes starting at bytes, which must lie within data. 
+// The bytes aren't copied; the result keeps data alive instead.
+NSData *LKKCDataSlice(NSData *data, const void *bytes, size_t length);
+
+// Call body for every index in [0, count) using all available cores. 
+// Each worker thread calls setup once, passes its result to all of its body calls, then passes it to teardown (optional).
+// Workers claim indices from a shared counter, so the load balances itself when some indices take longer than others.
+// Stops early if setup or body fails, and returns NO with the first error in *error (if given).
+BOOL LKKCParallelApply(NSUInteger count, 
+                       id (^setup)(NSError **error), 
+                       BOOL (^body)(id state, NSUInteger index, NSError **error), 
+                       void (^teardown)(id state), 
+                       NSError **error);
+// A lock-free pool of idle objects, such as crypto contexts.
+// Each thread starts searching at a slot derived from its identity, so threads rarely touch 
+// the same slots and a thread usually gets back the object it returned most recently.
+// A non-NULL slot owns a reference to its object.
+typedef struct LKKCObjectPool LKKCObjectPool;
+
+// Return *pool, creating it with the given number of slots if it's NULL. Safe to call from multiple threads.
+// Returns NULL if the pool can't be allocated; the other functions accept a NULL pool and treat it as empty and full.
+LKKCObjectPool *LKKCObjectPoolGet(LKKCObjectPool *volatile *pool, NSUInteger capacity);
+// Release all idle objects and free the pool. The pool must not be in use.
+void LKKCObjectPoolDestroy(LKKCObjectPool *pool);
+// Remove an idle object from the pool and return it autoreleased, or return nil if the pool is empty.
+id LKKCObjectPoolCheckOut(LKKCObjectPool *pool);
+// Add an idle object to the pool. Returns NO (without retaining the object) if all slots are taken.
+BOOL LKKCObjectPoolCheckIn(LKKCObjectPool *pool, id object);
+// Release all idle objects.
+void LKKCObjectPoolDrain(LKKCObjectPool *pool);
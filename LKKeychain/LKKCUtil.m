@@ -34,9 +34,138 @@
 // 
 
 #import "LKKCUtil.h"
+#import <libkern/OSAtomic.h>
+#import <pthread.h>
 
 NSString *const LKKCErrorDomain = @"LKKeychain";
 
+void
+LKKCWipe(void *bytes, size_t length)
+{
+    volatile uint8_t *p = bytes;
+    while (length--)
+        *p++ = 0;
+}
+
+#define LKKCRandomBufferLength 4096
+
+typedef struct {
+    size_t available; // Unused bytes at the end of the buffer.
+    uint8_t bytes[LKKCRandomBufferLength];
+} LKKCRandomBuffer;
+
+static pthread_key_t randomBufferKey;
+static pthread_once_t randomBufferOnce = PTHREAD_ONCE_INIT;
+
+static void
+LKKCRandomBufferDestroy(void *buffer)
+{
+    LKKCWipe(buffer, sizeof(LKKCRandomBuffer));
+    free(buffer);
+}
+
+// The child of a fork inherits the buffer of the forking thread; make sure it doesn't hand out the same bytes as the parent.
+static void
+LKKCRandomBufferForkChild(void)
+{
+    LKKCRandomBuffer *buffer = pthread_getspecific(randomBufferKey);
+    if (buffer != NULL) {
+        LKKCWipe(buffer->bytes, sizeof(buffer->bytes));
+        buffer->available = 0;
+    }
+}
+
+static void
+LKKCRandomBufferInitialize(void)
+{
+    pthread_key_create(&randomBufferKey, LKKCRandomBufferDestroy);
+    pthread_atfork(NULL, NULL, LKKCRandomBufferForkChild);
+}
+
+void
+LKKCRandomBytes(void *bytes, size_t length)
+{
+    // Large requests wouldn't gain anything from buffering.
+    if (length >= LKKCRandomBufferLength / 4) {
+        arc4random_buf(bytes, length);
+        return;
+    }
+    pthread_once(&randomBufferOnce, LKKCRandomBufferInitialize);
+    LKKCRandomBuffer *buffer = pthread_getspecific(randomBufferKey);
+    if (buffer == NULL) {
+        buffer = calloc(1, sizeof(LKKCRandomBuffer));
+        if (buffer == NULL || pthread_setspecific(randomBufferKey, buffer) != 0) {
+            free(buffer);
+            arc4random_buf(bytes, length);
+            return;
+        }
+    }
+    uint8_t *output = bytes;
+    while (length > 0) {
+        if (buffer->available == 0) {
+            arc4random_buf(buffer->bytes, sizeof(buffer->bytes));
+            buffer->available = sizeof(buffer->bytes);
+        }
+        size_t count = MIN(length, buffer->available);
+        uint8_t *source = buffer->bytes + sizeof(buffer->bytes) - buffer->available;
+        memcpy(output, source, count);
+        LKKCWipe(source, count);
+        buffer->available -= count;
+        output += count;
+        length -= count;
+    }
+}
+
+// An NSData whose bytes belong to another NSData.
+@interface LKKCSlicedData : NSData
+{
+@private
+    NSData *_parent;
+    const void *_bytes;
+    NSUInteger _length;
+}
+- (id)initWithParent:(NSData *)parent bytes:(const void *)bytes length:(NSUInteger)length;
+@end
+
+@implementation LKKCSlicedData
+
+- (id)initWithParent:(NSData *)parent bytes:(const void *)bytes length:(NSUInteger)length
+{
+    self = [super init];
+    if (self == nil)
+        return nil;
+    _parent = [parent retain];
+    _bytes = bytes;
+    _length = length;
+    return self;
+}
+
+- (void)dealloc
+{
+    [_parent release];
+    [super dealloc];
+}
+
+- (const void *)bytes
+{
+    return _bytes;
+}
+
+- (NSUInteger)length
+{
+    return _length;
+}
+
+@end
+
+NSData *
+LKKCDataSlice(NSData *data, const void *bytes, size_t length)
+{
+    NSCAssert((const uint8_t *)bytes >= (const uint8_t *)[data bytes] 
+              && (const uint8_t *)bytes + length <= (const uint8_t *)[data bytes] + [data length], @"Slice out of bounds");
+    return [[[LKKCSlicedData alloc] initWithParent:data bytes:bytes length:length] autorelease];
+}
+
 void 
 LKKCReportErrorImpl(char *file, int line, OSStatus status, NSError **error, NSString *message, ...)
 {
@@ -69,3 +198,132 @@ LKKCReportErrorObjImpl(char *file, int line, NSError *errorIn, NSError **errorOu
         *errorOut = errorIn;
     }
 }
+
+BOOL
+LKKCParallelApply(NSUInteger count, 
+                  id (^setup)(NSError **error), 
+                  BOOL (^body)(id state, NSUInteger index, NSError **error), 
+                  void (^teardown)(id state), 
+                  NSError **error)
+{
+    if (count == 0)
+        return YES;
+    NSUInteger workers = MIN(count, [[NSProcessInfo processInfo] activeProcessorCount]);
+    __block volatile int64_t next = 0;
+    __block volatile BOOL failed = NO;
+    __block NSError *failure = nil;
+    NSObject *lock = [[NSObject alloc] init];
+    dispatch_apply(workers, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t worker) {
+        @autoreleasepool {
+            NSError *e = nil;
+            id state = setup(&e);
+            BOOL ok = (state != nil);
+            while (ok && !failed) {
+                int64_t index = OSAtomicIncrement64Barrier(&next) - 1;
+                if (index >= (int64_t)count)
+                    break;
+                ok = body(state, (NSUInteger)index, &e);
+            }
+            if (state != nil && teardown != nil)
+                teardown(state);
+            if (!ok) {
+                @synchronized(lock) {
+                    if (failure == nil)
+                        failure = [e retain];
+                    failed = YES;
+                }
+            }
+        }
+    });
+    [lock release];
+    if (failed) {
+        if (error != NULL)
+            *error = [failure autorelease];
+        else
+            [failure release];
+        return NO;
+    }
+    return YES;
+}
+
+struct LKKCObjectPool {
+    NSUInteger capacity;
+    void *volatile slots[];
+};
+
+static inline NSUInteger
+LKKCObjectPoolHomeSlot(LKKCObjectPool *pool)
+{
+    // Fibonacci hashing spreads the (aligned) pthread addresses over the slots.
+    uint64_t hash = (uint64_t)(uintptr_t)pthread_self() * 0x9e3779b97f4a7c15ULL;
+    return (NSUInteger)((hash >> 32) % pool->capacity);
+}
+
+LKKCObjectPool *
+LKKCObjectPoolGet(LKKCObjectPool *volatile *pool, NSUInteger capacity)
+{
+    LKKCObjectPool *result = *pool;
+    if (result != NULL)
+        return result;
+    LKKCObjectPool *newPool = calloc(1, sizeof(LKKCObjectPool) + capacity * sizeof(void *));
+    if (newPool == NULL)
+        return NULL;
+    newPool->capacity = capacity;
+    if (OSAtomicCompareAndSwapPtrBarrier(NULL, newPool, (void *volatile *)pool))
+        return newPool;
+    free(newPool);
+    return *pool;
+}
+
+void
+LKKCObjectPoolDestroy(LKKCObjectPool *pool)
+{
+    if (pool == NULL)
+        return;
+    LKKCObjectPoolDrain(pool);
+    free(pool);
+}
+
+id
+LKKCObjectPoolCheckOut(LKKCObjectPool *pool)
+{
+    if (pool == NULL)
+        return nil;
+    NSUInteger home = LKKCObjectPoolHomeSlot(pool);
+    for (NSUInteger i = 0; i < pool->capacity; i++) {
+        void *volatile *slot = &pool->slots[(home + i) % pool->capacity];
+        void *object = *slot;
+        if (object != NULL && OSAtomicCompareAndSwapPtrBarrier(object, NULL, slot))
+            return [(id)object autorelease];
+    }
+    return nil;
+}
+
+BOOL
+LKKCObjectPoolCheckIn(LKKCObjectPool *pool, id object)
+{
+    if (pool == NULL)
+        return NO;
+    NSUInteger home = LKKCObjectPoolHomeSlot(pool);
+    [object retain];
+    for (NSUInteger i = 0; i < pool->capacity; i++) {
+        void *volatile *slot = &pool->slots[(home + i) % pool->capacity];
+        if (*slot == NULL && OSAtomicCompareAndSwapPtrBarrier(NULL, object, slot))
+            return YES;
+    }
+    [object release];
+    return NO;
+}
+
+void
+LKKCObjectPoolDrain(LKKCObjectPool *pool)
+{
+    if (pool == NULL)
+        return;
+    for (NSUInteger i = 0; i < pool->capacity; i++) {
+        void *volatile *slot = &pool->slots[i];
+        void *object = *slot;
+        if (object != NULL && OSAtomicCompareAndSwapPtrBarrier(object, NULL, slot))
+            [(id)object release];
+    }
+}
@@ -37,9 +37,17 @@
 #import <LKKeychain/LKKCKeychainItem.h>
 #import <LKKeychain/LKKCGenericPassword.h>
 #import <LKKeychain/LKKCInternetPassword.h>
+#import <LKKeychain/LKKCInternetPasswordResolver.h>
 #import <LKKeychain/LKKCCertificate.h>
 #import <LKKeychain/LKKCKey.h>
 #import <LKKeychain/LKKCIdentity.h>
 #import <LKKeychain/LKKCKeyPair.h>
 #import <LKKeychain/LKKCKeyGenerator.h>
+#import <LKKeychain/LKKCKeyDeriver.h>
+#import <LKKeychain/LKKCNonceGenerator.h>
+#import <LKKeychain/LKKCCryptoContext.h>
+#import <LKKeychain/LKKCSignatureContext.h>
+#import <LKKeychain/LKKCDigestContext.h>
+#import <LKKeychain/LKKCEngine.h>
+#import <LKKeychain/LKKCDER.h>
 #import <LKKeychain/LKKCTrust.h>
\ No newline at end of file
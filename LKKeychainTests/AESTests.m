@@ -7,6 +7,8 @@
 //
 
 #import "AESTests.h"
+#import <fcntl.h>
+#import <libkern/OSAtomic.h>
 
 @implementation AESTests
 
@@ -180,4 +182,513 @@
     shouldBeEqual(decryptedtext, plaintext);
 }
 
+- (void)testAESStreaming
+{
+    NSError *error = nil;
+    LKKCKeyGenerator *generator = [LKKCKeyGenerator generatorWithKeychain:nil];
+    LKKCKey *key = [generator generateAESKeyWithError:&error];
+    should(key != nil);
+    NSData *iv = [key randomInitVector];
+    
+    // Use a message that spans several stream buffers and doesn't end on a block boundary.
+    NSMutableData *plaintext = [NSMutableData dataWithLength:3 * LKKCCryptoContextStreamBufferSize + 7];
+    arc4random_buf([plaintext mutableBytes], [plaintext length]);
+    NSData *ciphertext = [key encryptData:plaintext initVector:iv error:&error];
+    should(ciphertext != nil);
+    
+    // Incremental encryption in uneven chunks.
+    LKKCCryptoContext *cc = [LKKCCryptoContext cryptoContextForKey:key operation:CSSM_ACL_AUTHORIZATION_ENCRYPT initVector:iv error:&error];
+    should(cc != nil);
+    NSMutableData *result = [NSMutableData data];
+    for (NSUInteger offset = 0; offset < [plaintext length]; offset += 1000) {
+        NSRange range = NSMakeRange(offset, MIN(1000, [plaintext length] - offset));
+        NSData *output = [cc updateWithData:[plaintext subdataWithRange:range] error:&error];
+        should(output != nil);
+        [result appendData:output];
+    }
+    NSData *output = [cc finishWithError:&error];
+    should(output != nil);
+    [result appendData:output];
+    shouldBeEqual(result, ciphertext);
+    
+    // The context can be reused after it is finished.
+    result = [NSMutableData dataWithData:[cc updateWithData:plaintext error:&error]];
+    [result appendData:[cc finishWithError:&error]];
+    shouldBeEqual(result, ciphertext);
+    
+    // Streams.
+    NSInputStream *inputStream = [NSInputStream inputStreamWithData:plaintext];
+    NSOutputStream *outputStream = [NSOutputStream outputStreamToMemory];
+    BOOL success = [cc processInputStream:inputStream outputStream:outputStream error:&error];
+    should(success);
+    shouldBeEqual([outputStream propertyForKey:NSStreamDataWrittenToMemoryStreamKey], ciphertext);
+    [inputStream close];
+    [outputStream close];
+    
+    // File descriptors.
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSProcessInfo processInfo] globallyUniqueString]];
+    success = [ciphertext writeToFile:path atomically:NO];
+    should(success);
+    int pipefds[2];
+    should(pipe(pipefds) == 0);
+    int fd = open([path fileSystemRepresentation], O_RDONLY);
+    should(fd >= 0);
+    LKKCCryptoContext *dc = [LKKCCryptoContext cryptoContextForKey:key operation:CSSM_ACL_AUTHORIZATION_DECRYPT initVector:iv error:&error];
+    should(dc != nil);
+    __block NSData *decrypted = nil;
+    dispatch_group_t group = dispatch_group_create();
+    dispatch_group_async(group, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        NSFileHandle *handle = [[NSFileHandle alloc] initWithFileDescriptor:pipefds[0] closeOnDealloc:YES];
+        decrypted = [[handle readDataToEndOfFile] retain];
+        [handle release];
+    });
+    success = [dc processFileDescriptor:fd outputFileDescriptor:pipefds[1] error:&error];
+    should(success);
+    close(pipefds[1]);
+    close(fd);
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    dispatch_release(group);
+    shouldBeEqual(decrypted, plaintext);
+    [decrypted release];
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+    
+    // Streaming doesn't work with asymmetric keys.
+    LKKCKeyPair *keypair = [[LKKCKeyGenerator generatorWithKeychain:_keychain] generateRSAKeyPairWithError:&error];
+    should(keypair != nil);
+    LKKCCryptoContext *rc = [LKKCCryptoContext cryptoContextForKey:keypair.publicKey operation:CSSM_ACL_AUTHORIZATION_ENCRYPT initVector:nil error:&error];
+    should(rc != nil);
+    should([rc updateWithData:plaintext error:&error] == nil);
+    should([error code] == errSecParam);
+}
+
+- (void)testAESContextReuse
+{
+    NSError *error = nil;
+    LKKCKeyGenerator *generator = [LKKCKeyGenerator generatorWithKeychain:_keychain];
+    LKKCKey *key = [generator generateAESKeyWithError:&error];
+    should(key != nil);
+    NSData *plaintext = [@"This is some sample plaintext" dataUsingEncoding:NSUTF8StringEncoding];
+    
+    // Pooled contexts must produce the same results as fresh ones, even when the IV changes.
+    for (int i = 0; i < 10; i++) {
+        NSData *iv = [key randomInitVector];
+        NSData *ciphertext = [key encryptData:plaintext initVector:iv error:&error];
+        should(ciphertext != nil);
+        LKKCCryptoContext *cc = [LKKCCryptoContext cryptoContextForKey:key operation:CSSM_ACL_AUTHORIZATION_ENCRYPT initVector:iv error:&error];
+        shouldBeEqual([cc encryptData:plaintext error:&error], ciphertext);
+        shouldBeEqual([key decryptData:ciphertext initVector:iv error:&error], plaintext);
+    }
+    
+    // A context can be re-keyed explicitly.
+    NSData *iv1 = [key randomInitVector];
+    NSData *iv2 = [key randomInitVector];
+    LKKCCryptoContext *cc = [LKKCCryptoContext cryptoContextForKey:key operation:CSSM_ACL_AUTHORIZATION_ENCRYPT initVector:iv1 error:&error];
+    should(cc != nil);
+    should([cc resetWithInitVector:iv2 error:&error]);
+    shouldBeEqual(cc.initVector, iv2);
+    shouldBeEqual([cc encryptData:plaintext error:&error], [key encryptData:plaintext initVector:iv2 error:&error]);
+    should(![cc resetWithInitVector:nil error:&error]);
+    
+    // The error argument is optional.
+    should([key encryptData:plaintext initVector:nil error:NULL] == nil);
+    
+    // Deleted keys don't reuse their old contexts.
+    should([key deleteItemWithError:&error]);
+    should([key encryptData:plaintext initVector:iv1 error:&error] == nil);
+    should([error code] == errSecInvalidKeyRef);
+}
+
+- (void)testAESConcurrentContexts
+{
+    NSError *error = nil;
+    LKKCKeyGenerator *generator = [LKKCKeyGenerator generatorWithKeychain:_keychain];
+    LKKCKey *key = [generator generateAESKeyWithError:&error];
+    should(key != nil);
+    
+    // Many threads sharing a key each get a working context from the pool.
+    const NSUInteger count = 2000;
+    __block volatile int32_t failures = 0;
+    dispatch_apply(count, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+        @autoreleasepool {
+            NSData *plaintext = [[NSString stringWithFormat:@"Message %lu", (unsigned long)i] dataUsingEncoding:NSUTF8StringEncoding];
+            NSData *iv = [key randomInitVector];
+            NSData *ciphertext = [key encryptData:plaintext initVector:iv error:NULL];
+            if (ciphertext == nil || ![[key decryptData:ciphertext initVector:iv error:NULL] isEqualToData:plaintext])
+                OSAtomicIncrement32Barrier(&failures);
+        }
+    });
+    should(failures == 0);
+    
+    // Deleting the key drops the pooled contexts.
+    NSData *iv = [key randomInitVector];
+    should([key deleteItemWithError:&error]);
+    should([key encryptData:[@"x" dataUsingEncoding:NSUTF8StringEncoding] initVector:iv error:NULL] == nil);
+}
+
+- (void)testAESBatch
+{
+    NSError *error = nil;
+    LKKCKey *key = [[LKKCKeyGenerator generatorWithKeychain:_keychain] generateAESKeyWithError:&error];
+    should(key != nil);
+    
+    const NSUInteger count = 100;
+    LKKCCryptoBatchItem items[count];
+    NSMutableArray *messages = [NSMutableArray array];
+    NSMutableArray *ivs = [NSMutableArray array];
+    size_t capacity = 0;
+    for (NSUInteger i = 0; i < count; i++) {
+        NSMutableData *message = [NSMutableData dataWithLength:i * 7];
+        arc4random_buf([message mutableBytes], [message length]);
+        NSData *iv = [key randomInitVector];
+        [messages addObject:message];
+        [ivs addObject:iv];
+        items[i].bytes = [message bytes];
+        items[i].length = [message length];
+        items[i].initVector = [iv bytes];
+        capacity += [key encryptedLengthForPlaintextLength:[message length]];
+    }
+    
+    NSMutableData *ciphertext = [NSMutableData dataWithLength:capacity];
+    size_t offsets[count + 1];
+    BOOL result = [key encryptBatch:items count:count output:[ciphertext mutableBytes] capacity:capacity offsets:offsets error:&error];
+    should(result);
+    should(offsets[count] == capacity);
+    for (NSUInteger i = 0; i < count; i++) {
+        NSData *expected = [key encryptData:[messages objectAtIndex:i] initVector:[ivs objectAtIndex:i] error:&error];
+        shouldBeEqual([ciphertext subdataWithRange:NSMakeRange(offsets[i], offsets[i + 1] - offsets[i])], expected);
+        items[i].bytes = (const uint8_t *)[ciphertext bytes] + offsets[i];
+        items[i].length = offsets[i + 1] - offsets[i];
+    }
+    
+    NSMutableData *plaintext = [NSMutableData dataWithLength:capacity];
+    size_t plainOffsets[count + 1];
+    result = [key decryptBatch:items count:count output:[plaintext mutableBytes] capacity:capacity offsets:plainOffsets error:&error];
+    should(result);
+    for (NSUInteger i = 0; i < count; i++) {
+        shouldBeEqual([plaintext subdataWithRange:NSMakeRange(plainOffsets[i], plainOffsets[i + 1] - plainOffsets[i])], [messages objectAtIndex:i]);
+    }
+    
+    // Too small output buffers are reported as errors.
+    result = [key decryptBatch:items count:count output:[plaintext mutableBytes] capacity:capacity / 2 offsets:plainOffsets error:&error];
+    should(!result);
+}
+
+- (void)testAESCallerProvidedOutput
+{
+    NSError *error = nil;
+    LKKCKey *key = [[LKKCKeyGenerator generatorWithKeychain:_keychain] generateAESKeyWithError:&error];
+    should(key != nil);
+    NSData *iv = [key randomInitVector];
+    NSData *plaintext = [@"This is some sample plaintext" dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *expected = [key encryptData:plaintext initVector:iv error:&error];
+    
+    LKKCCryptoContext *cc = [LKKCCryptoContext cryptoContextForKey:key operation:CSSM_ACL_AUTHORIZATION_ENCRYPT initVector:iv error:&error];
+    should(cc != nil);
+    should(!cc.supportsInPlaceOperation);
+    should([cc outputLengthForInputLength:[plaintext length]] == [expected length]);
+    should([cc outputLengthForInputLength:32] == 48);
+    
+    // Raw buffers.
+    uint8_t buffer[64];
+    size_t length = 0;
+    BOOL result = [cc encryptBytes:[plaintext bytes] length:[plaintext length] output:buffer capacity:sizeof(buffer) outputLength:&length error:&error];
+    should(result);
+    shouldBeEqual([NSData dataWithBytes:buffer length:length], expected);
+    
+    // Block ciphers can't work in place.
+    result = [cc encryptBytes:buffer length:16 output:buffer capacity:sizeof(buffer) outputLength:&length error:&error];
+    should(!result);
+    should([error code] == errSecParam);
+    
+    // Appending to mutable data.
+    NSMutableData *packet = [NSMutableData dataWithBytes:"HDR" length:3];
+    result = [cc encryptData:plaintext appendingToData:packet error:&error];
+    should(result);
+    should([packet length] == 3 + [expected length]);
+    shouldBeEqual([packet subdataWithRange:NSMakeRange(3, [expected length])], expected);
+    
+    LKKCCryptoContext *dc = [LKKCCryptoContext cryptoContextForKey:key operation:CSSM_ACL_AUTHORIZATION_DECRYPT initVector:iv error:&error];
+    NSMutableData *decrypted = [NSMutableData data];
+    result = [dc decryptData:expected appendingToData:decrypted error:&error];
+    should(result);
+    shouldBeEqual(decrypted, plaintext);
+}
+
+- (void)testRC4InPlace
+{
+    NSError *error = nil;
+    NSData *keyData = [NSData dataWithBytes:"\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f\x10" length:16];
+    LKKCKey *key = [LKKCKey keyWithData:keyData keyClass:LKKCKeyClassSymmetric keyType:LKKCKeyTypeRC4 keySize:128];
+    should(key != nil);
+    NSData *iv = [NSData dataWithBytes:"\0" length:1];
+    NSData *plaintext = [@"This is some sample plaintext" dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *expected = [key encryptData:plaintext initVector:iv error:&error];
+    should(expected != nil);
+    
+    LKKCCryptoContext *cc = [LKKCCryptoContext cryptoContextForKey:key operation:CSSM_ACL_AUTHORIZATION_ENCRYPT initVector:iv error:&error];
+    should(cc.supportsInPlaceOperation);
+    should([cc outputLengthForInputLength:[plaintext length]] == [plaintext length]);
+    NSMutableData *buffer = [NSMutableData dataWithData:plaintext];
+    size_t length = 0;
+    BOOL result = [cc encryptBytes:[buffer bytes] length:[buffer length] output:[buffer mutableBytes] capacity:[buffer length] outputLength:&length error:&error];
+    should(result);
+    should(length == [plaintext length]);
+    shouldBeEqual(buffer, expected);
+}
+
+- (void)testAESGCM
+{
+    // Test Case 4 from "The Galois/Counter Mode of Operation (GCM)" by McGrew and Viega.
+    NSError *error = nil;
+    LKKCKey *key = [LKKCKey keyWithData:[self dataFromHex:@"feffe9928665731c6d6a8f9467308308"] keyClass:LKKCKeyClassSymmetric keyType:LKKCKeyTypeAES keySize:128];
+    should(key != nil);
+    NSData *nonce = [self dataFromHex:@"cafebabefacedbaddecaf888"];
+    NSData *plaintext = [self dataFromHex:@"d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39"];
+    NSData *aad = [self dataFromHex:@"feedfacedeadbeeffeedfacedeadbeefabaddad2"];
+    NSData *expectedCiphertext = [self dataFromHex:@"42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091"];
+    NSData *expectedTag = [self dataFromHex:@"5bc94fbc3221a5db94fae95ae7121a47"];
+    
+    NSData *tag = nil;
+    NSData *ciphertext = [key encryptData:plaintext nonce:nonce additionalData:aad tag:&tag error:&error];
+    shouldBeEqual(ciphertext, expectedCiphertext);
+    shouldBeEqual(tag, expectedTag);
+    
+    NSData *decrypted = [key decryptData:ciphertext nonce:nonce additionalData:aad tag:tag error:&error];
+    shouldBeEqual(decrypted, plaintext);
+    
+    // Test Case 6 uses a 60-byte nonce.
+    NSData *longNonce = [self dataFromHex:@"9313225df88406e555909c5aff5269aa6a7a9538534f7da1e4c303d2a318a728c3c0c95156809539fcf0e2429a6b525416aedbf5a0de6a57a637b39b"];
+    ciphertext = [key encryptData:plaintext nonce:longNonce additionalData:aad tag:&tag error:&error];
+    shouldBeEqual(ciphertext, [self dataFromHex:@"8ce24998625615b603a033aca13fb894be9112a5c3a211a8ba262a3cca7e2ca701e4a9a4fba43c90ccdcb281d48c7c6fd62875d2aca417034c34aee5"]);
+    shouldBeEqual(tag, [self dataFromHex:@"619cc5aefffe0bfa462af43c1699d050"]);
+    
+    // Modified ciphertext, additional data or tag must be rejected.
+    NSMutableData *modified = [NSMutableData dataWithData:expectedCiphertext];
+    ((uint8_t *)[modified mutableBytes])[3] ^= 1;
+    should([key decryptData:modified nonce:nonce additionalData:aad tag:expectedTag error:&error] == nil);
+    should([key decryptData:expectedCiphertext nonce:nonce additionalData:nil tag:expectedTag error:&error] == nil);
+    modified = [NSMutableData dataWithData:expectedTag];
+    ((uint8_t *)[modified mutableBytes])[15] ^= 0x80;
+    should([key decryptData:expectedCiphertext nonce:nonce additionalData:aad tag:modified error:&error] == nil);
+}
+
+- (void)testAESGCMRoundTrip
+{
+    NSError *error = nil;
+    LKKCKey *key = [[LKKCKeyGenerator generatorWithKeychain:_keychain] generateAESKeyWithError:&error];
+    should(key != nil);
+    for (NSUInteger length = 0; length < 10000; length = 3 * length + 1) {
+        NSMutableData *plaintext = [NSMutableData dataWithLength:length];
+        arc4random_buf([plaintext mutableBytes], length);
+        NSData *nonce = [key randomNonce];
+        NSData *tag = nil;
+        NSData *ciphertext = [key encryptData:plaintext nonce:nonce additionalData:nil tag:&tag error:&error];
+        should([ciphertext length] == length);
+        should([tag length] == 16);
+        shouldBeEqual([key decryptData:ciphertext nonce:nonce additionalData:nil tag:tag error:&error], plaintext);
+    }
+}
+
+- (void)testAESParallel
+{
+    NSError *error = nil;
+    LKKCKey *key = [[LKKCKeyGenerator generatorWithKeychain:_keychain] generateAESKeyWithError:&error];
+    should(key != nil);
+    
+    NSMutableData *plaintext = [NSMutableData dataWithLength:5 * 1024 * 1024 + 123];
+    arc4random_buf([plaintext mutableBytes], [plaintext length]);
+    NSData *ciphertext = [key encryptDataInParallel:plaintext segmentSize:64 * 1024 error:&error];
+    should(ciphertext != nil);
+    shouldBeEqual([key decryptDataInParallel:ciphertext error:&error], plaintext);
+    
+    // Default segment size and empty messages.
+    shouldBeEqual([key decryptDataInParallel:[key encryptDataInParallel:plaintext error:&error] error:&error], plaintext);
+    shouldBeEqual([key decryptDataInParallel:[key encryptDataInParallel:[NSData data] error:&error] error:&error], [NSData data]);
+    
+    // Any modification is detected: the payload, the header, or the length.
+    NSMutableData *modified = [NSMutableData dataWithData:ciphertext];
+    ((uint8_t *)[modified mutableBytes])[[modified length] / 2] ^= 1;
+    should([key decryptDataInParallel:modified error:&error] == nil);
+    
+    modified = [NSMutableData dataWithData:ciphertext];
+    ((uint8_t *)[modified mutableBytes])[20] ^= 1; // Nonce prefix
+    should([key decryptDataInParallel:modified error:&error] == nil);
+    
+    modified = [NSMutableData dataWithData:ciphertext];
+    [modified setLength:[modified length] - 1];
+    should([key decryptDataInParallel:modified error:&error] == nil);
+    
+    // Swapping two segments is detected.
+    modified = [NSMutableData dataWithData:ciphertext];
+    size_t sealedLength = 64 * 1024 + 16;
+    uint8_t *first = (uint8_t *)[modified mutableBytes] + 28;
+    NSData *saved = [NSData dataWithBytes:first length:sealedLength];
+    memcpy(first, first + sealedLength, sealedLength);
+    memcpy(first + sealedLength, [saved bytes], sealedLength);
+    should([key decryptDataInParallel:modified error:&error] == nil);
+}
+
+- (void)testAESParallelCBCDecryption
+{
+    NSError *error = nil;
+    LKKCKey *key = [[LKKCKeyGenerator generatorWithKeychain:_keychain] generateAESKeyWithError:&error];
+    should(key != nil);
+    NSData *iv = [key randomInitVector];
+    
+    size_t lengths[] = { 0, 15, 16, 17, 64 * 1024 - 1, 64 * 1024, 64 * 1024 + 16, 3 * 1024 * 1024 + 5 };
+    for (int i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        NSMutableData *plaintext = [NSMutableData dataWithLength:lengths[i]];
+        arc4random_buf([plaintext mutableBytes], lengths[i]);
+        NSData *ciphertext = [key encryptData:plaintext initVector:iv error:&error];
+        should(ciphertext != nil);
+        
+        // Compare against a plain serial context.
+        LKKCCryptoContext *cc = [LKKCCryptoContext cryptoContextForKey:key operation:CSSM_ACL_AUTHORIZATION_DECRYPT initVector:iv error:&error];
+        shouldBeEqual([cc decryptData:ciphertext error:&error], plaintext);
+        shouldBeEqual([key decryptDataInParallel:ciphertext initVector:iv error:&error], plaintext);
+        shouldBeEqual([key decryptData:ciphertext initVector:iv error:&error], plaintext);
+    }
+    
+    // Truncated ciphertexts are rejected.
+    NSMutableData *plaintext = [NSMutableData dataWithLength:1024 * 1024];
+    NSData *ciphertext = [key encryptData:plaintext initVector:iv error:&error];
+    should([key decryptDataInParallel:[ciphertext subdataWithRange:NSMakeRange(0, [ciphertext length] - 1)] initVector:iv error:&error] == nil);
+}
+
+- (void)testAESKeyWrap
+{
+    NSError *error = nil;
+    
+    // RFC 3394, section 4.6: 256-bit key data with a 256-bit KEK.
+    LKKCKey *kek = [LKKCKey keyWithData:[self dataFromHex:@"000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F"] 
+                               keyClass:LKKCKeyClassSymmetric keyType:LKKCKeyTypeAES keySize:256];
+    LKKCKey *key = [LKKCKey keyWithData:[self dataFromHex:@"00112233445566778899AABBCCDDEEFF000102030405060708090A0B0C0D0E0F"] 
+                               keyClass:LKKCKeyClassSymmetric keyType:LKKCKeyTypeAES keySize:256];
+    NSData *expected = [self dataFromHex:@"28C9F404C4B810F4CBCCB35CFB87F8263F5786E2D80ED326CBC7F0E71A99F43BFB988B9B7A02DD21"];
+    shouldBeEqual([kek wrapKey:key error:&error], expected);
+    LKKCKey *unwrapped = [kek unwrapKey:expected keyType:LKKCKeyTypeAES keySize:256 error:&error];
+    should(unwrapped != nil);
+    shouldBeEqual([unwrapped keyDataWithError:&error], [key keyDataWithError:&error]);
+    
+    // Batches round-trip.
+    NSMutableArray *keys = [NSMutableArray array];
+    for (int i = 0; i < 1000; i++) {
+        NSMutableData *bits = [NSMutableData dataWithLength:16];
+        arc4random_buf([bits mutableBytes], 16);
+        [keys addObject:[LKKCKey keyWithData:bits keyClass:LKKCKeyClassSymmetric keyType:LKKCKeyTypeAES keySize:128]];
+    }
+    NSArray *wrappedKeys = [kek wrapKeys:keys error:&error];
+    should([wrappedKeys count] == [keys count]);
+    NSArray *unwrappedKeys = [kek unwrapKeys:wrappedKeys keyType:LKKCKeyTypeAES keySize:128 error:&error];
+    should([unwrappedKeys count] == [keys count]);
+    for (NSUInteger i = 0; i < [keys count]; i++)
+        shouldBeEqual([[unwrappedKeys objectAtIndex:i] keyDataWithError:&error], [[keys objectAtIndex:i] keyDataWithError:&error]);
+    
+    // Tampered keys, wrong sizes and wrong KEKs fail the integrity check.
+    NSMutableData *tampered = [[[wrappedKeys objectAtIndex:0] mutableCopy] autorelease];
+    ((uint8_t *)[tampered mutableBytes])[5] ^= 1;
+    should([kek unwrapKey:tampered keyType:LKKCKeyTypeAES keySize:128 error:NULL] == nil);
+    should([kek unwrapKey:[wrappedKeys objectAtIndex:0] keyType:LKKCKeyTypeAES keySize:256 error:NULL] == nil);
+    LKKCKey *otherKEK = [LKKCKey keyWithData:[self dataFromHex:@"000102030405060708090A0B0C0D0E0F"] 
+                                    keyClass:LKKCKeyClassSymmetric keyType:LKKCKeyTypeAES keySize:128];
+    should([otherKEK unwrapKey:[wrappedKeys objectAtIndex:0] keyType:LKKCKeyTypeAES keySize:128 error:NULL] == nil);
+    
+    // The KEK stays in its CSP, so it doesn't need to be extractable.
+    LKKCKeyGenerator *generator = [LKKCKeyGenerator generatorWithKeychain:_keychain];
+    generator.keySize = 256;
+    generator.extractable = NO;
+    LKKCKey *keychainKEK = [generator generateAESKeyWithError:&error];
+    should(keychainKEK != nil);
+    NSData *wrapped = [keychainKEK wrapKey:key error:&error];
+    should([wrapped length] == 40);
+    unwrapped = [keychainKEK unwrapKey:wrapped keyType:LKKCKeyTypeAES keySize:256 error:&error];
+    shouldBeEqual([unwrapped keyDataWithError:&error], [key keyDataWithError:&error]);
+    should([kek unwrapKey:wrapped keyType:LKKCKeyTypeAES keySize:256 error:NULL] == nil);
+}
+
+- (void)testAESBulkGeneration
+{
+    NSError *error = nil;
+    NSData *tag = [@"bulk key tag" dataUsingEncoding:NSUTF8StringEncoding];
+    
+    // Floating keys.
+    LKKCKeyGenerator *generator = [LKKCKeyGenerator generatorWithKeychain:nil];
+    generator.keySize = 256;
+    generator.label = @"floating bulk key";
+    NSArray *keys = [generator generateAESKeys:300 error:&error];
+    should([keys count] == 300);
+    NSMutableSet *bits = [NSMutableSet set];
+    for (LKKCKey *key in keys) {
+        should(key.keychain == nil);
+        should(key.keyType == LKKCKeyTypeAES);
+        should(key.keySize == 256);
+        shouldBeEqual(key.label, @"floating bulk key");
+        [bits addObject:[key keyDataWithError:&error]];
+    }
+    should([bits count] == 300);
+    should([[generator generateAESKeys:0 error:&error] count] == 0);
+    
+    // Extractable keys in a keychain, in more than one batch.
+    generator = [LKKCKeyGenerator generatorWithKeychain:_keychain];
+    generator.label = @"bulk key";
+    generator.tag = tag;
+    generator.extractable = YES;
+    keys = [generator generateAESKeys:300 error:&error];
+    should([keys count] == 300);
+    for (LKKCKey *key in keys) {
+        should(key.keychain != nil);
+        should(key.keySize == 128);
+        shouldBeEqual(key.label, @"bulk key");
+        shouldBeEqual(key.tag, tag);
+    }
+    should([[_keychain symmetricKeys] count] == 300);
+    
+    NSData *iv = [[keys objectAtIndex:17] randomInitVector];
+    NSData *plaintext = [@"Hello, world" dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *ciphertext = [[keys objectAtIndex:17] encryptData:plaintext initVector:iv error:&error];
+    shouldBeEqual([[keys objectAtIndex:17] decryptData:ciphertext initVector:iv error:&error], plaintext);
+    
+    // Non-extractable keys.
+    generator.extractable = NO;
+    keys = [generator generateAESKeys:3 error:&error];
+    should([keys count] == 3);
+    should([[_keychain symmetricKeys] count] == 303);
+    
+    // Application labels would collide.
+    generator.applicationLabel = @"bulk key ID";
+    should([generator generateAESKeys:2 error:&error] == nil);
+    should([error code] == errSecDuplicateItem);
+    should([[_keychain symmetricKeys] count] == 303);
+}
+
+- (void)testAESKeyProperties
+{
+    NSError *error = nil;
+    LKKCKey *key = [LKKCKey keyWithData:[self dataFromHex:@"000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F"] 
+                               keyClass:LKKCKeyClassSymmetric keyType:LKKCKeyTypeAES keySize:256];
+    for (int i = 0; i < 2; i++) {
+        // The second round reads the properties from the cache.
+        should(key.keyClass == LKKCKeyClassSymmetric);
+        should(key.keyType == LKKCKeyTypeAES);
+        should(key.keySize == 256);
+        should(key.effectiveKeySize == 256);
+        should(key.blockSize == 16);
+        should(key.canEncrypt);
+        should(key.canDecrypt);
+    }
+    
+    // Adding the key to a keychain doesn't change its properties.
+    should([key addToKeychain:_keychain error:&error]);
+    should(key.keyClass == LKKCKeyClassSymmetric);
+    should(key.keyType == LKKCKeyTypeAES);
+    should(key.keySize == 256);
+    should(key.blockSize == 16);
+    should(key.canEncrypt);
+    
+    // Deleted keys have no properties.
+    should([key deleteItemWithError:&error]);
+    should(key.keyClass == LKKCKeyClassUnknown);
+    should(key.keySize == 0);
+}
+
 @end
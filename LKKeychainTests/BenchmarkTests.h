@@ -0,0 +1,18 @@
+//
+//  BenchmarkTests.h
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright (c) 2011 Karoly Lorentey. All rights reserved.
+//
+
+#import "LKKeychainTestCase.h"
+
+// Throughput and latency benchmarks. These only run when the LKKC_BENCHMARK environment variable 
+// is set to the path of a JSON file to write the results to.
+@interface BenchmarkTests : LKKeychainTestCase
+{
+@private
+    NSMutableArray *_results;
+}
+@end
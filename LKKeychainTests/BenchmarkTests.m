@@ -0,0 +1,362 @@
+//
+//  BenchmarkTests.m
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright (c) 2011 Karoly Lorentey. All rights reserved.
+//
+
+#import "BenchmarkTests.h"
+#import <mach/mach_time.h>
+#import <LKKeychain/LKKCKey+Private.h>
+
+// Each measurement runs for about this long on every thread, after a warmup of a tenth as long.
+static const double LKKCBenchmarkDuration = 0.25;
+static const NSUInteger LKKCBenchmarkMinIterations = 5;
+static const NSUInteger LKKCBenchmarkMaxIterations = 100000;
+
+static double
+SecondsFromMachTime(uint64_t t)
+{
+    static mach_timebase_info_data_t timebase;
+    if (timebase.denom == 0)
+        mach_timebase_info(&timebase);
+    return (double)t * timebase.numer / timebase.denom / 1e9;
+}
+
+static int
+CompareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x < y ? -1 : (x > y ? 1 : 0));
+}
+
+static NSData *
+RandomData(size_t length)
+{
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    arc4random_buf([data mutableBytes], length);
+    return data;
+}
+
+@interface BenchmarkTests()
+- (void)_measure:(NSString *)name 
+      parameters:(NSDictionary *)parameters 
+           bytes:(size_t)bytes 
+         threads:(NSUInteger)threads 
+            body:(BOOL (^)(NSUInteger thread))body;
+- (NSArray *)_threadCounts;
+- (void)_benchmarkSymmetricCiphers;
+- (void)_benchmarkRSA;
+- (void)_benchmarkDigests;
+- (void)_benchmarkEngine;
+- (void)_benchmarkLookups;
+@end
+
+@implementation BenchmarkTests
+
+// Run body repeatedly on `threads` threads at once, and record the distribution of per-call latencies.
+- (void)_measure:(NSString *)name 
+      parameters:(NSDictionary *)parameters 
+           bytes:(size_t)bytes 
+         threads:(NSUInteger)threads 
+            body:(BOOL (^)(NSUInteger thread))body
+{
+    // Warm up (filling context pools and caches), and estimate the cost of a single call.
+    NSUInteger warmup = 0;
+    uint64_t start = mach_absolute_time();
+    while (warmup < LKKCBenchmarkMinIterations || SecondsFromMachTime(mach_absolute_time() - start) < LKKCBenchmarkDuration / 10) {
+        BOOL ok;
+        @autoreleasepool {
+            ok = body(0);
+        }
+        if (!ok) {
+            STFail(@"Benchmark %@ %@ failed", name, parameters);
+            return;
+        }
+        warmup++;
+    }
+    double estimate = SecondsFromMachTime(mach_absolute_time() - start) / warmup;
+    NSUInteger iterations = (NSUInteger)(LKKCBenchmarkDuration / estimate);
+    iterations = MAX(LKKCBenchmarkMinIterations, MIN(LKKCBenchmarkMaxIterations, iterations));
+    
+    NSUInteger count = threads * iterations;
+    double *latencies = malloc(count * sizeof(double));
+    __block BOOL failed = NO;
+    start = mach_absolute_time();
+    dispatch_apply(threads, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0), ^(size_t thread) {
+        for (NSUInteger i = 0; i < iterations; i++) {
+            BOOL ok;
+            uint64_t t0 = mach_absolute_time();
+            @autoreleasepool {
+                ok = body(thread);
+            }
+            latencies[thread * iterations + i] = SecondsFromMachTime(mach_absolute_time() - t0);
+            if (!ok)
+                failed = YES;
+        }
+    });
+    double elapsed = SecondsFromMachTime(mach_absolute_time() - start);
+    if (failed) {
+        free(latencies);
+        STFail(@"Benchmark %@ %@ failed", name, parameters);
+        return;
+    }
+    
+    qsort(latencies, count, sizeof(double), CompareDoubles);
+    double sum = 0;
+    for (NSUInteger i = 0; i < count; i++)
+        sum += latencies[i];
+    double (^percentile)(double) = ^double(double p) {
+        return latencies[MIN(count - 1, (NSUInteger)(p * count))] * 1e6;
+    };
+    
+    NSMutableDictionary *result = [NSMutableDictionary dictionaryWithDictionary:parameters];
+    [result setObject:name forKey:@"name"];
+    [result setObject:[NSNumber numberWithUnsignedInteger:threads] forKey:@"threads"];
+    [result setObject:[NSNumber numberWithUnsignedInteger:count] forKey:@"iterations"];
+    NSDictionary *latency = [NSDictionary dictionaryWithObjectsAndKeys:
+                             [NSNumber numberWithDouble:latencies[0] * 1e6], @"min",
+                             [NSNumber numberWithDouble:percentile(0.50)], @"p50",
+                             [NSNumber numberWithDouble:percentile(0.90)], @"p90",
+                             [NSNumber numberWithDouble:percentile(0.99)], @"p99",
+                             [NSNumber numberWithDouble:latencies[count - 1] * 1e6], @"max",
+                             [NSNumber numberWithDouble:sum / count * 1e6], @"mean",
+                             nil];
+    [result setObject:latency forKey:@"latencyMicroseconds"];
+    [result setObject:[NSNumber numberWithDouble:count / elapsed] forKey:@"opsPerSecond"];
+    if (bytes > 0)
+        [result setObject:[NSNumber numberWithDouble:(double)bytes * count / elapsed / 1e6] forKey:@"megabytesPerSecond"];
+    [_results addObject:result];
+    free(latencies);
+    NSLog(@"%@ %@: p50 %.1f us, %.0f ops/s", name, parameters, percentile(0.50), count / elapsed);
+}
+
+- (NSArray *)_threadCounts
+{
+    NSUInteger cpus = [[NSProcessInfo processInfo] activeProcessorCount];
+    NSMutableArray *counts = [NSMutableArray array];
+    for (NSUInteger n = 1; n < cpus; n *= 2)
+        [counts addObject:[NSNumber numberWithUnsignedInteger:n]];
+    [counts addObject:[NSNumber numberWithUnsignedInteger:cpus]];
+    return counts;
+}
+
+- (void)testBenchmarks
+{
+    const char *path = getenv("LKKC_BENCHMARK");
+    if (path == NULL)
+        return;
+    
+    _results = [[NSMutableArray alloc] init];
+    [self _benchmarkSymmetricCiphers];
+    [self _benchmarkRSA];
+    [self _benchmarkDigests];
+    [self _benchmarkEngine];
+    [self _benchmarkLookups];
+    
+    NSDateFormatter *formatter = [[[NSDateFormatter alloc] init] autorelease];
+    [formatter setLocale:[[[NSLocale alloc] initWithLocaleIdentifier:@"en_US_POSIX"] autorelease]];
+    [formatter setDateFormat:@"yyyy'-'MM'-'dd'T'HH':'mm':'ss'Z'"];
+    [formatter setTimeZone:[NSTimeZone timeZoneForSecondsFromGMT:0]];
+    NSDictionary *host = [NSDictionary dictionaryWithObjectsAndKeys:
+                          [NSNumber numberWithUnsignedInteger:[[NSProcessInfo processInfo] activeProcessorCount]], @"cpus",
+                          [[NSProcessInfo processInfo] operatingSystemVersionString], @"os",
+                          [NSNumber numberWithUnsignedInt:LKKCEngineAvailableFeatures()], @"engineFeatures",
+                          nil];
+    NSDictionary *report = [NSDictionary dictionaryWithObjectsAndKeys:
+                            [formatter stringFromDate:[NSDate date]], @"date",
+                            host, @"host",
+                            _results, @"results",
+                            nil];
+    NSError *error = nil;
+    NSData *json = [NSJSONSerialization dataWithJSONObject:report options:NSJSONWritingPrettyPrinted error:&error];
+    should(json != nil);
+    should([json writeToFile:[NSString stringWithUTF8String:path] options:NSDataWritingAtomic error:&error]);
+    [_results release];
+    _results = nil;
+}
+
+- (void)_benchmarkSymmetricCiphers
+{
+    NSArray *messageSizes = [NSArray arrayWithObjects:
+                             [NSNumber numberWithUnsignedInteger:16],
+                             [NSNumber numberWithUnsignedInteger:1024],
+                             [NSNumber numberWithUnsignedInteger:16 * 1024],
+                             [NSNumber numberWithUnsignedInteger:256 * 1024],
+                             [NSNumber numberWithUnsignedInteger:4 * 1024 * 1024],
+                             nil];
+    for (UInt32 keySize = 128; keySize <= 256; keySize += 128) {
+        LKKCKey *key = [LKKCKey keyWithData:RandomData(keySize / 8) keyClass:LKKCKeyClassSymmetric keyType:LKKCKeyTypeAES keySize:keySize];
+        should(key != nil);
+        NSData *iv = [key randomInitVector];
+        NSData *nonce = [key randomNonce];
+        NSNumber *keySizeNumber = [NSNumber numberWithUnsignedInt:keySize];
+        
+        [self _measure:@"aes-context-setup" 
+            parameters:[NSDictionary dictionaryWithObject:keySizeNumber forKey:@"keySize"] 
+                 bytes:0 
+               threads:1 
+                  body:^BOOL(NSUInteger thread) {
+                      return [LKKCCryptoContext cryptoContextForKey:key operation:CSSM_ACL_AUTHORIZATION_ENCRYPT initVector:iv error:NULL] != nil;
+                  }];
+        
+        for (NSNumber *size in messageSizes) {
+            NSData *plaintext = RandomData([size unsignedIntegerValue]);
+            NSData *ciphertext = [key encryptData:plaintext initVector:iv error:NULL];
+            NSData *tag = nil;
+            NSData *gcmCiphertext = [key encryptData:plaintext nonce:nonce additionalData:nil tag:&tag error:NULL];
+            should(ciphertext != nil && gcmCiphertext != nil);
+            
+            for (NSNumber *threads in [self _threadCounts]) {
+                NSDictionary *parameters = [NSDictionary dictionaryWithObjectsAndKeys:
+                                            keySizeNumber, @"keySize", 
+                                            size, @"messageSize", 
+                                            nil];
+                NSUInteger threadCount = [threads unsignedIntegerValue];
+                [self _measure:@"aes-cbc-encrypt" parameters:parameters bytes:[plaintext length] threads:threadCount body:^BOOL(NSUInteger thread) {
+                    return [key encryptData:plaintext initVector:iv error:NULL] != nil;
+                }];
+                [self _measure:@"aes-cbc-decrypt" parameters:parameters bytes:[plaintext length] threads:threadCount body:^BOOL(NSUInteger thread) {
+                    return [key decryptData:ciphertext initVector:iv error:NULL] != nil;
+                }];
+                [self _measure:@"aes-gcm-encrypt" parameters:parameters bytes:[plaintext length] threads:threadCount body:^BOOL(NSUInteger thread) {
+                    NSData *t = nil;
+                    return [key encryptData:plaintext nonce:nonce additionalData:nil tag:&t error:NULL] != nil;
+                }];
+                [self _measure:@"aes-gcm-decrypt" parameters:parameters bytes:[plaintext length] threads:threadCount body:^BOOL(NSUInteger thread) {
+                    return [key decryptData:gcmCiphertext nonce:nonce additionalData:nil tag:tag error:NULL] != nil;
+                }];
+            }
+            
+            // These spread a single message over all cores on their own.
+            if ([size unsignedIntegerValue] >= 256 * 1024) {
+                NSDictionary *parameters = [NSDictionary dictionaryWithObjectsAndKeys:keySizeNumber, @"keySize", size, @"messageSize", nil];
+                [self _measure:@"aes-gcm-parallel-encrypt" parameters:parameters bytes:[plaintext length] threads:1 body:^BOOL(NSUInteger thread) {
+                    return [key encryptDataInParallel:plaintext error:NULL] != nil;
+                }];
+                [self _measure:@"aes-cbc-parallel-decrypt" parameters:parameters bytes:[plaintext length] threads:1 body:^BOOL(NSUInteger thread) {
+                    return [key decryptDataInParallel:ciphertext initVector:iv error:NULL] != nil;
+                }];
+            }
+        }
+    }
+}
+
+- (void)_benchmarkRSA
+{
+    NSData *message = RandomData(256);
+    for (unsigned int keySize = 1024; keySize <= 4096; keySize *= 2) {
+        NSDictionary *parameters = [NSDictionary dictionaryWithObject:[NSNumber numberWithUnsignedInt:keySize] forKey:@"keySize"];
+        LKKCKeyGenerator *generator = [LKKCKeyGenerator generatorWithKeychain:_keychain];
+        generator.keySize = keySize;
+        __block LKKCKeyPair *keypair = nil;
+        [self _measure:@"rsa-generate" parameters:parameters bytes:0 threads:1 body:^BOOL(NSUInteger thread) {
+            [keypair release];
+            keypair = [[generator generateRSAKeyPairWithError:NULL] retain];
+            return keypair != nil;
+        }];
+        [keypair autorelease];
+        if (keypair == nil)
+            continue;
+        
+        NSData *signature = [keypair.privateKey signData:message digestAlgorithm:LKKCDigestAlgorithmSHA256 error:NULL];
+        should(signature != nil);
+        for (NSNumber *threads in [self _threadCounts]) {
+            NSUInteger threadCount = [threads unsignedIntegerValue];
+            [self _measure:@"rsa-sign" parameters:parameters bytes:0 threads:threadCount body:^BOOL(NSUInteger thread) {
+                return [keypair.privateKey signData:message digestAlgorithm:LKKCDigestAlgorithmSHA256 error:NULL] != nil;
+            }];
+            [self _measure:@"rsa-verify" parameters:parameters bytes:0 threads:threadCount body:^BOOL(NSUInteger thread) {
+                return [keypair.publicKey verifySignature:signature forData:message digestAlgorithm:LKKCDigestAlgorithmSHA256 error:NULL];
+            }];
+        }
+    }
+}
+
+- (void)_benchmarkDigests
+{
+    LKKCKey *key = [LKKCKey keyWithData:RandomData(32) keyClass:LKKCKeyClassSymmetric keyType:LKKCKeyTypeAES keySize:256];
+    for (NSUInteger size = 64; size <= 1024 * 1024; size *= 16) {
+        NSData *message = RandomData(size);
+        NSDictionary *parameters = [NSDictionary dictionaryWithObject:[NSNumber numberWithUnsignedInteger:size] forKey:@"messageSize"];
+        [self _measure:@"hmac-sha256" parameters:parameters bytes:size threads:1 body:^BOOL(NSUInteger thread) {
+            return [key hmacForData:message digestAlgorithm:LKKCDigestAlgorithmSHA256 error:NULL] != nil;
+        }];
+    }
+}
+
+- (void)_benchmarkEngine
+{
+    const size_t size = 64 * 1024;
+    uint8_t *buffer = malloc(size);
+    arc4random_buf(buffer, size);
+    LKKCEngineAESKey key;
+    uint8_t keyBytes[16];
+    arc4random_buf(keyBytes, sizeof(keyBytes));
+    LKKCEngineAESSetKey(&key, keyBytes, sizeof(keyBytes));
+    
+    unsigned masks[] = { 0, ~0U };
+    for (int m = 0; m < 2; m++) {
+        LKKCEngineSetFeatureMask(masks[m]);
+        NSDictionary *parameters = [NSDictionary dictionaryWithObjectsAndKeys:
+                                    [NSNumber numberWithUnsignedInteger:size], @"messageSize",
+                                    [NSNumber numberWithUnsignedInt:LKKCEngineActiveFeatures()], @"engineFeatures",
+                                    nil];
+        [self _measure:@"engine-aes128-ctr" parameters:parameters bytes:size threads:1 body:^BOOL(NSUInteger thread) {
+            uint8_t counter[16] = { 0 };
+            LKKCEngineAESCTR32(&key, counter, buffer, buffer, size / 16);
+            return YES;
+        }];
+        [self _measure:@"engine-sha256" parameters:parameters bytes:size threads:1 body:^BOOL(NSUInteger thread) {
+            LKKCEngineSHA256Context context;
+            uint8_t digest[LKKCEngineSHA256DigestLength];
+            LKKCEngineSHA256Init(&context);
+            LKKCEngineSHA256Update(&context, buffer, size);
+            LKKCEngineSHA256Final(&context, digest);
+            return YES;
+        }];
+        [self _measure:@"engine-ghash" parameters:parameters bytes:size threads:1 body:^BOOL(NSUInteger thread) {
+            LKKCEngineGHASHKey ghash;
+            uint8_t y[16] = { 0 };
+            LKKCEngineGHASHSetKey(&ghash, keyBytes);
+            LKKCEngineGHASHUpdate(&ghash, y, buffer, size);
+            return YES;
+        }];
+    }
+    LKKCEngineSetFeatureMask(~0U);
+    LKKCEngineAESClearKey(&key);
+    free(buffer);
+}
+
+// Lookups of the first and the last entry of each enum mapping table should cost the same.
+- (void)_benchmarkLookups
+{
+    const NSUInteger lookups = 1000;
+    NSArray *schemes = [NSArray arrayWithObjects:
+                        [LKKCInternetPassword urlSchemeFromProtocol:LKKCProtocolFTP], 
+                        [LKKCInternetPassword urlSchemeFromProtocol:LKKCProtocolPOP3S], 
+                        nil];
+    for (NSString *scheme in schemes) {
+        NSDictionary *parameters = [NSDictionary dictionaryWithObject:scheme forKey:@"scheme"];
+        [self _measure:@"protocol-from-scheme" parameters:parameters bytes:0 threads:1 body:^BOOL(NSUInteger thread) {
+            for (NSUInteger i = 0; i < lookups; i++)
+                [LKKCInternetPassword protocolFromURLScheme:scheme];
+            return YES;
+        }];
+    }
+    
+    LKKCKeyType keyTypes[] = { LKKCKeyTypeRSA, LKKCKeyTypeECDSA };
+    for (int k = 0; k < 2; k++) {
+        CFTypeRef algorithm = [LKKCKey _algorithmFromLKKCKeyType:keyTypes[k]];
+        NSDictionary *parameters = [NSDictionary dictionaryWithObject:[LKKCKey stringFromKeyType:keyTypes[k]] forKey:@"keyType"];
+        [self _measure:@"key-type-from-algorithm" parameters:parameters bytes:0 threads:1 body:^BOOL(NSUInteger thread) {
+            for (NSUInteger i = 0; i < lookups; i++)
+                [LKKCKey _keyTypeFromAlgorithm:algorithm];
+            return YES;
+        }];
+    }
+}
+
+@end
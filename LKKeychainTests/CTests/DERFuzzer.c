@@ -0,0 +1,154 @@
+//
+//  DERFuzzer.c
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright (c) 2011 Karoly Lorentey. All rights reserved.
+//
+//  A fuzzing entry point for LKKCDER. It decodes the input as a certificate and, if that succeeds,
+//  walks every field the rest of LKKeychain uses, aborting if a result points outside the input.
+//
+//  With libFuzzer (clang):   make DERFuzzer && ./DERFuzzer -max_len=8192 ../Resources
+//  With AFL:                 make DERFuzzerReplay CC=afl-clang-fast && afl-fuzz -i ../Resources -o findings -- ./DERFuzzerReplay @@
+//  DERFuzzerReplay runs the entry point over the files named on the command line (or standard input);
+//  `make check` runs it over the test certificates.
+//
+
+#include "LKKCDER.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void
+CheckSlice(LKKCDERSlice slice, const uint8_t *bytes, size_t length)
+{
+    if (slice.bytes == NULL) {
+        if (slice.length != 0)
+            abort();
+        return;
+    }
+    if (slice.bytes < bytes || slice.length > length || (size_t)(slice.bytes - bytes) > length - slice.length)
+        abort();
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    // A private copy, so that AddressSanitizer sees the exact bounds of the input.
+    uint8_t *bytes = malloc(size > 0 ? size : 1);
+    if (bytes == NULL)
+        return 0;
+    memcpy(bytes, data, size);
+
+    LKKCDERCertificate der;
+    if (LKKCDERDecodeCertificate(bytes, size, &der) == 0) {
+        CheckSlice(der.tbsCertificate, bytes, size);
+        CheckSlice(der.serialNumber, bytes, size);
+        CheckSlice(der.signature, bytes, size);
+        CheckSlice(der.issuer, bytes, size);
+        CheckSlice(der.notBefore, bytes, size);
+        CheckSlice(der.notAfter, bytes, size);
+        CheckSlice(der.subject, bytes, size);
+        CheckSlice(der.subjectPublicKeyInfo, bytes, size);
+        CheckSlice(der.publicKeyAlgorithm, bytes, size);
+        CheckSlice(der.subjectPublicKey, bytes, size);
+        CheckSlice(der.issuerUniqueID, bytes, size);
+        CheckSlice(der.subjectUniqueID, bytes, size);
+        CheckSlice(der.extensions, bytes, size);
+        CheckSlice(der.signatureAlgorithm, bytes, size);
+        CheckSlice(der.signatureValue, bytes, size);
+
+        int64_t seconds;
+        if (LKKCDERDecodeTime(der.notBeforeTag, der.notBefore, &seconds) != 0
+            || LKKCDERDecodeTime(der.notAfterTag, der.notAfter, &seconds) != 0)
+            abort(); // The decoder has already validated both times.
+
+        // Walk the extensions and the subject alternative names, formatting every OID on the way.
+        char oid[256];
+        LKKCDERReader reader;
+        LKKCDERExtension extension;
+        LKKCDERReaderInit(&reader, der.extensions);
+        while (LKKCDERReaderNextExtension(&reader, &extension) == 0) {
+            CheckSlice(extension.oid, bytes, size);
+            CheckSlice(extension.value, bytes, size);
+            LKKCDERFormatOID(extension.oid, oid, sizeof(oid));
+        }
+        if (LKKCDERFindExtension(&der, LKKCDEROIDSubjectAlternativeName, sizeof(LKKCDEROIDSubjectAlternativeName), &extension) == 0) {
+            LKKCDERReader names;
+            LKKCDERItem name;
+            if (LKKCDERReaderInitGeneralNames(&names, &extension) == 0) {
+                while (LKKCDERReaderNext(&names, &name) == 0)
+                    CheckSlice(name.encoding, bytes, size);
+            }
+        }
+        LKKCDERItem algorithm, algorithmOID;
+        if (LKKCDERDecodeItem(der.publicKeyAlgorithm, &algorithm) == 0) {
+            LKKCDERReaderInit(&reader, algorithm.content);
+            if (LKKCDERReaderNext(&reader, &algorithmOID) == 0 && algorithmOID.tag == LKKCDERTagObjectIdentifier)
+                LKKCDERFormatOID(algorithmOID.content, oid, sizeof(oid));
+        }
+    }
+    free(bytes);
+    return 0;
+}
+
+#ifdef LKKC_DER_FUZZER_MAIN
+
+static uint8_t *
+ReadFile(FILE *file, size_t *length)
+{
+    uint8_t *bytes = NULL;
+    size_t capacity = 0;
+    *length = 0;
+    for (;;) {
+        if (*length == capacity) {
+            capacity = (capacity == 0 ? 4096 : 2 * capacity);
+            uint8_t *grown = realloc(bytes, capacity);
+            if (grown == NULL) {
+                free(bytes);
+                return NULL;
+            }
+            bytes = grown;
+        }
+        size_t count = fread(bytes + *length, 1, capacity - *length, file);
+        if (count == 0)
+            return bytes;
+        *length += count;
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    if (argc < 2) {
+        size_t length;
+        uint8_t *bytes = ReadFile(stdin, &length);
+        if (bytes == NULL)
+            return 1;
+        LLVMFuzzerTestOneInput(bytes, length);
+        free(bytes);
+        return 0;
+    }
+    for (int i = 1; i < argc; i++) {
+        FILE *file = fopen(argv[i], "rb");
+        if (file == NULL) {
+            perror(argv[i]);
+            return 1;
+        }
+        size_t length;
+        uint8_t *bytes = ReadFile(file, &length);
+        fclose(file);
+        if (bytes == NULL)
+            return 1;
+        // Every prefix too, to cover the truncated encodings around each seed.
+        for (size_t prefix = 0; prefix <= length; prefix++)
+            LLVMFuzzerTestOneInput(bytes, prefix);
+        free(bytes);
+    }
+    printf("DERFuzzerReplay: %d input(s) processed\n", argc - 1);
+    return 0;
+}
+
+#endif
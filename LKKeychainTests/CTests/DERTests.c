@@ -0,0 +1,337 @@
+//
+//  DERTests.c
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright (c) 2011 Karoly Lorentey. All rights reserved.
+//
+//  A plain C test driver for LKKCDER, built from LKKCDER.c alone.
+//  It decodes the test certificates in LKKeychainTests/Resources and a set of hand-built encodings
+//  that DER forbids. Build and run it with `make check` in this directory.
+//
+
+#include "LKKCDER.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures;
+
+#define check(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++; \
+        } \
+    } while (0)
+
+static const char *resourceDirectory = "../Resources";
+
+static uint8_t *
+ReadResource(const char *name, size_t *length)
+{
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", resourceDirectory, name);
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "%s: can't open\n", path);
+        failures++;
+        return NULL;
+    }
+    uint8_t *bytes = NULL;
+    size_t capacity = 0;
+    *length = 0;
+    for (;;) {
+        if (*length == capacity) {
+            capacity = (capacity == 0 ? 4096 : 2 * capacity);
+            bytes = realloc(bytes, capacity);
+        }
+        size_t count = fread(bytes + *length, 1, capacity - *length, file);
+        if (count == 0)
+            break;
+        *length += count;
+    }
+    fclose(file);
+    return bytes;
+}
+
+static int
+SliceIsInside(LKKCDERSlice slice, const uint8_t *bytes, size_t length)
+{
+    if (slice.bytes == NULL)
+        return slice.length == 0;
+    return slice.bytes >= bytes && slice.length <= length && slice.bytes - bytes <= (ptrdiff_t)(length - slice.length);
+}
+
+static void
+TestLengthEncoding(void)
+{
+    uint8_t buffer[1 + sizeof(size_t)];
+    check(LKKCDEREncodeLength(0x7f, buffer) == 1 && buffer[0] == 0x7f);
+    check(LKKCDEREncodeLength(0x80, buffer) == 2 && buffer[0] == 0x81 && buffer[1] == 0x80);
+    check(LKKCDEREncodeLength(0x12345, buffer) == 4 && buffer[0] == 0x83 && buffer[1] == 0x01 && buffer[2] == 0x23 && buffer[3] == 0x45);
+}
+
+static void
+TestItems(void)
+{
+    static const struct {
+        const char *bytes;
+        size_t length;
+        int valid;
+    } cases[] = {
+        { "\x04\x01\xaa", 3, 1 },
+        { "\x04\x81\x01\xaa", 4, 0 },         // Long form for a short length
+        { "\x04\x82\x00\x01\xaa", 5, 0 },     // Leading zero in the length
+        { "\x24\x80\x04\x01\xaa\x00\x00", 7, 0 }, // Indefinite length
+        { "\x1f\x21\x01\xaa", 4, 0 },         // High tag number
+        { "\x04\x02\xaa", 3, 0 },             // Truncated
+        { "\x04\x01\xaa\x00", 4, 0 },         // Trailing data
+        { "\x04\x89\x01\x00\x00\x00\x00\x00\x00\x00\x00", 11, 0 } // Length wider than size_t
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        LKKCDERSlice slice = { (const uint8_t *)cases[i].bytes, cases[i].length };
+        LKKCDERItem item;
+        int result = LKKCDERDecodeItem(slice, &item);
+        check((result == 0) == cases[i].valid);
+    }
+}
+
+static void
+TestOIDs(void)
+{
+    char buffer[64];
+    LKKCDERSlice oid = { (const uint8_t *)"\x2a\x86\x48\x86\xf7\x0d\x01\x01\x0b", 9 };
+    check(LKKCDERFormatOID(oid, buffer, sizeof(buffer)) == 0 && strcmp(buffer, "1.2.840.113549.1.1.11") == 0);
+    check(LKKCDERFormatOID(oid, buffer, 8) == -1);
+    LKKCDERSlice leadingZero = { (const uint8_t *)"\x2a\x80\x01", 3 };
+    check(LKKCDERFormatOID(leadingZero, buffer, sizeof(buffer)) == -1);
+    LKKCDERSlice unterminated = { (const uint8_t *)"\x2a\x86", 2 };
+    check(LKKCDERFormatOID(unterminated, buffer, sizeof(buffer)) == -1);
+}
+
+static void
+TestTimes(void)
+{
+    int64_t seconds;
+    LKKCDERSlice utc = { (const uint8_t *)"491231235959Z", 13 };
+    check(LKKCDERDecodeTime(LKKCDERTagUTCTime, utc, &seconds) == 0 && seconds == 2524607999LL);
+    LKKCDERSlice utc1950 = { (const uint8_t *)"500101000000Z", 13 };
+    check(LKKCDERDecodeTime(LKKCDERTagUTCTime, utc1950, &seconds) == 0 && seconds == -631152000LL);
+    LKKCDERSlice generalized = { (const uint8_t *)"20000229120000Z", 15 };
+    check(LKKCDERDecodeTime(LKKCDERTagGeneralizedTime, generalized, &seconds) == 0 && seconds == 951825600LL);
+    LKKCDERSlice notLeap = { (const uint8_t *)"21000229120000Z", 15 };
+    check(LKKCDERDecodeTime(LKKCDERTagGeneralizedTime, notLeap, &seconds) == -1);
+    LKKCDERSlice offset = { (const uint8_t *)"491231235959+0100", 17 };
+    check(LKKCDERDecodeTime(LKKCDERTagUTCTime, offset, &seconds) == -1);
+    LKKCDERSlice fraction = { (const uint8_t *)"20000229120000.5Z", 17 };
+    check(LKKCDERDecodeTime(LKKCDERTagGeneralizedTime, fraction, &seconds) == -1);
+}
+
+// A fixed-size buffer for building encodings from the inside out.
+typedef struct {
+    uint8_t bytes[1024];
+    size_t length;
+} Buffer;
+
+static void
+AppendHex(Buffer *buffer, const char *hex)
+{
+    for (; hex[0] != 0 && hex[1] != 0; hex += 2) {
+        unsigned int byte;
+        sscanf(hex, "%2x", &byte);
+        buffer->bytes[buffer->length++] = (uint8_t)byte;
+    }
+}
+
+// Replace the contents of buffer with a single item of the given tag that contains them.
+static void
+Wrap(Buffer *buffer, uint8_t tag)
+{
+    uint8_t header[2 + sizeof(size_t)];
+    header[0] = tag;
+    size_t headerLength = 1 + LKKCDEREncodeLength(buffer->length, header + 1);
+    memmove(buffer->bytes + headerLength, buffer->bytes, buffer->length);
+    memcpy(buffer->bytes, header, headerLength);
+    buffer->length += headerLength;
+}
+
+// Build a minimal certificate from the encodings of its version, serial number and extensions.
+// A NULL extensions string omits the extensions field.
+static void
+BuildCertificate(Buffer *certificate, const char *version, const char *serialNumber, const char *extensions)
+{
+    Buffer tbs = { .length = 0 };
+    AppendHex(&tbs, version);
+    AppendHex(&tbs, serialNumber);
+    AppendHex(&tbs, "300d06092a864886f70d01010b0500");                    // sha256WithRSAEncryption
+    AppendHex(&tbs, "3000");                                              // issuer
+    AppendHex(&tbs, "301e170d3131303130313030303030305a170d3439313233313233353935395a"); // validity
+    AppendHex(&tbs, "3000");                                              // subject
+    AppendHex(&tbs, "301a300d06092a864886f70d0101010500030900aabbccddeeff0011"); // subjectPublicKeyInfo
+    if (extensions != NULL) {
+        Buffer wrapped = { .length = 0 };
+        AppendHex(&wrapped, extensions);
+        Wrap(&wrapped, LKKCDERTagSequence);
+        Wrap(&wrapped, LKKCDERTagContextConstructed | 3);
+        memcpy(tbs.bytes + tbs.length, wrapped.bytes, wrapped.length);
+        tbs.length += wrapped.length;
+    }
+    Wrap(&tbs, LKKCDERTagSequence);
+    *certificate = tbs;
+    AppendHex(certificate, "300d06092a864886f70d01010b0500");
+    AppendHex(certificate, "030300abcd");
+    Wrap(certificate, LKKCDERTagSequence);
+}
+
+// The decoded fields point into this buffer, so it stays valid until the next call.
+static Buffer builtCertificate;
+
+static int
+DecodeBuilt(const char *version, const char *serialNumber, const char *extensions, LKKCDERCertificate *der)
+{
+    BuildCertificate(&builtCertificate, version, serialNumber, extensions);
+    return LKKCDERDecodeCertificate(builtCertificate.bytes, builtCertificate.length, der);
+}
+
+static void
+TestCanonicalEncodings(void)
+{
+    static const char *keyUsage = "300c0603551d0f0101ff0402aabb";        // critical = TRUE
+    static const char *keyUsageFalse = "300c0603551d0f0101000402aabb";   // critical = FALSE, encoded
+    static const char *keyUsageDefault = "30090603551d0f0402aabb";       // critical omitted
+    static const char *keyUsageNonCanonicalTrue = "300c0603551d0f0101010402aabb";
+    LKKCDERCertificate der;
+    LKKCDERExtension extension;
+
+    check(DecodeBuilt("a003020102", "020101", keyUsage, &der) == 0);
+    check(der.version == 2);
+    check(der.serialNumber.length == 1 && der.serialNumber.bytes[0] == 1);
+    check(LKKCDERFindExtension(&der, (const uint8_t *)"\x55\x1d\x0f", 3, &extension) == 0 && extension.critical == 1);
+    check(LKKCDERFindExtension(&der, LKKCDEROIDSubjectAlternativeName, sizeof(LKKCDEROIDSubjectAlternativeName), &extension) == 1);
+
+    check(DecodeBuilt("a003020102", "020101", keyUsageDefault, &der) == 0);
+    check(LKKCDERFindExtension(&der, (const uint8_t *)"\x55\x1d\x0f", 3, &extension) == 0 && extension.critical == 0);
+    check(DecodeBuilt("a003020102", "020101", keyUsageFalse, &der) == -1);
+    check(DecodeBuilt("a003020102", "020101", keyUsageNonCanonicalTrue, &der) == -1);
+
+    // A v1 certificate omits the version; an explicit v1 version is not DER.
+    check(DecodeBuilt("", "020101", NULL, &der) == 0);
+    check(der.version == 0);
+    check(DecodeBuilt("a003020100", "020101", NULL, &der) == -1);
+    check(DecodeBuilt("a003020101", "020101", NULL, &der) == 0 && der.version == 1);
+    check(DecodeBuilt("a003020103", "020101", NULL, &der) == -1);
+
+    // Serial numbers must be minimal INTEGERs.
+    check(DecodeBuilt("a003020102", "02020080", keyUsage, &der) == 0);
+    check(DecodeBuilt("a003020102", "02020001", keyUsage, &der) == -1);
+    check(DecodeBuilt("a003020102", "0202ff80", keyUsage, &der) == -1);
+    check(DecodeBuilt("a003020102", "0200", keyUsage, &der) == -1);
+
+    // Extensions is SIZE (1..MAX).
+    check(DecodeBuilt("a003020102", "020101", "", &der) == -1);
+}
+
+static void
+TestCertificates(void)
+{
+    static const char *valid[] = {
+        "LKKeychain Expired Test CA.cer",
+        "LKKeychain Intermediate CA.cer",
+        "LKKeychain Test CA.cer",
+        "example.com (Expired CA).cer",
+        "example.com (Expired).cer",
+        "example.com (Expired, Intermediate CA).cer",
+        "example.com (Valid).cer",
+        "example.com (Valid, Intermediate CA).cer"
+    };
+    LKKCDERCertificate der;
+    for (size_t i = 0; i < sizeof(valid) / sizeof(valid[0]); i++) {
+        size_t length;
+        uint8_t *bytes = ReadResource(valid[i], &length);
+        if (bytes == NULL)
+            continue;
+        if (LKKCDERDecodeCertificate(bytes, length, &der) != 0) {
+            fprintf(stderr, "%s: can't decode\n", valid[i]);
+            failures++;
+        }
+        else {
+            check(der.version == 2);
+            check(SliceIsInside(der.subject, bytes, length) && SliceIsInside(der.issuer, bytes, length));
+            int64_t notBefore, notAfter;
+            check(LKKCDERDecodeTime(der.notBeforeTag, der.notBefore, &notBefore) == 0);
+            check(LKKCDERDecodeTime(der.notAfterTag, der.notAfter, &notAfter) == 0);
+            check(notBefore < notAfter);
+        }
+        free(bytes);
+    }
+
+    size_t length;
+    uint8_t *corrupt = ReadResource("example.com (Corrupt).cer", &length);
+    if (corrupt != NULL)
+        check(LKKCDERDecodeCertificate(corrupt, length, &der) == -1);
+    free(corrupt);
+
+    uint8_t *bytes = ReadResource("example.com (Valid).cer", &length);
+    if (bytes == NULL)
+        return;
+    check(LKKCDERDecodeCertificate(bytes, length, &der) == 0);
+    LKKCDERExtension extension;
+    LKKCDERReader names;
+    LKKCDERItem name;
+    int result = LKKCDERFindExtension(&der, LKKCDEROIDSubjectAlternativeName, sizeof(LKKCDEROIDSubjectAlternativeName), &extension);
+    if (result == 0) {
+        check(LKKCDERReaderInitGeneralNames(&names, &extension) == 0);
+        while ((result = LKKCDERReaderNext(&names, &name)) == 0)
+            check(SliceIsInside(name.content, bytes, length));
+        check(result == 1);
+    }
+    else
+        check(result == 1);
+
+    // Every truncation must be rejected. Each one gets its own allocation, so that
+    // AddressSanitizer catches reads past the end.
+    for (size_t i = 0; i < length; i++) {
+        uint8_t *truncated = malloc(i + 1);
+        memcpy(truncated, bytes, i);
+        check(LKKCDERDecodeCertificate(truncated, i, &der) == -1);
+        free(truncated);
+    }
+
+    // Random corruption must never produce slices outside the buffer.
+    uint8_t *mutated = malloc(length);
+    srand(49);
+    for (int i = 0; i < 10000; i++) {
+        memcpy(mutated, bytes, length);
+        for (int j = 0; j < 4; j++)
+            mutated[(size_t)rand() % length] = (uint8_t)rand();
+        if (LKKCDERDecodeCertificate(mutated, length, &der) == 0) {
+            check(SliceIsInside(der.tbsCertificate, mutated, length));
+            check(SliceIsInside(der.subject, mutated, length));
+            check(SliceIsInside(der.subjectPublicKey, mutated, length));
+            check(SliceIsInside(der.extensions, mutated, length));
+            check(SliceIsInside(der.signatureValue, mutated, length));
+        }
+    }
+    free(mutated);
+    free(bytes);
+}
+
+int
+main(int argc, char **argv)
+{
+    if (argc > 1)
+        resourceDirectory = argv[1];
+    TestLengthEncoding();
+    TestItems();
+    TestOIDs();
+    TestTimes();
+    TestCanonicalEncodings();
+    TestCertificates();
+    if (failures > 0) {
+        printf("DERTests: %d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("DERTests: all checks passed\n");
+    return 0;
+}
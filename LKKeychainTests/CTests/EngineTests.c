@@ -0,0 +1,322 @@
+//
+//  EngineTests.c
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright (c) 2011 Karoly Lorentey. All rights reserved.
+//
+//  A plain C test driver for LKKCEngine, so that the engine can be tested without Xcode
+//  (e.g., on Linux). It checks the published test vectors with the portable implementation
+//  and with every combination of processor features, and cross-checks the kernels against each other.
+//  Build and run it with `make check` in this directory.
+//
+
+#include "LKKCEngine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures;
+static unsigned currentMask;
+
+#define check(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed (feature mask 0x%x): %s\n", __FILE__, __LINE__, currentMask, #condition); \
+            failures++; \
+        } \
+    } while (0)
+
+static size_t
+FromHex(const char *hex, uint8_t *bytes)
+{
+    size_t length = strlen(hex) / 2;
+    for (size_t i = 0; i < length; i++) {
+        unsigned int byte;
+        sscanf(hex + 2 * i, "%2x", &byte);
+        bytes[i] = (uint8_t)byte;
+    }
+    return length;
+}
+
+// A deterministic pseudorandom fill, so that failures are reproducible.
+static void
+Fill(uint8_t *bytes, size_t length, uint32_t seed)
+{
+    uint32_t x = seed * 2654435761U + 1;
+    for (size_t i = 0; i < length; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        bytes[i] = (uint8_t)x;
+    }
+}
+
+static void
+TestAES(void)
+{
+    // FIPS-197, appendix C.1, C.2 and C.3
+    static const char *expected[3] = {
+        "69c4e0d86a7b0430d8cdb78070b4c55a",
+        "dda97ca4864cdfe06eaf70a0ec0d7191",
+        "8ea2b7ca516745bfeafc49904b496089"
+    };
+    uint8_t plaintext[16], keyBytes[32], ciphertext[16], reference[16], output[16];
+    for (int i = 0; i < 16; i++)
+        plaintext[i] = (uint8_t)(i * 0x11);
+    for (int i = 0; i < 32; i++)
+        keyBytes[i] = (uint8_t)i;
+    LKKCEngineAESKey key;
+    for (int k = 0; k < 3; k++) {
+        check(LKKCEngineAESSetKey(&key, keyBytes, 16 + 8 * k) == 0);
+        FromHex(expected[k], reference);
+        LKKCEngineAESEncryptECB(&key, plaintext, ciphertext, 1);
+        check(memcmp(ciphertext, reference, 16) == 0);
+        LKKCEngineAESEncryptECBConstantTime(&key, plaintext, output, 1);
+        check(memcmp(output, reference, 16) == 0);
+        LKKCEngineAESDecryptECB(&key, ciphertext, output, 1);
+        check(memcmp(output, plaintext, 16) == 0);
+        LKKCEngineAESDecryptECBConstantTime(&key, ciphertext, output, 1);
+        check(memcmp(output, plaintext, 16) == 0);
+    }
+    check(LKKCEngineAESSetKey(&key, keyBytes, 20) == -1);
+    LKKCEngineAESClearKey(&key);
+}
+
+static void
+TestCBC(void)
+{
+    // NIST SP 800-38A, F.2.1 and F.2.2 (CBC-AES128)
+    uint8_t keyBytes[16], iv[16], plaintext[64], expected[64], output[64];
+    FromHex("2b7e151628aed2a6abf7158809cf4f3c", keyBytes);
+    FromHex("000102030405060708090a0b0c0d0e0f", iv);
+    FromHex("6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+            "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710", plaintext);
+    FromHex("7649abac8119b246cee98e9b12e9197d5086cb9b507219ee95db113a917678b2"
+            "73bed6b8e3c1743b7116e69e222295163ff1caa1681fac09120eca307586e1a7", expected);
+    LKKCEngineAESKey key;
+    LKKCEngineAESSetKey(&key, keyBytes, sizeof(keyBytes));
+
+    // Consecutive calls continue the same message.
+    uint8_t chain[16];
+    memcpy(chain, iv, 16);
+    LKKCEngineAESEncryptCBC(&key, chain, plaintext, output, 1);
+    LKKCEngineAESEncryptCBC(&key, chain, plaintext + 16, output + 16, 3);
+    check(memcmp(output, expected, sizeof(output)) == 0);
+    check(memcmp(chain, expected + 48, 16) == 0);
+    memcpy(chain, iv, 16);
+    LKKCEngineAESDecryptCBC(&key, chain, output, output, 4);
+    check(memcmp(output, plaintext, sizeof(output)) == 0);
+    LKKCEngineAESClearKey(&key);
+}
+
+static void
+TestCTR32(void)
+{
+    // The reference: encrypt the counter blocks with the constant-time ECB kernel, wrapping around in the last 32 bits.
+    uint8_t keyBytes[32], input[16 * 37], expected[sizeof(input)], output[sizeof(input)], start[16], counter[16], c[16];
+    Fill(keyBytes, sizeof(keyBytes), 1);
+    Fill(input, sizeof(input), 2);
+    Fill(start, sizeof(start), 3);
+    start[12] = start[13] = start[14] = 0xff;
+    start[15] = 0xf0;
+    LKKCEngineAESKey key;
+    LKKCEngineAESSetKey(&key, keyBytes, sizeof(keyBytes));
+    memcpy(counter, start, 16);
+    for (size_t b = 0; b < sizeof(input) / 16; b++) {
+        LKKCEngineAESEncryptECBConstantTime(&key, counter, expected + 16 * b, 1);
+        for (int i = 0; i < 16; i++)
+            expected[16 * b + i] ^= input[16 * b + i];
+        for (int i = 15; i >= 12 && ++counter[i] == 0; i--)
+            ;
+    }
+    memcpy(c, start, 16);
+    LKKCEngineAESCTR32(&key, c, input, output, sizeof(input) / 16);
+    check(memcmp(output, expected, sizeof(output)) == 0);
+    check(memcmp(c, counter, 16) == 0);
+    LKKCEngineAESClearKey(&key);
+}
+
+static void
+TestGCM(void)
+{
+    // Test Case 4 from "The Galois/Counter Mode of Operation (GCM)" by McGrew and Viega,
+    // computed from CTR32 and GHASH as in LKKCGCMContext.
+    uint8_t keyBytes[16], iv[12], plaintext[60], aad[20], expected[60], expectedTag[16];
+    FromHex("feffe9928665731c6d6a8f9467308308", keyBytes);
+    FromHex("cafebabefacedbaddecaf888", iv);
+    FromHex("d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+            "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39", plaintext);
+    FromHex("feedfacedeadbeeffeedfacedeadbeefabaddad2", aad);
+    FromHex("42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e"
+            "21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091", expected);
+    FromHex("5bc94fbc3221a5db94fae95ae7121a47", expectedTag);
+
+    LKKCEngineAESKey key;
+    LKKCEngineAESSetKey(&key, keyBytes, sizeof(keyBytes));
+    uint8_t h[16] = { 0 };
+    LKKCEngineAESEncryptECB(&key, h, h, 1);
+    LKKCEngineGHASHKey ghash;
+    LKKCEngineGHASHSetKey(&ghash, h);
+
+    uint8_t j0[16], counter[16], padded[64] = { 0 }, ciphertext[60];
+    memcpy(j0, iv, 12);
+    j0[12] = j0[13] = j0[14] = 0;
+    j0[15] = 1;
+    memcpy(counter, j0, 16);
+    counter[15] = 2;
+    memcpy(padded, plaintext, sizeof(plaintext));
+    LKKCEngineAESCTR32(&key, counter, padded, padded, sizeof(padded) / 16);
+    memcpy(ciphertext, padded, sizeof(ciphertext));
+    check(memcmp(ciphertext, expected, sizeof(ciphertext)) == 0);
+
+    uint8_t y[16] = { 0 }, lengths[16] = { 0 }, tag[16];
+    LKKCEngineGHASHUpdate(&ghash, y, aad, sizeof(aad));
+    LKKCEngineGHASHUpdate(&ghash, y, ciphertext, sizeof(ciphertext));
+    lengths[7] = (uint8_t)(8 * sizeof(aad));
+    lengths[6] = (uint8_t)((8 * sizeof(aad)) >> 8);
+    lengths[15] = (uint8_t)(8 * sizeof(ciphertext));
+    lengths[14] = (uint8_t)((8 * sizeof(ciphertext)) >> 8);
+    LKKCEngineGHASHUpdate(&ghash, y, lengths, sizeof(lengths));
+    LKKCEngineAESEncryptECB(&key, j0, tag, 1);
+    for (int i = 0; i < 16; i++)
+        tag[i] ^= y[i];
+    check(memcmp(tag, expectedTag, sizeof(tag)) == 0);
+
+    LKKCEngineGHASHClearKey(&ghash);
+    LKKCEngineAESClearKey(&key);
+}
+
+static void
+SHA256(const void *data, size_t length, size_t split, uint8_t digest[LKKCEngineSHA256DigestLength])
+{
+    LKKCEngineSHA256Context context;
+    LKKCEngineSHA256Init(&context);
+    LKKCEngineSHA256Update(&context, data, split);
+    LKKCEngineSHA256Update(&context, (const uint8_t *)data + split, length - split);
+    LKKCEngineSHA256Final(&context, digest);
+}
+
+static void
+TestSHA256(void)
+{
+    // FIPS 180-2, appendix B.1, B.2 and B.3
+    uint8_t digest[LKKCEngineSHA256DigestLength], expected[LKKCEngineSHA256DigestLength];
+    SHA256("abc", 3, 1, digest);
+    FromHex("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", expected);
+    check(memcmp(digest, expected, sizeof(digest)) == 0);
+
+    const char *message = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    SHA256(message, strlen(message), 20, digest);
+    FromHex("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1", expected);
+    check(memcmp(digest, expected, sizeof(digest)) == 0);
+
+    size_t length = 1000000;
+    uint8_t *a = malloc(length);
+    memset(a, 'a', length);
+    SHA256(a, length, 333333, digest);
+    FromHex("cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0", expected);
+    check(memcmp(digest, expected, sizeof(digest)) == 0);
+    free(a);
+}
+
+// Compare the current implementation against the portable one on random inputs of every size.
+static void
+TestAgainstPortable(unsigned mask)
+{
+    uint8_t keyBytes[32], iv[16], input[16 * 41], reference[sizeof(input)], output[sizeof(input)];
+    uint8_t chainReference[16], chain[16];
+    LKKCEngineAESKey key;
+    for (size_t keySize = 16; keySize <= 32; keySize += 8) {
+        Fill(keyBytes, keySize, (uint32_t)keySize);
+        Fill(iv, sizeof(iv), 4);
+        Fill(input, sizeof(input), 5);
+        LKKCEngineAESSetKey(&key, keyBytes, keySize);
+        for (size_t blocks = 0; blocks <= sizeof(input) / 16; blocks += 5) {
+            LKKCEngineSetFeatureMask(0);
+            LKKCEngineAESEncryptECB(&key, input, reference, blocks);
+            LKKCEngineSetFeatureMask(mask);
+            LKKCEngineAESEncryptECB(&key, input, output, blocks);
+            check(memcmp(output, reference, 16 * blocks) == 0);
+
+            LKKCEngineSetFeatureMask(0);
+            LKKCEngineAESDecryptECB(&key, input, reference, blocks);
+            LKKCEngineSetFeatureMask(mask);
+            LKKCEngineAESDecryptECB(&key, input, output, blocks);
+            check(memcmp(output, reference, 16 * blocks) == 0);
+
+            memcpy(chainReference, iv, 16);
+            memcpy(chain, iv, 16);
+            LKKCEngineSetFeatureMask(0);
+            LKKCEngineAESEncryptCBC(&key, chainReference, input, reference, blocks);
+            LKKCEngineSetFeatureMask(mask);
+            LKKCEngineAESEncryptCBC(&key, chain, input, output, blocks);
+            check(memcmp(output, reference, 16 * blocks) == 0);
+            check(memcmp(chain, chainReference, 16) == 0);
+
+            memcpy(chainReference, iv, 16);
+            memcpy(chain, iv, 16);
+            LKKCEngineSetFeatureMask(0);
+            LKKCEngineAESDecryptCBC(&key, chainReference, input, reference, blocks);
+            LKKCEngineSetFeatureMask(mask);
+            LKKCEngineAESDecryptCBC(&key, chain, input, output, blocks);
+            check(memcmp(output, reference, 16 * blocks) == 0);
+            check(memcmp(chain, chainReference, 16) == 0);
+        }
+    }
+    LKKCEngineAESClearKey(&key);
+
+    uint8_t h[16], portable[16], fast[16];
+    Fill(h, sizeof(h), 6);
+    LKKCEngineGHASHKey ghash;
+    LKKCEngineGHASHSetKey(&ghash, h);
+    for (size_t length = 0; length < sizeof(input); length += 7) {
+        memset(portable, 0, sizeof(portable));
+        memset(fast, 0, sizeof(fast));
+        LKKCEngineSetFeatureMask(0);
+        LKKCEngineGHASHUpdate(&ghash, portable, input, length);
+        LKKCEngineSetFeatureMask(mask);
+        LKKCEngineGHASHUpdate(&ghash, fast, input, length);
+        check(memcmp(fast, portable, 16) == 0);
+    }
+    LKKCEngineGHASHClearKey(&ghash);
+
+    uint8_t digestReference[LKKCEngineSHA256DigestLength], digest[LKKCEngineSHA256DigestLength];
+    for (size_t length = 0; length < 300; length++) {
+        LKKCEngineSetFeatureMask(0);
+        SHA256(input, length, length / 3, digestReference);
+        LKKCEngineSetFeatureMask(mask);
+        SHA256(input, length, length / 3, digest);
+        check(memcmp(digest, digestReference, sizeof(digest)) == 0);
+    }
+}
+
+int
+main(void)
+{
+    unsigned available = LKKCEngineAvailableFeatures();
+    printf("Available engine features: 0x%x\n", available);
+
+    // Every subset of the available features, starting with the portable implementation.
+    unsigned mask = 0;
+    do {
+        currentMask = mask;
+        LKKCEngineSetFeatureMask(mask);
+        check(LKKCEngineActiveFeatures() == mask);
+        TestAES();
+        TestCBC();
+        TestCTR32();
+        TestGCM();
+        TestSHA256();
+        if (mask != 0)
+            TestAgainstPortable(mask);
+        mask = (mask - available) & available;
+    } while (mask != 0);
+
+    if (failures > 0) {
+        printf("EngineTests: %d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("EngineTests: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,98 @@
+//
+//  ECDHTests.m
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright (c) 2011 Karoly Lorentey. All rights reserved.
+//
+
+#import "ECDHTests.h"
+
+@implementation ECDHTests
+
+- (void)testFloatingKeyPairGeneration
+{
+    NSError *error = nil;
+    LKKCKeyGenerator *generator = [LKKCKeyGenerator generatorWithKeychain:nil];
+    generator.label = @"ephemeral key";
+    LKKCKeyPair *keypair = [generator generateECDSAKeyPairWithError:&error];
+    should(keypair != nil);
+    should(keypair.publicKey.keychain == nil);
+    should(keypair.privateKey.keychain == nil);
+    should(keypair.publicKey.keyClass == LKKCKeyClassPublic);
+    should(keypair.privateKey.keyClass == LKKCKeyClassPrivate);
+    should(keypair.privateKey.keyType == LKKCKeyTypeECDSA);
+    should(keypair.privateKey.keySize == 256);
+    shouldBeEqual(keypair.privateKey.label, @"ephemeral key");
+    
+    NSData *data = [@"Hello" dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *signature = [keypair signData:data digestAlgorithm:LKKCDigestAlgorithmSHA256 error:&error];
+    should([keypair verifySignature:signature forData:data digestAlgorithm:LKKCDigestAlgorithmSHA256 error:&error]);
+    
+    generator.keySize = 1024;
+    keypair = [generator generateRSAKeyPairWithError:&error];
+    should(keypair != nil);
+    should(keypair.privateKey.keychain == nil);
+    should(keypair.privateKey.keySize == 1024);
+    
+    should([[_keychain privateKeys] count] == 0);
+}
+
+- (void)testECDH
+{
+    NSError *error = nil;
+    LKKCKeyGenerator *generator = [LKKCKeyGenerator generatorWithKeychain:nil];
+    LKKCKeyPair *alice = [generator generateECDSAKeyPairWithError:&error];
+    LKKCKeyPair *bob = [generator generateECDSAKeyPairWithError:&error];
+    should(alice != nil && bob != nil);
+    
+    NSData *secret = [alice sharedSecretWithPublicKey:bob.publicKey error:&error];
+    should([secret length] == 32);
+    shouldBeEqual([bob sharedSecretWithPublicKey:alice.publicKey error:&error], secret);
+    
+    LKKCKeyPair *eve = [generator generateECDSAKeyPairWithError:&error];
+    should(![[eve sharedSecretWithPublicKey:bob.publicKey error:&error] isEqualToData:secret]);
+    
+    // Keychain keys can agree with in-memory keys.
+    LKKCKeyGenerator *keychainGenerator = [LKKCKeyGenerator generatorWithKeychain:_keychain];
+    LKKCKeyPair *carol = [keychainGenerator generateECDSAKeyPairWithError:&error];
+    should(carol != nil);
+    secret = [carol sharedSecretWithPublicKey:alice.publicKey error:&error];
+    should([secret length] == 32);
+    shouldBeEqual([alice sharedSecretWithPublicKey:carol.publicKey error:&error], secret);
+    
+    // Keys must be on the same curve.
+    generator.keySize = kSecp384r1;
+    LKKCKeyPair *dave = [generator generateECDSAKeyPairWithError:&error];
+    should([[dave sharedSecretWithPublicKey:dave.publicKey error:&error] length] == 48);
+    should([dave sharedSecretWithPublicKey:alice.publicKey error:&error] == nil);
+    should([error code] == errSecParam);
+    should([alice.publicKey sharedSecretWithPublicKey:bob.publicKey error:NULL] == nil);
+}
+
+- (void)testEphemeralKeyPairPool
+{
+    NSError *error = nil;
+    LKKCKeyGenerator *generator = [LKKCKeyGenerator generatorWithKeychain:nil];
+    generator.keyPairPoolSize = 4;
+    [generator fillKeyPairPoolWithKeyType:LKKCKeyTypeECDSA keySize:0];
+    NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:60];
+    while ([generator readyKeyPairCountWithKeyType:LKKCKeyTypeECDSA keySize:0] < 4 && [deadline timeIntervalSinceNow] > 0)
+        usleep(10000);
+    should([generator readyKeyPairCountWithKeyType:LKKCKeyTypeECDSA keySize:0] == 4);
+    
+    NSMutableSet *secrets = [NSMutableSet set];
+    LKKCKeyPair *peer = [generator generateECDSAKeyPairWithError:&error];
+    for (int i = 0; i < 3; i++) {
+        LKKCKeyPair *keypair = [generator generateECDSAKeyPairWithError:&error];
+        should(keypair.privateKey.keychain == nil);
+        [secrets addObject:[keypair sharedSecretWithPublicKey:peer.publicKey error:&error]];
+    }
+    should([secrets count] == 3);
+    should([[_keychain privateKeys] count] == 0);
+    
+    [generator drainKeyPairPool];
+    should([generator readyKeyPairCountWithKeyType:LKKCKeyTypeECDSA keySize:0] == 0);
+}
+
+@end
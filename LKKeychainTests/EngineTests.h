@@ -0,0 +1,12 @@
+//
+//  EngineTests.h
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright (c) 2011 Karoly Lorentey. All rights reserved.
+//
+
+#import "LKKeychainTestCase.h"
+
+@interface EngineTests : LKKeychainTestCase
+@end
@@ -0,0 +1,162 @@
+//
+//  EngineTests.m
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright (c) 2011 Karoly Lorentey. All rights reserved.
+//
+
+#import "EngineTests.h"
+#import <LKKeychain/LKKCEngine.h>
+#import <CommonCrypto/CommonCryptor.h>
+#import <CommonCrypto/CommonDigest.h>
+
+@implementation EngineTests
+
+- (void)tearDown
+{
+    LKKCEngineSetFeatureMask(~0U);
+    [super tearDown];
+}
+
+// Run a block once with the portable implementation and once with the fastest one.
+- (void)_withEachImplementation:(void (^)(void))block
+{
+    LKKCEngineSetFeatureMask(0);
+    should(LKKCEngineActiveFeatures() == 0);
+    block();
+    LKKCEngineSetFeatureMask(~0U);
+    should(LKKCEngineActiveFeatures() == LKKCEngineAvailableFeatures());
+    block();
+}
+
+- (void)testAES
+{
+    [self _withEachImplementation:^{
+        // FIPS-197, appendix C.1 and C.3
+        uint8_t plaintext[16], keyBytes[32], ciphertext[16];
+        for (int i = 0; i < 16; i++)
+            plaintext[i] = i * 0x11;
+        for (int i = 0; i < 32; i++)
+            keyBytes[i] = i;
+        LKKCEngineAESKey key;
+        should(LKKCEngineAESSetKey(&key, keyBytes, 16) == 0);
+        LKKCEngineAESEncryptECB(&key, plaintext, ciphertext, 1);
+        should(memcmp(ciphertext, "\x69\xc4\xe0\xd8\x6a\x7b\x04\x30\xd8\xcd\xb7\x80\x70\xb4\xc5\x5a", 16) == 0);
+        LKKCEngineAESDecryptECB(&key, ciphertext, ciphertext, 1);
+        should(memcmp(ciphertext, plaintext, 16) == 0);
+        should(LKKCEngineAESSetKey(&key, keyBytes, 32) == 0);
+        LKKCEngineAESEncryptECB(&key, plaintext, ciphertext, 1);
+        should(memcmp(ciphertext, "\x8e\xa2\xb7\xca\x51\x67\x45\xbf\xea\xfc\x49\x90\x4b\x49\x60\x89", 16) == 0);
+        should(LKKCEngineAESSetKey(&key, keyBytes, 20) == -1);
+        
+        // CBC matches CommonCrypto, for every key size and in pieces.
+        uint8_t input[1024], output[1024], reference[1024], iv[16];
+        arc4random_buf(input, sizeof(input));
+        for (size_t keySize = 16; keySize <= 32; keySize += 8) {
+            arc4random_buf(keyBytes, keySize);
+            arc4random_buf(iv, sizeof(iv));
+            size_t moved = 0;
+            should(CCCrypt(kCCEncrypt, kCCAlgorithmAES128, 0, keyBytes, keySize, iv, input, sizeof(input), reference, sizeof(reference), &moved) == kCCSuccess);
+            LKKCEngineAESSetKey(&key, keyBytes, keySize);
+            uint8_t chain[16];
+            memcpy(chain, iv, 16);
+            LKKCEngineAESEncryptCBC(&key, chain, input, output, 13);
+            LKKCEngineAESEncryptCBC(&key, chain, input + 13 * 16, output + 13 * 16, sizeof(input) / 16 - 13);
+            should(memcmp(output, reference, sizeof(output)) == 0);
+            memcpy(chain, iv, 16);
+            LKKCEngineAESDecryptCBC(&key, chain, output, output, sizeof(output) / 16);
+            should(memcmp(output, input, sizeof(output)) == 0);
+            
+            // The constant-time kernels agree with the table-based ones.
+            LKKCEngineAESEncryptECB(&key, input, reference, 8);
+            LKKCEngineAESEncryptECBConstantTime(&key, input, output, 8);
+            should(memcmp(output, reference, 8 * 16) == 0);
+            LKKCEngineAESDecryptECBConstantTime(&key, output, output, 8);
+            should(memcmp(output, input, 8 * 16) == 0);
+        }
+        LKKCEngineAESClearKey(&key);
+    }];
+}
+
+- (void)testCTR32
+{
+    uint8_t keyBytes[16], input[16 * 37], expected[sizeof(input)], output[sizeof(input)], counter[16];
+    arc4random_buf(keyBytes, sizeof(keyBytes));
+    arc4random_buf(input, sizeof(input));
+    LKKCEngineAESKey key;
+    LKKCEngineAESSetKey(&key, keyBytes, sizeof(keyBytes));
+    
+    // The reference: encrypt the counter blocks with ECB, wrapping around in the last 32 bits.
+    uint8_t start[16];
+    arc4random_buf(start, sizeof(start));
+    start[12] = start[13] = start[14] = 0xff;
+    start[15] = 0xf0;
+    memcpy(counter, start, 16);
+    for (size_t b = 0; b < sizeof(input) / 16; b++) {
+        LKKCEngineAESEncryptECB(&key, counter, expected + 16 * b, 1);
+        for (int i = 0; i < 16; i++)
+            expected[16 * b + i] ^= input[16 * b + i];
+        for (int i = 15; i >= 12 && ++counter[i] == 0; i--)
+            ;
+    }
+    
+    [self _withEachImplementation:^{
+        uint8_t c[16];
+        memcpy(c, start, 16);
+        LKKCEngineAESCTR32(&key, c, input, output, sizeof(input) / 16);
+        should(memcmp(output, expected, sizeof(output)) == 0);
+        should(memcmp(c, counter, 16) == 0);
+    }];
+}
+
+- (void)testGHASH
+{
+    uint8_t h[16], data[1000];
+    arc4random_buf(h, sizeof(h));
+    arc4random_buf(data, sizeof(data));
+    LKKCEngineGHASHKey key;
+    LKKCEngineGHASHSetKey(&key, h);
+    
+    // The portable and accelerated implementations agree, including on partial blocks.
+    for (size_t length = 0; length < 100; length += 7) {
+        __block uint8_t portable[16] = { 0 };
+        __block uint8_t fast[16] = { 0 };
+        __block BOOL first = YES;
+        [self _withEachImplementation:^{
+            LKKCEngineGHASHUpdate(&key, first ? portable : fast, data, length);
+            first = NO;
+        }];
+        should(memcmp(portable, fast, 16) == 0);
+    }
+    LKKCEngineGHASHClearKey(&key);
+}
+
+- (void)testSHA256
+{
+    [self _withEachImplementation:^{
+        // FIPS 180-2, appendix B.1
+        uint8_t digest[LKKCEngineSHA256DigestLength];
+        LKKCEngineSHA256Context context;
+        LKKCEngineSHA256Init(&context);
+        LKKCEngineSHA256Update(&context, "abc", 3);
+        LKKCEngineSHA256Final(&context, digest);
+        should(memcmp(digest, "\xba\x78\x16\xbf\x8f\x01\xcf\xea\x41\x41\x40\xde\x5d\xae\x22\x23"
+                      "\xb0\x03\x61\xa3\x96\x17\x7a\x9c\xb4\x10\xff\x61\xf2\x00\x15\xad", 32) == 0);
+        
+        // Matches CommonCrypto for all lengths around the block boundaries, fed in two pieces.
+        uint8_t data[300], reference[CC_SHA256_DIGEST_LENGTH];
+        arc4random_buf(data, sizeof(data));
+        for (size_t length = 0; length < sizeof(data); length++) {
+            CC_SHA256(data, (CC_LONG)length, reference);
+            size_t split = length / 3;
+            LKKCEngineSHA256Init(&context);
+            LKKCEngineSHA256Update(&context, data, split);
+            LKKCEngineSHA256Update(&context, data + split, length - split);
+            LKKCEngineSHA256Final(&context, digest);
+            should(memcmp(digest, reference, sizeof(digest)) == 0);
+        }
+    }];
+}
+
+@end
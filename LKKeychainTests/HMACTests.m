@@ -0,0 +1,136 @@
+//
+//  HMACTests.m
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright (c) 2011 Karoly Lorentey. All rights reserved.
+//
+
+#import "HMACTests.h"
+#import <CommonCrypto/CommonDigest.h>
+#import <CommonCrypto/CommonHMAC.h>
+
+@implementation HMACTests
+
+- (void)testDigest
+{
+    NSError *error = nil;
+    LKKCDigestContext *context = [LKKCDigestContext digestContextWithAlgorithm:LKKCDigestAlgorithmSHA256 error:&error];
+    should(context != nil);
+    should(context.digestLength == CC_SHA256_DIGEST_LENGTH);
+    should(context.SecKey == NULL);
+    
+    // FIPS 180-2, appendix B.1
+    const uint8_t expected[] = {
+        0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+        0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad
+    };
+    NSData *abc = [@"abc" dataUsingEncoding:NSUTF8StringEncoding];
+    shouldBeEqual([context digestData:abc], [NSData dataWithBytes:expected length:sizeof(expected)]);
+    
+    [context updateWithBytes:"a" length:1];
+    [context updateWithBytes:"bc" length:2];
+    should([context finishAndVerifyDigest:[NSData dataWithBytes:expected length:sizeof(expected)]]);
+    
+    // Plain digests of every algorithm match CommonCrypto.
+    NSData *message = [@"The quick brown fox jumps over the lazy dog" dataUsingEncoding:NSUTF8StringEncoding];
+    unsigned char *(*digestFunctions[])(const void *, CC_LONG, unsigned char *) = { CC_SHA1, CC_SHA224, CC_SHA256, CC_SHA384, CC_SHA512 };
+    for (LKKCDigestAlgorithm algorithm = LKKCDigestAlgorithmSHA1; algorithm <= LKKCDigestAlgorithmSHA512; algorithm++) {
+        LKKCDigestContext *c = [LKKCDigestContext digestContextWithAlgorithm:algorithm error:&error];
+        should(c != nil);
+        should(c.digestLength == [LKKCDigestContext digestLengthForAlgorithm:algorithm]);
+        uint8_t reference[CC_SHA512_DIGEST_LENGTH];
+        digestFunctions[algorithm]([message bytes], (CC_LONG)[message length], reference);
+        shouldBeEqual([c digestData:message], [NSData dataWithBytes:reference length:c.digestLength]);
+    }
+    
+    should([LKKCDigestContext digestContextWithAlgorithm:(LKKCDigestAlgorithm)42 error:NULL] == nil);
+}
+
+- (void)testHMAC
+{
+    NSError *error = nil;
+    uint8_t keyBytes[32];
+    for (int i = 0; i < sizeof(keyBytes); i++)
+        keyBytes[i] = i;
+    LKKCKey *key = [LKKCKey keyWithData:[NSData dataWithBytes:keyBytes length:sizeof(keyBytes)] keyClass:LKKCKeyClassSymmetric keyType:LKKCKeyTypeAES keySize:256];
+    should(key != nil);
+    
+    NSMutableData *message = [NSMutableData dataWithLength:100000];
+    arc4random_buf([message mutableBytes], [message length]);
+    
+    const CCHmacAlgorithm hmacAlgorithms[] = { kCCHmacAlgSHA1, kCCHmacAlgSHA224, kCCHmacAlgSHA256, kCCHmacAlgSHA384, kCCHmacAlgSHA512 };
+    for (LKKCDigestAlgorithm algorithm = LKKCDigestAlgorithmSHA1; algorithm <= LKKCDigestAlgorithmSHA512; algorithm++) {
+        uint8_t reference[CC_SHA512_DIGEST_LENGTH];
+        CCHmac(hmacAlgorithms[algorithm], keyBytes, sizeof(keyBytes), [message bytes], [message length], reference);
+        NSData *expected = [NSData dataWithBytes:reference length:[LKKCDigestContext digestLengthForAlgorithm:algorithm]];
+        
+        NSData *hmac = [key hmacForData:message digestAlgorithm:algorithm error:&error];
+        shouldBeEqual(hmac, expected);
+        // The second call reuses the pooled context.
+        shouldBeEqual([key hmacForData:message digestAlgorithm:algorithm error:&error], expected);
+        should([key verifyHMAC:expected forData:message digestAlgorithm:algorithm error:&error]);
+        
+        // Incremental operation gives the same result.
+        LKKCDigestContext *context = [LKKCDigestContext hmacContextForKey:key digestAlgorithm:algorithm error:&error];
+        should(context != nil);
+        should(context.SecKey == key.SecKey);
+        const uint8_t *bytes = [message bytes];
+        for (NSUInteger offset = 0; offset < [message length]; offset += 777)
+            [context updateWithBytes:bytes + offset length:MIN(777, [message length] - offset)];
+        shouldBeEqual([context finish], expected);
+        
+        // Copies are independent.
+        [context updateWithBytes:bytes length:1000];
+        LKKCDigestContext *copy = [[context copy] autorelease];
+        [copy updateWithBytes:bytes + 1000 length:[message length] - 1000];
+        shouldBeEqual([copy finish], expected);
+        [context updateWithBytes:bytes + 1000 length:[message length] - 1000];
+        shouldBeEqual([context finish], expected);
+    }
+    
+    // Tampered messages and HMACs are rejected.
+    NSData *hmac = [key hmacForData:message digestAlgorithm:LKKCDigestAlgorithmSHA256 error:&error];
+    NSMutableData *tampered = [[message mutableCopy] autorelease];
+    ((uint8_t *)[tampered mutableBytes])[500] ^= 1;
+    error = nil;
+    should(![key verifyHMAC:hmac forData:tampered digestAlgorithm:LKKCDigestAlgorithmSHA256 error:&error]);
+    should([error code] == CSSMERR_CSP_VERIFY_FAILED);
+    should(![key verifyHMAC:[hmac subdataWithRange:NSMakeRange(0, 16)] forData:message digestAlgorithm:LKKCDigestAlgorithmSHA256 error:NULL]);
+    
+    // HMACs need symmetric keys.
+    LKKCKeyGenerator *generator = [LKKCKeyGenerator generatorWithKeychain:_keychain];
+    LKKCKeyPair *keypair = [generator generateRSAKeyPairWithError:&error];
+    should(keypair != nil);
+    should([LKKCDigestContext hmacContextForKey:keypair.publicKey digestAlgorithm:LKKCDigestAlgorithmSHA256 error:NULL] == nil);
+}
+
+- (void)testHMACBatch
+{
+    NSError *error = nil;
+    uint8_t keyBytes[16] = "0123456789abcdef";
+    LKKCKey *key = [LKKCKey keyWithData:[NSData dataWithBytes:keyBytes length:sizeof(keyBytes)] keyClass:LKKCKeyClassSymmetric keyType:LKKCKeyTypeAES keySize:128];
+    LKKCDigestContext *context = [LKKCDigestContext hmacContextForKey:key digestAlgorithm:LKKCDigestAlgorithmSHA256 error:&error];
+    should(context != nil);
+    
+    NSMutableArray *messages = [NSMutableArray array];
+    for (int i = 0; i < 100; i++) {
+        NSMutableData *message = [NSMutableData dataWithLength:i * 13];
+        arc4random_buf([message mutableBytes], [message length]);
+        [messages addObject:message];
+    }
+    
+    // A message in progress is discarded.
+    [context updateWithBytes:"garbage" length:7];
+    
+    NSMutableData *output = [NSMutableData dataWithLength:[messages count] * context.digestLength];
+    [context digestMessages:messages output:[output mutableBytes]];
+    for (NSUInteger i = 0; i < [messages count]; i++) {
+        uint8_t reference[CC_SHA256_DIGEST_LENGTH];
+        NSData *message = [messages objectAtIndex:i];
+        CCHmac(kCCHmacAlgSHA256, keyBytes, sizeof(keyBytes), [message bytes], [message length], reference);
+        should(memcmp(reference, (uint8_t *)[output bytes] + i * CC_SHA256_DIGEST_LENGTH, CC_SHA256_DIGEST_LENGTH) == 0);
+    }
+}
+
+@end
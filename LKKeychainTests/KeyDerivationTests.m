@@ -0,0 +1,143 @@
+//
+//  KeyDerivationTests.m
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright (c) 2011 Karoly Lorentey. All rights reserved.
+//
+
+#import "KeyDerivationTests.h"
+
+@implementation KeyDerivationTests
+
+- (void)testPBKDF2
+{
+    NSError *error = nil;
+    LKKCKeyDeriver *deriver = [LKKCKeyDeriver deriver];
+    should(deriver.keyType == LKKCKeyTypeAES);
+    should(deriver.keySize == 256);
+    should(deriver.digestAlgorithm == LKKCDigestAlgorithmSHA256);
+    NSData *salt = [@"salt" dataUsingEncoding:NSUTF8StringEncoding];
+    
+    // PBKDF2-HMAC-SHA256 with P = "password", S = "salt".
+    LKKCKey *key = [deriver deriveKeyFromPassword:@"password" salt:salt iterations:1 error:&error];
+    should(key != nil);
+    should(key.keyClass == LKKCKeyClassSymmetric);
+    should(key.keyType == LKKCKeyTypeAES);
+    shouldBeEqual([key keyDataWithError:&error], [self dataFromHex:@"120fb6cffcf8b32c43e7225256c4f837a86548c92ccc35480805987cb70be17b"]);
+    
+    key = [deriver deriveKeyFromPassword:@"password" salt:salt iterations:4096 error:&error];
+    shouldBeEqual([key keyDataWithError:&error], [self dataFromHex:@"c5e478d59288c841aa530db6845c4c8d962893a001ce4e11a4963873aa98134a"]);
+    
+    deriver.keySize = 128;
+    key = [deriver deriveKeyFromPassword:@"password" salt:salt iterations:4096 error:&error];
+    should(key.keySize == 128);
+    shouldBeEqual([key keyDataWithError:&error], [self dataFromHex:@"c5e478d59288c841aa530db6845c4c8d"]);
+    
+    // Calibration scales with the target duration.
+    unsigned int fast = [deriver calibratedIterationsForDuration:0.01 passwordLength:16 saltLength:16];
+    unsigned int slow = [deriver calibratedIterationsForDuration:0.1 passwordLength:16 saltLength:16];
+    should(fast > 0);
+    should(slow > fast);
+    
+    should([deriver deriveKeyFromPassword:@"password" salt:salt iterations:0 error:NULL] == nil);
+    deriver.keyType = LKKCKeyTypeRSA;
+    should([deriver deriveKeyFromPassword:@"password" salt:salt iterations:1 error:NULL] == nil);
+}
+
+- (void)testScrypt
+{
+    NSError *error = nil;
+    LKKCKeyDeriver *deriver = [LKKCKeyDeriver deriver];
+    
+    // RFC 7914, section 12 (first 32 bytes of the 64-byte output).
+    LKKCKey *key = [deriver deriveKeyFromPassword:@"password" 
+                                             salt:[@"NaCl" dataUsingEncoding:NSUTF8StringEncoding] 
+                                       scryptCost:1024 
+                                        blockSize:8 
+                                      parallelism:16 
+                                            error:&error];
+    should(key != nil);
+    shouldBeEqual([key keyDataWithError:&error], [self dataFromHex:@"fdbabe1c9d3472007856e7190d01e9fe7c6ad7cbc8237830e77376634b373162"]);
+    
+    key = [deriver deriveKeyFromPassword:@"pleaseletmein" 
+                                    salt:[@"SodiumChloride" dataUsingEncoding:NSUTF8StringEncoding] 
+                              scryptCost:16384 
+                               blockSize:8 
+                             parallelism:1 
+                                   error:&error];
+    shouldBeEqual([key keyDataWithError:&error], [self dataFromHex:@"7023bdcb3afd7348461c06cd81fd38ebfda8fbba904f8e3ea9b543f6545da1f2"]);
+    
+    NSData *salt = [@"salt" dataUsingEncoding:NSUTF8StringEncoding];
+    should([deriver deriveKeyFromPassword:@"password" salt:salt scryptCost:1000 blockSize:8 parallelism:1 error:NULL] == nil);
+    should([deriver deriveKeyFromPassword:@"password" salt:salt scryptCost:1 blockSize:8 parallelism:1 error:NULL] == nil);
+    should([deriver deriveKeyFromPassword:@"password" salt:salt scryptCost:1ull << 40 blockSize:8 parallelism:1 error:NULL] == nil);
+}
+
+- (void)testHKDF
+{
+    NSError *error = nil;
+    LKKCKeyDeriver *deriver = [LKKCKeyDeriver deriver];
+    
+    // RFC 5869, test case 1 (first 32 bytes of the 42-byte output).
+    LKKCKey *key = [deriver deriveKeyFromKeyMaterial:[self dataFromHex:@"0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b"] 
+                                                salt:[self dataFromHex:@"000102030405060708090a0b0c"] 
+                                                info:[self dataFromHex:@"f0f1f2f3f4f5f6f7f8f9"] 
+                                               error:&error];
+    should(key != nil);
+    shouldBeEqual([key keyDataWithError:&error], [self dataFromHex:@"3cb25f25faacd57a90434f64d0362f2a2d2d0a90cf1a5a4c5db02d56ecc4c5bf"]);
+    
+    // RFC 5869, test case 3: no salt, no info.
+    key = [deriver deriveKeyFromKeyMaterial:[self dataFromHex:@"0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b"] salt:nil info:nil error:&error];
+    shouldBeEqual([key keyDataWithError:&error], [self dataFromHex:@"8da4e775a563c18f715f802a063c5a31b8a11f5c5ee1879ec3454e5f3c738d2d"]);
+    
+    // Subkeys are HKDF-Expand with the master key as the PRK; the PRK of test case 1 gives its output.
+    LKKCKey *master = [LKKCKey keyWithData:[self dataFromHex:@"077709362c2e32df0ddc3f0dc47bba6390b6c73bb50f9c3122ec844ad7c2b3e5"] 
+                                  keyClass:LKKCKeyClassSymmetric 
+                                   keyType:LKKCKeyTypeAES 
+                                   keySize:256];
+    LKKCKey *subkey = [deriver deriveSubkeyFromKey:master info:[self dataFromHex:@"f0f1f2f3f4f5f6f7f8f9"] error:&error];
+    should(subkey != nil);
+    shouldBeEqual([subkey keyDataWithError:&error], [self dataFromHex:@"3cb25f25faacd57a90434f64d0362f2a2d2d0a90cf1a5a4c5db02d56ecc4c5bf"]);
+    
+    LKKCKey *other = [deriver deriveSubkeyFromKey:master info:[@"other" dataUsingEncoding:NSUTF8StringEncoding] error:&error];
+    should(other != nil);
+    should(![[other keyDataWithError:&error] isEqualToData:[subkey keyDataWithError:&error]]);
+}
+
+- (void)testCache
+{
+    NSError *error = nil;
+    LKKCKeyDeriver *deriver = [LKKCKeyDeriver deriver];
+    NSData *salt = [@"salt" dataUsingEncoding:NSUTF8StringEncoding];
+    
+    LKKCKey *key = [deriver deriveKeyFromPassword:@"password" salt:salt iterations:100000 error:&error];
+    should(key != nil);
+    // A cache hit returns the original object rather than a new key with the same bits.
+    LKKCKey *cached = [deriver deriveKeyFromPassword:@"password" salt:salt iterations:100000 error:&error];
+    should(cached == key);
+    
+    // Any change in the inputs or key parameters is a different key.
+    should([deriver deriveKeyFromPassword:@"password" salt:salt iterations:100001 error:&error] != key);
+    should([deriver deriveKeyFromPassword:@"passwore" salt:salt iterations:100000 error:&error] != key);
+    deriver.keySize = 128;
+    should([deriver deriveKeyFromPassword:@"password" salt:salt iterations:100000 error:&error] != key);
+    deriver.keySize = 256;
+    should([deriver deriveKeyFromPassword:@"password" salt:salt iterations:100000 error:&error] == key);
+    
+    LKKCKey *master = [deriver deriveKeyFromKeyMaterial:salt salt:nil info:nil error:&error];
+    NSData *info = [@"session" dataUsingEncoding:NSUTF8StringEncoding];
+    LKKCKey *subkey = [deriver deriveSubkeyFromKey:master info:info error:&error];
+    should(subkey != nil);
+    should([deriver deriveSubkeyFromKey:master info:info error:&error] == subkey);
+    
+    [deriver removeAllCachedKeys];
+    LKKCKey *rederived = [deriver deriveKeyFromPassword:@"password" salt:salt iterations:100000 error:&error];
+    should(rederived != key);
+    shouldBeEqual([rederived keyDataWithError:&error], [key keyDataWithError:&error]);
+    
+    deriver.cacheLimit = 0;
+    should([deriver deriveSubkeyFromKey:master info:info error:&error] != subkey);
+}
+
+@end
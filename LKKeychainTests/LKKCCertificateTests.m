@@ -8,6 +8,8 @@
 
 #import <CommonCrypto/CommonDigest.h>
 #import "LKKCCertificateTests.h"
+#import <LKKeychain/LKKCDER.h>
+#import <LKKeychain/LKKCKeychainItem+Subclasses.h>
 
 @implementation LKKCCertificateTests
 
@@ -75,6 +77,26 @@
 }
 
 
+- (void)testDecodedPublicKeyHashMatchesKeychainAttribute
+{
+    // Floating certificates hash the subjectPublicKey bits from their DER data; 
+    // this must agree with the attribute the keychain computes for the same certificate.
+    NSError *error = nil;
+    for (LKKCCertificate *certificate in [self allTestCertificates]) {
+        BOOL res = [certificate addToKeychain:_keychain error:&error];
+        should(res);
+    }
+    NSArray *stored = [_keychain certificates];
+    should([stored count] == [[self allTestCertificates] count]);
+    for (LKKCCertificate *certificate in stored) {
+        NSData *attribute = [certificate valueForAttribute:kSecAttrPublicKeyHash];
+        should([attribute length] == CC_SHA1_DIGEST_LENGTH);
+        LKKCCertificate *floating = [LKKCCertificate certificateWithDERData:certificate.data];
+        shouldBeEqual(floating.publicKeyHash, attribute);
+        shouldBeEqual(floating.publicKeyHash, [self publicKeyHashForCertificate:floating]);
+    }
+}
+
 - (void)testValidCAValues
 {
     LKKCCertificate *certificate = [self validCA];
@@ -152,4 +174,99 @@
     shouldBeEqual(certificate.emailAddresses, [NSArray array]);
 }
 
+- (void)testDecodedFields
+{
+    LKKCCertificate *certificate = [self validCert];
+    
+    shouldBeEqual(certificate.notValidBefore, [NSDate dateWithTimeIntervalSince1970:1324476893]);
+    shouldBeEqual(certificate.notValidAfter, [NSDate dateWithTimeIntervalSince1970:1955196893]);
+    shouldBeEqual(certificate.DNSNames, [NSArray arrayWithObject:@"example.com"]);
+    shouldBeEqual(certificate.IPAddresses, [NSArray array]);
+    shouldBeEqual(certificate.extensionOIDs, ([NSArray arrayWithObjects:@"2.5.29.15", @"2.5.29.37", @"2.5.29.17", nil]));
+    
+    BOOL critical = NO;
+    shouldBeEqual([certificate valueForExtensionWithOID:@"2.5.29.15" critical:&critical], [NSData dataWithBytes:"\x03\x02\x07\x80" length:4]);
+    should(critical);
+    should([certificate valueForExtensionWithOID:@"2.5.29.19" critical:NULL] == nil);
+    
+    // The raw names are slices of the original encoding.
+    NSData *data = certificate.data;
+    NSData *rawSubject = certificate.rawSubject;
+    should([rawSubject length] > 2 && ((const UInt8 *)[rawSubject bytes])[0] == 0x30);
+    should([data rangeOfData:rawSubject options:0 range:NSMakeRange(0, [data length])].location != NSNotFound);
+    should([data rangeOfData:certificate.subjectPublicKeyInfo options:0 range:NSMakeRange(0, [data length])].location != NSNotFound);
+    
+    LKKCCertificate *other = [self validCertWithExpiredCA];
+    shouldBeEqual(other.IPAddresses, [NSArray arrayWithObject:[NSData dataWithBytes:"\x05\x07\x23\x10" length:4]]);
+    shouldBeEqual(other.rawIssuer, self.expiredCA.rawSubject);
+    
+    for (LKKCCertificate *cert in [self allTestCertificates]) {
+        should([cert.notValidBefore compare:cert.notValidAfter] == NSOrderedAscending);
+    }
+}
+
+- (void)testFingerprints
+{
+    LKKCCertificate *certificate = [self validCA];
+    char *sha1 = "\x7a\x56\xbc\x8e\x63\x73\xef\xa9\x5c\xe2\x54\xa7\xbb\x90\x50\x5c\x61\x14\x26\x79";
+    char *sha256 = "\xc0\xe3\xa8\x0b\x75\x9e\xdf\xbb\x54\x85\xe9\x59\x1f\x6c\xdc\xa2\xf3\x37\x14\x85\x46\xb1\x46\xa3\x8e\x34\xcf\x14\x13\xf0\x27\x8e";
+    
+    shouldBeEqual(certificate.SHA1Fingerprint, [NSData dataWithBytes:sha1 length:20]);
+    shouldBeEqual(certificate.SHA256Fingerprint, [NSData dataWithBytes:sha256 length:32]);
+    
+    // Derived values are computed only once.
+    should(certificate.SHA1Fingerprint == certificate.SHA1Fingerprint);
+    should(certificate.publicKeyHash == certificate.publicKeyHash);
+    should(certificate.commonName == certificate.commonName);
+    should(certificate.emailAddresses == certificate.emailAddresses);
+    should(certificate.contents == certificate.contents);
+    
+    NSError *error = nil;
+    BOOL res = [certificate addToKeychain:_keychain error:&error];
+    should(res);
+    shouldBeEqual(certificate.SHA1Fingerprint, [NSData dataWithBytes:sha1 length:20]);
+    shouldBeEqual(certificate.SHA256Fingerprint, [NSData dataWithBytes:sha256 length:32]);
+}
+
+- (void)testDERLengthEncoding
+{
+    UInt8 buffer[1 + sizeof(size_t)];
+    STAssertEquals(LKKCDEREncodeLength(0x7f, buffer), (size_t)1, @"");
+    should(buffer[0] == 0x7f);
+    STAssertEquals(LKKCDEREncodeLength(0x80, buffer), (size_t)2, @"");
+    should(buffer[0] == 0x81 && buffer[1] == 0x80);
+    STAssertEquals(LKKCDEREncodeLength(0x12345, buffer), (size_t)4, @"");
+    should(buffer[0] == 0x83 && buffer[1] == 0x01 && buffer[2] == 0x23 && buffer[3] == 0x45);
+}
+
+- (void)testDERDecodingMalformedInput
+{
+    NSData *data = [self validCert].data;
+    const UInt8 *bytes = [data bytes];
+    NSUInteger length = [data length];
+    LKKCDERCertificate der;
+    
+    should(LKKCDERDecodeCertificate(bytes, length, &der) == 0);
+    
+    // Every truncation must be rejected.
+    for (NSUInteger i = 0; i < length; i++) {
+        should(LKKCDERDecodeCertificate(bytes, i, &der) != 0);
+    }
+    
+    // Random corruption must never read outside the buffer.
+    NSMutableData *mutated = [NSMutableData dataWithData:data];
+    UInt8 *m = [mutated mutableBytes];
+    srandom(49);
+    for (int i = 0; i < 10000; i++) {
+        memcpy(m, bytes, length);
+        for (int j = 0; j < 4; j++)
+            m[random() % length] = (UInt8)random();
+        if (LKKCDERDecodeCertificate(m, length, &der) == 0) {
+            should(der.subject.bytes >= m && der.subject.bytes + der.subject.length <= m + length);
+        }
+    }
+    
+    should(LKKCDERDecodeCertificate([[self corruptCert].data bytes], [[self corruptCert].data length], &der) != 0);
+}
+
 @end
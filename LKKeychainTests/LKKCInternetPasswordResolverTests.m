@@ -0,0 +1,90 @@
+//
+//  LKKCInternetPasswordResolverTests.m
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright (c) 2011 Karoly Lorentey. All rights reserved.
+//
+
+#import "LKKCInternetPasswordResolverTests.h"
+
+@implementation LKKCInternetPasswordResolverTests
+
+- (LKKCInternetPassword *)addPasswordWithURL:(NSString *)urlString password:(NSString *)passwordString
+{
+    NSError *error = nil;
+    LKKCInternetPassword *password = [LKKCInternetPassword createPassword];
+    password.url = [NSURL URLWithString:urlString];
+    password.password = passwordString;
+    BOOL result = [password addToKeychain:_keychain error:&error];
+    should(result);
+    return password;
+}
+
+- (NSString *)passwordForURL:(NSString *)urlString resolver:(LKKCInternetPasswordResolver *)resolver
+{
+    return [resolver internetPasswordForURL:[NSURL URLWithString:urlString]].password;
+}
+
+- (void)testBestMatch
+{
+    [self addPasswordWithURL:@"http://example.com" password:@"root"];
+    [self addPasswordWithURL:@"http://example.com/admin" password:@"admin"];
+    [self addPasswordWithURL:@"https://example.com/admin" password:@"secure admin"];
+    [self addPasswordWithURL:@"http://example.com:8080/admin/tools" password:@"tools"];
+    [self addPasswordWithURL:@"http://other.example.com/admin" password:@"other"];
+    
+    LKKCInternetPasswordResolver *resolver = [LKKCInternetPasswordResolver resolverWithKeychain:_keychain];
+    should(resolver != nil);
+    shouldBeEqual(resolver.keychain, _keychain);
+    
+    shouldBeEqual([self passwordForURL:@"http://example.com/" resolver:resolver], @"root");
+    shouldBeEqual([self passwordForURL:@"http://EXAMPLE.com/index.html" resolver:resolver], @"root");
+    shouldBeEqual([self passwordForURL:@"http://example.com/administrator" resolver:resolver], @"root");
+    shouldBeEqual([self passwordForURL:@"http://example.com/admin" resolver:resolver], @"admin");
+    shouldBeEqual([self passwordForURL:@"http://example.com/admin/login.php" resolver:resolver], @"admin");
+    shouldBeEqual([self passwordForURL:@"https://example.com/admin/login.php" resolver:resolver], @"secure admin");
+    shouldBeEqual([self passwordForURL:@"http://example.com/admin/tools/x" resolver:resolver], @"admin");
+    shouldBeEqual([self passwordForURL:@"http://example.com:8080/admin/tools/x" resolver:resolver], @"tools");
+    shouldBeEqual([self passwordForURL:@"http://other.example.com/admin" resolver:resolver], @"other");
+    should([resolver internetPasswordForURL:[NSURL URLWithString:@"https://example.com/"]] == nil);
+    should([resolver internetPasswordForURL:[NSURL URLWithString:@"http://example.org/admin"]] == nil);
+    
+    NSArray *matches = [resolver internetPasswordsForURL:[NSURL URLWithString:@"http://example.com:8080/admin/tools"]];
+    should([matches count] == 3);
+    shouldBeEqual([[matches objectAtIndex:0] password], @"tools");
+    shouldBeEqual([[matches objectAtIndex:1] password], @"admin");
+    shouldBeEqual([[matches objectAtIndex:2] password], @"root");
+}
+
+- (void)testDefaultPorts
+{
+    [self addPasswordWithURL:@"https://example.com:443/" password:@"https"];
+    [self addPasswordWithURL:@"http://example.com:80/admin" password:@"http"];
+    
+    LKKCInternetPasswordResolver *resolver = [LKKCInternetPasswordResolver resolverWithKeychain:_keychain];
+    shouldBeEqual([self passwordForURL:@"https://example.com/" resolver:resolver], @"https");
+    shouldBeEqual([self passwordForURL:@"https://example.com:443/index.html" resolver:resolver], @"https");
+    shouldBeEqual([self passwordForURL:@"http://example.com/admin" resolver:resolver], @"http");
+    should([resolver internetPasswordForURL:[NSURL URLWithString:@"https://example.com:8443/"]] == nil);
+    should([resolver internetPasswordForURL:[NSURL URLWithString:@"http://example.com/"]] == nil);
+    should([resolver internetPasswordForURL:[NSURL URLWithString:@"http://example.com:8080/admin"]] == nil);
+}
+
+- (void)testReload
+{
+    LKKCInternetPasswordResolver *resolver = [LKKCInternetPasswordResolver resolverWithKeychain:_keychain];
+    should([resolver internetPasswordForURL:[NSURL URLWithString:@"http://example.com/admin"]] == nil);
+    
+    LKKCInternetPassword *password = [self addPasswordWithURL:@"http://example.com/admin" password:@"admin"];
+    [resolver reload];
+    shouldBeEqual([self passwordForURL:@"http://example.com/admin" resolver:resolver], @"admin");
+    
+    NSError *error = nil;
+    BOOL result = [password deleteItemWithError:&error];
+    should(result);
+    [resolver reload];
+    should([resolver internetPasswordForURL:[NSURL URLWithString:@"http://example.com/admin"]] == nil);
+}
+
+@end
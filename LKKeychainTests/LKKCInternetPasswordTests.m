@@ -7,6 +7,7 @@
 //
 
 #import "LKKCInternetPasswordTests.h"
+#import <LKKeychain/LKKCKeychainItem+Subclasses.h>
 
 @implementation LKKCInternetPasswordTests
 
@@ -280,4 +281,89 @@
     should([error code] == errSecDuplicateItem);
     
 }
+
+- (void)testProtocolMapping
+{
+    for (LKKCProtocol protocol = LKKCProtocolFTP; protocol < LKKCProtocolCount; protocol++) {
+        NSString *scheme = [LKKCInternetPassword urlSchemeFromProtocol:protocol];
+        should(scheme != nil && ![scheme isEqualToString:@"any"]);
+        should([LKKCInternetPassword protocolFromURLScheme:scheme] == protocol);
+    }
+    should([LKKCInternetPassword protocolFromURLScheme:@"no-such-scheme"] == LKKCProtocolAny);
+    should([LKKCInternetPassword protocolFromURLScheme:nil] == LKKCProtocolAny);
+    shouldBeEqual([LKKCInternetPassword urlSchemeFromProtocol:LKKCProtocolAny], @"any");
+}
+
+- (void)testProtocolAttributeMapping
+{
+    // Every enum value must map to its own kSecAttrProtocol constant and back.
+    const CFTypeRef *expected[LKKCProtocolCount] = {
+        [LKKCProtocolFTP] = &kSecAttrProtocolFTP,
+        [LKKCProtocolFTPAccount] = &kSecAttrProtocolFTPAccount,
+        [LKKCProtocolHTTP] = &kSecAttrProtocolHTTP,
+        [LKKCProtocolIRC] = &kSecAttrProtocolIRC,
+        [LKKCProtocolNNTP] = &kSecAttrProtocolNNTP,
+        [LKKCProtocolPOP3] = &kSecAttrProtocolPOP3,
+        [LKKCProtocolSMTP] = &kSecAttrProtocolSMTP,
+        [LKKCProtocolSOCKS] = &kSecAttrProtocolSOCKS,
+        [LKKCProtocolIMAP] = &kSecAttrProtocolIMAP,
+        [LKKCProtocolLDAP] = &kSecAttrProtocolLDAP,
+        [LKKCProtocolAppleTalk] = &kSecAttrProtocolAppleTalk,
+        [LKKCProtocolAFP] = &kSecAttrProtocolAFP,
+        [LKKCProtocolTelnet] = &kSecAttrProtocolTelnet,
+        [LKKCProtocolSSH] = &kSecAttrProtocolSSH,
+        [LKKCProtocolFTPS] = &kSecAttrProtocolFTPS,
+        [LKKCProtocolHTTPS] = &kSecAttrProtocolHTTPS,
+        [LKKCProtocolHTTPProxy] = &kSecAttrProtocolHTTPProxy,
+        [LKKCProtocolHTTPSProxy] = &kSecAttrProtocolHTTPSProxy,
+        [LKKCProtocolFTPProxy] = &kSecAttrProtocolFTPProxy,
+        [LKKCProtocolSMB] = &kSecAttrProtocolSMB,
+        [LKKCProtocolRTSP] = &kSecAttrProtocolRTSP,
+        [LKKCProtocolRTSPProxy] = &kSecAttrProtocolRTSPProxy,
+        [LKKCProtocolDAAP] = &kSecAttrProtocolDAAP,
+        [LKKCProtocolEPPC] = &kSecAttrProtocolEPPC,
+        [LKKCProtocolIPP] = &kSecAttrProtocolIPP,
+        [LKKCProtocolNNTPS] = &kSecAttrProtocolNNTPS,
+        [LKKCProtocolLDAPS] = &kSecAttrProtocolLDAPS,
+        [LKKCProtocolTelnetS] = &kSecAttrProtocolTelnetS,
+        [LKKCProtocolIMAPS] = &kSecAttrProtocolIMAPS,
+        [LKKCProtocolIRCS] = &kSecAttrProtocolIRCS,
+        [LKKCProtocolPOP3S] = &kSecAttrProtocolPOP3S
+    };
+    LKKCInternetPassword *password = [LKKCInternetPassword createPassword];
+    for (LKKCProtocol protocol = LKKCProtocolFTP; protocol < LKKCProtocolCount; protocol++) {
+        should(expected[protocol] != NULL);
+        if (expected[protocol] == NULL)
+            continue;
+        password.protocol = protocol;
+        shouldBeEqual([password valueForAttribute:kSecAttrProtocol], (id)*expected[protocol]);
+        should(password.protocol == protocol);
+    }
+}
+
+- (void)testAuthenticationTypeAttributeMapping
+{
+    const CFTypeRef *expected[LKKCAuthenticationTypeCount] = {
+        [LKKCAuthenticationTypeNTLM] = &kSecAttrAuthenticationTypeNTLM,
+        [LKKCAuthenticationTypeMSN] = &kSecAttrAuthenticationTypeMSN,
+        [LKKCAuthenticationTypeDPA] = &kSecAttrAuthenticationTypeDPA,
+        [LKKCAuthenticationTypeRPA] = &kSecAttrAuthenticationTypeRPA,
+        [LKKCAuthenticationTypeHTTPBasic] = &kSecAttrAuthenticationTypeHTTPBasic,
+        [LKKCAuthenticationTypeHTTPDigest] = &kSecAttrAuthenticationTypeHTTPDigest,
+        [LKKCAuthenticationTypeHTMLForm] = &kSecAttrAuthenticationTypeHTMLForm,
+        [LKKCAuthenticationTypeDefault] = &kSecAttrAuthenticationTypeDefault
+    };
+    LKKCInternetPassword *password = [LKKCInternetPassword createPassword];
+    for (LKKCAuthenticationType type = LKKCAuthenticationTypeNTLM; type < LKKCAuthenticationTypeCount; type++) {
+        should(expected[type] != NULL);
+        if (expected[type] == NULL)
+            continue;
+        password.authenticationType = type;
+        shouldBeEqual([password valueForAttribute:kSecAttrAuthenticationType], (id)*expected[type]);
+        should(password.authenticationType == type);
+    }
+    shouldBeEqual([LKKCInternetPassword stringFromAuthenticationType:LKKCAuthenticationTypeHTTPBasic], @"HTTPBasic");
+    shouldBeEqual([LKKCInternetPassword stringFromAuthenticationType:LKKCAuthenticationTypeDefault], @"Default");
+}
+
 @end
@@ -7,8 +7,66 @@
 //
 
 #import "LKKCKeyTests.h"
+#import <LKKeychain/LKKCKey+Private.h>
+#import <LKKeychain/LKKCKeychainItem+Subclasses.h>
 
 @implementation LKKCKeyTests
 
+- (void)testAlgorithmMapping
+{
+    const CFTypeRef *expected[LKKCKeyTypeCount] = {
+        [LKKCKeyTypeRSA] = &kSecAttrKeyTypeRSA,
+        [LKKCKeyTypeDSA] = &kSecAttrKeyTypeDSA,
+        [LKKCKeyTypeAES] = &kSecAttrKeyTypeAES,
+        [LKKCKeyTypeDES] = &kSecAttrKeyTypeDES,
+        [LKKCKeyType3DES] = &kSecAttrKeyType3DES,
+        [LKKCKeyTypeRC4] = &kSecAttrKeyTypeRC4,
+        [LKKCKeyTypeRC2] = &kSecAttrKeyTypeRC2,
+        [LKKCKeyTypeCAST] = &kSecAttrKeyTypeCAST,
+        [LKKCKeyTypeECDSA] = &kSecAttrKeyTypeECDSA
+    };
+    for (LKKCKeyType keyType = LKKCKeyTypeRSA; keyType < LKKCKeyTypeCount; keyType++) {
+        should(expected[keyType] != NULL);
+        if (expected[keyType] == NULL)
+            continue;
+        CFTypeRef algorithm = [LKKCKey _algorithmFromLKKCKeyType:keyType];
+        should(algorithm == *expected[keyType]);
+        should([LKKCKey _keyTypeFromAlgorithm:algorithm] == keyType);
+        
+        // Equal strings that aren't the framework constants must map the same way.
+        NSString *copy = [NSString stringWithString:(NSString *)algorithm];
+        should([LKKCKey _keyTypeFromAlgorithm:(CFTypeRef)copy] == keyType);
+    }
+    should([LKKCKey _keyTypeFromAlgorithm:CFSTR("17")] == LKKCKeyType3DES);
+    should([LKKCKey _keyTypeFromAlgorithm:CFSTR("-1")] == LKKCKeyTypeUnknown);
+    should([LKKCKey _keyTypeFromAlgorithm:NULL] == LKKCKeyTypeUnknown);
+    should([LKKCKey _algorithmFromLKKCKeyType:LKKCKeyTypeUnknown] == NULL);
+}
+
+
+- (void)testSharedAccess
+{
+    NSError *error = nil;
+    SecAccessRef access = [LKKCKeychainItem sharedAccessWithLabel:@"shared access" trustedApplications:nil error:&error];
+    should(access != NULL);
+    should([LKKCKeychainItem sharedAccessWithLabel:@"shared access" trustedApplications:nil error:&error] == access);
+    should([LKKCKeychainItem sharedAccessWithLabel:@"other access" trustedApplications:nil error:&error] != access);
+    
+    // No trusted applications isn't the same as the current application.
+    SecAccessRef untrusted = [LKKCKeychainItem sharedAccessWithLabel:@"shared access" trustedApplications:[NSArray array] error:&error];
+    should(untrusted != NULL && untrusted != access);
+    should([LKKCKeychainItem sharedAccessWithLabel:@"shared access" trustedApplications:[NSArray array] error:&error] == untrusted);
+    
+    // Items added with the same access object are independent.
+    LKKCKeyGenerator *generator = [LKKCKeyGenerator generatorWithKeychain:nil];
+    generator.label = @"shared access";
+    LKKCKey *key1 = [generator generateAESKeyWithError:&error];
+    LKKCKey *key2 = [generator generateAESKeyWithError:&error];
+    should([key1 addToKeychain:_keychain error:&error]);
+    should([key2 addToKeychain:_keychain error:&error]);
+    should([key1 deleteItemWithError:&error]);
+    should(![key2 isDeleted]);
+    should([[_keychain symmetricKeys] count] == 1);
+}
 
 @end
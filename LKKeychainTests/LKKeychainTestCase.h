@@ -22,6 +22,7 @@
 - (LKKCKeychain *)createTestKeychain:(NSString *)name;
 
 - (NSData *)dataFromResource:(NSString *)resource ofType:(NSString *)extension;
+- (NSData *)dataFromHex:(NSString *)hex;
 - (LKKCCertificate *)certificateFromResourceName:(NSString *)name;
 - (LKKCCertificate *)validCA;
 - (LKKCCertificate *)expiredCA;
@@ -56,6 +56,19 @@
     return data;
 }
 
+- (NSData *)dataFromHex:(NSString *)hex
+{
+    should([hex length] % 2 == 0);
+    NSMutableData *data = [NSMutableData dataWithLength:[hex length] / 2];
+    uint8_t *bytes = [data mutableBytes];
+    for (NSUInteger i = 0; i < [data length]; i++) {
+        unsigned int byte = 0;
+        should([[NSScanner scannerWithString:[hex substringWithRange:NSMakeRange(2 * i, 2)]] scanHexInt:&byte]);
+        bytes[i] = byte;
+    }
+    return data;
+}
+
 - (LKKCCertificate *)certificateFromResourceName:(NSString *)name
 {
     NSData *DERData = [self dataFromResource:name ofType:@"cer"];
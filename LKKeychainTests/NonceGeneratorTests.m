@@ -0,0 +1,109 @@
+//
+//  NonceGeneratorTests.m
+//  LKKeychain
+//
+//  Created by Karoly Lorentey on 2026-10-19.
+//  Copyright (c) 2011 Karoly Lorentey. All rights reserved.
+//
+
+#import "NonceGeneratorTests.h"
+
+@implementation NonceGeneratorTests
+
+- (void)testCounterNonces
+{
+    NSError *error = nil;
+    LKKCNonceGenerator *generator = [LKKCNonceGenerator gcmNonceGenerator];
+    should(generator.length == 12);
+    
+    NSData *first = [generator nextNonce];
+    NSData *second = [generator nextNonce];
+    should([first length] == 12);
+    shouldBeEqual([first subdataWithRange:NSMakeRange(0, 8)], [second subdataWithRange:NSMakeRange(0, 8)]);
+    const uint8_t one[4] = { 0, 0, 0, 1 };
+    shouldBeEqual([second subdataWithRange:NSMakeRange(8, 4)], [NSData dataWithBytes:one length:4]);
+    should(generator.remainingCount == ((uint64_t)1 << 32) - 2);
+    
+    // Separate generators get separate random prefixes.
+    should(![[[LKKCNonceGenerator gcmNonceGenerator] nextNonce] isEqualToData:first]);
+    
+    // Bulk nonces continue the same sequence.
+    NSMutableData *nonces = [NSMutableData dataWithLength:1000 * 12];
+    should([generator getNonces:[nonces mutableBytes] count:1000 error:&error]);
+    NSMutableSet *set = [NSMutableSet setWithObjects:first, second, nil];
+    for (NSUInteger i = 0; i < 1000; i++)
+        [set addObject:[nonces subdataWithRange:NSMakeRange(12 * i, 12)]];
+    should([set count] == 1002);
+}
+
+- (void)testCounterExhaustion
+{
+    NSError *error = nil;
+    const uint8_t prefix[3] = { 0xAA, 0xBB, 0xCC };
+    LKKCNonceGenerator *generator = [LKKCNonceGenerator counterNonceGeneratorWithPrefix:[NSData dataWithBytes:prefix length:3] length:4];
+    should(generator.remainingCount == 256);
+    const uint8_t expected[4] = { 0xAA, 0xBB, 0xCC, 0x00 };
+    shouldBeEqual([generator nextNonce], [NSData dataWithBytes:expected length:4]);
+    
+    uint8_t buffer[256 * 4];
+    should(![generator getNonces:buffer count:256 error:&error]);
+    should([generator getNonces:buffer count:255 error:&error]);
+    should(buffer[255 * 4 - 1] == 0xFF);
+    should(generator.remainingCount == 0);
+    should([generator nextNonce] == nil);
+    
+    should([LKKCNonceGenerator counterNonceGeneratorWithPrefix:[NSData dataWithBytes:prefix length:3] length:3] == nil);
+    should([LKKCNonceGenerator counterNonceGeneratorWithPrefix:nil length:17] == nil);
+    
+    // Random prefixes are at least 8 bytes long.
+    should([LKKCNonceGenerator counterNonceGeneratorWithPrefix:nil length:11] == nil);
+    should([LKKCNonceGenerator counterNonceGeneratorWithPrefix:nil length:16].remainingCount == (uint64_t)1 << 32);
+}
+
+- (void)testConcurrentNonces
+{
+    LKKCNonceGenerator *generator = [LKKCNonceGenerator gcmNonceGenerator];
+    const NSUInteger threads = 8;
+    const NSUInteger perThread = 10000;
+    NSMutableData *nonces = [NSMutableData dataWithLength:threads * perThread * 12];
+    uint8_t *bytes = [nonces mutableBytes];
+    dispatch_apply(threads, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t t) {
+        for (NSUInteger i = 0; i < perThread; i += 100)
+            [generator getNonces:bytes + 12 * (t * perThread + i) count:100 error:NULL];
+    });
+    NSMutableSet *set = [NSMutableSet set];
+    for (NSUInteger i = 0; i < threads * perThread; i++)
+        [set addObject:[nonces subdataWithRange:NSMakeRange(12 * i, 12)]];
+    should([set count] == threads * perThread);
+}
+
+- (void)testRandomNonces
+{
+    NSError *error = nil;
+    LKKCNonceGenerator *generator = [LKKCNonceGenerator randomNonceGeneratorWithLength:16];
+    should(generator.remainingCount == UINT64_MAX);
+    NSMutableSet *set = [NSMutableSet set];
+    for (int i = 0; i < 1000; i++) {
+        NSData *nonce = [generator nextNonce];
+        should([nonce length] == 16);
+        [set addObject:nonce];
+    }
+    NSMutableData *nonces = [NSMutableData dataWithLength:1000 * 16];
+    should([generator getNonces:[nonces mutableBytes] count:1000 error:&error]);
+    for (NSUInteger i = 0; i < 1000; i++)
+        [set addObject:[nonces subdataWithRange:NSMakeRange(16 * i, 16)]];
+    should([set count] == 2000);
+}
+
+- (void)testRandomInitVector
+{
+    NSError *error = nil;
+    LKKCKey *key = [[LKKCKeyGenerator generatorWithKeychain:_keychain] generateAESKeyWithError:&error];
+    should(key != nil);
+    NSData *iv = [key randomInitVector];
+    should([iv length] == key.blockSize);
+    should(![iv isEqualToData:[key randomInitVector]]);
+    should([[key randomNonce] length] == 12);
+}
+
+@end
@@ -129,9 +129,18 @@
         LKKCKeyGenerator *generator = [LKKCKeyGenerator generatorWithKeychain:nil];
         should(generator != nil);
         generator.label = @"floating RSA key label";
-        generator.tag = [@"floating RSA key tag" dataUsingEncoding:NSUTF8StringEncoding];
+        NSData *tag = [@"floating RSA key tag" dataUsingEncoding:NSUTF8StringEncoding];
+        generator.tag = tag;
         LKKCKeyPair *keypair = [generator generateRSAKeyPairWithError:&error];
-        should(keypair == nil);
+        should(keypair != nil);
+        should(keypair.publicKey.keychain == nil);
+        should(keypair.privateKey.keychain == nil);
+        should(keypair.privateKey.keySize == 2048);
+        shouldBeEqual(keypair.privateKey.label, @"floating RSA key label");
+        shouldBeEqual(keypair.privateKey.tag, tag);
+        
+        NSData *plaintext = [@"floating" dataUsingEncoding:NSUTF8StringEncoding];
+        shouldBeEqual([keypair decryptData:[keypair encryptData:plaintext error:&error] error:&error], plaintext);
     }
 }
 
@@ -158,4 +167,208 @@
     shouldBeEqual(decryptedMessage, message);
 }
 
+- (void)testRSASignature
+{
+    NSError *error = nil;
+    LKKCKeyPair *keypair = [[LKKCKeyGenerator generatorWithKeychain:_keychain] generateRSAKeyPairWithError:&error];
+    should(keypair != nil);
+    NSData *message = [@"This is some sample plaintext" dataUsingEncoding:NSUTF8StringEncoding];
+    
+    LKKCDigestAlgorithm algorithms[] = { LKKCDigestAlgorithmSHA1, LKKCDigestAlgorithmSHA224, LKKCDigestAlgorithmSHA256, LKKCDigestAlgorithmSHA384, LKKCDigestAlgorithmSHA512 };
+    for (int i = 0; i < sizeof(algorithms) / sizeof(algorithms[0]); i++) {
+        NSData *signature = [keypair signData:message digestAlgorithm:algorithms[i] error:&error];
+        should(signature != nil);
+        should([signature length] == 256);
+        should([keypair verifySignature:signature forData:message digestAlgorithm:algorithms[i] error:&error]);
+        
+        NSMutableData *modified = [NSMutableData dataWithData:message];
+        ((uint8_t *)[modified mutableBytes])[0] ^= 1;
+        should(![keypair verifySignature:signature forData:modified digestAlgorithm:algorithms[i] error:&error]);
+        should([error code] == CSSMERR_CSP_VERIFY_FAILED);
+    }
+    
+    // Signing a message in pieces gives a signature that verifies against the whole message.
+    LKKCSignatureContext *sc = [LKKCSignatureContext signatureContextForKey:keypair.privateKey digestAlgorithm:LKKCDigestAlgorithmSHA256 error:&error];
+    should(sc.signing);
+    should([sc updateWithData:[message subdataWithRange:NSMakeRange(0, 10)] error:&error]);
+    should([sc updateWithData:[message subdataWithRange:NSMakeRange(10, [message length] - 10)] error:&error]);
+    NSData *signature = [sc signWithError:&error];
+    should([keypair.publicKey verifySignature:signature forData:message digestAlgorithm:LKKCDigestAlgorithmSHA256 error:&error]);
+    
+    LKKCSignatureContext *vc = [LKKCSignatureContext signatureContextForKey:keypair.publicKey digestAlgorithm:LKKCDigestAlgorithmSHA256 error:&error];
+    should(!vc.signing);
+    should([vc updateWithData:message error:&error]);
+    should([vc verifySignature:signature error:&error]);
+    should([vc signWithError:&error] == nil);
+}
+
+- (void)testRSABatchVerification
+{
+    NSError *error = nil;
+    LKKCKeyPair *keypair = [[LKKCKeyGenerator generatorWithKeychain:_keychain] generateRSAKeyPairWithError:&error];
+    should(keypair != nil);
+    
+    const NSUInteger count = 200;
+    NSMutableArray *messages = [NSMutableArray array];
+    NSMutableArray *signatures = [NSMutableArray array];
+    for (NSUInteger i = 0; i < count; i++) {
+        NSData *message = [[NSString stringWithFormat:@"Message %lu", (unsigned long)i] dataUsingEncoding:NSUTF8StringEncoding];
+        NSData *signature = [keypair signData:message digestAlgorithm:LKKCDigestAlgorithmSHA256 error:&error];
+        should(signature != nil);
+        if (i % 7 == 3) {
+            // Corrupt every 7th signature.
+            NSMutableData *modified = [NSMutableData dataWithData:signature];
+            ((uint8_t *)[modified mutableBytes])[10] ^= 1;
+            signature = modified;
+        }
+        [messages addObject:message];
+        [signatures addObject:signature];
+    }
+    
+    BOOL results[count];
+    BOOL success = [keypair verifySignatures:signatures forMessages:messages digestAlgorithm:LKKCDigestAlgorithmSHA256 results:results error:&error];
+    should(success);
+    for (NSUInteger i = 0; i < count; i++) {
+        should(results[i] == (i % 7 != 3));
+    }
+    
+    should(![keypair verifySignatures:signatures forMessages:[messages subarrayWithRange:NSMakeRange(0, 10)] digestAlgorithm:LKKCDigestAlgorithmSHA256 results:NULL error:&error]);
+}
+
+- (void)testRSAEnvelopeEncryption
+{
+    NSError *error = nil;
+    LKKCKeyPair *keypair = [[LKKCKeyGenerator generatorWithKeychain:_keychain] generateRSAKeyPairWithError:&error];
+    should(keypair != nil);
+    should(keypair.envelopeKeyReuseLimit == 1);
+    
+    // Much larger than the RSA modulus.
+    NSMutableData *plaintext = [NSMutableData dataWithLength:3 * 1024 * 1024 + 17];
+    arc4random_buf([plaintext mutableBytes], [plaintext length]);
+    NSData *envelope = [keypair encryptEnvelope:plaintext error:&error];
+    should(envelope != nil);
+    shouldBeEqual([keypair decryptEnvelope:envelope error:&error], plaintext);
+    
+    // Empty messages work too.
+    NSData *empty = [keypair encryptEnvelope:[NSData data] error:&error];
+    should(empty != nil);
+    should([[keypair decryptEnvelope:empty error:&error] length] == 0);
+    
+    // Every envelope gets a new session key by default.
+    NSData *message = [@"Hello" dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *first = [keypair encryptEnvelope:message error:&error];
+    NSData *second = [keypair encryptEnvelope:message error:&error];
+    NSUInteger wrappedKeyLength = (((const uint8_t *)[first bytes])[6] << 8) | ((const uint8_t *)[first bytes])[7];
+    NSRange wrappedKeyRange = NSMakeRange(8, wrappedKeyLength);
+    should(![[first subdataWithRange:wrappedKeyRange] isEqualToData:[second subdataWithRange:wrappedKeyRange]]);
+    
+    // With reuse enabled, consecutive envelopes share the wrapped session key but not their nonces.
+    keypair.envelopeKeyReuseLimit = 3;
+    NSMutableArray *envelopes = [NSMutableArray array];
+    for (int i = 0; i < 4; i++)
+        [envelopes addObject:[keypair encryptEnvelope:message error:&error]];
+    NSData *wrappedKey = [[envelopes objectAtIndex:0] subdataWithRange:wrappedKeyRange];
+    shouldBeEqual([[envelopes objectAtIndex:1] subdataWithRange:wrappedKeyRange], wrappedKey);
+    shouldBeEqual([[envelopes objectAtIndex:2] subdataWithRange:wrappedKeyRange], wrappedKey);
+    should(![[[envelopes objectAtIndex:3] subdataWithRange:wrappedKeyRange] isEqualToData:wrappedKey]);
+    should(![[envelopes objectAtIndex:0] isEqualToData:[envelopes objectAtIndex:1]]);
+    for (NSData *e in envelopes)
+        shouldBeEqual([keypair decryptEnvelope:e error:&error], message);
+    
+    // Modified envelopes are rejected.
+    NSMutableData *modified = [NSMutableData dataWithData:envelope];
+    ((uint8_t *)[modified mutableBytes])[[modified length] - 100] ^= 1;
+    should([keypair decryptEnvelope:modified error:NULL] == nil);
+    should([keypair decryptEnvelope:[envelope subdataWithRange:NSMakeRange(0, 100)] error:NULL] == nil);
+    should([keypair decryptEnvelope:message error:NULL] == nil);
+    
+    // A corrupted session key fails exactly like a corrupted payload.
+    NSError *payloadError = nil;
+    should([keypair decryptEnvelope:modified error:&payloadError] == nil);
+    NSMutableData *badKey = [NSMutableData dataWithData:envelope];
+    ((uint8_t *)[badKey mutableBytes])[8 + wrappedKeyLength / 2] ^= 1;
+    NSError *keyError = nil;
+    should([keypair decryptEnvelope:badKey error:&keyError] == nil);
+    should(payloadError != nil && keyError != nil);
+    shouldBeEqual([keyError domain], [payloadError domain]);
+    should([keyError code] == [payloadError code]);
+    shouldBeEqual([keyError localizedDescription], [payloadError localizedDescription]);
+}
+
+- (void)testRSAKeyWrap
+{
+    NSError *error = nil;
+    LKKCKeyPair *keypair = [[LKKCKeyGenerator generatorWithKeychain:_keychain] generateRSAKeyPairWithError:&error];
+    should(keypair != nil);
+    
+    NSMutableArray *keys = [NSMutableArray array];
+    for (int i = 0; i < 20; i++) {
+        NSMutableData *bits = [NSMutableData dataWithLength:32];
+        arc4random_buf([bits mutableBytes], 32);
+        [keys addObject:[LKKCKey keyWithData:bits keyClass:LKKCKeyClassSymmetric keyType:LKKCKeyTypeAES keySize:256]];
+    }
+    NSArray *wrappedKeys = [keypair.publicKey wrapKeys:keys error:&error];
+    should([wrappedKeys count] == [keys count]);
+    NSArray *unwrappedKeys = [keypair.privateKey unwrapKeys:wrappedKeys keyType:LKKCKeyTypeAES keySize:256 error:&error];
+    should([unwrappedKeys count] == [keys count]);
+    for (NSUInteger i = 0; i < [keys count]; i++)
+        shouldBeEqual([[unwrappedKeys objectAtIndex:i] keyDataWithError:&error], [[keys objectAtIndex:i] keyDataWithError:&error]);
+    
+    // Keys only wrap one way.
+    should([keypair.privateKey wrapKey:[keys objectAtIndex:0] error:NULL] == nil);
+    should([keypair.publicKey unwrapKey:[wrappedKeys objectAtIndex:0] keyType:LKKCKeyTypeAES keySize:256 error:NULL] == nil);
+    should([keypair.privateKey unwrapKey:[wrappedKeys objectAtIndex:0] keyType:LKKCKeyTypeAES keySize:128 error:NULL] == nil);
+}
+
+- (void)testRSAKeyPairPool
+{
+    NSError *error = nil;
+    LKKCKeyGenerator *generator = [LKKCKeyGenerator generatorWithKeychain:_keychain];
+    generator.keySize = 1024;
+    generator.keyPairPoolSize = 2;
+    [generator fillKeyPairPoolWithKeyType:LKKCKeyTypeRSA keySize:1024];
+    NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:60];
+    while ([generator readyKeyPairCountWithKeyType:LKKCKeyTypeRSA keySize:1024] < 2 && [deadline timeIntervalSinceNow] > 0)
+        usleep(10000);
+    should([generator readyKeyPairCountWithKeyType:LKKCKeyTypeRSA keySize:1024] == 2);
+    should([generator readyKeyPairCountWithKeyType:LKKCKeyTypeRSA keySize:2048] == 0);
+    // Ready pairs aren't in the keychain yet.
+    should([[_keychain privateKeys] count] == 0);
+    
+    // Pooled pairs get the attributes that are current when they're handed out, and go into the keychain then.
+    NSData *tag = [@"pooled key tag" dataUsingEncoding:NSUTF8StringEncoding];
+    generator.label = @"pooled key label";
+    generator.applicationLabel = @"pooled application label";
+    generator.tag = tag;
+    LKKCKeyPair *keypair = [generator generateRSAKeyPairWithError:&error];
+    should(keypair != nil);
+    should(keypair.publicKey.keySize == 1024);
+    should(keypair.privateKey.keychain != nil);
+    should(keypair.publicKey.keychain != nil);
+    shouldBeEqual(keypair.publicKey.label, @"pooled key label");
+    shouldBeEqual(keypair.privateKey.label, @"pooled key label");
+    shouldBeEqual(keypair.privateKey.applicationLabel, @"pooled application label");
+    shouldBeEqual(keypair.publicKey.tag, tag);
+    shouldBeEqual(keypair.privateKey.tag, tag);
+    should([[_keychain privateKeys] count] == 1);
+    should([generator readyKeyPairCountWithKeyType:LKKCKeyTypeRSA keySize:1024] <= 1);
+    
+    NSData *plaintext = [@"Hello" dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *ciphertext = [keypair.publicKey encryptData:plaintext initVector:nil error:&error];
+    shouldBeEqual([keypair.privateKey decryptData:ciphertext initVector:nil error:&error], plaintext);
+    
+    // Draining discards unclaimed pairs but leaves handed-out ones alone.
+    [generator drainKeyPairPool];
+    should([generator readyKeyPairCountWithKeyType:LKKCKeyTypeRSA keySize:1024] == 0);
+    should(![keypair.publicKey isDeleted]);
+    should([[_keychain privateKeys] count] == 1);
+    
+    // Without a pool, pairs are generated on demand as before.
+    generator.applicationLabel = nil;
+    generator.keyPairPoolSize = 0;
+    keypair = [generator generateRSAKeyPairWithError:&error];
+    should(keypair != nil);
+    shouldBeEqual(keypair.privateKey.label, @"pooled key label");
+}
+
 @end